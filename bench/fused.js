@@ -0,0 +1,67 @@
+/* jshint esversion: 6 */
+
+/**
+  * compares a chain of native elementwise ops, the same chain run with lazy
+  * evaluation enabled, and the expression compiled with tensor.fused.
+  *
+  * usage: node bench/fused.js [size]
+  */
+
+var astute = require('../astute');
+var tensor = astute.tensor;
+
+var size = parseInt(process.argv[2]) || 10000000;
+var repetitions = 10;
+
+function lazily(func) {
+  return () => {
+    tensor.setLazyEvaluation(true);
+    try {
+      return tensor.lazy.materialize(func());
+    } finally {
+      tensor.setLazyEvaluation(false);
+    }
+  };
+}
+
+function time(func) {
+  func();
+  var start = process.hrtime();
+  for(let i=0; i<repetitions; i++) {
+    func();
+  }
+  var elapsed = process.hrtime(start);
+  return (elapsed[0] * 1e3 + elapsed[1] / 1e6) / repetitions;
+}
+
+var x = tensor.random.normalLike([size], 0, 1);
+var y = tensor.random.normalLike([size], 0, 1);
+var z = tensor.random.uniformLike([size], 1, 2);
+var absY = y.abs();
+var dest = tensor.zerosLike(x);
+
+var logistic = tensor.fused.compile((x, y) => x.mul(y).neg().exp().add(1).log());
+var freeRex = tensor.fused.compile((g, a, eta, lr) =>
+  g.sign().neg().mul(a.div(eta.sqrt()).mul(lr).exp().sub(1)));
+
+var benchmarks = {
+  logisticLoss: [
+    () => x.mul(y).scale(-1).exp().add(1).log(),
+    () => logistic(x, y, dest)
+  ],
+  freeRexUpdate: [
+    () => x.sign().scale(-1).mul(tensor.exp(absY.divideScale(z.sqrt(), 0.45)).sub(1)),
+    () => freeRex(x, absY, z, 0.45, dest)
+  ]
+};
+
+console.log('size: ' + size);
+console.log('op\t\tchained (ms)\tlazy (ms)\tfused (ms)');
+for(let name in benchmarks) {
+  let [chained, fused] = benchmarks[name];
+  let chainedTime = time(chained);
+  let lazyTime = time(lazily(chained));
+  let fusedTime = time(fused);
+  console.log(name + '\t' + chainedTime.toFixed(2) + '\t\t' + lazyTime.toFixed(2) +
+              '\t\t' + fusedTime.toFixed(2));
+}
@@ -0,0 +1,84 @@
+/* jshint esversion: 6 */
+
+/**
+  * compares float64 storage against mixed-precision float32 storage:
+  * throughput of bandwidth-bound ops and accuracy of the reductions
+  * relative to the all-double path.
+  *
+  * usage: node bench/mixedPrecision.js [size]
+  */
+
+var astute = require('../astute');
+var tensor = astute.tensor;
+
+var size = parseInt(process.argv[2]) || 10000000;
+var repetitions = 10;
+
+function time(func) {
+  func();
+  var start = process.hrtime();
+  for(let i=0; i<repetitions; i++) {
+    func();
+  }
+  var elapsed = process.hrtime(start);
+  return (elapsed[0] * 1e3 + elapsed[1] / 1e6) / repetitions;
+}
+
+var x64 = tensor.random.normalLike([size], 0, 1);
+var y64 = tensor.random.normalLike([size], 0, 1);
+var x32 = x64.toDataType('float32');
+var y32 = y64.toDataType('float32');
+var dest64 = tensor.zerosLike(x64);
+var dest32 = tensor.zerosLike(x32);
+//x as a row and y as a column: their dot product as a contraction of two
+//dimensions, which takes the generic path whatever the dtypes, as no BLAS
+//routine does it.
+var xRow64 = new tensor.Tensor({shape: [1, size], data: x64.data});
+var xRow32 = new tensor.Tensor({shape: [1, size], data: x32.data});
+var yColumn64 = new tensor.Tensor({shape: [size, 1], data: y64.data});
+
+var benchmarks = {
+  sum: [() => x64.sum(), () => x32.sum()],
+  dot: [() => x64.dot(y64), () => x32.dot(y32)],
+  contractFallback: [
+    () => xRow64.contract(yColumn64, 2),
+    () => xRow32.contract(yColumn64, 2)
+  ],
+  addScale: [
+    () => tensor.addScale(x64, y64, 1, 2, dest64),
+    () => tensor.addScale(x32, y32, 1, 2, dest32)
+  ]
+};
+
+console.log('size: ' + size);
+console.log('op\t\tfloat64 (ms)\tfloat32 (ms)\tspeedup');
+for(let name in benchmarks) {
+  let [op64, op32] = benchmarks[name];
+  let t64 = time(op64);
+  let t32 = time(op32);
+  console.log(name + '\t' + (name.length < 8 ? '\t' : '') +
+              t64.toFixed(2) + '\t\t' + t32.toFixed(2) + '\t\t' + (t64/t32).toFixed(2) + 'x');
+}
+
+//accuracy is measured against the double path run on the (already rounded)
+//float32 values, so it isolates the error of the accumulation itself.
+var xRounded = x32.toDataType('float64');
+var yRounded = y32.toDataType('float64');
+function relativeError(value, reference) {
+  return Math.abs(value - reference) / Math.max(Math.abs(reference), 1e-300);
+}
+
+var naiveSum = 0;
+var naiveDot = 0;
+for(let i=0; i<size; i++) {
+  naiveSum = Math.fround(naiveSum + x32.data[i]);
+  naiveDot = Math.fround(naiveDot + Math.fround(x32.data[i] * y32.data[i]));
+}
+
+var referenceSum = xRounded.sum().data[0];
+var referenceDot = xRounded.dot(yRounded).data[0];
+console.log('\naccuracy relative to the all-double path:');
+console.log('sum, double accumulation:\t' + relativeError(x32.sum().data[0], referenceSum).toExponential(2));
+console.log('sum, float accumulation:\t' + relativeError(naiveSum, referenceSum).toExponential(2));
+console.log('dot, double accumulation:\t' + relativeError(x32.dot(y32).data[0], referenceDot).toExponential(2));
+console.log('dot, float accumulation:\t' + relativeError(naiveDot, referenceDot).toExponential(2));
@@ -5,7 +5,14 @@
       "sources": [
         "csrc/tensorBinding.cc",
         "csrc/tensor.cc",
-        "csrc/mathops.cc"
+        "csrc/mathops.cc",
+        "csrc/fused.cc",
+        "csrc/random.cc",
+        "csrc/sparse.cc",
+        "csrc/decompose.cc",
+        "csrc/linalg.cc",
+        "csrc/losses.cc",
+        "csrc/optimizers.cc"
         ],
       "cflags!": [
         "-fno-exceptions"
@@ -0,0 +1,61 @@
+#pragma once
+#include "cblas.h"
+#include "tensor.h"
+
+namespace tensor {
+
+/**
+  * row-major BLAS-3 calls overloaded on the storage type, so that kernels
+  * templated on double or float storage can call one name.
+  */
+inline void gemm(CBLAS_TRANSPOSE transpose1, CBLAS_TRANSPOSE transpose2, int m, int n, int k,
+                 double alpha, const double* source1, int stride1, const double* source2, int stride2,
+                 double beta, double* dest, int destStride) {
+  cblas_dgemm(CblasRowMajor, transpose1, transpose2, m, n, k, alpha, source1, stride1,
+              source2, stride2, beta, dest, destStride);
+}
+
+inline void gemm(CBLAS_TRANSPOSE transpose1, CBLAS_TRANSPOSE transpose2, int m, int n, int k,
+                 double alpha, const float* source1, int stride1, const float* source2, int stride2,
+                 double beta, float* dest, int destStride) {
+  cblas_sgemm(CblasRowMajor, transpose1, transpose2, m, n, k, alpha, source1, stride1,
+              source2, stride2, beta, dest, destStride);
+}
+
+inline void syrk(CBLAS_UPLO uplo, CBLAS_TRANSPOSE transpose, int n, int k, double alpha,
+                 const double* source, int stride, double beta, double* dest, int destStride) {
+  cblas_dsyrk(CblasRowMajor, uplo, transpose, n, k, alpha, source, stride, beta, dest, destStride);
+}
+
+inline void syrk(CBLAS_UPLO uplo, CBLAS_TRANSPOSE transpose, int n, int k, double alpha,
+                 const float* source, int stride, double beta, float* dest, int destStride) {
+  cblas_ssyrk(CblasRowMajor, uplo, transpose, n, k, alpha, source, stride, beta, dest, destStride);
+}
+
+inline void trsm(CBLAS_SIDE side, CBLAS_UPLO uplo, CBLAS_TRANSPOSE transpose, int m, int n,
+                 const double* triangular, int stride, double* dest, int destStride) {
+  cblas_dtrsm(CblasRowMajor, side, uplo, transpose, CblasNonUnit, m, n, 1.0, triangular, stride,
+              dest, destStride);
+}
+
+inline void trsm(CBLAS_SIDE side, CBLAS_UPLO uplo, CBLAS_TRANSPOSE transpose, int m, int n,
+                 const float* triangular, int stride, float* dest, int destStride) {
+  cblas_strsm(CblasRowMajor, side, uplo, transpose, CblasNonUnit, m, n, 1.0, triangular, stride,
+              dest, destStride);
+}
+
+//the storage of a tensor's first element, for kernels templated on it.
+template<typename S>
+S* storage(Tensor& tensor);
+
+template<>
+inline double* storage<double>(Tensor& tensor) {
+  return tensor.data + tensor.initial_offset;
+}
+
+template<>
+inline float* storage<float>(Tensor& tensor) {
+  return tensor.floatData + tensor.initial_offset;
+}
+
+}
@@ -0,0 +1,552 @@
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#include "blas.h"
+#include "tensor.h"
+#include "parallel.h"
+#include "sparse.h"
+#include "decompose.h"
+
+namespace tensor {
+
+//loops are split across threads in ranges of at least this many
+//multiply-adds.
+const uint64_t DECOMPOSE_PARALLEL_THRESHOLD = 1 << 15;
+
+//rows of Khatri-Rao products are built this many entries at a time.
+const uint64_t KHATRI_RAO_BLOCK_SIZE = 1 << 16;
+
+bool isCompact(Tensor& tensor) {
+  return !isFloat32(tensor) && isRowMajor(tensor);
+}
+
+//the transpose of a compact matrix.
+bool isTransposedCompact(Tensor& matrix) {
+  return !isFloat32(matrix) && matrix.numDimensions == 2 &&
+         matrix.strides[0] == 1 && matrix.strides[1] == matrix.shape[0];
+}
+
+double* compactData(Tensor& tensor) {
+  return tensor.data + tensor.initial_offset;
+}
+
+//product of shape[first..last).
+uint64_t shapeProduct(Tensor& tensor, uint32_t first, uint32_t last) {
+  uint64_t product = 1;
+  for(uint32_t i=first; i<last; i++)
+    product *= tensor.shape[i];
+  return product;
+}
+
+/**
+  * rows of the Khatri-Rao product of the factors of modes
+  * [firstMode, lastMode), in row-major order of their indices: row
+  * (i_first, .., i_last-1) is the elementwise product of row i_m of each
+  * factor m. With no modes every row is all ones.
+  */
+struct KhatriRaoRows {
+  std::vector<double*> data;
+  std::vector<uint32_t> sizes;
+  std::vector<uint32_t> coords;
+  uint32_t rank;
+
+  KhatriRaoRows(std::vector<Tensor*>& factors, uint32_t firstMode, uint32_t lastMode, uint32_t _rank) {
+    rank = _rank;
+    for(uint32_t m=firstMode; m<lastMode; m++) {
+      data.push_back(compactData(*factors[m]));
+      sizes.push_back(factors[m]->shape[0]);
+    }
+    coords.resize(sizes.size(), 0);
+  }
+
+  void seek(uint64_t row) {
+    for(uint32_t j=sizes.size(); j>0; j--) {
+      coords[j-1] = row % sizes[j-1];
+      row /= sizes[j-1];
+    }
+  }
+
+  void get(double* out) {
+    std::fill(out, out + rank, 1.0);
+    for(uint32_t j=0; j<sizes.size(); j++) {
+      double* factorRow = data[j] + (uint64_t)coords[j] * rank;
+      for(uint32_t r=0; r<rank; r++)
+        out[r] *= factorRow[r];
+    }
+  }
+
+  void next(void) {
+    for(uint32_t j=sizes.size(); j>0; j--) {
+      if(++coords[j-1] < sizes[j-1])
+        return;
+      coords[j-1] = 0;
+    }
+  }
+};
+
+//the factors of every mode but skip are compact [X.shape[m], rank] matrices.
+bool validFactors(uint32_t numDimensions, uint32_t* shape, std::vector<Tensor*>& factors,
+                  uint32_t skip, uint32_t rank) {
+  if(factors.size() != numDimensions)
+    return false;
+  for(uint32_t m=0; m<numDimensions; m++) {
+    if(m == skip)
+      continue;
+    Tensor& factor = *factors[m];
+    if(factor.numDimensions != 2 || !isCompact(factor) || factor.shape[0] != shape[m] ||
+       (rank != 0 && factor.shape[1] != rank))
+      return false;
+  }
+  return true;
+}
+
+uint32_t rankOf(std::vector<Tensor*>& factors, uint32_t mode) {
+  Tensor& other = *factors[mode == 0 ? 1 : 0];
+  return other.numDimensions == 2 ? other.shape[1] : 0;
+}
+
+void mttkrp(Tensor& X, std::vector<Tensor*>& factors, uint32_t mode, Tensor& dest, TensorError* error) {
+  uint32_t N = X.numDimensions;
+  if(N < 2 || mode >= N || factors.size() != N) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  uint32_t rank = rankOf(factors, mode);
+  uint32_t size = X.shape[mode];
+  if(!isCompact(X) || !isCompact(dest) || !validFactors(N, X.shape, factors, mode, rank) ||
+     dest.numDimensions != 2 || dest.shape[0] != size || dest.shape[1] != rank) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  double* data = compactData(X);
+  double* out = compactData(dest);
+
+  if(mode == N-1) {
+    //dest = X_(mode) (Khatri-Rao of the other modes), with the Khatri-Rao
+    //rows built a block at a time and each block folded in by a gemm.
+    uint64_t numRows = shapeProduct(X, 0, N-1);
+    uint64_t blockRows = MAX(KHATRI_RAO_BLOCK_SIZE / MAX(rank, 1u), (uint64_t)1);
+    std::vector<double> block(blockRows * rank);
+    std::fill(out, out + (uint64_t)size * rank, 0.0);
+    for(uint64_t first=0; first<numRows; first+=blockRows) {
+      uint64_t count = MIN(blockRows, numRows - first);
+      auto build = [&](uint32_t t, uint64_t begin, uint64_t end) {
+        KhatriRaoRows rows(factors, 0, N-1, rank);
+        rows.seek(first + begin);
+        for(uint64_t row=begin; row<end; row++, rows.next())
+          rows.get(block.data() + row * rank);
+      };
+      parallelFor(count, parallelRanges(count, DECOMPOSE_PARALLEL_THRESHOLD / MAX(rank * (N-1), 1u)), build);
+      cblas_dgemm(CblasRowMajor, CblasTrans, CblasNoTrans, size, rank, count, 1.0,
+                  data + first * size, size, block.data(), rank, 1.0, out, rank);
+    }
+    return;
+  }
+
+  //W = X contracted with the last factor: [I_0 .. I_N-2, rank].
+  uint32_t lastSize = X.shape[N-1];
+  uint64_t numRows = shapeProduct(X, 0, N-1);
+  std::vector<double> W(numRows * rank);
+  cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, numRows, rank, lastSize, 1.0,
+              data, lastSize, compactData(*factors[N-1]), rank, 0.0, W.data(), rank);
+
+  //fold in modes N-2 .. mode+1, one at a time, elementwise in r.
+  for(uint32_t m=N-2; m>mode; m--) {
+    uint64_t numOuter = shapeProduct(X, 0, m);
+    uint32_t modeSize = X.shape[m];
+    double* factor = compactData(*factors[m]);
+    std::vector<double> folded(numOuter * rank);
+    auto fold = [&](uint32_t t, uint64_t first, uint64_t last) {
+      for(uint64_t q=first; q<last; q++) {
+        double* target = folded.data() + q * rank;
+        std::fill(target, target + rank, 0.0);
+        for(uint32_t i=0; i<modeSize; i++) {
+          double* source = W.data() + (q * modeSize + i) * rank;
+          double* factorRow = factor + (uint64_t)i * rank;
+          for(uint32_t r=0; r<rank; r++)
+            target[r] += source[r] * factorRow[r];
+        }
+      }
+    };
+    uint64_t work = MAX((uint64_t)modeSize * rank, (uint64_t)1);
+    parallelFor(numOuter, parallelRanges(numOuter, DECOMPOSE_PARALLEL_THRESHOLD / work), fold);
+    W.swap(folded);
+  }
+
+  //W is [I_0 .. I_mode, rank]; fold in the leading modes through their
+  //Khatri-Rao rows, one row per leading index, split over dest rows.
+  uint64_t numLeading = shapeProduct(X, 0, mode);
+  auto reduce = [&](uint32_t t, uint64_t first, uint64_t last) {
+    KhatriRaoRows rows(factors, 0, mode, rank);
+    std::vector<double> product(rank);
+    std::fill(out + first * rank, out + last * rank, 0.0);
+    for(uint64_t l=0; l<numLeading; l++, rows.next()) {
+      rows.get(product.data());
+      for(uint64_t i=first; i<last; i++) {
+        double* source = W.data() + (l * size + i) * rank;
+        double* target = out + i * rank;
+        for(uint32_t r=0; r<rank; r++)
+          target[r] += source[r] * product[r];
+      }
+    }
+  };
+  uint64_t work = MAX(numLeading * rank, (uint64_t)1);
+  parallelFor(size, parallelRanges(size, DECOMPOSE_PARALLEL_THRESHOLD / work), reduce);
+}
+
+void mttkrp(CooTensor& X, std::vector<Tensor*>& factors, uint32_t mode, Tensor& dest, TensorError* error) {
+  uint32_t N = X.numDimensions;
+  if(N < 2 || mode >= N || factors.size() != N) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  uint32_t rank = rankOf(factors, mode);
+  uint32_t size = X.shape[mode];
+  if(!isCompact(dest) || !validFactors(N, X.shape, factors, mode, rank) ||
+     dest.numDimensions != 2 || dest.shape[0] != size || dest.shape[1] != rank) {
+    *error = DimensionMismatchError;
+    return;
+  }
+
+  std::vector<double*> data(N);
+  for(uint32_t m=0; m<N; m++)
+    data[m] = m == mode ? NULL : compactData(*factors[m]);
+  uint64_t resultSize = (uint64_t)size * rank;
+  uint32_t numRanges = parallelRanges(X.nnz, DECOMPOSE_PARALLEL_THRESHOLD / MAX(rank * N, 1u));
+  std::vector<double> partials(numRanges * resultSize, 0.0);
+  auto accumulate = [&](uint32_t t, uint64_t first, uint64_t last) {
+    double* result = partials.data() + t * resultSize;
+    std::vector<double> product(rank);
+    for(uint64_t k=first; k<last; k++) {
+      uint32_t* coords = X.coordsOf(k);
+      std::fill(product.begin(), product.end(), X.values[k]);
+      for(uint32_t m=0; m<N; m++) {
+        if(m == mode)
+          continue;
+        double* factorRow = data[m] + (uint64_t)coords[m] * rank;
+        for(uint32_t r=0; r<rank; r++)
+          product[r] *= factorRow[r];
+      }
+      double* target = result + (uint64_t)coords[mode] * rank;
+      for(uint32_t r=0; r<rank; r++)
+        target[r] += product[r];
+    }
+  };
+  parallelFor(X.nnz, numRanges, accumulate);
+
+  double* out = compactData(dest);
+  std::copy(partials.begin(), partials.begin() + resultSize, out);
+  for(uint32_t t=1; t<numRanges; t++) {
+    double* partial = partials.data() + t * resultSize;
+    for(uint64_t i=0; i<resultSize; i++)
+      out[i] += partial[i];
+  }
+}
+
+void modeProduct(Tensor& X, Tensor& matrix, uint32_t mode, Tensor& dest, TensorError* error) {
+  uint32_t N = X.numDimensions;
+  bool transposed = !isCompact(matrix) && isTransposedCompact(matrix);
+  if(mode >= N || matrix.numDimensions != 2 || !isCompact(X) || !isCompact(dest) ||
+     !(transposed || isCompact(matrix)) || dest.numDimensions != N ||
+     matrix.shape[0] != X.shape[mode]) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  for(uint32_t m=0; m<N; m++) {
+    if(dest.shape[m] != (m == mode ? matrix.shape[1] : X.shape[m])) {
+      *error = DimensionMismatchError;
+      return;
+    }
+  }
+
+  uint32_t size = X.shape[mode];
+  uint32_t columns = matrix.shape[1];
+  uint64_t numLeading = shapeProduct(X, 0, mode);
+  uint64_t numTrailing = shapeProduct(X, mode+1, N);
+  double* data = compactData(X);
+  double* matrixData = compactData(matrix);
+  uint32_t matrixStride = transposed ? size : columns;
+  double* out = compactData(dest);
+  if(numTrailing == 1) {
+    //the last mode: one gemm, dest = X [numLeading, size] * matrix.
+    cblas_dgemm(CblasRowMajor, CblasNoTrans, transposed ? CblasTrans : CblasNoTrans,
+                numLeading, columns, size, 1.0, data, size, matrixData, matrixStride,
+                0.0, out, columns);
+    return;
+  }
+  //a slab [size, numTrailing] of X per leading index: dest slab = matrix^T slab.
+  for(uint64_t l=0; l<numLeading; l++) {
+    cblas_dgemm(CblasRowMajor, transposed ? CblasNoTrans : CblasTrans, CblasNoTrans,
+                columns, numTrailing, size, 1.0, matrixData, matrixStride,
+                data + l * size * numTrailing, numTrailing,
+                0.0, out + l * columns * numTrailing, numTrailing);
+  }
+}
+
+void modeGram(Tensor& X, Tensor& Y, uint32_t mode, Tensor& dest, TensorError* error) {
+  uint32_t N = X.numDimensions;
+  if(mode >= N || Y.numDimensions != N || !isCompact(X) || !isCompact(Y) || !isCompact(dest) ||
+     dest.numDimensions != 2 || dest.shape[0] != X.shape[mode] || dest.shape[1] != Y.shape[mode]) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  for(uint32_t m=0; m<N; m++) {
+    if(m != mode && X.shape[m] != Y.shape[m]) {
+      *error = DimensionMismatchError;
+      return;
+    }
+  }
+
+  uint32_t sizeX = X.shape[mode];
+  uint32_t sizeY = Y.shape[mode];
+  uint64_t numLeading = shapeProduct(X, 0, mode);
+  uint64_t numTrailing = shapeProduct(X, mode+1, N);
+  double* dataX = compactData(X);
+  double* dataY = compactData(Y);
+  double* out = compactData(dest);
+  if(numTrailing == 1) {
+    cblas_dgemm(CblasRowMajor, CblasTrans, CblasNoTrans, sizeX, sizeY, numLeading, 1.0,
+                dataX, sizeX, dataY, sizeY, 0.0, out, sizeY);
+    return;
+  }
+  std::fill(out, out + (uint64_t)sizeX * sizeY, 0.0);
+  for(uint64_t l=0; l<numLeading; l++) {
+    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, sizeX, sizeY, numTrailing, 1.0,
+                dataX + l * sizeX * numTrailing, numTrailing,
+                dataY + l * sizeY * numTrailing, numTrailing, 1.0, out, sizeY);
+  }
+}
+
+void ttmChain(CooTensor& X, std::vector<Tensor*>& factors, uint32_t mode, Tensor& dest, TensorError* error) {
+  uint32_t N = X.numDimensions;
+  if(N < 2 || mode >= N || !validFactors(N, X.shape, factors, mode, 0) || !isCompact(dest) ||
+     dest.numDimensions != 2 || dest.shape[0] != X.shape[mode]) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  uint64_t width = 1;
+  std::vector<double*> data(N);
+  std::vector<uint32_t> ranks(N);
+  for(uint32_t m=0; m<N; m++) {
+    if(m == mode)
+      continue;
+    data[m] = compactData(*factors[m]);
+    ranks[m] = factors[m]->shape[1];
+    width *= ranks[m];
+  }
+  if(dest.shape[1] != width) {
+    *error = DimensionMismatchError;
+    return;
+  }
+
+  uint64_t resultSize = (uint64_t)X.shape[mode] * width;
+  uint32_t numRanges = parallelRanges(X.nnz, DECOMPOSE_PARALLEL_THRESHOLD / MAX(width, (uint64_t)1));
+  std::vector<double> partials(numRanges * resultSize, 0.0);
+  auto accumulate = [&](uint32_t t, uint64_t first, uint64_t last) {
+    double* result = partials.data() + t * resultSize;
+    std::vector<double> product(width);
+    for(uint64_t k=first; k<last; k++) {
+      uint32_t* coords = X.coordsOf(k);
+      //the Kronecker product of the factor rows, grown in place from the
+      //back so that no entry is overwritten before it is read.
+      uint64_t length = 1;
+      product[0] = X.values[k];
+      for(uint32_t m=0; m<N; m++) {
+        if(m == mode)
+          continue;
+        double* factorRow = data[m] + (uint64_t)coords[m] * ranks[m];
+        for(uint64_t s=length; s>0; s--) {
+          double value = product[s-1];
+          for(uint32_t r=ranks[m]; r>0; r--)
+            product[(s-1) * ranks[m] + r-1] = value * factorRow[r-1];
+        }
+        length *= ranks[m];
+      }
+      double* target = result + (uint64_t)coords[mode] * width;
+      for(uint64_t j=0; j<width; j++)
+        target[j] += product[j];
+    }
+  };
+  parallelFor(X.nnz, numRanges, accumulate);
+
+  double* out = compactData(dest);
+  std::copy(partials.begin(), partials.begin() + resultSize, out);
+  for(uint32_t t=1; t<numRanges; t++) {
+    double* partial = partials.data() + t * resultSize;
+    for(uint64_t i=0; i<resultSize; i++)
+      out[i] += partial[i];
+  }
+}
+
+//the entry of a tensor of either dtype at offset.
+inline double valueAt(Tensor& tensor, uint64_t offset) {
+  return isFloat32(tensor) ? tensor.floatData[offset] : tensor.data[offset];
+}
+
+inline void setValueAt(Tensor& tensor, uint64_t offset, double value) {
+  if(isFloat32(tensor))
+    tensor.floatData[offset] = value;
+  else
+    tensor.data[offset] = value;
+}
+
+uint64_t offsetOf(Tensor& matrix, uint64_t row, uint64_t column) {
+  return matrix.initial_offset + row * matrix.strides[0] + column * matrix.strides[1];
+}
+
+template<typename D>
+void kroneckerKernel(Tensor& A, Tensor& B, D* dest, uint64_t* destStrides, uint64_t first, uint64_t last) {
+  uint32_t p = B.shape[0];
+  uint32_t n = A.shape[1];
+  uint32_t q = B.shape[1];
+  std::vector<double> rowB(q);
+  for(uint32_t j=0; j<p; j++) {
+    for(uint32_t b=0; b<q; b++)
+      rowB[b] = valueAt(B, offsetOf(B, j, b));
+    for(uint64_t i=first; i<last; i++) {
+      D* row = dest + (i * p + j) * destStrides[0];
+      for(uint32_t a=0; a<n; a++) {
+        double value = valueAt(A, offsetOf(A, i, a));
+        D* block = row + (uint64_t)a * q * destStrides[1];
+        for(uint32_t b=0; b<q; b++)
+          block[b * destStrides[1]] = value * rowB[b];
+      }
+    }
+  }
+}
+
+void kronecker(Tensor& A, Tensor& B, Tensor& dest, TensorError* error) {
+  if(A.numDimensions != 2 || B.numDimensions != 2 || dest.numDimensions != 2 ||
+     dest.shape[0] != (uint64_t)A.shape[0] * B.shape[0] ||
+     dest.shape[1] != (uint64_t)A.shape[1] * B.shape[1]) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  auto fill = [&](uint32_t t, uint64_t first, uint64_t last) {
+    if(isFloat32(dest))
+      kroneckerKernel(A, B, dest.floatData + dest.initial_offset, dest.strides, first, last);
+    else
+      kroneckerKernel(A, B, dest.data + dest.initial_offset, dest.strides, first, last);
+  };
+  uint64_t work = MAX((uint64_t)B.shape[0] * A.shape[1] * B.shape[1], (uint64_t)1);
+  parallelFor(A.shape[0], parallelRanges(A.shape[0], DECOMPOSE_PARALLEL_THRESHOLD / work), fill);
+}
+
+void khatriRao(Tensor& A, Tensor& B, Tensor& dest, TensorError* error) {
+  if(A.numDimensions != 2 || B.numDimensions != 2 || dest.numDimensions != 2 ||
+     A.shape[1] != B.shape[1] || dest.shape[1] != A.shape[1] ||
+     dest.shape[0] != (uint64_t)A.shape[0] * B.shape[0]) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  uint32_t p = B.shape[0];
+  uint32_t rank = A.shape[1];
+  auto fill = [&](uint32_t t, uint64_t first, uint64_t last) {
+    for(uint64_t i=first; i<last; i++) {
+      for(uint32_t j=0; j<p; j++) {
+        for(uint32_t r=0; r<rank; r++)
+          setValueAt(dest, offsetOf(dest, i * p + j, r),
+                     valueAt(A, offsetOf(A, i, r)) * valueAt(B, offsetOf(B, j, r)));
+      }
+    }
+  };
+  uint64_t work = MAX((uint64_t)p * rank, (uint64_t)1);
+  parallelFor(A.shape[0], parallelRanges(A.shape[0], DECOMPOSE_PARALLEL_THRESHOLD / work), fill);
+}
+
+//a matrix as a row-major gemm operand: its storage, op and leading dimension.
+template<typename S>
+struct GemmOperand {
+  S* data;
+  CBLAS_TRANSPOSE transpose;
+  int stride;
+
+  //the operand for the transpose of the matrix.
+  CBLAS_TRANSPOSE flipped(void) {
+    return transpose == CblasNoTrans ? CblasTrans : CblasNoTrans;
+  }
+};
+
+template<typename S>
+GemmOperand<S> gemmOperand(Tensor& matrix) {
+  if(isRowMajor(matrix))
+    return {storage<S>(matrix), CblasNoTrans, (int)MAX(matrix.shape[1], 1u)};
+  return {storage<S>(matrix), CblasTrans, (int)MAX(matrix.shape[0], 1u)};
+}
+
+bool isGemmOperand(Tensor& matrix) {
+  return matrix.numDimensions == 2 && fitsBLAS(matrix) &&
+         (isRowMajor(matrix) || (matrix.strides[0] == 1 && matrix.strides[1] == matrix.shape[0]));
+}
+
+template<typename S>
+void kroneckerMultiplyKernel(Tensor& A, Tensor& B, Tensor& x, Tensor& dest, uint32_t k) {
+  GemmOperand<S> a = gemmOperand<S>(A);
+  GemmOperand<S> b = gemmOperand<S>(B);
+  S* source = storage<S>(x);
+  S* out = storage<S>(dest);
+  int m = A.shape[0], n = A.shape[1];
+  int p = B.shape[0], q = B.shape[1];
+
+  //applying A first costs m q k (n + p) multiply-adds, B first n p k (q + m).
+  if((uint64_t)m * q * (n + p) <= (uint64_t)n * p * (q + m)) {
+    //Y[m, q, k] = A X, then dest[i] = B Y[i] for every i.
+    std::vector<S> Y((uint64_t)m * q * k);
+    gemm(a.transpose, CblasNoTrans, m, q * k, n, 1.0, a.data, a.stride, source, q * k,
+         0.0, Y.data(), q * k);
+    if(k == 1) {
+      gemm(CblasNoTrans, b.flipped(), m, p, q, 1.0, Y.data(), q, b.data, b.stride, 0.0, out, p);
+      return;
+    }
+    for(int i=0; i<m; i++) {
+      gemm(b.transpose, CblasNoTrans, p, k, q, 1.0, b.data, b.stride,
+           Y.data() + (uint64_t)i * q * k, k, 0.0, out + (uint64_t)i * p * k, k);
+    }
+    return;
+  }
+  //W[n, p, k] with W[a] = B X[a], then dest = A W.
+  std::vector<S> W((uint64_t)n * p * k);
+  if(k == 1) {
+    gemm(CblasNoTrans, b.flipped(), n, p, q, 1.0, source, q, b.data, b.stride, 0.0, W.data(), p);
+  } else {
+    for(int i=0; i<n; i++) {
+      gemm(b.transpose, CblasNoTrans, p, k, q, 1.0, b.data, b.stride,
+           source + (uint64_t)i * q * k, k, 0.0, W.data() + (uint64_t)i * p * k, k);
+    }
+  }
+  gemm(a.transpose, CblasNoTrans, m, p * k, n, 1.0, a.data, a.stride, W.data(), p * k, 0.0, out, p * k);
+}
+
+void kroneckerMultiply(Tensor& A, Tensor& B, Tensor& x, Tensor& dest, TensorError* error) {
+  if(!isGemmOperand(A) || !isGemmOperand(B) || x.numDimensions == 0 || x.numDimensions > 2 ||
+     dest.numDimensions != x.numDimensions || !isRowMajor(x) || !isRowMajor(dest) ||
+     A.dtype != B.dtype || A.dtype != x.dtype || A.dtype != dest.dtype) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  uint32_t k = x.numDimensions == 2 ? x.shape[1] : 1;
+  uint64_t m = A.shape[0], n = A.shape[1];
+  uint64_t p = B.shape[0], q = B.shape[1];
+  if(x.shape[0] != n * q || dest.shape[0] != m * p || (x.numDimensions == 2 && dest.shape[1] != k)) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  //sizes and leading dimensions of the gemms, including the intermediate.
+  if(MAX(m * q, n * p) * k >= INT_MAX || MAX(x.totalSize(), dest.totalSize()) >= INT_MAX) {
+    *error = SizeMismatchError;
+    return;
+  }
+  if(m * p * k == 0)
+    return;
+  if(n * q == 0) {
+    scale(dest, 0.0, dest, error);
+    return;
+  }
+  if(isFloat32(dest))
+    kroneckerMultiplyKernel<float>(A, B, x, dest, k);
+  else
+    kroneckerMultiplyKernel<double>(A, B, x, dest, k);
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+
+#include "tensor.h"
+#include "sparse.h"
+
+namespace tensor {
+
+/**
+  * kernels for tensor decompositions (CP-ALS and Tucker/HOOI, driven from
+  * src/tensor/decompose.js) and for Kronecker-structured products.
+  *
+  * Dense tensors, factor matrices and dests must be compact: float64 and
+  * row-major with no gaps (isCompact()). Factor m of a tensor X is a
+  * matrix with X.shape[m] rows. Shape mismatches fail with
+  * DimensionMismatchError.
+  */
+bool isCompact(Tensor& tensor);
+
+/**
+  * dest = the matricized tensor times Khatri-Rao product (MTTKRP) of X for
+  * mode:
+  *   dest[i, r] = sum of X[i_0, .., i, .., i_N-1] * prod_{m != mode} factors[m][i_m, r]
+  * over every index but the mode-th one. All factors have rank columns
+  * (the entry for mode is not read, and dest is [X.shape[mode], rank]).
+  *
+  * The Khatri-Rao product is never formed. For dense X the last mode (or
+  * the one before it when mode is last) is contracted with one BLAS-3
+  * gemm, and the remaining modes are folded in one at a time, or a block
+  * of Khatri-Rao rows at a time, on several threads. For sparse X each
+  * thread adds the products of its nonzeros into a private copy of dest;
+  * the copies are summed in thread order.
+  */
+void mttkrp(Tensor& X, std::vector<Tensor*>& factors, uint32_t mode, Tensor& dest,
+            TensorError* error=&globalError);
+
+void mttkrp(CooTensor& X, std::vector<Tensor*>& factors, uint32_t mode, Tensor& dest,
+            TensorError* error=&globalError);
+
+/**
+  * the mode product of X with matrix, which replaces dimension mode of X
+  * by the columns of matrix:
+  *   dest[.., j, ..] = sum_i X[.., i, ..] * matrix[i, j]
+  * as a gemm per slab of X. matrix may also be the transpose of a compact
+  * matrix.
+  */
+void modeProduct(Tensor& X, Tensor& matrix, uint32_t mode, Tensor& dest,
+                 TensorError* error=&globalError);
+
+/**
+  * dest = X_(mode) Y_(mode)^T, the product of the mode-unfoldings of two
+  * tensors of equal shape except in dimension mode:
+  *   dest[i, j] = sum of X[.., i, ..] * Y[.., j, ..] over the other indices.
+  */
+void modeGram(Tensor& X, Tensor& Y, uint32_t mode, Tensor& dest, TensorError* error=&globalError);
+
+/**
+  * dest = the mode-unfolding of X times every factor but the mode-th:
+  *   dest[i, (r_m for m != mode)] = sum over the nonzeros of X with
+  *                                  coordinate i in mode of
+  *                                  value * prod_{m != mode} factors[m][i_m, r_m]
+  * where the columns of dest run over the r_m in row-major order. This is
+  * the tensor-times-matrix chain of Tucker/HOOI for sparse X, computed
+  * from the nonzeros without densifying X.
+  */
+void ttmChain(CooTensor& X, std::vector<Tensor*>& factors, uint32_t mode, Tensor& dest,
+              TensorError* error=&globalError);
+
+/**
+  * dest = A (x) B, the Kronecker product of an [m, n] and a [p, q] matrix:
+  *   dest[i*p + j, a*q + b] = A[i, a] * B[j, b]
+  * for a [m*p, n*q] dest. The operands may have any layout and either
+  * dtype.
+  */
+void kronecker(Tensor& A, Tensor& B, Tensor& dest, TensorError* error=&globalError);
+
+/**
+  * dest = the Khatri-Rao (column-wise Kronecker) product of an [m, R] and a
+  * [p, R] matrix:
+  *   dest[i*p + j, r] = A[i, r] * B[j, r]
+  * for a [m*p, R] dest. The operands may have any layout and either dtype.
+  */
+void khatriRao(Tensor& A, Tensor& B, Tensor& dest, TensorError* error=&globalError);
+
+/**
+  * dest = (A (x) B) x for an [m, n] matrix A, a [p, q] matrix B and x
+  * either a vector of n*q entries or an [n*q, k] matrix, without forming
+  * A (x) B: viewing x as X[n, q, k],
+  *   dest[i, j, :] = sum_{a, b} A[i, a] * B[j, b] * X[a, b, :]
+  * is two gemms, A first or B first, whichever needs fewer flops.
+  *
+  * x and dest are row-major; A and B are row-major or the transpose of a
+  * row-major matrix. All four have the same dtype.
+  */
+void kroneckerMultiply(Tensor& A, Tensor& B, Tensor& x, Tensor& dest, TensorError* error=&globalError);
+
+}
@@ -0,0 +1,285 @@
+#include <cmath>
+#include <vector>
+
+#include "tensor.h"
+#include "fused.h"
+
+#define FUSED_BINARY_CASE(opcode, expression) case opcode: { \
+  double* left = stack + (depth - 2) * FUSED_TILE_SIZE; \
+  double* right = left + FUSED_TILE_SIZE; \
+  for(uint32_t i=0; i<n; i++) { \
+    double x = left[i]; \
+    double y = right[i]; \
+    left[i] = (expression); \
+  } \
+  depth--; \
+  break; \
+}
+
+#define FUSED_UNARY_CASE(opcode, expression) case opcode: { \
+  double* top = stack + (depth - 1) * FUSED_TILE_SIZE; \
+  for(uint32_t i=0; i<n; i++) { \
+    double x = top[i]; \
+    top[i] = (expression); \
+  } \
+  break; \
+}
+
+namespace tensor {
+
+/**
+  * an input of a fused program. Inputs with a single element are
+  * broadcast by filling the tile with their value.
+  */
+struct FusedInput {
+  Tensor* tensor;
+  bool isScalar;
+  double value;
+};
+
+bool isBinaryOpcode(uint32_t opcode) {
+  return opcode >= FusedAdd && opcode <= FusedFmod;
+}
+
+bool validateFusedProgram(uint32_t* code, uint32_t numInstructions,
+                          uint32_t numConstants, uint32_t numInputs,
+                          uint32_t* maxStackDepth) {
+  uint32_t depth = 0;
+  uint32_t maxDepth = 0;
+  for(uint32_t pc=0; pc<numInstructions; pc++) {
+    uint32_t opcode = code[2*pc];
+    uint32_t operand = code[2*pc + 1];
+    if(opcode >= FusedNumOpcodes)
+      return false;
+
+    if(opcode == FusedLoadInput) {
+      if(operand >= numInputs)
+        return false;
+      depth++;
+    } else if(opcode == FusedLoadConstant) {
+      if(operand >= numConstants)
+        return false;
+      depth++;
+    } else if(isBinaryOpcode(opcode)) {
+      if(depth < 2)
+        return false;
+      depth--;
+    } else {
+      if(depth < 1)
+        return false;
+    }
+    maxDepth = MAX(maxDepth, depth);
+  }
+  if(depth != 1)
+    return false;
+
+  *maxStackDepth = maxDepth;
+  return true;
+}
+
+bool broadcastsTo(Tensor& source, Tensor& dest) {
+  if(source.numDimensions > dest.numDimensions)
+    return false;
+  for(uint32_t i=0; i<source.numDimensions; i++) {
+    uint32_t sourceDimension = source.shape[source.numDimensions - i - 1];
+    uint32_t destDimension = dest.shape[dest.numDimensions - i - 1];
+    if(sourceDimension != destDimension && sourceDimension != 1)
+      return false;
+  }
+  return true;
+}
+
+/**
+  * runs the program over one tile of n elements. load(k, tile, n) fills
+  * tile with the next n values of input k.
+  * Returns the tile holding the result.
+  */
+template<typename Loader>
+double* runFusedTile(uint32_t* code, uint32_t numInstructions, double* constants,
+                     double* stack, uint32_t n, Loader& load) {
+  uint32_t depth = 0;
+  for(uint32_t pc=0; pc<numInstructions; pc++) {
+    uint32_t operand = code[2*pc + 1];
+    switch(code[2*pc]) {
+      case FusedLoadInput:
+        load(operand, stack + depth * FUSED_TILE_SIZE, n);
+        depth++;
+        break;
+      case FusedLoadConstant: {
+        double* top = stack + depth * FUSED_TILE_SIZE;
+        double value = constants[operand];
+        for(uint32_t i=0; i<n; i++)
+          top[i] = value;
+        depth++;
+        break;
+      }
+
+      FUSED_BINARY_CASE(FusedAdd, x + y)
+      FUSED_BINARY_CASE(FusedSub, x - y)
+      FUSED_BINARY_CASE(FusedMul, x * y)
+      FUSED_BINARY_CASE(FusedDiv, x / y)
+      FUSED_BINARY_CASE(FusedPow, ::pow(x, y))
+      FUSED_BINARY_CASE(FusedMax, MAX(x, y))
+      FUSED_BINARY_CASE(FusedMin, MIN(x, y))
+      FUSED_BINARY_CASE(FusedFmod, ::fmod(x, y))
+
+      FUSED_UNARY_CASE(FusedNeg, -x)
+      FUSED_UNARY_CASE(FusedSquare, x * x)
+      FUSED_UNARY_CASE(FusedSign, x==0?0:(x>0?1.0:-1))
+      FUSED_UNARY_CASE(FusedAbs, x>0?x:-x)
+      FUSED_UNARY_CASE(FusedSqrt, ::sqrt(x))
+      FUSED_UNARY_CASE(FusedExp, ::exp(x))
+      FUSED_UNARY_CASE(FusedLog, ::log(x))
+      FUSED_UNARY_CASE(FusedSin, ::sin(x))
+      FUSED_UNARY_CASE(FusedCos, ::cos(x))
+      FUSED_UNARY_CASE(FusedTan, ::tan(x))
+      FUSED_UNARY_CASE(FusedSinh, ::sinh(x))
+      FUSED_UNARY_CASE(FusedCosh, ::cosh(x))
+      FUSED_UNARY_CASE(FusedTanh, ::tanh(x))
+      FUSED_UNARY_CASE(FusedAtan, ::atan(x))
+      FUSED_UNARY_CASE(FusedAcos, ::acos(x))
+      FUSED_UNARY_CASE(FusedAsin, ::asin(x))
+      FUSED_UNARY_CASE(FusedAtanh, ::atanh(x))
+      FUSED_UNARY_CASE(FusedAcosh, ::acosh(x))
+      FUSED_UNARY_CASE(FusedAsinh, ::asinh(x))
+      FUSED_UNARY_CASE(FusedErf, ::erf(x))
+      FUSED_UNARY_CASE(FusedFloor, ::floor(x))
+      FUSED_UNARY_CASE(FusedCeil, ::ceil(x))
+      FUSED_UNARY_CASE(FusedRound, ::round(x))
+    }
+  }
+  return stack;
+}
+
+/**
+  * dest is dense and every input is either a scalar or laid out exactly
+  * like dest, so tiles are contiguous runs of memory.
+  */
+void fusedLinear(uint32_t* code, uint32_t numInstructions, double* constants,
+                 std::vector<FusedInput>& inputs, double* stack, Tensor& dest) {
+  uint64_t totalSize = dest.totalSize();
+  uint64_t start = 0;
+
+  auto load = [&](uint32_t k, double* tile, uint32_t n) {
+    FusedInput& input = inputs[k];
+    if(input.isScalar) {
+      for(uint32_t i=0; i<n; i++)
+        tile[i] = input.value;
+    } else if(isFloat32(*input.tensor)) {
+      float* source = input.tensor->floatData + input.tensor->initial_offset + start;
+      for(uint32_t i=0; i<n; i++)
+        tile[i] = source[i];
+    } else {
+      double* source = input.tensor->data + input.tensor->initial_offset + start;
+      for(uint32_t i=0; i<n; i++)
+        tile[i] = source[i];
+    }
+  };
+
+  for(; start<totalSize; start+=FUSED_TILE_SIZE) {
+    uint32_t n = MIN(totalSize - start, (uint64_t)FUSED_TILE_SIZE);
+    double* result = runFusedTile(code, numInstructions, constants, stack, n, load);
+    if(isFloat32(dest)) {
+      float* destData = dest.floatData + dest.initial_offset + start;
+      for(uint32_t i=0; i<n; i++)
+        destData[i] = result[i];
+    } else {
+      double* destData = dest.data + dest.initial_offset + start;
+      for(uint32_t i=0; i<n; i++)
+        destData[i] = result[i];
+    }
+  }
+}
+
+/**
+  * general case: walks dest in index order and gathers the broadcast
+  * offsets of every input for a tile before running the program on it.
+  */
+void fusedStrided(uint32_t* code, uint32_t numInstructions, double* constants,
+                  std::vector<FusedInput>& inputs, double* stack, Tensor& dest) {
+  uint32_t numInputs = inputs.size();
+  uint32_t numCoords = dest.numDimensions;
+  std::vector<uint64_t> destOffsets(FUSED_TILE_SIZE);
+  std::vector<uint64_t> inputOffsets(numInputs * FUSED_TILE_SIZE);
+
+  auto load = [&](uint32_t k, double* tile, uint32_t n) {
+    FusedInput& input = inputs[k];
+    uint64_t* offsets = inputOffsets.data() + k * FUSED_TILE_SIZE;
+    if(input.isScalar) {
+      for(uint32_t i=0; i<n; i++)
+        tile[i] = input.value;
+    } else if(isFloat32(*input.tensor)) {
+      for(uint32_t i=0; i<n; i++)
+        tile[i] = input.tensor->floatData[offsets[i]];
+    } else {
+      for(uint32_t i=0; i<n; i++)
+        tile[i] = input.tensor->data[offsets[i]];
+    }
+  };
+
+  MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
+  bool remaining = true;
+  while(remaining) {
+    uint32_t n = 0;
+    do {
+      uint32_t* currentCoords = destIterator.get();
+      destOffsets[n] = dest.offsetOf(currentCoords);
+      for(uint32_t k=0; k<numInputs; k++) {
+        if(!inputs[k].isScalar)
+          inputOffsets[k * FUSED_TILE_SIZE + n] =
+            inputs[k].tensor->broadcastOffsetOf(currentCoords, numCoords);
+      }
+      n++;
+      remaining = destIterator.next();
+    } while(remaining && n < FUSED_TILE_SIZE);
+
+    double* result = runFusedTile(code, numInstructions, constants, stack, n, load);
+    if(isFloat32(dest)) {
+      for(uint32_t i=0; i<n; i++)
+        dest.floatData[destOffsets[i]] = result[i];
+    } else {
+      for(uint32_t i=0; i<n; i++)
+        dest.data[destOffsets[i]] = result[i];
+    }
+  }
+}
+
+void fusedElementwise(uint32_t* code, uint32_t numInstructions,
+                      double* constants, uint32_t numConstants,
+                      Tensor** inputs, uint32_t numInputs,
+                      Tensor& dest, TensorError* error) {
+  uint32_t maxStackDepth;
+  if(!validateFusedProgram(code, numInstructions, numConstants, numInputs, &maxStackDepth)) {
+    *error = InvalidProgramError;
+    return;
+  }
+
+  std::vector<FusedInput> fusedInputs(numInputs);
+  bool linear = isDense(dest);
+  for(uint32_t k=0; k<numInputs; k++) {
+    Tensor& input = *inputs[k];
+    if(!broadcastsTo(input, dest)) {
+      *error = DimensionMismatchError;
+      return;
+    }
+    fusedInputs[k].tensor = &input;
+    fusedInputs[k].isScalar = input.totalSize() == 1;
+    if(fusedInputs[k].isScalar) {
+      std::vector<uint32_t> zeros(input.numDimensions, 0);
+      fusedInputs[k].value = input.get(zeros.data());
+    } else if(!identicalLayout(input, dest)) {
+      linear = false;
+    }
+  }
+
+  if(dest.totalSize() == 0)
+    return;
+
+  std::vector<double> stack(maxStackDepth * FUSED_TILE_SIZE);
+  if(linear)
+    fusedLinear(code, numInstructions, constants, fusedInputs, stack.data(), dest);
+  else
+    fusedStrided(code, numInstructions, constants, fusedInputs, stack.data(), dest);
+}
+
+}
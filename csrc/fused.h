@@ -0,0 +1,81 @@
+#pragma once
+#include "tensor.h"
+
+namespace tensor {
+
+/**
+  * fused elementwise expressions.
+  *
+  * A fused program is a postfix sequence of (opcode, operand) pairs
+  * run by a small stack machine. Instead of single values, each stack slot
+  * holds a tile of FUSED_TILE_SIZE doubles, so the whole expression is
+  * evaluated one tile at a time in a single pass over the inputs and the
+  * destination, with every intermediate staying in L1.
+  *
+  * FusedLoadInput pushes a tile of inputs[operand], broadcast to the shape
+  * of dest. FusedLoadConstant pushes constants[operand]. Every other opcode
+  * ignores its operand and pops one (unary) or two (binary) tiles and
+  * pushes the result. A valid program leaves exactly one tile on the stack,
+  * which is written to dest.
+  *
+  * The numbering is shared with src/tensor/fused.js and must not change.
+  */
+enum FusedOpcode {
+  FusedLoadInput = 0,
+  FusedLoadConstant,
+
+  FusedAdd,
+  FusedSub,
+  FusedMul,
+  FusedDiv,
+  FusedPow,
+  FusedMax,
+  FusedMin,
+  FusedFmod,
+
+  FusedNeg,
+  FusedSquare,
+  FusedSign,
+  FusedAbs,
+  FusedSqrt,
+  FusedExp,
+  FusedLog,
+  FusedSin,
+  FusedCos,
+  FusedTan,
+  FusedSinh,
+  FusedCosh,
+  FusedTanh,
+  FusedAtan,
+  FusedAcos,
+  FusedAsin,
+  FusedAtanh,
+  FusedAcosh,
+  FusedAsinh,
+  FusedErf,
+  FusedFloor,
+  FusedCeil,
+  FusedRound,
+
+  FusedNumOpcodes
+};
+
+const uint32_t FUSED_TILE_SIZE = 256;
+
+/**
+  * checks that code (numInstructions pairs) only references existing
+  * inputs and constants and leaves exactly one value on the stack.
+  * On success the deepest stack used is stored in maxStackDepth.
+  */
+bool validateFusedProgram(uint32_t* code, uint32_t numInstructions,
+                          uint32_t numConstants, uint32_t numInputs,
+                          uint32_t* maxStackDepth);
+
+void fusedElementwise(uint32_t* code, uint32_t numInstructions,
+                      double* constants, uint32_t numConstants,
+                      Tensor** inputs, uint32_t numInputs,
+                      Tensor& dest, TensorError* error=&globalError);
+
+bool broadcastsTo(Tensor& source, Tensor& dest);
+
+}
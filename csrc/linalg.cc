@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "blas.h"
+#include "tensor.h"
+#include "parallel.h"
+#include "linalg.h"
+
+namespace tensor {
+
+//rows and columns in a block of the blocked Cholesky factorization.
+const uint32_t CHOLESKY_BLOCK_SIZE = 64;
+
+//trailing updates of fewer multiply-adds run on one thread.
+const uint64_t CHOLESKY_PARALLEL_THRESHOLD = 1 << 22;
+
+/**
+  * factors the size x size block at a in place, as cholesky() does,
+  * accumulating in double precision. Returns false if it is not positive
+  * definite.
+  */
+template<typename S>
+bool unblockedCholesky(S* a, uint64_t stride, uint32_t size) {
+  for(uint32_t j=0; j<size; j++) {
+    S* rowJ = a + j * stride;
+    double diagonal = rowJ[j];
+    for(uint32_t k=0; k<j; k++)
+      diagonal -= (double)rowJ[k] * rowJ[k];
+    if(!(diagonal > 0))
+      return false;
+    diagonal = std::sqrt(diagonal);
+    rowJ[j] = diagonal;
+    for(uint32_t i=j+1; i<size; i++) {
+      S* rowI = a + i * stride;
+      double value = rowI[j];
+      for(uint32_t k=0; k<j; k++)
+        value -= (double)rowI[k] * rowJ[k];
+      rowI[j] = value / diagonal;
+    }
+  }
+  return true;
+}
+
+template<typename S>
+bool choleskyKernel(S* a, uint32_t n) {
+  uint32_t nb = CHOLESKY_BLOCK_SIZE;
+  for(uint32_t k0=0; k0<n; k0+=nb) {
+    uint32_t kb = MIN(nb, n - k0);
+    S* diagonal = a + (uint64_t)k0 * n + k0;
+    if(!unblockedCholesky(diagonal, n, kb))
+      return false;
+    uint32_t first = k0 + kb;
+    uint32_t rest = n - first;
+    if(rest == 0)
+      break;
+
+    //L21 = A21 L11^-T
+    S* panel = a + (uint64_t)first * n + k0;
+    trsm(CblasRight, CblasLower, CblasTrans, rest, kb, diagonal, n, panel, n);
+
+    //A22 -= L21 L21^T, lower triangle only, one block column at a time.
+    uint32_t numBlocks = (rest + nb - 1) / nb;
+    auto update = [&](uint32_t t, uint64_t firstBlock, uint64_t lastBlock) {
+      for(uint64_t block=firstBlock; block<lastBlock; block++) {
+        uint32_t j0 = first + block * nb;
+        uint32_t jb = MIN(nb, n - j0);
+        S* rowsJ = a + (uint64_t)j0 * n + k0;
+        syrk(CblasLower, CblasNoTrans, jb, kb, -1.0, rowsJ, n, 1.0, a + (uint64_t)j0 * n + j0, n);
+        uint32_t below = n - j0 - jb;
+        if(below > 0) {
+          gemm(CblasNoTrans, CblasTrans, below, jb, kb, -1.0, rowsJ + (uint64_t)jb * n, n,
+               rowsJ, n, 1.0, a + (uint64_t)(j0 + jb) * n + j0, n);
+        }
+      }
+    };
+    uint64_t work = (uint64_t)rest * rest * kb / 2;
+    uint32_t numRanges = work < CHOLESKY_PARALLEL_THRESHOLD ? 1 : parallelRanges(numBlocks, 1);
+    parallelFor(numBlocks, numRanges, update);
+  }
+
+  for(uint32_t i=0; i<n; i++) {
+    for(uint32_t j=i+1; j<n; j++)
+      a[(uint64_t)i * n + j] = 0;
+  }
+  return true;
+}
+
+bool fitsInt(uint64_t size) {
+  return size < INT_MAX;
+}
+
+void cholesky(Tensor& A, TensorError* error) {
+  if(A.numDimensions != 2 || A.shape[0] != A.shape[1] || !isRowMajor(A)) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  if(!fitsInt(A.totalSize())) {
+    *error = SizeMismatchError;
+    return;
+  }
+  bool factored = isFloat32(A) ? choleskyKernel(storage<float>(A), A.shape[0]) :
+                                 choleskyKernel(storage<double>(A), A.shape[0]);
+  if(!factored)
+    *error = NotPositiveDefiniteError;
+}
+
+//the number of columns of a right hand side: 1 for a vector.
+uint32_t numColumns(Tensor& B) {
+  return B.numDimensions == 2 ? B.shape[1] : 1;
+}
+
+template<typename S>
+void triangularSolveKernel(Tensor& T, bool lower, bool transpose, Tensor& B) {
+  uint32_t n = T.shape[0];
+  uint32_t k = numColumns(B);
+  trsm(CblasLeft, lower ? CblasLower : CblasUpper, transpose ? CblasTrans : CblasNoTrans, n, k,
+       storage<S>(T), n, storage<S>(B), k);
+}
+
+void triangularSolve(Tensor& T, bool lower, bool transpose, Tensor& B, TensorError* error) {
+  if(T.numDimensions != 2 || T.shape[0] != T.shape[1] || B.numDimensions == 0 ||
+     B.numDimensions > 2 || B.shape[0] != T.shape[0] || !isRowMajor(T) || !isRowMajor(B) ||
+     T.dtype != B.dtype) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  if(!fitsInt(T.totalSize()) || !fitsInt(B.totalSize())) {
+    *error = SizeMismatchError;
+    return;
+  }
+  if(B.totalSize() == 0)
+    return;
+  if(isFloat32(B))
+    triangularSolveKernel<float>(T, lower, transpose, B);
+  else
+    triangularSolveKernel<double>(T, lower, transpose, B);
+}
+
+template<typename S>
+bool leastSquaresKernel(Tensor& A, Tensor& b, double ridge, Tensor& dest) {
+  uint32_t m = A.shape[0];
+  uint32_t n = A.shape[1];
+  uint32_t k = numColumns(b);
+  S* out = storage<S>(dest);
+  std::vector<S> gram((uint64_t)n * n, 0);
+  if(m > 0) {
+    syrk(CblasLower, CblasTrans, n, m, 1.0, storage<S>(A), n, 0.0, gram.data(), n);
+    gemm(CblasTrans, CblasNoTrans, n, k, m, 1.0, storage<S>(A), n, storage<S>(b), k, 0.0, out, k);
+  } else {
+    std::fill(out, out + (uint64_t)n * k, 0);
+  }
+  for(uint32_t i=0; i<n; i++)
+    gram[(uint64_t)i * n + i] += ridge;
+
+  if(!choleskyKernel(gram.data(), n))
+    return false;
+  trsm(CblasLeft, CblasLower, CblasNoTrans, n, k, gram.data(), n, out, k);
+  trsm(CblasLeft, CblasLower, CblasTrans, n, k, gram.data(), n, out, k);
+  return true;
+}
+
+void leastSquares(Tensor& A, Tensor& b, double ridge, Tensor& dest, TensorError* error) {
+  if(A.numDimensions != 2 || b.numDimensions == 0 || b.numDimensions > 2 ||
+     dest.numDimensions != b.numDimensions || b.shape[0] != A.shape[0] ||
+     dest.shape[0] != A.shape[1] || numColumns(dest) != numColumns(b) ||
+     !isRowMajor(A) || !isRowMajor(b) || !isRowMajor(dest) ||
+     A.dtype != b.dtype || A.dtype != dest.dtype) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  if(!fitsInt(A.totalSize()) || !fitsInt(b.totalSize()) ||
+     !fitsInt((uint64_t)A.shape[1] * A.shape[1])) {
+    *error = SizeMismatchError;
+    return;
+  }
+  if(dest.totalSize() == 0)
+    return;
+  bool solved = isFloat32(dest) ? leastSquaresKernel<float>(A, b, ridge, dest) :
+                                  leastSquaresKernel<double>(A, b, ridge, dest);
+  if(!solved)
+    *error = NotPositiveDefiniteError;
+}
+
+//passes choleskyQRKernel takes at most, shifted ones included.
+const uint32_t CHOLESKY_QR_MAX_PASSES = 5;
+
+bool choleskyQRKernel(double* y, uint32_t m, uint32_t k, double* r) {
+  std::vector<double> gram((uint64_t)k * k);
+  std::vector<double> total((uint64_t)k * k, 0.0);
+  for(uint32_t i=0; i<k; i++)
+    total[(uint64_t)i * k + i] = 1;
+  double epsilon = std::numeric_limits<double>::epsilon();
+
+  uint32_t numPasses = 2;
+  for(uint32_t pass=0; pass<numPasses; pass++) {
+    syrk(CblasLower, CblasTrans, k, m, 1.0, y, k, 0.0, gram.data(), k);
+    std::vector<double> factor(gram);
+    if(!choleskyKernel(factor.data(), k)) {
+      //shifted CholeskyQR: a shift of this size keeps the Gram matrix
+      //positive definite, and the extra passes restore orthogonality. A Y
+      //of low numerical rank may need shifting again on a later pass.
+      double trace = 0;
+      for(uint32_t i=0; i<k; i++)
+        trace += gram[(uint64_t)i * k + i];
+      if(!(trace > 0) || pass + 1 >= CHOLESKY_QR_MAX_PASSES)
+        return false;
+      double shift = 11 * ((double)m * k + (double)k * (k + 1)) * epsilon * trace;
+      factor = gram;
+      for(uint32_t i=0; i<k; i++)
+        factor[(uint64_t)i * k + i] += shift;
+      if(!choleskyKernel(factor.data(), k))
+        return false;
+      numPasses = MIN(pass + 3, CHOLESKY_QR_MAX_PASSES);
+    }
+    //Y = Y L^-T, and R = L^T R.
+    trsm(CblasRight, CblasLower, CblasTrans, m, k, factor.data(), k, y, k);
+    std::vector<double> product((uint64_t)k * k, 0.0);
+    for(uint32_t i=0; i<k; i++) {
+      for(uint32_t l=i; l<k; l++) {
+        double value = factor[(uint64_t)l * k + i];
+        for(uint32_t j=0; j<k; j++)
+          product[(uint64_t)i * k + j] += value * total[(uint64_t)l * k + j];
+      }
+    }
+    total.swap(product);
+  }
+  std::copy(total.begin(), total.end(), r);
+  return true;
+}
+
+void choleskyQR(Tensor& Y, Tensor& R, TensorError* error) {
+  if(Y.numDimensions != 2 || R.numDimensions != 2 || Y.shape[0] < Y.shape[1] ||
+     R.shape[0] != Y.shape[1] || R.shape[1] != Y.shape[1] ||
+     !isRowMajor(Y) || !isRowMajor(R) || Y.dtype != R.dtype) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  if(!fitsInt(Y.totalSize())) {
+    *error = SizeMismatchError;
+    return;
+  }
+  if(Y.shape[1] == 0)
+    return;
+  uint32_t m = Y.shape[0];
+  uint32_t k = Y.shape[1];
+  bool factored;
+  if(isFloat32(Y)) {
+    //the Gram matrix squares the condition number of Y, which float32 cannot
+    //hold for the sketches of low-rank matrices: factor a double copy.
+    float* y = storage<float>(Y);
+    std::vector<double> copy(y, y + (uint64_t)m * k);
+    std::vector<double> r((uint64_t)k * k);
+    factored = choleskyQRKernel(copy.data(), m, k, r.data());
+    std::copy(copy.begin(), copy.end(), y);
+    std::copy(r.begin(), r.end(), storage<float>(R));
+  } else {
+    factored = choleskyQRKernel(storage<double>(Y), m, k, storage<double>(R));
+  }
+  if(!factored)
+    *error = NotPositiveDefiniteError;
+}
+
+//sweeps of one-sided Jacobi rotations before svdJacobi gives up converging.
+const uint32_t JACOBI_MAX_SWEEPS = 60;
+
+void svdJacobi(Tensor& A, Tensor& U, Tensor& S, Tensor& V, TensorError* error) {
+  if(A.numDimensions != 2 || A.shape[0] < A.shape[1] || U.numDimensions != 2 ||
+     U.shape[0] != A.shape[0] || U.shape[1] != A.shape[1] || S.numDimensions != 1 ||
+     S.shape[0] != A.shape[1] || V.numDimensions != 2 || V.shape[0] != A.shape[1] ||
+     V.shape[1] != A.shape[1] || isFloat32(A) || isFloat32(U) || isFloat32(S) || isFloat32(V) ||
+     !isRowMajor(A) || !isRowMajor(U) || !isRowMajor(S) || !isRowMajor(V)) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  uint32_t m = A.shape[0];
+  uint32_t n = A.shape[1];
+  //the columns of W = A V are rotated until they are orthogonal.
+  std::vector<double> W(storage<double>(A), storage<double>(A) + (uint64_t)m * n);
+  std::vector<double> rotations((uint64_t)n * n, 0.0);
+  for(uint32_t i=0; i<n; i++)
+    rotations[(uint64_t)i * n + i] = 1;
+
+  double epsilon = std::numeric_limits<double>::epsilon();
+  for(uint32_t sweep=0; sweep<JACOBI_MAX_SWEEPS; sweep++) {
+    bool rotated = false;
+    for(uint32_t p=0; p+1<n; p++) {
+      for(uint32_t q=p+1; q<n; q++) {
+        double alpha = 0, beta = 0, gamma = 0;
+        for(uint32_t i=0; i<m; i++) {
+          double wp = W[(uint64_t)i * n + p];
+          double wq = W[(uint64_t)i * n + q];
+          alpha += wp * wp;
+          beta += wq * wq;
+          gamma += wp * wq;
+        }
+        if(gamma == 0 || std::fabs(gamma) <= epsilon * std::sqrt(alpha * beta))
+          continue;
+        rotated = true;
+        double zeta = (beta - alpha) / (2 * gamma);
+        double t = (zeta >= 0 ? 1.0 : -1.0) / (std::fabs(zeta) + std::sqrt(1 + zeta * zeta));
+        double c = 1 / std::sqrt(1 + t * t);
+        double s = c * t;
+        for(uint32_t i=0; i<m; i++) {
+          double wp = W[(uint64_t)i * n + p];
+          double wq = W[(uint64_t)i * n + q];
+          W[(uint64_t)i * n + p] = c * wp - s * wq;
+          W[(uint64_t)i * n + q] = s * wp + c * wq;
+        }
+        for(uint32_t i=0; i<n; i++) {
+          double vp = rotations[(uint64_t)i * n + p];
+          double vq = rotations[(uint64_t)i * n + q];
+          rotations[(uint64_t)i * n + p] = c * vp - s * vq;
+          rotations[(uint64_t)i * n + q] = s * vp + c * vq;
+        }
+      }
+    }
+    if(!rotated)
+      break;
+  }
+
+  //singular values are the column norms of W, in decreasing order.
+  std::vector<double> norms(n);
+  std::vector<uint32_t> order(n);
+  for(uint32_t j=0; j<n; j++) {
+    double norm = 0;
+    for(uint32_t i=0; i<m; i++)
+      norm += W[(uint64_t)i * n + j] * W[(uint64_t)i * n + j];
+    norms[j] = std::sqrt(norm);
+    order[j] = j;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&norms](uint32_t a, uint32_t b) { return norms[a] > norms[b]; });
+
+  double* u = storage<double>(U);
+  double* s = storage<double>(S);
+  double* v = storage<double>(V);
+  for(uint32_t j=0; j<n; j++) {
+    uint32_t column = order[j];
+    s[j] = norms[column];
+    for(uint32_t i=0; i<m; i++)
+      u[(uint64_t)i * n + j] = norms[column] > 0 ? W[(uint64_t)i * n + column] / norms[column] : 0;
+    for(uint32_t i=0; i<n; i++)
+      v[(uint64_t)i * n + j] = rotations[(uint64_t)i * n + column];
+  }
+}
+
+}
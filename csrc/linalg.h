@@ -0,0 +1,70 @@
+#pragma once
+#include "tensor.h"
+
+namespace tensor {
+
+/**
+  * factorizations and solves built on BLAS-3 (there is no LAPACK).
+  *
+  * Matrices are row-major with no gaps (isRowMajor()), and the operands of
+  * a call share one dtype; computations run in that precision. Shape
+  * mismatches fail with DimensionMismatchError and matrices too large for
+  * BLAS's int sizes with SizeMismatchError.
+  */
+
+/**
+  * overwrites a symmetric positive definite [n, n] matrix A with its
+  * Cholesky factor L, the lower triangular matrix with A = L L^T; the
+  * strict upper triangle is zeroed. Only the lower triangle of A is read.
+  *
+  * Blocked and right-looking: each block column is factored, the panel
+  * below it solved against it (trsm), and the trailing lower triangle
+  * updated a block column at a time (syrk on the diagonal blocks, gemm
+  * below them), with the block columns of large updates on several
+  * threads. If A is not positive definite this fails with
+  * NotPositiveDefiniteError and A is left partly factored.
+  */
+void cholesky(Tensor& A, TensorError* error=&globalError);
+
+/**
+  * overwrites B, an [n] vector or [n, k] matrix, with op(T)^-1 B for an
+  * [n, n] triangular matrix T, lower or upper, where op(T) is T or T^T.
+  * Only the triangle of T is read.
+  */
+void triangularSolve(Tensor& T, bool lower, bool transpose, Tensor& B, TensorError* error=&globalError);
+
+/**
+  * dest = the least-squares solution x of min |A x - b|^2 + ridge |x|^2
+  * for an [m, n] matrix A and b an [m] vector or [m, k] matrix, from the
+  * normal equations (A^T A + ridge I) x = A^T b: A^T A is formed with syrk,
+  * factored with cholesky() and solved with two triangular solves. Fails
+  * with NotPositiveDefiniteError if A does not have full column rank and
+  * ridge is 0.
+  */
+void leastSquares(Tensor& A, Tensor& b, double ridge, Tensor& dest, TensorError* error=&globalError);
+
+/**
+  * the thin QR factorization of a tall [m, k] matrix Y (m >= k) by
+  * CholeskyQR: Y is overwritten with Q, whose columns are orthonormal, and
+  * the [k, k] matrix R with the upper triangular R for which Y = Q R.
+  * Each pass forms the Gram matrix with syrk, factors it and solves Y
+  * against the factor with trsm, so nearly all the work is BLAS-3. Two
+  * passes make Q orthonormal to working precision. An ill-conditioned Y
+  * whose Gram matrix is not numerically positive definite is factored with
+  * a shift and then takes more passes, shifted again as needed, up to five
+  * in all. float32 matrices are factored in double precision. A Y of rank
+  * 0, or one still not orthogonalized by then, fails with
+  * NotPositiveDefiniteError.
+  */
+void choleskyQR(Tensor& Y, Tensor& R, TensorError* error=&globalError);
+
+/**
+  * the singular value decomposition A = U diag(S) V^T of a float64 [m, n]
+  * matrix A with m >= n, by one-sided Jacobi rotations: U is [m, n] with
+  * orthonormal columns (when A has full rank), S the [n] singular values in
+  * decreasing order and V an [n, n] orthogonal matrix. This is for small
+  * matrices: each sweep costs O(m n^2).
+  */
+void svdJacobi(Tensor& A, Tensor& U, Tensor& S, Tensor& V, TensorError* error=&globalError);
+
+}
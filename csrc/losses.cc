@@ -0,0 +1,164 @@
+#include <cmath>
+#include <limits>
+
+#include "blas.h"
+#include "tensor.h"
+#include "parallel.h"
+#include "losses.h"
+
+namespace tensor {
+
+//losses over fewer elements run on one thread.
+const uint64_t LOSS_PARALLEL_THRESHOLD = 1 << 16;
+
+//row-major tensors of one dtype, as the loss kernels take them.
+static bool lossOperands(Tensor& t1, Tensor& t2, Tensor& t3, Tensor& t4) {
+  Tensor* tensors[] = {&t1, &t2, &t3, &t4};
+  for(Tensor* t : tensors) {
+    if(!isRowMajor(*t) || t->dtype != t1.dtype)
+      return false;
+  }
+  return true;
+}
+
+/**
+  * loss[i], grad[i] = func(pred[i], label[i]) with label broadcast when it
+  * has a single element.
+  */
+template<typename S, typename Func>
+void elementwiseLossKernel(Tensor& pred, Tensor& label, Tensor& loss, Tensor& grad, Func& func) {
+  S* predData = storage<S>(pred);
+  S* labelData = storage<S>(label);
+  S* lossData = storage<S>(loss);
+  S* gradData = storage<S>(grad);
+  uint64_t n = pred.totalSize();
+  uint64_t labelStride = label.totalSize() == 1 ? 0 : 1;
+  auto kernel = [&](uint32_t t, uint64_t first, uint64_t last) {
+    for(uint64_t i=first; i<last; i++) {
+      double value, derivative;
+      func(predData[i], labelData[i * labelStride], value, derivative);
+      lossData[i] = value;
+      gradData[i] = derivative;
+    }
+  };
+  parallelFor(n, parallelRanges(n, LOSS_PARALLEL_THRESHOLD), kernel);
+}
+
+template<typename Func>
+void elementwiseLoss(Tensor& pred, Tensor& label, Tensor& loss, Tensor& grad, Func func,
+                     TensorError* error) {
+  uint64_t n = pred.totalSize();
+  if(loss.totalSize() != n || grad.totalSize() != n ||
+     (label.totalSize() != n && label.totalSize() != 1)) {
+    *error = SizeMismatchError;
+    return;
+  }
+  if(!lossOperands(pred, label, loss, grad)) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  if(isFloat32(pred))
+    elementwiseLossKernel<float>(pred, label, loss, grad, func);
+  else
+    elementwiseLossKernel<double>(pred, label, loss, grad, func);
+}
+
+void logisticLoss(Tensor& pred, Tensor& label, Tensor& loss, Tensor& grad, TensorError* error) {
+  elementwiseLoss(pred, label, loss, grad, [](double p, double y, double& value, double& derivative) {
+    double z = y * p;
+    //log(1 + exp(-z)) = max(-z, 0) + log(1 + exp(-|z|))
+    double e = std::exp(-std::fabs(z));
+    value = MAX(-z, 0.0) + std::log1p(e);
+    //1 / (1 + exp(z))
+    derivative = -y * (z >= 0 ? e / (1 + e) : 1 / (1 + e));
+  }, error);
+}
+
+void squaredLoss(Tensor& pred, Tensor& label, Tensor& loss, Tensor& grad, TensorError* error) {
+  elementwiseLoss(pred, label, loss, grad, [](double p, double y, double& value, double& derivative) {
+    double residual = p - y;
+    value = 0.5 * residual * residual;
+    derivative = residual;
+  }, error);
+}
+
+template<typename S>
+void softmaxCrossEntropyKernel(Tensor& logits, Tensor& labels, bool targets, Tensor& loss, Tensor& grad) {
+  S* logitData = storage<S>(logits);
+  S* labelData = storage<S>(labels);
+  S* lossData = storage<S>(loss);
+  S* gradData = storage<S>(grad);
+  uint64_t classes = logits.shape[logits.numDimensions - 1];
+  uint64_t rows = logits.totalSize() / classes;
+  auto kernel = [&](uint32_t t, uint64_t first, uint64_t last) {
+    for(uint64_t r=first; r<last; r++) {
+      S* z = logitData + r * classes;
+      S* g = gradData + r * classes;
+      double largest = -std::numeric_limits<double>::infinity();
+      for(uint64_t c=0; c<classes; c++)
+        largest = MAX(largest, (double)z[c]);
+      //g holds exp(z - largest) until it is normalized.
+      double sum = 0;
+      for(uint64_t c=0; c<classes; c++) {
+        double e = std::exp(z[c] - largest);
+        g[c] = e;
+        sum += e;
+      }
+      double logSumExp = largest + std::log(sum);
+
+      if(targets) {
+        S* target = labelData + r * classes;
+        double total = 0;
+        double product = 0;
+        for(uint64_t c=0; c<classes; c++) {
+          total += target[c];
+          product += (double)target[c] * z[c];
+        }
+        lossData[r] = total * logSumExp - product;
+        for(uint64_t c=0; c<classes; c++)
+          g[c] = total * g[c] / sum - target[c];
+      } else {
+        uint64_t label = (uint64_t)labelData[r];
+        lossData[r] = logSumExp - z[label];
+        for(uint64_t c=0; c<classes; c++)
+          g[c] = g[c] / sum;
+        g[label] -= 1;
+      }
+    }
+  };
+  parallelFor(rows, parallelRanges(rows, MAX(LOSS_PARALLEL_THRESHOLD / classes, (uint64_t)1)), kernel);
+}
+
+void softmaxCrossEntropy(Tensor& logits, Tensor& labels, Tensor& loss, Tensor& grad, TensorError* error) {
+  if(logits.numDimensions == 0 || logits.totalSize() == 0) {
+    *error = SizeMismatchError;
+    return;
+  }
+  uint64_t classes = logits.shape[logits.numDimensions - 1];
+  uint64_t rows = logits.totalSize() / classes;
+  bool targets = labels.totalSize() == logits.totalSize();
+  if(loss.totalSize() != rows || grad.totalSize() != logits.totalSize() ||
+     (!targets && labels.totalSize() != rows)) {
+    *error = SizeMismatchError;
+    return;
+  }
+  if(!lossOperands(logits, labels, loss, grad)) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  if(!targets) {
+    for(uint64_t r=0; r<rows; r++) {
+      double label = isFloat32(labels) ? storage<float>(labels)[r] : storage<double>(labels)[r];
+      if(!(label >= 0 && label < classes) || label != std::floor(label)) {
+        *error = IndexOutOfBounds;
+        return;
+      }
+    }
+  }
+  if(isFloat32(logits))
+    softmaxCrossEntropyKernel<float>(logits, labels, targets, loss, grad);
+  else
+    softmaxCrossEntropyKernel<double>(logits, labels, targets, loss, grad);
+}
+
+}
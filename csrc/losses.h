@@ -0,0 +1,46 @@
+#pragma once
+#include "tensor.h"
+
+namespace tensor {
+
+/**
+  * losses computed together with their gradient, in a single pass over
+  * the predictions and in double precision, for the fused autograd loss
+  * operations.
+  *
+  * All the tensors are row-major (isRowMajor()) and share one dtype.
+  * grad receives the derivative of the sum of loss with respect to the
+  * predictions, and has their shape. Size mismatches fail with
+  * SizeMismatchError, and other dtypes or layouts with
+  * DimensionMismatchError.
+  */
+
+/**
+  * loss = log(1 + exp(-label * pred)) elementwise, computed so that it
+  * cannot overflow, and grad = -label / (1 + exp(label * pred)). label has
+  * the size of pred or a single element, used for all of them.
+  */
+void logisticLoss(Tensor& pred, Tensor& label, Tensor& loss, Tensor& grad, TensorError* error=&globalError);
+
+/**
+  * loss = (pred - label)^2 / 2 elementwise and grad = pred - label. label
+  * has the size of pred or a single element.
+  */
+void squaredLoss(Tensor& pred, Tensor& label, Tensor& loss, Tensor& grad, TensorError* error=&globalError);
+
+/**
+  * the cross entropy of the softmax of each row of logits (its last
+  * dimension holds the classes) against labels, which are either the
+  * class of each row, as an integral value, or target probabilities with
+  * the shape of logits. loss has one entry per row:
+  *
+  *   loss = logsumexp(z) - z[label],  grad = softmax(z) - onehot(label)
+  *
+  * or, for targets t, sum(t) logsumexp(z) - <t, z> with gradient
+  * sum(t) softmax(z) - t. A class out of range fails with
+  * IndexOutOfBounds.
+  */
+void softmaxCrossEntropy(Tensor& logits, Tensor& labels, Tensor& loss, Tensor& grad,
+                         TensorError* error=&globalError);
+
+}
@@ -10,6 +10,13 @@
     return; \
   } \
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions); \
+  if(anyFloat32(source, dest)) { \
+    do { \
+      uint32_t* currentCoords = destIterator.get(); \
+      dest.set(currentCoords, ::func_name(source.get(currentCoords))); \
+    } while(destIterator.next()); \
+    return; \
+  } \
   do { \
     uint32_t* currentCoords = destIterator.get(); \
     dest.at(currentCoords) = \
@@ -28,6 +35,14 @@
   } \
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions); \
   uint32_t numCoords = dest.numDimensions; \
+  if(anyFloat32(source1, source2, dest)) { \
+    do { \
+      uint32_t* currentCoords = destIterator.get(); \
+      dest.set(currentCoords, \
+        ::func_name(source1.broadcast_get(currentCoords, numCoords), source2.broadcast_get(currentCoords, numCoords))); \
+    } while(destIterator.next()); \
+    return; \
+  } \
   do { \
     uint32_t* currentCoords = destIterator.get(); \
     dest.at(currentCoords) = \
@@ -44,6 +59,13 @@ void apply(double(*func)(double), Tensor& source, Tensor& dest, TensorError* err
   }
 
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
+  if(anyFloat32(source, dest)) {
+    do {
+      uint32_t* currentCoords = destIterator.get();
+      dest.set(currentCoords, (*func)(source.get(currentCoords)));
+    } while(destIterator.next());
+    return;
+  }
   do {
     uint32_t* currentCoords = destIterator.get();
     dest.at(currentCoords) = 
@@ -57,6 +79,14 @@ void sign(Tensor& source, Tensor& dest, TensorError* error) {
     return;
   }
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
+  if(anyFloat32(source, dest)) {
+    do {
+      uint32_t* currentCoords = destIterator.get();
+      double sourceVal = source.get(currentCoords);
+      dest.set(currentCoords, sourceVal==0?0:(sourceVal>0?1.0:-1));
+    } while(destIterator.next());
+    return;
+  }
   do {
     uint32_t* currentCoords = destIterator.get();
     double sourceVal = source.at(currentCoords);
@@ -73,6 +103,14 @@ void abs(Tensor& source, Tensor& dest, TensorError* error) {
     return;
   }
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
+  if(anyFloat32(source, dest)) {
+    do {
+      uint32_t* currentCoords = destIterator.get();
+      double sourceVal = source.get(currentCoords);
+      dest.set(currentCoords, sourceVal>0?sourceVal:-sourceVal);
+    } while(destIterator.next());
+    return;
+  }
   do {
     uint32_t* currentCoords = destIterator.get();
     double sourceVal = source.at(currentCoords);
@@ -91,6 +129,15 @@ void max(Tensor& source1, Tensor& source2, Tensor& dest, TensorError* error) {
   }
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
   uint32_t numCoords = dest.numDimensions;
+  if(anyFloat32(source1, source2, dest)) {
+    do {
+      uint32_t* currentCoords = destIterator.get();
+      double value1 = source1.broadcast_get(currentCoords, numCoords);
+      double value2 = source2.broadcast_get(currentCoords, numCoords);
+      dest.set(currentCoords, MAX(value1, value2));
+    } while(destIterator.next());
+    return;
+  }
   do {
     uint32_t* currentCoords = destIterator.get();
     dest.at(currentCoords) =
@@ -109,6 +156,15 @@ void min(Tensor& source1, Tensor& source2, Tensor& dest, TensorError* error) {
   }
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
   uint32_t numCoords = dest.numDimensions;
+  if(anyFloat32(source1, source2, dest)) {
+    do {
+      uint32_t* currentCoords = destIterator.get();
+      double value1 = source1.broadcast_get(currentCoords, numCoords);
+      double value2 = source2.broadcast_get(currentCoords, numCoords);
+      dest.set(currentCoords, MIN(value1, value2));
+    } while(destIterator.next());
+    return;
+  }
   do {
     uint32_t* currentCoords = destIterator.get();
     dest.at(currentCoords) =
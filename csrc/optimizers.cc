@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <cmath>
+
+#include "blas.h"
+#include "tensor.h"
+#include "parallel.h"
+#include "optimizers.h"
+
+namespace tensor {
+
+//updates of fewer elements run on one thread.
+const uint64_t OPTIMIZER_PARALLEL_THRESHOLD = 1 << 16;
+
+//the weights and up to three slots.
+const int MAX_UPDATE_OPERANDS = 4;
+
+/**
+  * the magnitude of each level of a quantized value, relative to the scale
+  * of its block, and for the mantissas in [1/2 + i/32, 1/2 + (i+1)/32),
+  * firstInOctave[i] = the highest j with 2 magnitudes[119 + j] <= 1 + i/16:
+  * the level of a mantissa above magnitudes[119] is 119 + j or 120 + j, as
+  * levels are further apart than 1/32.
+  */
+struct QuantizationLevels {
+  double magnitudes[128];
+  int firstInOctave[16];
+
+  QuantizationLevels() {
+    magnitudes[0] = 0;
+    for(int level=1; level<128; level++)
+      magnitudes[level] = std::exp2((level - 127) / 8.0);
+    for(int i=0; i<16; i++)
+      firstInOctave[i] = (int)std::floor(8 * std::log2(1 + i / 16.0));
+  }
+};
+static const QuantizationLevels LEVELS;
+
+//values this close to a level, relatively, are at it: rounding errors of the float32 scales.
+const double LEVEL_TOLERANCE = 1e-6;
+
+//a number in [0, 1) that depends on seed and i alone (splitmix64).
+static double uniform(uint64_t seed, uint64_t i) {
+  uint64_t z = i + seed * 0xD1B54A32D192ED03ULL + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//the smallest level at or above magnitude, the scale of a block whose largest magnitude it is.
+static float blockScale(double magnitude) {
+  if(magnitude == 0)
+    return 0;
+  return std::exp2(std::ceil(8 * std::log2(magnitude * (1 - LEVEL_TOLERANCE))) / 8);
+}
+
+//the code of value in a block of the given scale, rounded at random with uniform(seed, i) (see Slot).
+static uint8_t quantize(double value, double scale, uint64_t seed, uint64_t i) {
+  if(value == 0 || scale == 0)
+    return 0;
+  double ratio = std::fabs(value) / scale;
+  const double* magnitudes = LEVELS.magnitudes;
+  //the highest level at or below ratio, within the tolerance, from ratio = mantissa 2^exponent.
+  int exponent;
+  double mantissa = std::frexp(ratio * (1 + LEVEL_TOLERANCE), &exponent);
+  //magnitudes[127] is 1, above any mantissa.
+  int j = LEVELS.firstInOctave[(int)(mantissa * 32) - 16];
+  j += mantissa >= magnitudes[120 + j];
+  int level = exponent > 0 ? 127 : MAX(119 + j + 8 * exponent, 0);
+  if(level == 0) {
+    //below the lowest level: rounded to it or to zero, without bias too.
+    if(!(uniform(seed, i) * magnitudes[1] < ratio))
+      return 0;
+    level = 1;
+  } else if(level < 127 && ratio > magnitudes[level] * (1 + LEVEL_TOLERANCE)) {
+    //a value at a level, which a block scale at a level keeps there, is not rounded.
+    double low = magnitudes[level];
+    double high = magnitudes[level + 1];
+    level += uniform(seed, i) * (high - low) < ratio - low;
+  }
+  return level | (value < 0 ? 0x80 : 0);
+}
+
+/**
+  * the values of the count elements of slot from first, which is the start
+  * of a block if slot is quantized: those of a float64 tensor in place, or
+  * else buffer, filled with them.
+  */
+static double* loadBlock(Slot& slot, uint64_t first, uint64_t count, double* buffer) {
+  if(slot.tensor != NULL && !isFloat32(*slot.tensor))
+    return storage<double>(*slot.tensor) + first;
+  if(slot.tensor != NULL) {
+    float* data = storage<float>(*slot.tensor) + first;
+    for(uint64_t k=0; k<count; k++)
+      buffer[k] = data[k];
+    return buffer;
+  }
+  double scale = slot.scales[first / SLOT_BLOCK_SIZE];
+  for(uint64_t k=0; k<count; k++) {
+    uint8_t code = slot.codes[first + k];
+    double magnitude = scale * LEVELS.magnitudes[code & 0x7f];
+    buffer[k] = code & 0x80 ? -magnitude : magnitude;
+  }
+  return buffer;
+}
+
+//the inverse of loadBlock, which quantizes a whole block at once.
+static void storeBlock(Slot& slot, uint64_t first, uint64_t count, double* values) {
+  if(slot.tensor != NULL && !isFloat32(*slot.tensor)) {
+    double* data = storage<double>(*slot.tensor) + first;
+    if(values != data)
+      std::copy(values, values + count, data);
+    return;
+  }
+  if(slot.tensor != NULL) {
+    float* data = storage<float>(*slot.tensor) + first;
+    for(uint64_t k=0; k<count; k++)
+      data[k] = values[k];
+    return;
+  }
+  double largest = 0;
+  for(uint64_t k=0; k<count; k++)
+    largest = MAX(largest, std::fabs(values[k]));
+  float scale = blockScale(largest);
+  slot.scales[first / SLOT_BLOCK_SIZE] = scale;
+  for(uint64_t k=0; k<count; k++)
+    slot.codes[first + k] = quantize(values[k], scale, slot.seed, first + k);
+}
+
+static Slot tensorSlot(Tensor& t) {
+  Slot slot = {&t, NULL, NULL, t.totalSize(), 0};
+  return slot;
+}
+
+//row-major weights and tensor slots, and slots of as many values as the weights.
+static bool updateOperands(Slot* operands, int numOperands, TensorError* error) {
+  for(int j=0; j<numOperands; j++) {
+    if(operands[j].size != operands[0].size) {
+      *error = SizeMismatchError;
+      return false;
+    }
+    if(operands[j].tensor != NULL && !isRowMajor(*operands[j].tensor)) {
+      *error = DimensionMismatchError;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+  * runs step(values, k, gradient) for every element of the operands, the
+  * weights and the slots, a block at a time: values[j][k] is the value of
+  * the k-th element of the block in operand j, which step updates, in
+  * place for float64 tensors. Of the steps, only sgdUpdate's vectorizes,
+  * behind a runtime aliasing check: the sqrt and exp of AdaGrad and FreeRex
+  * may set errno without -ffast-math, so their loops stay scalar, and gain
+  * only from the single pass.
+  */
+template<typename Step>
+static void denseUpdate(Slot* operands, int numOperands, Tensor& grad, Step step, TensorError* error) {
+  Slot gradSlot = tensorSlot(grad);
+  if(gradSlot.size != operands[0].size) {
+    *error = SizeMismatchError;
+    return;
+  }
+  if(!updateOperands(operands, numOperands, error))
+    return;
+  if(!isRowMajor(grad)) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  uint64_t n = operands[0].size;
+  uint64_t numBlocks = (n + SLOT_BLOCK_SIZE - 1) / SLOT_BLOCK_SIZE;
+  auto kernel = [&](uint32_t t, uint64_t firstBlock, uint64_t lastBlock) {
+    double buffers[MAX_UPDATE_OPERANDS + 1][SLOT_BLOCK_SIZE];
+    double* values[MAX_UPDATE_OPERANDS];
+    for(uint64_t b=firstBlock; b<lastBlock; b++) {
+      uint64_t first = b * SLOT_BLOCK_SIZE;
+      uint64_t count = MIN(SLOT_BLOCK_SIZE, n - first);
+      double* gradient = loadBlock(gradSlot, first, count, buffers[MAX_UPDATE_OPERANDS]);
+      for(int j=0; j<numOperands; j++)
+        values[j] = loadBlock(operands[j], first, count, buffers[j]);
+      for(uint64_t k=0; k<count; k++)
+        step(values, k, gradient[k]);
+      for(int j=0; j<numOperands; j++)
+        storeBlock(operands[j], first, count, values[j]);
+    }
+  };
+  uint64_t minBlocks = MAX(OPTIMIZER_PARALLEL_THRESHOLD / SLOT_BLOCK_SIZE, (uint64_t)1);
+  parallelFor(numBlocks, parallelRanges(numBlocks, minBlocks), kernel);
+}
+
+//denseUpdate for the elements at the indices of a sparse grad only, loading the blocks they are in.
+template<typename Step>
+static void sparseUpdate(Slot* operands, int numOperands, SparseVector& grad, Step step, TensorError* error) {
+  if(!updateOperands(operands, numOperands, error))
+    return;
+  uint64_t n = operands[0].size;
+  if(grad.extent() > n) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  double buffers[MAX_UPDATE_OPERANDS][SLOT_BLOCK_SIZE];
+  double* values[MAX_UPDATE_OPERANDS];
+  uint32_t k = 0;
+  while(k < grad.nnz) {
+    uint64_t first = grad.indices[k] / SLOT_BLOCK_SIZE * SLOT_BLOCK_SIZE;
+    uint64_t count = MIN(SLOT_BLOCK_SIZE, n - first);
+    for(int j=0; j<numOperands; j++)
+      values[j] = loadBlock(operands[j], first, count, buffers[j]);
+    for(; k<grad.nnz && grad.indices[k] < first + count; k++)
+      step(values, grad.indices[k] - first, grad.values[k]);
+    for(int j=0; j<numOperands; j++)
+      storeBlock(operands[j], first, count, values[j]);
+  }
+}
+
+void sgdUpdate(Tensor& weights, Tensor& grad, double stepSize, TensorError* error) {
+  Slot operands[] = {tensorSlot(weights)};
+  denseUpdate(operands, 1, grad, [stepSize](double** values, uint64_t k, double gradient) {
+    values[0][k] -= stepSize * gradient;
+  }, error);
+}
+
+static auto adaGradStep(double lr) {
+  return [lr](double** values, uint64_t k, double gradient) {
+    double& sumGradSq = values[1][k];
+    sumGradSq += gradient * gradient;
+    //zero only if gradient is and a quantized sumGradSq was rounded to zero.
+    if(sumGradSq > 0)
+      values[0][k] -= lr * gradient / std::sqrt(sumGradSq);
+  };
+}
+
+void adaGradUpdate(Tensor& weights, Tensor& grad, Slot& sumGradSq, double lr, TensorError* error) {
+  Slot operands[] = {tensorSlot(weights), sumGradSq};
+  denseUpdate(operands, 2, grad, adaGradStep(lr), error);
+}
+
+void adaGradUpdate(Tensor& weights, SparseVector& grad, Slot& sumGradSq, double lr, TensorError* error) {
+  Slot operands[] = {tensorSlot(weights), sumGradSq};
+  sparseUpdate(operands, 2, grad, adaGradStep(lr), error);
+}
+
+static auto freeRexStep(double lr) {
+  return [lr](double** values, uint64_t k, double gradient) {
+    double& sumGrad = values[1][k];
+    double& oneOverEtaSq = values[2][k];
+    double& Lmax = values[3][k];
+    double absSumGrad = std::fabs(sumGrad);
+    sumGrad += gradient;
+    Lmax = MAX(Lmax, std::fabs(gradient));
+    oneOverEtaSq = MAX(oneOverEtaSq + 2 * gradient * gradient, Lmax * absSumGrad);
+    double sign = (sumGrad > 0) - (sumGrad < 0);
+    //quantized slots may have been rounded to zero.
+    double rate = oneOverEtaSq > 0 ? absSumGrad / std::sqrt(oneOverEtaSq) : 0;
+    values[0][k] = -sign * (std::exp(rate * lr) - 1);
+  };
+}
+
+void freeRexUpdate(Tensor& weights, Tensor& grad, Slot& sumGrad, Slot& oneOverEtaSq, Slot& Lmax,
+                   double lr, TensorError* error) {
+  Slot operands[] = {tensorSlot(weights), sumGrad, oneOverEtaSq, Lmax};
+  denseUpdate(operands, 4, grad, freeRexStep(lr), error);
+}
+
+void freeRexUpdate(Tensor& weights, SparseVector& grad, Slot& sumGrad, Slot& oneOverEtaSq, Slot& Lmax,
+                   double lr, TensorError* error) {
+  Slot operands[] = {tensorSlot(weights), sumGrad, oneOverEtaSq, Lmax};
+  sparseUpdate(operands, 4, grad, freeRexStep(lr), error);
+}
+
+void copySlot(Slot& source, Slot& dest, TensorError* error) {
+  Slot operands[] = {source, dest};
+  if(!updateOperands(operands, 2, error))
+    return;
+  uint64_t n = source.size;
+  uint64_t numBlocks = (n + SLOT_BLOCK_SIZE - 1) / SLOT_BLOCK_SIZE;
+  auto kernel = [&](uint32_t t, uint64_t firstBlock, uint64_t lastBlock) {
+    double buffer[SLOT_BLOCK_SIZE];
+    for(uint64_t b=firstBlock; b<lastBlock; b++) {
+      uint64_t first = b * SLOT_BLOCK_SIZE;
+      uint64_t count = MIN(SLOT_BLOCK_SIZE, n - first);
+      storeBlock(dest, first, count, loadBlock(source, first, count, buffer));
+    }
+  };
+  uint64_t minBlocks = MAX(OPTIMIZER_PARALLEL_THRESHOLD / SLOT_BLOCK_SIZE, (uint64_t)1);
+  parallelFor(numBlocks, parallelRanges(numBlocks, minBlocks), kernel);
+}
+
+}
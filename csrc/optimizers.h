@@ -0,0 +1,80 @@
+#pragma once
+#include "tensor.h"
+#include "sparse.h"
+
+namespace tensor {
+
+//the values of a quantized Slot share a scale per block of this many.
+const uint64_t SLOT_BLOCK_SIZE = 256;
+
+/**
+  * the state an optimizer keeps for each weight, size values stored either
+  * in a row-major tensor of either dtype, or quantized to 8 bits: with s
+  * the scale of the block of SLOT_BLOCK_SIZE values that value i is in,
+  * its code c = codes[i] stands for
+  *
+  *   (c & 0x80 ? -1 : 1) * s * 2^(((c & 0x7f) - 127) / 8),
+  *
+  * or 0 if c & 0x7f is 0. So there are 8 levels per octave over the 16
+  * octaves below the scale, the lowest level at or above the largest
+  * magnitude of the block: as scales are levels themselves, a value that
+  * does not change keeps its value when its block is stored again.
+  * Values are rounded to one of the two levels around them at random, with
+  * the probabilities that make the rounding unbiased, so that small
+  * increments are not lost; seed picks the random numbers of a store.
+  * Values below the lowest level are rounded to it or to zero the same
+  * way, so slots that start at a small epsilon may store zeros.
+  */
+struct Slot {
+  Tensor* tensor;
+  uint8_t* codes;
+  float* scales;
+  uint64_t size;
+  uint64_t seed;
+};
+
+/**
+  * optimizer updates that read a gradient and update the weights and the
+  * optimizer's slots in place, in a single pass over them, threaded for
+  * dense gradients, for the variables of the optimizers in src/optim.
+  *
+  * The weights are a row-major tensor (isRowMajor()). The gradient is
+  * either a row-major tensor of as many elements, of either dtype, or a
+  * SparseVector: then only the values at its indices are updated, with
+  * the gradient it holds there, zero included. Every slot has one value
+  * per weight. Updates are computed in double precision. Size mismatches
+  * fail with SizeMismatchError, and other layouts with
+  * DimensionMismatchError.
+  */
+
+//weights -= stepSize * grad, for a dense grad.
+void sgdUpdate(Tensor& weights, Tensor& grad, double stepSize, TensorError* error=&globalError);
+
+/**
+  * sumGradSq += grad^2 and weights -= lr * grad / sqrt(sumGradSq), with the
+  * updated sumGradSq.
+  */
+void adaGradUpdate(Tensor& weights, Tensor& grad, Slot& sumGradSq, double lr,
+                   TensorError* error=&globalError);
+void adaGradUpdate(Tensor& weights, SparseVector& grad, Slot& sumGradSq, double lr,
+                   TensorError* error=&globalError);
+
+/**
+  * the FreeRex update: with s the sumGrad before the step,
+  *
+  *   sumGrad += grad,  Lmax = max(Lmax, |grad|),
+  *   oneOverEtaSq = max(oneOverEtaSq + 2 grad^2, Lmax |s|),
+  *   weights = -sign(sumGrad) (exp(lr |s| / sqrt(oneOverEtaSq)) - 1).
+  */
+void freeRexUpdate(Tensor& weights, Tensor& grad, Slot& sumGrad, Slot& oneOverEtaSq, Slot& Lmax,
+                   double lr, TensorError* error=&globalError);
+void freeRexUpdate(Tensor& weights, SparseVector& grad, Slot& sumGrad, Slot& oneOverEtaSq, Slot& Lmax,
+                   double lr, TensorError* error=&globalError);
+
+/**
+  * copies the values of source to dest, which has as many: this quantizes
+  * the values of a tensor or dequantizes a quantized slot.
+  */
+void copySlot(Slot& source, Slot& dest, TensorError* error=&globalError);
+
+}
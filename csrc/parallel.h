@@ -0,0 +1,52 @@
+#pragma once
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "tensor.h"
+
+namespace tensor {
+
+/**
+  * number of threads the multithreaded kernels (random fills, sparse
+  * matrix products) split their work across. Defaults to the number of
+  * cores.
+  */
+void setNumThreads(uint32_t numThreads);
+
+uint32_t getNumThreads(void);
+
+/**
+  * number of ranges of at least minRange items to split [0, n) into: one
+  * per thread, or fewer for small loops, which then run on the calling
+  * thread only.
+  */
+inline uint32_t parallelRanges(uint64_t n, uint64_t minRange) {
+  uint64_t numRanges = MIN((uint64_t)getNumThreads(), n / MAX(minRange, (uint64_t)1));
+  return MAX(numRanges, (uint64_t)1);
+}
+
+/**
+  * calls func(t, first, last) for each of numRanges consecutive ranges
+  * [first, last) covering [0, n), the t-th on its own thread. numRanges
+  * is usually parallelRanges(n, minRange); taking it as an argument lets
+  * callers size per-range buffers before the threads start.
+  */
+template<typename Func>
+void parallelFor(uint64_t n, uint32_t numRanges, Func& func) {
+  std::vector<std::thread> threads;
+  for(uint64_t t=1; t<numRanges; t++) {
+    uint64_t first = t * n / numRanges;
+    uint64_t last = (t + 1) * n / numRanges;
+    try {
+      threads.emplace_back([&func, t, first, last]() { func(t, first, last); });
+    } catch(std::system_error& e) {
+      func(t, first, last);
+    }
+  }
+  func(0, 0, n / numRanges);
+  for(std::thread& thread : threads)
+    thread.join();
+}
+
+}
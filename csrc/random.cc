@@ -0,0 +1,199 @@
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "tensor.h"
+#include "parallel.h"
+#include "random.h"
+
+namespace tensor {
+
+const uint32_t PHILOX_M0 = 0xD2511F53;
+const uint32_t PHILOX_M1 = 0xCD9E8D57;
+const uint32_t PHILOX_W0 = 0x9E3779B9;
+const uint32_t PHILOX_W1 = 0xBB67AE85;
+const uint32_t PHILOX_ROUNDS = 10;
+
+thread_local RandomStream threadStream;
+
+void seedRandom(uint64_t seed) {
+  threadStream.key = seed;
+  threadStream.counter = 0;
+}
+
+void seed_generator(void) {
+  uint64_t seed;
+  try {
+    std::random_device rd;
+    seed = ((uint64_t)rd() << 32) ^ rd();
+  } catch(std::exception& e) {
+    seed = std::chrono::system_clock::now().time_since_epoch().count() + 3;
+  }
+  seedRandom(seed);
+}
+
+RandomStream reserveRandom(uint64_t numValues) {
+  RandomStream stream = threadStream;
+  threadStream.counter += (numValues + 1) / 2;
+  return stream;
+}
+
+/**
+  * Philox4x32-10 of PHILOX_LANES consecutive counters, starting at
+  * counter. The state is kept as one array per word so that every round is
+  * a loop over independent lanes, which the compiler vectorizes. Of the
+  * transforms, only fillUniform's vectorizes with it (see fillNormal).
+  */
+void philoxLanes(uint64_t counter, uint64_t key, uint32_t out[4][PHILOX_LANES]) {
+  uint32_t c0[PHILOX_LANES], c1[PHILOX_LANES], c2[PHILOX_LANES], c3[PHILOX_LANES];
+  for(uint32_t l=0; l<PHILOX_LANES; l++) {
+    c0[l] = (uint32_t)(counter + l);
+    c1[l] = (uint32_t)((counter + l) >> 32);
+    c2[l] = 0;
+    c3[l] = 0;
+  }
+
+  uint32_t k0 = (uint32_t)key;
+  uint32_t k1 = (uint32_t)(key >> 32);
+  for(uint32_t round=0; round<PHILOX_ROUNDS; round++) {
+    for(uint32_t l=0; l<PHILOX_LANES; l++) {
+      uint64_t product0 = (uint64_t)PHILOX_M0 * c0[l];
+      uint64_t product1 = (uint64_t)PHILOX_M1 * c2[l];
+      uint32_t next0 = (uint32_t)(product1 >> 32) ^ c1[l] ^ k0;
+      uint32_t next2 = (uint32_t)(product0 >> 32) ^ c3[l] ^ k1;
+      c1[l] = (uint32_t)product1;
+      c3[l] = (uint32_t)product0;
+      c0[l] = next0;
+      c2[l] = next2;
+    }
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+
+  for(uint32_t l=0; l<PHILOX_LANES; l++) {
+    out[0][l] = c0[l];
+    out[1][l] = c1[l];
+    out[2][l] = c2[l];
+    out[3][l] = c3[l];
+  }
+}
+
+//a uniform double in [0, 1) from the top 53 bits of (high, low). The
+//shifted words fit in an int32, which converts to double in one
+//vector instruction.
+inline double toUnit(uint32_t high, uint32_t low) {
+  return ((int32_t)(high >> 5) * 67108864.0 + (int32_t)(low >> 6)) * (1.0 / 9007199254740992.0);
+}
+
+/**
+  * writes values start..start+n of stream to out; start must be even.
+  * Each counter gives two uniforms u0, u1 in [0, 1), which transform turns
+  * into two consecutive values.
+  */
+template<typename Transform>
+void generate(RandomStream stream, uint64_t start, uint64_t n, double* out, Transform& transform) {
+  uint64_t numCounters = (n + 1) / 2;
+  uint64_t counter = stream.counter + start / 2;
+  uint32_t words[4][PHILOX_LANES];
+  double values[2 * PHILOX_LANES];
+  for(uint64_t c=0; c<numCounters; c+=PHILOX_LANES) {
+    philoxLanes(counter + c, stream.key, words);
+    for(uint32_t l=0; l<PHILOX_LANES; l++) {
+      double u0 = toUnit(words[0][l], words[1][l]);
+      double u1 = toUnit(words[2][l], words[3][l]);
+      transform(u0, u1, values[2*l], values[2*l + 1]);
+    }
+    uint64_t count = MIN(n - 2*c, 2 * (uint64_t)PHILOX_LANES);
+    for(uint64_t i=0; i<count; i++)
+      out[2*c + i] = values[i];
+  }
+}
+
+/**
+  * calls func(start, n) for every block of a fill of totalSize values,
+  * spreading the blocks over the kernel threads.
+  */
+template<typename Func>
+void forEachBlock(uint64_t totalSize, Func& func) {
+  uint64_t numBlocks = (totalSize + RANDOM_BLOCK_SIZE - 1) / RANDOM_BLOCK_SIZE;
+  auto work = [&](uint32_t t, uint64_t firstBlock, uint64_t lastBlock) {
+    for(uint64_t block=firstBlock; block<lastBlock; block++) {
+      uint64_t start = block * RANDOM_BLOCK_SIZE;
+      func(start, MIN(RANDOM_BLOCK_SIZE, totalSize - start));
+    }
+  };
+  parallelFor(numBlocks, parallelRanges(numBlocks, RANDOM_PARALLEL_THRESHOLD / RANDOM_BLOCK_SIZE), work);
+}
+
+template<typename Transform>
+void fillRandom(Tensor& dest, RandomStream stream, Transform transform) {
+  uint64_t totalSize = dest.totalSize();
+  if(totalSize == 0)
+    return;
+
+  if(isRowMajor(dest) && !isFloat32(dest)) {
+    double* data = dest.data + dest.initial_offset;
+    auto fillBlock = [&](uint64_t start, uint64_t n) {
+      generate(stream, start, n, data + start, transform);
+    };
+    forEachBlock(totalSize, fillBlock);
+  } else if(isRowMajor(dest)) {
+    float* data = dest.floatData + dest.initial_offset;
+    auto fillBlock = [&](uint64_t start, uint64_t n) {
+      double buffer[RANDOM_BLOCK_SIZE];
+      generate(stream, start, n, buffer, transform);
+      for(uint64_t i=0; i<n; i++)
+        data[start + i] = buffer[i];
+    };
+    forEachBlock(totalSize, fillBlock);
+  } else {
+    //strided dest: values are generated in blocks and written in
+    //row-major index order (MultiIndexIterator runs the first index
+    //fastest), one thread.
+    std::vector<double> buffer(RANDOM_BLOCK_SIZE);
+    std::vector<uint32_t> coords(dest.numDimensions, 0);
+    for(uint64_t start=0; start<totalSize; start+=RANDOM_BLOCK_SIZE) {
+      uint64_t n = MIN(RANDOM_BLOCK_SIZE, totalSize - start);
+      generate(stream, start, n, buffer.data(), transform);
+      for(uint64_t i=0; i<n; i++) {
+        dest.set(coords.data(), buffer[i]);
+        for(uint32_t d=dest.numDimensions; d>0; d--) {
+          if(++coords[d-1] < dest.shape[d-1])
+            break;
+          coords[d-1] = 0;
+        }
+      }
+    }
+  }
+}
+
+void fillNormal(double mean, double std_dev, Tensor& dest, RandomStream stream) {
+  //Box-Muller. Without -ffast-math the log, sqrt, cos and sin are scalar
+  //library calls, so only the generator vectorizes here. 1 - u0 is in
+  //(0, 1], which keeps the log finite.
+  fillRandom(dest, stream, [mean, std_dev](double u0, double u1, double& value0, double& value1) {
+    double radius = std_dev * ::sqrt(-2.0 * ::log(1.0 - u0));
+    double angle = 2.0 * M_PI * u1;
+    value0 = mean + radius * ::cos(angle);
+    value1 = mean + radius * ::sin(angle);
+  });
+}
+
+void fillNormal(double mean, double std_dev, Tensor& dest) {
+  fillNormal(mean, std_dev, dest, reserveRandom(dest.totalSize()));
+}
+
+void fillUniform(double low, double high, Tensor& dest, RandomStream stream) {
+  double range = high - low;
+  fillRandom(dest, stream, [low, range](double u0, double u1, double& value0, double& value1) {
+    value0 = low + range * u0;
+    value1 = low + range * u1;
+  });
+}
+
+void fillUniform(double low, double high, Tensor& dest) {
+  fillUniform(low, high, dest, reserveRandom(dest.totalSize()));
+}
+
+}
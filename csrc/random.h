@@ -0,0 +1,45 @@
+#pragma once
+#include "tensor.h"
+
+namespace tensor {
+
+/**
+  * counter-based random numbers.
+  *
+  * Values come from Philox4x32-10 (Salmon et al., "Parallel random numbers:
+  * as easy as 1, 2, 3", SC 2011), a bijection of a 128 bit counter under a
+  * 64 bit key. Element i of a fill (in row-major order of dest) is always
+  * computed from counter stream.counter + i/2, so any block of a tensor can
+  * be generated on its own. Large fills are split into blocks across
+  * threads, and the result is the same for any number of threads, for
+  * float32 and float64 storage, and for any strides of dest.
+  *
+  * Each thread has its own stream, seeded from std::random_device when the
+  * addon is loaded or explicitly with seedRandom. A fill reserves the
+  * counters it uses from that stream, so consecutive fills never overlap.
+  */
+struct RandomStream {
+  uint64_t key;
+  uint64_t counter;
+};
+
+const uint32_t PHILOX_LANES = 32;
+
+const uint64_t RANDOM_BLOCK_SIZE = 4096;
+
+//fills are split into ranges of at least this many values per thread.
+const uint64_t RANDOM_PARALLEL_THRESHOLD = 1 << 16;
+
+void seedRandom(uint64_t seed);
+
+/**
+  * returns the calling thread's stream and advances it past the counters
+  * used by numValues values.
+  */
+RandomStream reserveRandom(uint64_t numValues);
+
+void fillNormal(double mean, double std_dev, Tensor& dest, RandomStream stream);
+
+void fillUniform(double low, double high, Tensor& dest, RandomStream stream);
+
+}
@@ -0,0 +1,616 @@
+#include <algorithm>
+#include <vector>
+
+#include "tensor.h"
+#include "parallel.h"
+#include "sparse.h"
+
+namespace tensor {
+
+/**
+  * sum of values[k] * data[indices[k] * stride]. Four independent
+  * accumulators keep the gathered loads in flight instead of waiting on
+  * one long chain of additions.
+  */
+template<typename Storage, bool unitStride>
+double gatherDot(uint32_t* indices, double* values, uint32_t nnz, Storage* data, uint64_t stride) {
+  double sums[4] = {0, 0, 0, 0};
+  uint32_t k = 0;
+  for(; k+4<=nnz; k+=4) {
+    for(uint32_t j=0; j<4; j++) {
+      uint64_t offset = unitStride ? indices[k+j] : indices[k+j] * stride;
+      sums[j] += values[k+j] * data[offset];
+    }
+  }
+  for(; k<nnz; k++) {
+    uint64_t offset = unitStride ? indices[k] : indices[k] * stride;
+    sums[0] += values[k] * data[offset];
+  }
+  return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+template<typename Storage>
+double gatherDot(SparseVector& sparse, Storage* data, uint64_t stride) {
+  if(stride == 1)
+    return gatherDot<Storage, true>(sparse.indices, sparse.values, sparse.nnz, data, 1);
+  return gatherDot<Storage, false>(sparse.indices, sparse.values, sparse.nnz, data, stride);
+}
+
+//dense is a 1-dimensional tensor that every index of sparse falls in.
+bool coversSparse(Tensor& dense, SparseVector& sparse) {
+  return dense.numDimensions == 1 && dense.shape[0] >= sparse.extent();
+}
+
+double sparseDot(SparseVector& sparse, Tensor& dense, TensorError* error) {
+  if(!coversSparse(dense, sparse)) {
+    *error = DimensionMismatchError;
+    return 0;
+  }
+  if(isFloat32(dense))
+    return gatherDot(sparse, dense.floatData + dense.initial_offset, dense.strides[0]);
+  return gatherDot(sparse, dense.data + dense.initial_offset, dense.strides[0]);
+}
+
+template<typename Storage>
+void scatterAdd(SparseVector& sparse, double scale, Storage* data, uint64_t stride) {
+  for(uint32_t k=0; k<sparse.nnz; k++) {
+    Storage& entry = data[sparse.indices[k] * stride];
+    entry = entry + scale * sparse.values[k];
+  }
+}
+
+void sparseAxpy(SparseVector& sparse, double scale, Tensor& dest, TensorError* error) {
+  if(!coversSparse(dest, sparse)) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  if(isFloat32(dest))
+    scatterAdd(sparse, scale, dest.floatData + dest.initial_offset, dest.strides[0]);
+  else
+    scatterAdd(sparse, scale, dest.data + dest.initial_offset, dest.strides[0]);
+}
+
+void sparseScale(SparseVector& source, double scale, SparseVector& dest, TensorError* error) {
+  if(dest.nnz != source.nnz) {
+    *error = SizeMismatchError;
+    return;
+  }
+  for(uint32_t k=0; k<source.nnz; k++) {
+    dest.values[k] = scale * source.values[k];
+  }
+}
+
+double sparseSum(SparseVector& sparse) {
+  double sums[4] = {0, 0, 0, 0};
+  uint32_t k = 0;
+  for(; k+4<=sparse.nnz; k+=4) {
+    for(uint32_t j=0; j<4; j++)
+      sums[j] += sparse.values[k+j];
+  }
+  for(; k<sparse.nnz; k++) {
+    sums[0] += sparse.values[k];
+  }
+  return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+template<typename Storage>
+void gatherScale(SparseVector& sparse, Storage* data, uint64_t stride, double scale,
+                 bool divide, SparseVector& dest) {
+  if(divide) {
+    for(uint32_t k=0; k<sparse.nnz; k++)
+      dest.values[k] = scale * sparse.values[k] / data[sparse.indices[k] * stride];
+  } else {
+    for(uint32_t k=0; k<sparse.nnz; k++)
+      dest.values[k] = scale * sparse.values[k] * data[sparse.indices[k] * stride];
+  }
+}
+
+void sparseGatherScale(SparseVector& sparse, Tensor& dense, double scale, bool divide,
+                       SparseVector& dest, TensorError* error) {
+  if(dest.nnz != sparse.nnz) {
+    *error = SizeMismatchError;
+    return;
+  }
+  //a single element is broadcast to every index.
+  bool broadcast = dense.numDimensions == 1 && dense.shape[0] == 1;
+  if(!broadcast && !coversSparse(dense, sparse)) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  uint64_t stride = broadcast ? 0 : dense.strides[0];
+  if(isFloat32(dense))
+    gatherScale(sparse, dense.floatData + dense.initial_offset, stride, scale, divide, dest);
+  else
+    gatherScale(sparse, dense.data + dense.initial_offset, stride, scale, divide, dest);
+}
+
+void sparseSparseAddScale(SparseVector& sparse1, SparseVector& sparse2, double scale1, double scale2,
+                          SparseVector& dest, TensorError* error) {
+  if(dest.capacity < (uint64_t)sparse1.nnz + sparse2.nnz) {
+    *error = SizeMismatchError;
+    return;
+  }
+  uint32_t i = 0;
+  uint32_t j = 0;
+  uint32_t nnz = 0;
+  while(i < sparse1.nnz && j < sparse2.nnz) {
+    uint32_t index1 = sparse1.indices[i];
+    uint32_t index2 = sparse2.indices[j];
+    if(index1 < index2) {
+      dest.indices[nnz] = index1;
+      dest.values[nnz] = scale1 * sparse1.values[i++];
+    } else if(index2 < index1) {
+      dest.indices[nnz] = index2;
+      dest.values[nnz] = scale2 * sparse2.values[j++];
+    } else {
+      dest.indices[nnz] = index1;
+      dest.values[nnz] = scale1 * sparse1.values[i++] + scale2 * sparse2.values[j++];
+    }
+    nnz++;
+  }
+  for(; i<sparse1.nnz; i++, nnz++) {
+    dest.indices[nnz] = sparse1.indices[i];
+    dest.values[nnz] = scale1 * sparse1.values[i];
+  }
+  for(; j<sparse2.nnz; j++, nnz++) {
+    dest.indices[nnz] = sparse2.indices[j];
+    dest.values[nnz] = scale2 * sparse2.values[j];
+  }
+  dest.nnz = nnz;
+}
+
+/**
+  * calls func(i, j) for every position at which small.indices[i] equals
+  * large.indices[j], in increasing index order. When large has many more
+  * nonzeros than small, each index of small is found by binary search
+  * instead of stepping through large.
+  */
+template<typename Func>
+void forEachCommonIndex(SparseVector& small, SparseVector& large, Func& func) {
+  bool search = (uint64_t)small.nnz * 8 < large.nnz;
+  uint32_t* end = large.indices + large.nnz;
+  uint32_t j = 0;
+  for(uint32_t i=0; i<small.nnz && j<large.nnz; i++) {
+    uint32_t index = small.indices[i];
+    if(search) {
+      j = std::lower_bound(large.indices + j, end, index) - large.indices;
+    } else {
+      while(j < large.nnz && large.indices[j] < index)
+        j++;
+    }
+    if(j < large.nnz && large.indices[j] == index) {
+      func(i, j);
+      j++;
+    }
+  }
+}
+
+void sparseSparseMultiplyScale(SparseVector& sparse1, SparseVector& sparse2, double scale,
+                               SparseVector& dest, TensorError* error) {
+  SparseVector& small = sparse1.nnz <= sparse2.nnz ? sparse1 : sparse2;
+  SparseVector& large = sparse1.nnz <= sparse2.nnz ? sparse2 : sparse1;
+  if(dest.capacity < small.nnz) {
+    *error = SizeMismatchError;
+    return;
+  }
+  uint32_t nnz = 0;
+  auto multiply = [&](uint32_t i, uint32_t j) {
+    dest.indices[nnz] = small.indices[i];
+    dest.values[nnz] = scale * (small.values[i] * large.values[j]);
+    nnz++;
+  };
+  forEachCommonIndex(small, large, multiply);
+  dest.nnz = nnz;
+}
+
+double sparseSparseDot(SparseVector& sparse1, SparseVector& sparse2) {
+  SparseVector& small = sparse1.nnz <= sparse2.nnz ? sparse1 : sparse2;
+  SparseVector& large = sparse1.nnz <= sparse2.nnz ? sparse2 : sparse1;
+  double product = 0;
+  auto accumulate = [&](uint32_t i, uint32_t j) {
+    product += small.values[i] * large.values[j];
+  };
+  forEachCommonIndex(small, large, accumulate);
+  return product;
+}
+
+//out += value * row, for a row of width entries spaced columnStride apart.
+template<typename Storage>
+inline void addScaledRow(double value, Storage* row, uint64_t columnStride, uint32_t width,
+                         double* out) {
+  if(columnStride == 1) {
+    for(uint32_t j=0; j<width; j++)
+      out[j] += value * row[j];
+  } else {
+    for(uint32_t j=0; j<width; j++)
+      out[j] += value * row[j * columnStride];
+  }
+}
+
+template<typename Storage>
+void accumulateRows(SparseVector& sparse, Storage* data, uint64_t rowStride,
+                    uint64_t columnStride, uint32_t numColumns, double* accumulator) {
+  for(uint32_t k=0; k<sparse.nnz; k++) {
+    addScaledRow(sparse.values[k], data + sparse.indices[k] * rowStride, columnStride,
+                 numColumns, accumulator);
+  }
+}
+
+void sparseMatMul(SparseVector& sparse, Tensor& matrix, Tensor& dest, TensorError* error) {
+  if(matrix.numDimensions != 2 || dest.numDimensions != 1 ||
+     matrix.shape[0] < sparse.extent() || dest.shape[0] != matrix.shape[1]) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  uint32_t numColumns = matrix.shape[1];
+  std::vector<double> accumulator(numColumns, 0.0);
+  if(isFloat32(matrix))
+    accumulateRows(sparse, matrix.floatData + matrix.initial_offset, matrix.strides[0],
+                   matrix.strides[1], numColumns, accumulator.data());
+  else
+    accumulateRows(sparse, matrix.data + matrix.initial_offset, matrix.strides[0],
+                   matrix.strides[1], numColumns, accumulator.data());
+
+  for(uint32_t j=0; j<numColumns; j++) {
+    uint64_t offset = dest.initial_offset + j * dest.strides[0];
+    if(isFloat32(dest))
+      dest.floatData[offset] = accumulator[j];
+    else
+      dest.data[offset] = accumulator[j];
+  }
+}
+
+/**
+  * a 1- or 2-dimensional tensor viewed as rows of width entries; a vector
+  * is a column.
+  */
+struct DenseRows {
+  uint32_t numRows;
+  uint32_t width;
+  uint64_t rowStride;
+  uint64_t columnStride;
+
+  DenseRows(Tensor& tensor) {
+    numRows = tensor.shape[0];
+    width = tensor.numDimensions == 2 ? tensor.shape[1] : 1;
+    rowStride = tensor.strides[0];
+    columnStride = tensor.numDimensions == 2 ? tensor.strides[1] : 0;
+  }
+};
+
+void writeRow(Tensor& dest, DenseRows& layout, uint32_t row, double* values) {
+  uint64_t offset = dest.initial_offset + row * layout.rowStride;
+  if(isFloat32(dest)) {
+    for(uint32_t j=0; j<layout.width; j++)
+      dest.floatData[offset + j * layout.columnStride] = values[j];
+  } else {
+    for(uint32_t j=0; j<layout.width; j++)
+      dest.data[offset + j * layout.columnStride] = values[j];
+  }
+}
+
+//ranges of outer rows, each worth at least SPARSE_PARALLEL_THRESHOLD
+//multiply-adds on average.
+uint32_t outerRanges(SparseMatrix& matrix, uint32_t width) {
+  uint64_t outer = matrix.outerSize();
+  uint64_t work = ((uint64_t)matrix.nnz() + outer) * width;
+  uint64_t minRange = outer * SPARSE_PARALLEL_THRESHOLD / MAX(work, (uint64_t)1);
+  return parallelRanges(outer, minRange);
+}
+
+/**
+  * dest row o = sum of values[k] * dense row indices[k] over the nonzeros
+  * of outer row o.
+  */
+template<typename Storage>
+void gatherRows(SparseMatrix& matrix, Storage* data, DenseRows& denseLayout,
+                Tensor& dest, DenseRows& destLayout) {
+  uint32_t width = denseLayout.width;
+  auto work = [&](uint32_t t, uint64_t first, uint64_t last) {
+    std::vector<double> row(width);
+    for(uint64_t o=first; o<last; o++) {
+      uint32_t begin = matrix.offsets[o];
+      uint32_t count = matrix.offsets[o+1] - begin;
+      if(width == 1) {
+        row[0] = denseLayout.rowStride == 1 ?
+            gatherDot<Storage, true>(matrix.indices + begin, matrix.values + begin, count, data, 1) :
+            gatherDot<Storage, false>(matrix.indices + begin, matrix.values + begin, count, data,
+                                      denseLayout.rowStride);
+      } else {
+        std::fill(row.begin(), row.end(), 0.0);
+        for(uint32_t k=begin; k<begin+count; k++) {
+          addScaledRow(matrix.values[k], data + matrix.indices[k] * denseLayout.rowStride,
+                       denseLayout.columnStride, width, row.data());
+        }
+      }
+      writeRow(dest, destLayout, o, row.data());
+    }
+  };
+  uint32_t outer = matrix.outerSize();
+  parallelFor(outer, outerRanges(matrix, width), work);
+}
+
+/**
+  * dest row indices[k] += values[k] * dense row o over the nonzeros of
+  * every outer row o, with one accumulator per range of outer rows.
+  */
+template<typename Storage>
+void scatterRows(SparseMatrix& matrix, Storage* data, DenseRows& denseLayout,
+                 Tensor& dest, DenseRows& destLayout) {
+  uint32_t width = denseLayout.width;
+  uint32_t outer = matrix.outerSize();
+  uint32_t numRanges = outerRanges(matrix, width);
+  uint64_t resultSize = (uint64_t)destLayout.numRows * width;
+  std::vector<double> partials(numRanges * resultSize, 0.0);
+  auto work = [&](uint32_t t, uint64_t first, uint64_t last) {
+    double* result = partials.data() + t * resultSize;
+    for(uint64_t o=first; o<last; o++) {
+      Storage* row = data + o * denseLayout.rowStride;
+      for(uint32_t k=matrix.offsets[o]; k<matrix.offsets[o+1]; k++) {
+        addScaledRow(matrix.values[k], row, denseLayout.columnStride, width,
+                     result + (uint64_t)matrix.indices[k] * width);
+      }
+    }
+  };
+  parallelFor(outer, numRanges, work);
+
+  double* result = partials.data();
+  for(uint32_t t=1; t<numRanges; t++) {
+    double* partial = partials.data() + t * resultSize;
+    for(uint64_t i=0; i<resultSize; i++)
+      result[i] += partial[i];
+  }
+  for(uint32_t i=0; i<destLayout.numRows; i++)
+    writeRow(dest, destLayout, i, result + (uint64_t)i * width);
+}
+
+void sparseMatrixMultiply(SparseMatrix& matrix, bool transpose, Tensor& dense, Tensor& dest,
+                          TensorError* error) {
+  uint32_t numRows = transpose ? matrix.numColumns : matrix.numRows;
+  uint32_t numColumns = transpose ? matrix.numRows : matrix.numColumns;
+  if(dense.numDimensions < 1 || dense.numDimensions > 2 ||
+     dest.numDimensions != dense.numDimensions || dense.shape[0] != numColumns ||
+     dest.shape[0] != numRows ||
+     (dense.numDimensions == 2 && dest.shape[1] != dense.shape[1])) {
+    *error = DimensionMismatchError;
+    return;
+  }
+
+  DenseRows denseLayout(dense);
+  DenseRows destLayout(dest);
+  //the rows of the product are the stored rows of matrix.
+  bool gather = matrix.compressedRows != transpose;
+  if(isFloat32(dense)) {
+    float* data = dense.floatData + dense.initial_offset;
+    if(gather)
+      gatherRows(matrix, data, denseLayout, dest, destLayout);
+    else
+      scatterRows(matrix, data, denseLayout, dest, destLayout);
+  } else {
+    double* data = dense.data + dense.initial_offset;
+    if(gather)
+      gatherRows(matrix, data, denseLayout, dest, destLayout);
+    else
+      scatterRows(matrix, data, denseLayout, dest, destLayout);
+  }
+}
+
+bool CooTensor::isCoalesced(void) {
+  for(uint32_t k=1; k<nnz; k++) {
+    uint32_t* previous = coordsOf(k-1);
+    uint32_t* current = coordsOf(k);
+    if(!std::lexicographical_compare(previous, previous + numDimensions, current, current + numDimensions))
+      return false;
+  }
+  return true;
+}
+
+uint32_t cooCoalesce(CooTensor& tensor) {
+  uint32_t numDimensions = tensor.numDimensions;
+  //order of the nonzeros, by row-major linear index if that fits in 64
+  //bits and by comparing coordinates otherwise. Ties keep their order.
+  std::vector<uint32_t> order(tensor.nnz);
+  bool fitsKey = true;
+  uint64_t size = 1;
+  for(uint32_t d=0; d<numDimensions && fitsKey; d++) {
+    fitsKey = tensor.shape[d] == 0 || size <= UINT64_MAX / tensor.shape[d];
+    size *= tensor.shape[d];
+  }
+  if(fitsKey) {
+    std::vector<std::pair<uint64_t, uint32_t>> keys(tensor.nnz);
+    for(uint32_t k=0; k<tensor.nnz; k++) {
+      uint32_t* coords = tensor.coordsOf(k);
+      uint64_t key = 0;
+      for(uint32_t d=0; d<numDimensions; d++)
+        key = key * tensor.shape[d] + coords[d];
+      keys[k] = std::make_pair(key, k);
+    }
+    std::sort(keys.begin(), keys.end());
+    for(uint32_t k=0; k<tensor.nnz; k++)
+      order[k] = keys[k].second;
+  } else {
+    for(uint32_t k=0; k<tensor.nnz; k++)
+      order[k] = k;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      uint32_t* coordsA = tensor.coordsOf(a);
+      uint32_t* coordsB = tensor.coordsOf(b);
+      return std::lexicographical_compare(coordsA, coordsA + numDimensions, coordsB, coordsB + numDimensions);
+    });
+  }
+
+  std::vector<uint32_t> coords((uint64_t)tensor.nnz * numDimensions);
+  std::vector<double> values(tensor.nnz);
+  uint32_t nnz = 0;
+  for(uint32_t k=0; k<tensor.nnz; k++) {
+    uint32_t* source = tensor.coordsOf(order[k]);
+    if(nnz > 0 && std::equal(source, source + numDimensions, coords.data() + (uint64_t)(nnz-1) * numDimensions)) {
+      values[nnz-1] += tensor.values[order[k]];
+    } else {
+      std::copy(source, source + numDimensions, coords.data() + (uint64_t)nnz * numDimensions);
+      values[nnz++] = tensor.values[order[k]];
+    }
+  }
+  std::copy(coords.begin(), coords.begin() + (uint64_t)nnz * numDimensions, tensor.coords);
+  std::copy(values.begin(), values.begin() + nnz, tensor.values);
+  tensor.nnz = nnz;
+  return nnz;
+}
+
+/**
+  * a block of entries inside a tensor: numDimensions dims of the given
+  * shape, strides in the tensor's storage, walked in row-major order.
+  */
+struct StridedBlock {
+  uint32_t numDimensions;
+  uint32_t* shape;
+  uint64_t* strides;
+
+  uint64_t size(void) {
+    uint64_t size = 1;
+    for(uint32_t d=0; d<numDimensions; d++)
+      size *= shape[d];
+    return size;
+  }
+
+  //calls func(i, offset) for the i-th entry of the block at base.
+  template<typename Func>
+  void forEach(uint64_t base, Func& func) {
+    if(numDimensions == 0) {
+      func(0, base);
+      return;
+    }
+    if(numDimensions == 1) {
+      for(uint32_t j=0; j<shape[0]; j++)
+        func(j, base + j * strides[0]);
+      return;
+    }
+    uint32_t last = numDimensions - 1;
+    uint32_t width = shape[last];
+    uint64_t stride = strides[last];
+    uint64_t numRows = size() / MAX(width, 1u);
+    std::vector<uint32_t> coords(numDimensions, 0);
+    uint64_t rowOffset = base;
+    for(uint64_t row=0; row<numRows; row++) {
+      for(uint32_t j=0; j<width; j++)
+        func(row * width + j, rowOffset + j * stride);
+      for(uint32_t d=last; d>0; d--) {
+        rowOffset += strides[d-1];
+        if(++coords[d-1] < shape[d-1])
+          break;
+        rowOffset -= (uint64_t)coords[d-1] * strides[d-1];
+        coords[d-1] = 0;
+      }
+    }
+  }
+};
+
+template<typename Storage>
+void accumulateBlocks(CooTensor& sparse, uint32_t numLeading, Storage* data, uint64_t* denseStrides,
+                      StridedBlock& trailing, Tensor& dest, StridedBlock& destTrailing,
+                      std::vector<uint32_t>& blocks) {
+  uint32_t numDimensions = sparse.numDimensions;
+  uint64_t width = trailing.size();
+  auto work = [&](uint32_t t, uint64_t first, uint64_t last) {
+    std::vector<double> accumulator(width);
+    for(uint64_t block=first; block<last; block++) {
+      uint32_t k = blocks[block];
+      while(k < blocks[block+1]) {
+        //the nonzeros sharing the leading coordinates of the k-th.
+        uint32_t* leading = sparse.coordsOf(k);
+        std::fill(accumulator.begin(), accumulator.end(), 0.0);
+        do {
+          uint32_t* coords = sparse.coordsOf(k);
+          uint64_t base = 0;
+          for(uint32_t d=numLeading; d<numDimensions; d++)
+            base += coords[d] * denseStrides[numDimensions - 1 - d];
+          double value = sparse.values[k];
+          auto add = [&](uint64_t i, uint64_t offset) {
+            accumulator[i] += value * data[offset];
+          };
+          trailing.forEach(base, add);
+          k++;
+        } while(k < blocks[block+1] && std::equal(leading, leading + numLeading, sparse.coordsOf(k)));
+
+        uint64_t destBase = dest.initial_offset;
+        for(uint32_t d=0; d<numLeading; d++)
+          destBase += leading[d] * dest.strides[d];
+        if(isFloat32(dest)) {
+          auto write = [&](uint64_t i, uint64_t offset) { dest.floatData[offset] = accumulator[i]; };
+          destTrailing.forEach(destBase, write);
+        } else {
+          auto write = [&](uint64_t i, uint64_t offset) { dest.data[offset] = accumulator[i]; };
+          destTrailing.forEach(destBase, write);
+        }
+      }
+    }
+  };
+  parallelFor(blocks.size() - 1, blocks.size() - 1, work);
+}
+
+void cooContract(CooTensor& sparse, Tensor& dense, uint32_t dimsToContract, Tensor& dest,
+                 TensorError* error) {
+  if(dimsToContract > sparse.numDimensions || dimsToContract > dense.numDimensions) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  uint32_t numLeading = sparse.numDimensions - dimsToContract;
+  uint32_t numTrailing = dense.numDimensions - dimsToContract;
+  bool scalar = numLeading + numTrailing == 0;
+  if(scalar ? !(dest.numDimensions == 1 && dest.shape[0] == 1) :
+              dest.numDimensions != numLeading + numTrailing) {
+    *error = DimensionMismatchError;
+    return;
+  }
+  for(uint32_t d=0; d<dimsToContract; d++) {
+    if(sparse.shape[sparse.numDimensions - 1 - d] != dense.shape[d]) {
+      *error = DimensionMismatchError;
+      return;
+    }
+  }
+  for(uint32_t d=0; d<dest.numDimensions && !scalar; d++) {
+    uint32_t expected = d < numLeading ? sparse.shape[d] : dense.shape[d - numLeading + dimsToContract];
+    if(dest.shape[d] != expected) {
+      *error = DimensionMismatchError;
+      return;
+    }
+  }
+
+  //zero dest, then write each run of nonzeros with the same leading
+  //coordinates to its part of dest.
+  StridedBlock wholeDest = {dest.numDimensions, dest.shape, dest.strides};
+  if(isFloat32(dest)) {
+    auto zero = [&](uint64_t i, uint64_t offset) { dest.floatData[offset] = 0; };
+    wholeDest.forEach(dest.initial_offset, zero);
+  } else {
+    auto zero = [&](uint64_t i, uint64_t offset) { dest.data[offset] = 0; };
+    wholeDest.forEach(dest.initial_offset, zero);
+  }
+
+  StridedBlock trailing = {numTrailing, dense.shape + dimsToContract, dense.strides + dimsToContract};
+  StridedBlock destTrailing = {numTrailing, dest.shape + numLeading, dest.strides + numLeading};
+
+  //block boundaries: even splits of the nonzeros, moved forward past any
+  //nonzeros that share leading coordinates with the one before.
+  uint64_t work = (uint64_t)sparse.nnz * MAX(trailing.size(), (uint64_t)1);
+  uint32_t numBlocks = parallelRanges(sparse.nnz, sparse.nnz * SPARSE_PARALLEL_THRESHOLD / MAX(work, (uint64_t)1));
+  std::vector<uint32_t> blocks;
+  blocks.push_back(0);
+  for(uint32_t b=1; b<numBlocks; b++) {
+    uint32_t k = MAX((uint64_t)blocks.back(), (uint64_t)b * sparse.nnz / numBlocks);
+    while(k > 0 && k < sparse.nnz &&
+          std::equal(sparse.coordsOf(k), sparse.coordsOf(k) + numLeading, sparse.coordsOf(k-1)))
+      k++;
+    if(k > blocks.back() && k < sparse.nnz)
+      blocks.push_back(k);
+  }
+  blocks.push_back(sparse.nnz);
+
+  if(isFloat32(dense))
+    accumulateBlocks(sparse, numLeading, dense.floatData + dense.initial_offset, dense.strides,
+                     trailing, dest, destTrailing, blocks);
+  else
+    accumulateBlocks(sparse, numLeading, dense.data + dense.initial_offset, dense.strides,
+                     trailing, dest, destTrailing, blocks);
+}
+
+}
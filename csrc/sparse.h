@@ -0,0 +1,169 @@
+#pragma once
+#include "tensor.h"
+
+namespace tensor {
+
+/**
+  * a sparse vector of length entries: values[k] is the entry at
+  * indices[k], for k < nnz. indices are strictly increasing, and every
+  * other entry is zero. The arrays hold capacity >= nnz entries.
+  *
+  * Dense operands of the sparse kernels are 1-dimensional tensors of
+  * either dtype and any stride, long enough to hold every index of the
+  * sparse operand; otherwise the kernels fail with DimensionMismatchError.
+  */
+struct SparseVector {
+  uint32_t* indices;
+  double* values;
+  uint32_t nnz;
+  uint32_t capacity;
+  uint64_t length;
+
+  //index of the last nonzero plus one.
+  uint64_t extent(void) {
+    return nnz == 0 ? 0 : (uint64_t)indices[nnz - 1] + 1;
+  }
+};
+
+double sparseDot(SparseVector& sparse, Tensor& dense, TensorError* error=&globalError);
+
+/**
+  * dest += scale * sparse.
+  */
+void sparseAxpy(SparseVector& sparse, double scale, Tensor& dest, TensorError* error=&globalError);
+
+/**
+  * the values of dest, which has the indices of source, become
+  * scale * source. dest may be source.
+  */
+void sparseScale(SparseVector& source, double scale, SparseVector& dest, TensorError* error=&globalError);
+
+double sparseSum(SparseVector& sparse);
+
+/**
+  * the values of dest, which has the indices of sparse, become
+  * scale * sparse * dense, or scale * sparse / dense if divide is set.
+  * A dense operand of length 1 is broadcast.
+  */
+void sparseGatherScale(SparseVector& sparse, Tensor& dense, double scale, bool divide,
+                       SparseVector& dest, TensorError* error=&globalError);
+
+/**
+  * dest = scale1 * sparse1 + scale2 * sparse2, stored at the union of
+  * their indices by merging the two index lists. dest needs a capacity of
+  * sparse1.nnz + sparse2.nnz and must not share arrays with either
+  * source; its nnz is set to the size of the union.
+  */
+void sparseSparseAddScale(SparseVector& sparse1, SparseVector& sparse2, double scale1, double scale2,
+                          SparseVector& dest, TensorError* error=&globalError);
+
+/**
+  * dest = scale * sparse1 * sparse2 (elementwise), stored at the
+  * intersection of their indices. dest needs a capacity of the smaller
+  * nnz and must not share arrays with either source; its nnz is set to
+  * the size of the intersection.
+  */
+void sparseSparseMultiplyScale(SparseVector& sparse1, SparseVector& sparse2, double scale,
+                               SparseVector& dest, TensorError* error=&globalError);
+
+double sparseSparseDot(SparseVector& sparse1, SparseVector& sparse2);
+
+/**
+  * dest = sparse^T matrix, for a 2-dimensional matrix, as a sum of scaled
+  * rows of matrix.
+  */
+void sparseMatMul(SparseVector& sparse, Tensor& matrix, Tensor& dest, TensorError* error=&globalError);
+
+/**
+  * a numRows x numColumns sparse matrix in compressed sparse row (CSR)
+  * form if compressedRows is set, and compressed sparse column (CSC) form
+  * otherwise. The nonzeros of outer row (or column) o are
+  * values[k], at inner column (or row) indices[k], for
+  * offsets[o] <= k < offsets[o+1]. offsets has outerSize() + 1 entries,
+  * starting at 0 and nondecreasing.
+  */
+struct SparseMatrix {
+  uint32_t numRows;
+  uint32_t numColumns;
+  bool compressedRows;
+  uint32_t* offsets;
+  uint32_t* indices;
+  double* values;
+
+  uint32_t outerSize(void) {
+    return compressedRows ? numRows : numColumns;
+  }
+
+  uint32_t innerSize(void) {
+    return compressedRows ? numColumns : numRows;
+  }
+
+  uint32_t nnz(void) {
+    return offsets[outerSize()];
+  }
+};
+
+//products are split across threads in ranges of at least this many
+//multiply-adds.
+const uint64_t SPARSE_PARALLEL_THRESHOLD = 1 << 15;
+
+/**
+  * dest = matrix dense, or matrix^T dense if transpose is set, where dense
+  * and dest are both vectors (SpMV) or both 2-dimensional (SpMM), of
+  * either dtype and any strides. dest must not overlap dense.
+  *
+  * Products along the stored rows of matrix (CSR, or CSC transposed) are
+  * gathers and split across threads by output rows. The others are
+  * scatters: each thread adds into a private copy of dest, and the copies
+  * are summed in thread order, so the result only depends on the number
+  * of threads through the order of the summation.
+  */
+void sparseMatrixMultiply(SparseMatrix& matrix, bool transpose, Tensor& dense, Tensor& dest,
+                          TensorError* error=&globalError);
+
+/**
+  * a sparse tensor of any rank in coordinate (COO) form: the k-th nonzero
+  * is values[k] at coordinates coords[k * numDimensions + d], for k < nnz.
+  * The nonzeros may come in any order and repeat coordinates (repeated
+  * entries add up) until the tensor is coalesced.
+  */
+struct CooTensor {
+  uint32_t numDimensions;
+  uint32_t* shape;
+  uint32_t* coords;
+  double* values;
+  uint32_t nnz;
+
+  uint32_t* coordsOf(uint32_t k) {
+    return coords + (uint64_t)k * numDimensions;
+  }
+
+  //nonzeros sorted in row-major order of their coordinates, no repeats.
+  bool isCoalesced(void);
+};
+
+/**
+  * sorts the nonzeros of tensor into row-major order of their coordinates
+  * and sums the values of repeated coordinates, in place. Returns the new
+  * nnz. Repeats are summed in their original order, so the result does not
+  * depend on the sort.
+  */
+uint32_t cooCoalesce(CooTensor& tensor);
+
+/**
+  * dest = contraction of the last dimsToContract dimensions of sparse with
+  * the first dimsToContract dimensions of dense, following the axis
+  * convention of contract(): the last dimension of sparse pairs with the
+  * first of dense, the one before it with the second, and so on. dest has
+  * the remaining dimensions of sparse followed by the remaining dimensions
+  * of dense (or shape [1] if there are none). sparse must be coalesced; dense and dest may have any
+  * strides and either dtype, and dest must not overlap dense.
+  *
+  * The nonzeros are split into blocks at changes of their leading (not
+  * contracted) coordinates, so each thread writes its own part of dest,
+  * accumulating in double.
+  */
+void cooContract(CooTensor& sparse, Tensor& dense, uint32_t dimsToContract, Tensor& dest,
+                 TensorError* error=&globalError);
+
+}
@@ -1,86 +1,231 @@
+#include <atomic>
 #include <iostream>
-#include <chrono>
-#include <random>
+#include <climits>
+#include <vector>
 #include "cblas.h"
 
 #include "tensor.h"
+#include "parallel.h"
 namespace tensor {
 
-TensorError globalError;
+thread_local TensorError globalError;
+
+std::atomic<uint32_t> numThreads(MAX(std::thread::hardware_concurrency(), 1u));
+
+void setNumThreads(uint32_t threads) {
+  numThreads = MAX(threads, 1u);
+}
+
+uint32_t getNumThreads(void) {
+  return numThreads;
+}
 
 using std::cout;
 using std::endl;
 
-std::mt19937 global_generator;
+bool identicalLayout(Tensor& tensor1, Tensor& tensor2);
+
+/**
+  * dense kernels shared by the Float64 and Float32 storage types.
+  * Whatever the storage type, arithmetic and accumulation are done in
+  * double precision and only the final store is narrowed.
+  *
+  * The kernels are templated on the loop index type; INDEX_DISPATCH runs
+  * them with a 32-bit index whenever the extent fits in one.
+  * The reductions keep four independent accumulators so that the adds
+  * pipeline; the compiler may not reorder a single floating point sum.
+  * Their unrolled loops test size-i, which cannot wrap around as i+4 can
+  * with a 32-bit index near UINT32_MAX.
+  **/
+#define INDEX_DISPATCH(size, kernel, ...) \
+  ((size) <= UINT32_MAX ? kernel<uint32_t>(__VA_ARGS__) : kernel<uint64_t>(__VA_ARGS__))
+
+template<typename Index, typename S1, typename S2>
+double denseDotKernel(S1* source1, S2* source2, uint64_t totalSize) {
+  double product[4] = {0.0, 0.0, 0.0, 0.0};
+  Index size = totalSize;
+  Index i = 0;
+  for(; size-i>=4; i+=4) {
+    product[0] += (double)source1[i] * (double)source2[i];
+    product[1] += (double)source1[i+1] * (double)source2[i+1];
+    product[2] += (double)source1[i+2] * (double)source2[i+2];
+    product[3] += (double)source1[i+3] * (double)source2[i+3];
+  }
+  for(; i<size; i++) {
+    product[0] += (double)source1[i] * (double)source2[i];
+  }
+  return (product[0] + product[1]) + (product[2] + product[3]);
+}
+
+template<typename Index, typename S>
+double denseSumKernel(S* source, uint64_t totalSize) {
+  double answer[4] = {0.0, 0.0, 0.0, 0.0};
+  Index size = totalSize;
+  Index i = 0;
+  for(; size-i>=4; i+=4) {
+    answer[0] += source[i];
+    answer[1] += source[i+1];
+    answer[2] += source[i+2];
+    answer[3] += source[i+3];
+  }
+  for(; i<size; i++) {
+    answer[0] += source[i];
+  }
+  return (answer[0] + answer[1]) + (answer[2] + answer[3]);
+}
+
+template<typename Index, typename S>
+void denseAddScaleKernel(S* source1, S* source2, double scale1, double scale2, S* dest, uint64_t totalSize) {
+  Index size = totalSize;
+  for(Index i=0; i<size; i++) {
+    dest[i] = scale1 * (double)source1[i] + scale2 * (double)source2[i];
+  }
+}
+
+template<typename Index, typename S>
+void denseMultiplyScaleKernel(S* source1, S* source2, double scale, S* dest, uint64_t totalSize) {
+  Index size = totalSize;
+  for(Index i=0; i<size; i++) {
+    dest[i] = scale * (double)source1[i] * (double)source2[i];
+  }
+}
+
+template<typename Index, typename S>
+void denseDivideScaleKernel(S* source1, S* source2, double scale, S* dest, uint64_t totalSize) {
+  Index size = totalSize;
+  for(Index i=0; i<size; i++) {
+    dest[i] = scale * (double)source1[i] / (double)source2[i];
+  }
+}
 
-void seed_generator(void) {
-  try {
-    std::random_device rd;
-    global_generator.seed(rd());
-  } catch(int e) {
-    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count() + 3;
-    global_generator.seed(seed);
+template<typename Index, typename S>
+void denseScaleKernel(S* source, double scale, S* dest, uint64_t totalSize) {
+  Index size = totalSize;
+  for(Index i=0; i<size; i++) {
+    dest[i] = scale * (double)source[i];
   }
 }
 
-uint32_t Tensor::totalSize(void) {
+uint64_t Tensor::totalSize(void) {
   if(this->numDimensions == 0) {
     return 0;
   }
-  uint32_t accumulator = 1;
+  uint64_t accumulator = 1;
   for(uint32_t i=0; i<this->numDimensions; i++) {
     accumulator *= this->shape[i];
   }
   return accumulator;
 }
 
-uint32_t Tensor::maximumOffset(void) {
+uint64_t Tensor::maximumOffset(void) {
   if(this->numDimensions == 0) {
     return this->initial_offset;
   }
-  uint32_t offset = this->initial_offset;
+  uint64_t offset = this->initial_offset;
 
   for(uint32_t i=0; i<this->numDimensions; i++) {
-    offset += (this->shape[i]-1)*this->strides[i];
+    offset += (uint64_t)(this->shape[i]-1)*this->strides[i];
   }
 
   return offset;
 }
 
 bool Tensor::isValid(void) {
-  return this->data != NULL;
+  return this->data != NULL || this->floatData != NULL;
 }
 
-double& Tensor::at(uint32_t* coords, TensorError* error) {
-  uint32_t offset = this->initial_offset;
+uint64_t Tensor::offsetOf(uint32_t* coords, TensorError* error) {
+  uint64_t offset = this->initial_offset;
   for(uint32_t i=0; i<this->numDimensions; i++) {
     if(coords[i] >= this->shape[i]) {
       *error = IndexOutOfBounds;
-      return this->data[offset];
+      return offset;
     }
-    offset += coords[i] * this->strides[i];
+    offset += (uint64_t)coords[i] * this->strides[i];
   }
-  return this->data[offset];
+  return offset;
 }
 
-double& Tensor::broadcast_at(uint32_t* coords, uint32_t numCoords, TensorError* error) {
-  uint32_t offset = this->initial_offset;
+uint64_t Tensor::broadcastOffsetOf(uint32_t* coords, uint32_t numCoords, TensorError* error) {
+  uint64_t offset = this->initial_offset;
   for(uint32_t i=0; i<this->numDimensions; i++) {
     uint32_t dimension = this->shape[this->numDimensions - i - 1];
-    uint32_t stride = this->strides[this->numDimensions - i - 1];
+    uint64_t stride = this->strides[this->numDimensions - i - 1];
     uint32_t coord = coords[numCoords -i -1];
     if(coord < dimension) {
       offset += coord * stride;
     } else if(dimension != 1) {
       *error = IndexOutOfBounds;
-      return this->data[offset];
+      return offset;
     }
   }
+  return offset;
+}
+
+double& Tensor::at(uint32_t* coords, TensorError* error) {
+  return this->data[this->offsetOf(coords, error)];
+}
+
+double& Tensor::broadcast_at(uint32_t* coords, uint32_t numCoords, TensorError* error) {
+  return this->data[this->broadcastOffsetOf(coords, numCoords, error)];
+}
+
+double Tensor::get(uint32_t* coords, TensorError* error) {
+  uint64_t offset = this->offsetOf(coords, error);
+  if(this->dtype == Float32)
+    return this->floatData[offset];
   return this->data[offset];
 }
 
+double Tensor::broadcast_get(uint32_t* coords, uint32_t numCoords, TensorError* error) {
+  uint64_t offset = this->broadcastOffsetOf(coords, numCoords, error);
+  if(this->dtype == Float32)
+    return this->floatData[offset];
+  return this->data[offset];
+}
+
+void Tensor::set(uint32_t* coords, double value, TensorError* error) {
+  uint64_t offset = this->offsetOf(coords, error);
+  if(this->dtype == Float32)
+    this->floatData[offset] = value;
+  else
+    this->data[offset] = value;
+}
+
+/**
+  * makes this tensor a view on the same storage as other.
+  * shape, strides and initial_offset are left untouched.
+  **/
+void Tensor::shareStorage(Tensor& other) {
+  this->dtype = other.dtype;
+  this->data = other.data;
+  this->floatData = other.floatData;
+}
+
+bool Tensor::sameStorage(Tensor& other) {
+  return this->dtype == other.dtype &&
+         this->data == other.data &&
+         this->floatData == other.floatData;
+}
+
+bool isFloat32(Tensor& t1) {
+  return t1.dtype == Float32;
+}
+
+bool anyFloat32(Tensor& t1, Tensor& t2) {
+  return isFloat32(t1) || isFloat32(t2);
+}
+
+bool anyFloat32(Tensor& t1, Tensor& t2, Tensor& t3) {
+  return isFloat32(t1) || isFloat32(t2) || isFloat32(t3);
+}
+
+bool sameDataType(Tensor& t1, Tensor& t2, Tensor& t3) {
+  return t1.dtype == t2.dtype && t1.dtype == t3.dtype;
+}
+
 /**
-  * sets the strides pouint32_ter in the tensor object.
+  * sets the strides pointer in the tensor object.
   * shapeInReversedOrder specifies whether the tensor is 
   * stored in "column major" or "row major" order. Specifically, if
   * shapeInReversedOrder is true, the ijk th element of a NxMxK tensor
@@ -99,13 +244,13 @@ double& Tensor::broadcast_at(uint32_t* coords, uint32_t numCoords, TensorError*
 
 void Tensor::setStrides(bool shapeInReversedOrder) {
   if(shapeInReversedOrder) {
-    uint32_t currentStride = 1;
+    uint64_t currentStride = 1;
     for(uint32_t i=0; i<numDimensions; i++) {
       this->strides[i] = currentStride;
       currentStride *= this->shape[i];
     }
   } else {
-    uint32_t currentStride = 1;
+    uint64_t currentStride = 1;
     for(int i=this->numDimensions-1; i>=0; i--) {
       this->strides[i] = currentStride;
       currentStride *= this->shape[i];
@@ -114,7 +259,7 @@ void Tensor::setStrides(bool shapeInReversedOrder) {
 }
 
 void transpose(Tensor& source, Tensor& dest, TensorError* error) {
-  if(source.data != dest.data) {
+  if(!source.sameStorage(dest)) {
     *error = MemoryLeakError;
     return;
   }
@@ -122,9 +267,15 @@ void transpose(Tensor& source, Tensor& dest, TensorError* error) {
     *error = SizeMismatchError;
     return;
   }
-  for(uint32_t i=0; i<source.numDimensions; i++) {
-    dest.shape[i] = source.shape[source.numDimensions-1-i];
-    dest.strides[i] = source.strides[source.numDimensions-1-i];
+  //swaps pairs of dimensions, so that dest may be source.
+  for(uint32_t i=0; i<(source.numDimensions+1)/2; i++) {
+    uint32_t j = source.numDimensions-1-i;
+    uint32_t shape = source.shape[i];
+    uint64_t stride = source.strides[i];
+    dest.shape[i] = source.shape[j];
+    dest.strides[i] = source.strides[j];
+    dest.shape[j] = shape;
+    dest.strides[j] = stride;
   }
   dest.initial_offset = source.initial_offset;
 }
@@ -178,7 +329,7 @@ bool compatibleDimensions(Tensor& t1, Tensor& t2) {
   * We assume heldCoords is sorted.
   **/
 void subTensor(Tensor& source, uint32_t* heldCoords, uint32_t* heldValues, uint32_t numHeld, Tensor& dest, TensorError* error) {
-  if(dest.data!=source.data) {
+  if(!dest.sameStorage(source)) {
     *error = MemoryLeakError;
     return;   
   }
@@ -188,14 +339,14 @@ void subTensor(Tensor& source, uint32_t* heldCoords, uint32_t* heldValues, uint3
   }
   uint32_t heldCoordsIndex = 0;
   uint32_t destDimensionIndex = 0;
-  uint32_t offset = source.initial_offset;
+  uint64_t offset = source.initial_offset;
   for(uint32_t i=0; i<source.numDimensions; i++) {
     if(heldCoordsIndex>= numHeld || i!=heldCoords[heldCoordsIndex]) {
       dest.shape[destDimensionIndex] = source.shape[i];
       dest.strides[destDimensionIndex] = source.strides[i];
       destDimensionIndex++;
     } else {
-      offset += source.strides[i] * heldValues[heldCoordsIndex];
+      offset += source.strides[i] * (uint64_t)heldValues[heldCoordsIndex];
       heldCoordsIndex++;
     }
   }
@@ -209,11 +360,11 @@ bool TensorIterator::next(void) {
   } else {
    
     uint32_t i = 0;
-    int offset = 0;
+    int64_t offset = 0;
     currentCoords[i] = (currentCoords[i] + 1) % T->shape[i];
     offset += T->strides[i];
     while(currentCoords[i] == 0) {
-      offset -= T->strides[i] * T->shape[i];
+      offset -= (int64_t)(T->strides[i] * T->shape[i]);
       i++;
       if(i>=T->numDimensions) {
         ended = true;
@@ -253,6 +404,31 @@ uint32_t* MultiIndexIterator::get(void) {
   return currentCoords;
 }
 
+/**
+  * scalar product of tensors with at least one Float32 operand.
+  * Products and the running sum are always computed in double precision.
+  **/
+double mixedScalarProduct(Tensor& t1, Tensor& t2) {
+  if(isDense(t1) && isDense(t2) && identicalLayout(t1, t2)) {
+    uint64_t totalSize = t1.totalSize();
+    if(isFloat32(t1) && isFloat32(t2)) {
+      return INDEX_DISPATCH(totalSize, denseDotKernel, t1.floatData + t1.initial_offset, t2.floatData + t2.initial_offset, totalSize);
+    } else if(isFloat32(t1)) {
+      return INDEX_DISPATCH(totalSize, denseDotKernel, t1.floatData + t1.initial_offset, t2.data + t2.initial_offset, totalSize);
+    } else {
+      return INDEX_DISPATCH(totalSize, denseDotKernel, t1.data + t1.initial_offset, t2.floatData + t2.initial_offset, totalSize);
+    }
+  }
+
+  double product = 0.0;
+  MultiIndexIterator iterator(t1.shape, t1.numDimensions);
+  do {
+    uint32_t* currentCoords = iterator.get();
+    product += t1.get(currentCoords) * t2.get(currentCoords);
+  } while(iterator.next());
+  return product;
+}
+
 double scalarProduct(Tensor& t1, Tensor& t2, TensorError* error) {
 
   if(!matchedDimensions(t1, t2)) {
@@ -260,6 +436,10 @@ double scalarProduct(Tensor& t1, Tensor& t2, TensorError* error) {
     return 0.0;
   }
 
+  if(anyFloat32(t1, t2)) {
+    return mixedScalarProduct(t1, t2);
+  }
+
   TensorIterator iter1(t1);
   TensorIterator iter2(t2);
   double product = 0.0;
@@ -302,13 +482,40 @@ bool compatibleForContraction(Tensor& source1, Tensor& source2, uint32_t dimsToC
   return true;
 }
 
+template<typename D>
+void rowMajorOuterProduct(Tensor& source1, std::vector<double>& values2, D* dest) {
+  uint64_t size1 = source1.totalSize();
+  uint64_t size2 = values2.size();
+  for(uint64_t i=0; i<size1; i++) {
+    uint64_t offset = source1.initial_offset + i;
+    double value1 = isFloat32(source1) ? source1.floatData[offset] : source1.data[offset];
+    D* row = dest + i * size2;
+    for(uint64_t j=0; j<size2; j++)
+      row[j] = value1 * values2[j];
+  }
+}
+
 void outerProduct(Tensor& source1, Tensor& source2, Tensor& dest, TensorError* error) {
 
+  //every entry of source1 times a row-major copy of source2.
+  if(isRowMajor(source1) && isRowMajor(source2) && isRowMajor(dest)) {
+    std::vector<double> values2(source2.totalSize());
+    for(uint64_t j=0; j<values2.size(); j++) {
+      uint64_t offset = source2.initial_offset + j;
+      values2[j] = isFloat32(source2) ? source2.floatData[offset] : source2.data[offset];
+    }
+    if(isFloat32(dest))
+      rowMajorOuterProduct(source1, values2, dest.floatData + dest.initial_offset);
+    else
+      rowMajorOuterProduct(source1, values2, dest.data + dest.initial_offset);
+    return;
+  }
+
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
 
   do {
     uint32_t* currentCoords = destIterator.get();
-    dest.at(currentCoords, error) = source1.at(currentCoords, error) * source2.at(currentCoords + source1.numDimensions, error);
+    dest.set(currentCoords, source1.get(currentCoords, error) * source2.get(currentCoords + source1.numDimensions, error), error);
 
     if(*error != NoError)
       return;
@@ -316,6 +523,8 @@ void outerProduct(Tensor& source1, Tensor& source2, Tensor& dest, TensorError* e
   } while(destIterator.next());
 }
 
+void genericContract(Tensor& source1, Tensor& source2, uint32_t dimsToContract, Tensor& dest, TensorError* error);
+
 void contract(Tensor& source1, Tensor& source2, uint32_t dimsToContract, Tensor& dest, TensorError* error) {
 
   //Verify dimensions
@@ -338,7 +547,21 @@ void contract(Tensor& source1, Tensor& source2, uint32_t dimsToContract, Tensor&
     return;
   }
 
-  //check for special-case speedups using BLAS routines:
+  //check for special-case speedups using BLAS routines.
+  //BLAS needs all three tensors in the same storage type; mixed storage
+  //goes through the generic path below, which accumulates in double.
+  if(!sameDataType(source1, source2, dest)) {
+    genericContract(source1, source2, dimsToContract, dest, error);
+    return;
+  }
+
+  //the single precision BLAS paths have no native fallback.
+  if(isFloat32(dest) &&
+     !(isDense(source1) && isDense(source2) && isDense(dest) &&
+       fitsBLAS(source1) && fitsBLAS(source2) && fitsBLAS(dest))) {
+    genericContract(source1, source2, dimsToContract, dest, error);
+    return;
+  }
 
   //MM matrix-matrix multiply
   if(source1.numDimensions==2 && source2.numDimensions==2 && dimsToContract==1) {
@@ -364,28 +587,36 @@ void contract(Tensor& source1, Tensor& source2, uint32_t dimsToContract, Tensor&
     return;
   }
 
+  genericContract(source1, source2, dimsToContract, dest, error);
+}
 
+/**
+  * contraction by explicit scalar products of subtensors.
+  * Works for any combination of storage types.
+  **/
+void genericContract(Tensor& source1, Tensor& source2, uint32_t dimsToContract, Tensor& dest, TensorError* error) {
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
 
-  uint32_t* dimRange = new uint32_t[dest.numDimensions];
-  for(uint32_t i=0; i<dest.numDimensions; i++) {
+  //source1 keeps its leading dimensions fixed and source2 its trailing ones.
+  uint32_t* dimRange = new uint32_t[dest.numDimensions + dimsToContract];
+  for(uint32_t i=0; i<dest.numDimensions + dimsToContract; i++) {
     dimRange[i] = i;
   }
   Tensor sub1, sub2;
 
   if(dimsToContract != 0) {
     sub1.shape = new uint32_t[dimsToContract];
-    sub1.strides = new uint32_t[dimsToContract];
+    sub1.strides = new uint64_t[dimsToContract];
   }
   sub1.numDimensions = dimsToContract;
-  sub1.data = source1.data;
+  sub1.shareStorage(source1);
 
   if(dimsToContract != 0) {
     sub2.shape = new uint32_t[dimsToContract];
-    sub2.strides = new uint32_t[dimsToContract];
+    sub2.strides = new uint64_t[dimsToContract];
   }
   sub2.numDimensions = dimsToContract;
-  sub2.data = source2.data;
+  sub2.shareStorage(source2);
 
   do {
     uint32_t* currentCoords = destIterator.get();
@@ -397,7 +628,7 @@ void contract(Tensor& source1, Tensor& source2, uint32_t dimsToContract, Tensor&
               error);
     transpose(sub1, sub1, error);
     subTensor(source2, 
-              dimRange + source1.numDimensions - dimsToContract,
+              dimRange + dimsToContract,
               currentCoords + source1.numDimensions - dimsToContract,
               source2.numDimensions - dimsToContract,
               sub2,
@@ -406,13 +637,14 @@ void contract(Tensor& source1, Tensor& source2, uint32_t dimsToContract, Tensor&
     if(*error != NoError)
       return;
 
-    dest.at(currentCoords, error) = scalarProduct(sub1, sub2, error);
+    dest.set(currentCoords, scalarProduct(sub1, sub2, error), error);
 
     if(*error != NoError)
       return;
 
   } while(destIterator.next());
 
+  delete [] dimRange;
   if(dimsToContract != 0) {
     delete [] sub1.shape;
     delete [] sub1.strides;
@@ -465,13 +697,24 @@ void addScale(Tensor& source1, Tensor& source2, double scale1, double scale2, Te
     return;
   }
 
-  if(identicalLayout(dest, source1) && identicalLayout(dest, source2) && isDense(dest)) {
+  if(identicalLayout(dest, source1) && identicalLayout(dest, source2) && isDense(dest) && sameDataType(source1, source2, dest)) {
     denseAddScale(source1, source2, scale1, scale2, dest);
     return;
   }
 
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
   uint32_t numDim = dest.numDimensions;
+
+  if(anyFloat32(source1, source2, dest)) {
+    do {
+      uint32_t* currentCoords = destIterator.get();
+      dest.set(currentCoords,
+        scale1 * source1.broadcast_get(currentCoords, numDim) +
+        scale2 * source2.broadcast_get(currentCoords, numDim));
+    } while(destIterator.next());
+    return;
+  }
+
   do {
     uint32_t* currentCoords = destIterator.get();
     dest.at(currentCoords) = 
@@ -482,15 +725,21 @@ void addScale(Tensor& source1, Tensor& source2, double scale1, double scale2, Te
 }
 
 void denseAddScale(Tensor& source1, Tensor& source2, double scale1, double scale2, Tensor& dest) {
-  uint32_t totalSize = source1.totalSize();
-  double* source1Iterator = source1.data + source1.initial_offset;
-  double* source2Iterator = source2.data + source2.initial_offset;
-  double* destIterator = dest.data + dest.initial_offset;
-  for(uint32_t i = 0; i<totalSize; i++) {
-    *destIterator = scale1 * (*source1Iterator) + scale2* (*source2Iterator);
-    destIterator++;
-    source1Iterator++;
-    source2Iterator++;
+  uint64_t totalSize = source1.totalSize();
+  if(isFloat32(dest)) {
+    INDEX_DISPATCH(totalSize, denseAddScaleKernel,
+                   source1.floatData + source1.initial_offset,
+                   source2.floatData + source2.initial_offset,
+                   scale1, scale2,
+                   dest.floatData + dest.initial_offset,
+                   totalSize);
+  } else {
+    INDEX_DISPATCH(totalSize, denseAddScaleKernel,
+                   source1.data + source1.initial_offset,
+                   source2.data + source2.initial_offset,
+                   scale1, scale2,
+                   dest.data + dest.initial_offset,
+                   totalSize);
   }
 }
 
@@ -504,13 +753,25 @@ void multiplyScale(Tensor& source1, Tensor& source2, double scale, Tensor& dest,
     return;
   }
 
-  if(identicalLayout(dest, source1) && identicalLayout(dest, source2) && isDense(dest)) {
+  if(identicalLayout(dest, source1) && identicalLayout(dest, source2) && isDense(dest) && sameDataType(source1, source2, dest)) {
     denseMultiplyScale(source1, source2, scale, dest);
     return;
   }
 
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
   uint32_t numDim = dest.numDimensions;
+
+  if(anyFloat32(source1, source2, dest)) {
+    do {
+      uint32_t* currentCoords = destIterator.get();
+      dest.set(currentCoords,
+        scale * 
+        source1.broadcast_get(currentCoords, numDim) *
+        source2.broadcast_get(currentCoords, numDim));
+    } while(destIterator.next());
+    return;
+  }
+
   do {
     uint32_t* currentCoords = destIterator.get();
     dest.at(currentCoords) = 
@@ -522,15 +783,21 @@ void multiplyScale(Tensor& source1, Tensor& source2, double scale, Tensor& dest,
 }
 
 void denseMultiplyScale(Tensor& source1, Tensor& source2, double scale, Tensor& dest) {
-  uint32_t totalSize = source1.totalSize();
-  double* source1Iterator = source1.data + source1.initial_offset;
-  double* source2Iterator = source2.data + source2.initial_offset;
-  double* destIterator = dest.data + dest.initial_offset;
-  for(uint32_t i = 0; i<totalSize; i++) {
-    *destIterator = scale * (*source1Iterator) * (*source2Iterator);
-    destIterator++;
-    source1Iterator++;
-    source2Iterator++;
+  uint64_t totalSize = source1.totalSize();
+  if(isFloat32(dest)) {
+    INDEX_DISPATCH(totalSize, denseMultiplyScaleKernel,
+                   source1.floatData + source1.initial_offset,
+                   source2.floatData + source2.initial_offset,
+                   scale,
+                   dest.floatData + dest.initial_offset,
+                   totalSize);
+  } else {
+    INDEX_DISPATCH(totalSize, denseMultiplyScaleKernel,
+                   source1.data + source1.initial_offset,
+                   source2.data + source2.initial_offset,
+                   scale,
+                   dest.data + dest.initial_offset,
+                   totalSize);
   }
 }
 
@@ -544,13 +811,25 @@ void divideScale(Tensor& source1, Tensor& source2, double scale, Tensor& dest, T
     return;
   }
 
-  if(identicalLayout(dest, source1) && identicalLayout(dest, source2) && isDense(dest)) {
+  if(identicalLayout(dest, source1) && identicalLayout(dest, source2) && isDense(dest) && sameDataType(source1, source2, dest)) {
     denseDivideScale(source1, source2, scale, dest);
     return;
   }
 
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
   uint32_t numDim = dest.numDimensions;
+
+  if(anyFloat32(source1, source2, dest)) {
+    do {
+      uint32_t* currentCoords = destIterator.get();
+      dest.set(currentCoords,
+        scale * 
+        source1.broadcast_get(currentCoords, numDim) /
+        source2.broadcast_get(currentCoords, numDim));
+    } while(destIterator.next());
+    return;
+  }
+
   do {
     uint32_t* currentCoords = destIterator.get();
     dest.at(currentCoords) = 
@@ -562,15 +841,21 @@ void divideScale(Tensor& source1, Tensor& source2, double scale, Tensor& dest, T
 }
 
 void denseDivideScale(Tensor& source1, Tensor& source2, double scale, Tensor& dest) {
-  uint32_t totalSize = source1.totalSize();
-  double* source1Iterator = source1.data + source1.initial_offset;
-  double* source2Iterator = source2.data + source2.initial_offset;
-  double* destIterator = dest.data + dest.initial_offset;
-  for(uint32_t i = 0; i<totalSize; i++) {
-    *destIterator = scale * (*source1Iterator) / (*source2Iterator);
-    destIterator++;
-    source1Iterator++;
-    source2Iterator++;
+  uint64_t totalSize = source1.totalSize();
+  if(isFloat32(dest)) {
+    INDEX_DISPATCH(totalSize, denseDivideScaleKernel,
+                   source1.floatData + source1.initial_offset,
+                   source2.floatData + source2.initial_offset,
+                   scale,
+                   dest.floatData + dest.initial_offset,
+                   totalSize);
+  } else {
+    INDEX_DISPATCH(totalSize, denseDivideScaleKernel,
+                   source1.data + source1.initial_offset,
+                   source2.data + source2.initial_offset,
+                   scale,
+                   dest.data + dest.initial_offset,
+                   totalSize);
   }
 }
 
@@ -580,12 +865,21 @@ void scale(Tensor& source, double scale, Tensor& dest, TensorError* error) {
     return;
   }
 
-  if(identicalLayout(dest, source) && isDense(dest)) {
+  if(identicalLayout(dest, source) && isDense(dest) && source.dtype == dest.dtype) {
     denseScale(source, scale, dest);
     return;
   }
 
   MultiIndexIterator destIterator(dest.shape, dest.numDimensions);
+
+  if(anyFloat32(source, dest)) {
+    do {
+      uint32_t* currentCoords = destIterator.get();
+      dest.set(currentCoords, scale * source.get(currentCoords));
+    } while(destIterator.next());
+    return;
+  }
+
   do {
     uint32_t* currentCoords = destIterator.get();
     dest.at(currentCoords) = 
@@ -594,13 +888,19 @@ void scale(Tensor& source, double scale, Tensor& dest, TensorError* error) {
 }
 
 void denseScale(Tensor& source, double scale, Tensor& dest) {
-  uint32_t totalSize = source.totalSize();
-  double* sourceIterator = source.data + source.initial_offset;
-  double* destIterator = dest.data + dest.initial_offset;
-  for(uint32_t i = 0; i<totalSize; i++) {
-    *destIterator = scale * (*sourceIterator);
-    destIterator++;
-    sourceIterator++;
+  uint64_t totalSize = source.totalSize();
+  if(isFloat32(dest)) {
+    INDEX_DISPATCH(totalSize, denseScaleKernel,
+                   source.floatData + source.initial_offset,
+                   scale,
+                   dest.floatData + dest.initial_offset,
+                   totalSize);
+  } else {
+    INDEX_DISPATCH(totalSize, denseScaleKernel,
+                   source.data + source.initial_offset,
+                   scale,
+                   dest.data + dest.initial_offset,
+                   totalSize);
   }
 }
 
@@ -622,14 +922,14 @@ void divide(Tensor& source1, Tensor& source2, Tensor& dest, TensorError* error)
 
 bool isDense(Tensor& source) {
   if(source.strides[0]==1) {
-    uint32_t denseStride = 1;
+    uint64_t denseStride = 1;
     for(uint32_t i=0; i<source.numDimensions; i++) {
       if(source.strides[i] != denseStride)
         return false;
       denseStride *= source.shape[i];
     }
   } else if(source.strides[source.numDimensions-1] == 1) {
-    uint32_t denseStride = 1;
+    uint64_t denseStride = 1;
     for(uint32_t i=0; i<source.numDimensions; i++) {
       if(source.strides[source.numDimensions - i -1] != denseStride)
         return false;
@@ -641,19 +941,29 @@ bool isDense(Tensor& source) {
   return true;
 }
 
+bool isRowMajor(Tensor& source) {
+  uint64_t denseStride = 1;
+  for(uint32_t i=source.numDimensions; i>0; i--) {
+    if(source.strides[i-1] != denseStride)
+      return false;
+    denseStride *= source.shape[i-1];
+  }
+  return true;
+}
+
 void simpleMatMul(Tensor& source1, Tensor& source2, Tensor& dest) {
   double* destData = dest.data + dest.initial_offset;
   double* source1Data = source1.data + source1.initial_offset;
   double* source2Data = source2.data + source2.initial_offset;
 
-  uint32_t destStrides0 = dest.strides[0];
-  uint32_t destStrides1 = dest.strides[1];
+  uint64_t destStrides0 = dest.strides[0];
+  uint64_t destStrides1 = dest.strides[1];
 
-  uint32_t source1Strides0 = source1.strides[0];
-  uint32_t source1Strides1 = source1.strides[1];
+  uint64_t source1Strides0 = source1.strides[0];
+  uint64_t source1Strides1 = source1.strides[1];
 
-  uint32_t source2Strides0 = source2.strides[0];
-  uint32_t source2Strides1 = source2.strides[1];
+  uint64_t source2Strides0 = source2.strides[0];
+  uint64_t source2Strides1 = source2.strides[1];
 
   uint32_t kMax = source1.shape[1];
 
@@ -673,9 +983,18 @@ void simpleMatMul(Tensor& source1, Tensor& source2, Tensor& dest) {
   }
 }
 
+/**
+  * BLAS takes int sizes and strides, so tensors whose extent in memory
+  * does not fit in an int have to use the native loops.
+  **/
+bool fitsBLAS(Tensor& source) {
+  return source.maximumOffset() - source.initial_offset < INT_MAX;
+}
+
 void fastMatMul(Tensor& source1, Tensor& source2, Tensor& dest) {
 
-  if(!isDense(source1) || !isDense(source2) || !isDense(dest)) {
+  if(!isDense(source1) || !isDense(source2) || !isDense(dest) ||
+     !fitsBLAS(source1) || !fitsBLAS(source2) || !fitsBLAS(dest)) {
     simpleMatMul(source1, source2, dest);
     return;
   }
@@ -683,9 +1002,9 @@ void fastMatMul(Tensor& source1, Tensor& source2, Tensor& dest) {
   CBLAS_ORDER order=CblasRowMajor;
   CBLAS_TRANSPOSE transpose1=CblasNoTrans;
   CBLAS_TRANSPOSE transpose2=CblasNoTrans;
-  uint32_t source1Stride = MAX(source1.strides[0], source1.strides[1]);
-  uint32_t source2Stride = MAX(source2.strides[0], source2.strides[1]);
-  uint32_t destStride = MAX(dest.strides[0], dest.strides[1]);
+  int source1Stride = MAX(source1.strides[0], source1.strides[1]);
+  int source2Stride = MAX(source2.strides[0], source2.strides[1]);
+  int destStride = MAX(dest.strides[0], dest.strides[1]);
   if(dest.strides[0] == 1) {
     order = CblasColMajor;
     if(source1.strides[0] == 1) {
@@ -714,6 +1033,10 @@ void fastMatMul(Tensor& source1, Tensor& source2, Tensor& dest) {
       transpose2 = CblasTrans;
     }
   }
+  if(isFloat32(dest)) {
+    cblas_sgemm(order, transpose1, transpose2, source1.shape[0], source2.shape[1], source1.shape[1], 1.0, source1.floatData+source1.initial_offset, source1Stride, source2.floatData+source2.initial_offset, source2Stride, 0.0, dest.floatData+dest.initial_offset, destStride);
+    return;
+  }
   cblas_dgemm(order, transpose1, transpose2, source1.shape[0], source2.shape[1], source1.shape[1], 1.0, source1.data+source1.initial_offset, source1Stride, source2.data+source2.initial_offset, source2Stride, 0.0, dest.data+dest.initial_offset, destStride);
 }
 
@@ -722,12 +1045,12 @@ void simpleMatVectMul(bool transpose, Tensor& matrix, Tensor& vector, Tensor& de
   double* matrixData = matrix.data + matrix.initial_offset;
   double* vectorData = vector.data + vector.initial_offset;
 
-  uint32_t destStride = dest.strides[0];
+  uint64_t destStride = dest.strides[0];
 
-  uint32_t matrixStrides0 = transpose?matrix.strides[1]:matrix.strides[0];
-  uint32_t matrixStrides1 = transpose?matrix.strides[0]:matrix.strides[1];
+  uint64_t matrixStrides0 = transpose?matrix.strides[1]:matrix.strides[0];
+  uint64_t matrixStrides1 = transpose?matrix.strides[0]:matrix.strides[1];
 
-  uint32_t vectorStride = vector.strides[0];
+  uint64_t vectorStride = vector.strides[0];
 
   uint32_t innerDim = transpose?matrix.shape[0]:matrix.shape[1];
 
@@ -751,6 +1074,12 @@ void fastMatVectMul(bool transpose, Tensor& matrix, Tensor& vector, Tensor& dest
   //transpose source1 if necessary.
   CBLAS_ORDER order = CblasRowMajor;
   CBLAS_TRANSPOSE cblas_trans = transpose?CblasTrans:CblasNoTrans;
+
+  if(!fitsBLAS(matrix) || !fitsBLAS(vector) || !fitsBLAS(dest)) {
+    simpleMatVectMul(transpose, matrix, vector, dest);
+    return;
+  }
+
   int matrixStride = MAX(matrix.strides[0], matrix.strides[1]);
   int vectorStride = vector.strides[0];
   int destStride = dest.strides[0];
@@ -763,11 +1092,28 @@ void fastMatVectMul(bool transpose, Tensor& matrix, Tensor& vector, Tensor& dest
     simpleMatVectMul(transpose, matrix, vector, dest);
     return;
   }
+  if(isFloat32(dest)) {
+    cblas_sgemv(order, cblas_trans, matrix.shape[0], matrix.shape[1], 1.0, matrix.floatData+matrix.initial_offset, matrixStride, vector.floatData+vector.initial_offset, vectorStride, 0, dest.floatData+dest.initial_offset, destStride);
+    return;
+  }
   cblas_dgemv(order, cblas_trans, matrix.shape[0], matrix.shape[1], 1.0, matrix.data+matrix.initial_offset, matrixStride, vector.data+vector.initial_offset, vectorStride, 0, dest.data+dest.initial_offset, destStride);
   return;
 }
 
 void fastDotProduct(Tensor& vector1, Tensor& vector2, Tensor& dest) {
+  if(isFloat32(dest)) {
+    //dsdot accumulates in double precision.
+    dest.floatData[dest.initial_offset] = cblas_dsdot(vector1.shape[0],
+                                                      vector1.floatData + vector1.initial_offset,
+                                                      vector1.strides[0],
+                                                      vector2.floatData + vector2.initial_offset,
+                                                      vector2.strides[0]);
+    return;
+  }
+  if(!fitsBLAS(vector1) || !fitsBLAS(vector2)) {
+    dest.data[0] = scalarProduct(vector1, vector2);
+    return;
+  }
   dest.data[0] = cblas_ddot(vector1.shape[0], 
                             vector1.data + vector1.initial_offset,
                             vector1.strides[0],
@@ -780,46 +1126,19 @@ void matMul(Tensor& source1, Tensor& source2, Tensor& dest, TensorError* error)
   return contract(source1, source2, 1, dest, error);
 }
 
-void fillNormal(double mean, double std_dev, Tensor& dest) {
-  std::normal_distribution<double> distribution(mean, std_dev);
-  if(isDense(dest)) {
-    uint32_t totalSize = dest.totalSize();
-    double* iterator = dest.data + dest.initial_offset;
-    for(uint32_t i=0; i<totalSize; i++) {
-      iterator[i] = distribution(global_generator);
-    }
-  } else {
-    TensorIterator iterator(dest);
-    do {
-      iterator.get() = distribution(global_generator);
-    } while(iterator.next());
-  }
-}
-
-void fillUniform(double low, double high, Tensor& dest) {
-  std::uniform_real_distribution<double> distribution(low, high);
-  if(isDense(dest)) {
-    uint32_t totalSize = dest.totalSize();
-    double* iterator = dest.data + dest.initial_offset;
-    for(uint32_t i=0; i<totalSize; i++) {
-      iterator[i] = distribution(global_generator);
-    }
-  } else {
-    TensorIterator iterator(dest);
-    do {
-      iterator.get() = distribution(global_generator);
-    } while(iterator.next());
-  }
-}
 
 double sum(Tensor& source) {
   double answer = 0;
-  if(isDense(source)) {
-    uint32_t totalSize = source.totalSize();
-    double* iterator = source.data + source.initial_offset;
-    for(uint32_t i=0; i<totalSize; i++) {
-      answer += iterator[i];
-    }
+  if(isFloat32(source)) {
+    if(isDense(source))
+      return INDEX_DISPATCH(source.totalSize(), denseSumKernel, source.floatData + source.initial_offset, source.totalSize());
+    MultiIndexIterator iterator(source.shape, source.numDimensions);
+    do {
+      answer += source.get(iterator.get());
+    } while(iterator.next());
+  } else if(isDense(source)) {
+    uint64_t totalSize = source.totalSize();
+    return INDEX_DISPATCH(totalSize, denseSumKernel, source.data + source.initial_offset, totalSize);
   } else {
     TensorIterator iterator(source);
     do {
@@ -8,8 +8,12 @@ namespace tensor {
 
 #define ASSERT(expr, error) if(!(expr)) { return error; }
 #define ASSERT_SIZE_EQUAL_3(a, b, c)  ASSERT(a.totalSize() == b.totalSize() && a.totalSize() == c.totalSize(), SizeMismatchError)
+#ifndef MIN
 #define MIN(a,b) (a>b?b:a)
+#endif
+#ifndef MAX
 #define MAX(a,b) (a>b?a:b)
+#endif
 
 
 enum TensorError {
@@ -17,11 +21,23 @@ enum TensorError {
   SizeMismatchError,
   DimensionMismatchError,
   IndexOutOfBounds,
-  MemoryLeakError
+  MemoryLeakError,
+  InvalidProgramError,
+  NotPositiveDefiniteError
 };
 
 
-extern TensorError globalError;
+enum DataType {
+  Float64 = 0,
+  Float32
+};
+
+/**
+  * error slot used when a caller does not pass one. It is per thread, so
+  * that ops running concurrently on worker threads cannot clobber each
+  * other's errors.
+  */
+extern thread_local TensorError globalError;
 
 /**
   * shapeInReversedOrder is a flag that (when true) indicates that
@@ -29,27 +45,52 @@ extern TensorError globalError;
   * a MxNxK tensor has 
   * shape = [K, N, M]
   *
-  * We always mauint32_tain the guarantee that the order in shape
+  * We always maintain the guarantee that the order in shape
   * represents the layout of the data in the data array. That is,
   * if shape = [K, N, M], then 
   * data[k + nK + mKN] is either the mnk th element of the Tensor if 
   * shapeInReversedOrder=true or the
   * knm th element otherwise.
   * this is useful for copy-free transposing.
+  *
+  * Tensors are stored either in double precision (dtype = Float64, values
+  * in data) or in single precision (dtype = Float32, values in floatData).
+  * at() and the iterators only make sense for Float64 tensors; code that
+  * must handle both storage types goes through get() and set(), which
+  * always compute in double precision.
+  *
+  * Each dimension of shape fits in 32 bits, but sizes, strides and offsets
+  * are 64-bit so that a tensor may hold more than 2^32 elements.
   */
 struct Tensor {
-  double* data;
+  double* data = NULL;
+  float* floatData = NULL;
+  DataType dtype = Float64;
   uint32_t numDimensions;
   uint32_t* shape;
-  uint32_t* strides;
-  uint32_t initial_offset;
+  uint64_t* strides;
+  uint64_t initial_offset;
 
-  uint32_t totalSize(void);
+  uint64_t totalSize(void);
 
-  uint32_t maximumOffset(void);
+  uint64_t maximumOffset(void);
 
   double& at(uint32_t* coords, TensorError* error=&globalError);
 
+  uint64_t offsetOf(uint32_t* coords, TensorError* error=&globalError);
+
+  uint64_t broadcastOffsetOf(uint32_t* coords, uint32_t numCoords, TensorError* error=&globalError);
+
+  double get(uint32_t* coords, TensorError* error=&globalError);
+
+  double broadcast_get(uint32_t* coords, uint32_t numCoords, TensorError* error=&globalError);
+
+  void set(uint32_t* coords, double value, TensorError* error=&globalError);
+
+  void shareStorage(Tensor& other);
+
+  bool sameStorage(Tensor& other);
+
   // double& at(uint32_t* prefixCoords, uint32_t* suffixCoords, uint32_t suffixSize);
 
   double& broadcast_at(uint32_t* coords, uint32_t numCoords, TensorError* error=&globalError);
@@ -120,6 +161,8 @@ bool compatibleDimensions(Tensor& t1, Tensor& t2);
 
 bool isBroadcastDimension(Tensor& source1, Tensor& source2, Tensor& dest);
 
+bool identicalLayout(Tensor& tensor1, Tensor& tensor2);
+
 void transpose(Tensor& source, Tensor& dest, TensorError* error=&globalError);
 
 void addScale(Tensor& source1, Tensor& source2, double scale1, double scale2, Tensor& dest, TensorError* error=&globalError);
@@ -164,6 +207,21 @@ double sum(Tensor& source);
 
 bool isDense(Tensor& source);
 
+//dense with the last index fastest, as tensors are created.
+bool isRowMajor(Tensor& source);
+
+bool fitsBLAS(Tensor& source);
+
+bool isFloat32(Tensor& t1);
+
+bool anyFloat32(Tensor& t1, Tensor& t2);
+
+bool anyFloat32(Tensor& t1, Tensor& t2, Tensor& t3);
+
+/**
+  * seeds the calling thread's random stream from std::random_device.
+  * See random.h.
+  */
 void seed_generator(void);
 
 } //namespace tensor
\ No newline at end of file
@@ -1,66 +1,82 @@
 #include<node.h>
+#include<uv.h>
 #include "tensor.h"
 #include "mathops.h"
+#include "fused.h"
+#include "parallel.h"
+#include "random.h"
+#include "sparse.h"
+#include "decompose.h"
+#include "linalg.h"
+#include "losses.h"
+#include "optimizers.h"
+#include <functional>
 #include <iostream>
 #include <random>
+#include <memory>
 #include <string>
+#include <vector>
 
 #define GET_CONTENTS(view) \
 (static_cast<unsigned char*>(view->Buffer()->GetContents().Data()) + view->ByteOffset())
 
+//defines the binding name and its Promise-returning variant nameAsync
+//from nameBinding(args, async).
+#define SYNC_AND_ASYNC(name) \
+void name(const FunctionCallbackInfo<Value>& args) { name##Binding(args, false); } \
+void name##Async(const FunctionCallbackInfo<Value>& args) { name##Binding(args, true); }
+
 #define CREATE_OP(name) \
-void name(const FunctionCallbackInfo<Value>& args) { \
+void name##Binding(const FunctionCallbackInfo<Value>& args, bool async) { \
   Isolate* isolate = args.GetIsolate(); \
   if(args.Length() < 2) { \
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Requires 2 arguments: source, dest"))); \
     return; \
   } \
  \
-  Tensor source = cTensorFromJSTensor(isolate, args[0]); \
-  Tensor dest = cTensorFromJSTensor(isolate, args[1]); \
+  JSTensor source(isolate, args[0]); \
+  JSTensor dest(isolate, args[1]); \
  \
   if(!source.isValid() || !dest.isValid()) { \
     return; \
   } \
- \
-  TensorError error = tensor::NoError; \
-  tensor::name(source, dest, &error); \
-  if(error != tensor::NoError) { \
-    std::string errorString = std::string("Error in " #name ": ") + makeErrorString(error); \
-    isolate->ThrowException(Exception::TypeError( \
-        String::NewFromUtf8(isolate, errorString.c_str()) )); \
-    return; \
-  } \
-}
+  runTensorOp(args, "Error in " #name ": ", {&source, &dest}, \
+    [](Tensor** tensors, TensorError* error) { \
+      tensor::name(*tensors[0], *tensors[1], error); \
+      return 0.0; \
+    }, false, async); \
+} \
+SYNC_AND_ASYNC(name)
 //end CREATE_OP definition
 
-#define CREATE_BINARY_OP(name) void name(const FunctionCallbackInfo<Value>& args) { \
+#define CREATE_BINARY_OP(name) void name##Binding(const FunctionCallbackInfo<Value>& args, bool async) { \
   Isolate* isolate = args.GetIsolate(); \
   if(args.Length() < 3) { \
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Requires 3 arguments: source1, source2, dest"))); \
     return; \
   } \
  \
-  Tensor source1 = cTensorFromJSTensor(isolate, args[0]); \
-  Tensor source2 = cTensorFromJSTensor(isolate, args[1]); \
-  Tensor dest = cTensorFromJSTensor(isolate, args[2]); \
+  JSTensor source1(isolate, args[0]); \
+  JSTensor source2(isolate, args[1]); \
+  JSTensor dest(isolate, args[2]); \
  \
   if(!source1.isValid() || !source2.isValid() || !dest.isValid()) { \
     return; \
   } \
-  TensorError error = tensor::NoError; \
-  tensor::name(source1, source2, dest, &error); \
-  if(error != tensor::NoError) { \
-    std::string errorString = std::string("Error in " #name ": ") + makeErrorString(error); \
-    isolate->ThrowException(Exception::TypeError( \
-        String::NewFromUtf8(isolate, errorString.c_str()) )); \
-    return; \
-  } \
-}
+  runTensorOp(args, "Error in " #name ": ", {&source1, &source2, &dest}, \
+    [](Tensor** tensors, TensorError* error) { \
+      tensor::name(*tensors[0], *tensors[1], *tensors[2], error); \
+      return 0.0; \
+    }, false, async); \
+} \
+SYNC_AND_ASYNC(name)
 //end CREATE_BINARY_OP definition
 
-#define DECLARE_OP(name) NODE_SET_METHOD(exports, #name, name);
-#define DECLARE_BINARY_OP(name) NODE_SET_METHOD(exports, #name, name);
+#define DECLARE_SYNC_AND_ASYNC(name) \
+  NODE_SET_METHOD(exports, #name, name); \
+  NODE_SET_METHOD(exports, #name "Async", name##Async);
+#define DECLARE_OP(name) DECLARE_SYNC_AND_ASYNC(name)
+#define DECLARE_BINARY_OP(name) DECLARE_SYNC_AND_ASYNC(name)
 
 namespace nodetensor {
 
@@ -128,6 +144,12 @@ std::string makeErrorString(TensorError error) {
     case tensor::SizeMismatchError:
       return std::string("SizeMismatchError");
       break;
+    case tensor::InvalidProgramError:
+      return std::string("InvalidProgramError");
+      break;
+    case tensor::NotPositiveDefiniteError:
+      return std::string("NotPositiveDefiniteError");
+      break;
     case tensor::NoError:
       return std::string("No Error");
       break;
@@ -136,10 +158,71 @@ std::string makeErrorString(TensorError error) {
 }
 
 
+/**
+  * a Tensor backed by the typed arrays of a js tensor.
+  * shape and data point directly into the js arrays. js strides are
+  * Float64Arrays (so that they can exceed 2^32), which cannot be used in
+  * place, so they are converted into 64-bit integers owned by this object.
+  * JSTensors are only ever created on the stack of a binding call and
+  * cannot be copied.
+  **/
+struct JSTensor : public Tensor {
+  std::vector<uint64_t> strideStorage;
+  Local<Object> jsObject;
+  Local<Value> jsData;
+
+  JSTensor(Isolate* isolate, const Local<Value> jsTensor);
+  JSTensor(const JSTensor&) = delete;
+  JSTensor& operator=(const JSTensor&) = delete;
+
+  void writeBack(Isolate* isolate);
+};
+
+/**
+  * reads a js stride array into cTensor.strides.
+  * Uint32Array strides are still accepted for tensors built by hand.
+  **/
+bool readStrides(Local<Value> jsStrides, JSTensor& cTensor) {
+  cTensor.strideStorage.resize(cTensor.numDimensions);
+  cTensor.strides = cTensor.strideStorage.data();
+  if(jsStrides->IsFloat64Array()) {
+    double* jsData = reinterpret_cast<double*>(GET_CONTENTS(jsStrides.As<v8::Float64Array>()));
+    for(uint32_t i=0; i<cTensor.numDimensions; i++) {
+      if(jsData[i] < 0 || jsData[i] != (uint64_t)jsData[i])
+        return false;
+      cTensor.strides[i] = jsData[i];
+    }
+  } else {
+    uint32_t* jsData = reinterpret_cast<uint32_t*>(GET_CONTENTS(jsStrides.As<v8::Uint32Array>()));
+    for(uint32_t i=0; i<cTensor.numDimensions; i++) {
+      cTensor.strides[i] = jsData[i];
+    }
+  }
+  return true;
+}
+
+/**
+  * copies strides and initial_offset back into the js tensor after a
+  * native call that reshapes its dest in place (e.g. subTensor).
+  **/
+void JSTensor::writeBack(Isolate* isolate) {
+  Local<Context> context = isolate->GetCurrentContext();
+  Local<Value> jsStrides = jsObject->Get(context, String::NewFromUtf8(isolate, "strides")).ToLocalChecked();
+  for(uint32_t i=0; i<numDimensions; i++) {
+    if(jsStrides->IsFloat64Array())
+      reinterpret_cast<double*>(GET_CONTENTS(jsStrides.As<v8::Float64Array>()))[i] = strides[i];
+    else
+      reinterpret_cast<uint32_t*>(GET_CONTENTS(jsStrides.As<v8::Uint32Array>()))[i] = strides[i];
+  }
+  jsObject->Set(context, String::NewFromUtf8(isolate, "initial_offset"), Number::New(isolate, initial_offset)).FromMaybe(false);
+}
+
 /**
   * extracts a Tensor object as defined in tensor.h from a js object with
   * fields of the same name. All C++ arrays in the Tensor object correspond
-  * to either Float64Array or Uint32Array objects in the js object.
+  * to either Float64Array or Uint32Array objects in the js object, except
+  * that data may also be a Float32Array, in which case the Tensor stores
+  * its values in floatData and has dtype Float32.
   * Does some error checking to attempt to save you from buffer-overflows
   * down the line.
   * If the error checking fails, the returned Tensor object has data=NULL
@@ -148,25 +231,24 @@ std::string makeErrorString(TensorError error) {
   * It is the responsibility of the caller to check isValid() and return an
   * appropriate error to the javascript context.
   **/
-Tensor cTensorFromJSTensor(Isolate* isolate, const Local<Value> jsTensor) {
-  Tensor cTensor;
-
+void cTensorFromJSTensor(Isolate* isolate, const Local<Value> jsTensor, JSTensor& cTensor) {
   Local<Context> context = isolate->GetCurrentContext();
 
   Local<Object> obj = jsTensor->ToObject();
+  cTensor.jsObject = obj;
   Local<Value> tempValue;
   MaybeLocal<Value> tempMaybe;
   tempMaybe = obj->Get(context, String::NewFromUtf8(isolate,"numDimensions"));
   if(tempMaybe.IsEmpty()) {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; must define numDimensions")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
   tempValue = tempMaybe.ToLocalChecked();
   if(!tempValue->IsUint32()) {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; numDimensions must be integer")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
   cTensor.numDimensions = tempValue->Uint32Value();
 
@@ -174,32 +256,33 @@ Tensor cTensorFromJSTensor(Isolate* isolate, const Local<Value> jsTensor) {
   if(tempMaybe.IsEmpty()) {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; must define initial_offset")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
   tempValue = tempMaybe.ToLocalChecked();
-  if(!tempValue->IsUint32()) {
+  if(!tempValue->IsNumber() || tempValue->NumberValue() < 0 ||
+     tempValue->NumberValue() != (uint64_t)tempValue->NumberValue()) {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; initial_offset must be integer")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
-  cTensor.initial_offset = tempValue->Uint32Value();
+  cTensor.initial_offset = tempValue->NumberValue();
 
 
   tempMaybe = obj->Get(context, String::NewFromUtf8(isolate,"shape"));
   if(tempMaybe.IsEmpty()) {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; must define shape")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
   tempValue = tempMaybe.ToLocalChecked();
   if(!tempValue->IsUint32Array()) {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; shape must be Uint32Array")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
   if(tempValue.As<v8::Uint32Array>()->Length() != cTensor.numDimensions) {
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
   cTensor.shape = reinterpret_cast<uint32_t*>(GET_CONTENTS(tempValue.As<v8::Uint32Array>()));
 
@@ -208,45 +291,216 @@ Tensor cTensorFromJSTensor(Isolate* isolate, const Local<Value> jsTensor) {
   if(tempMaybe.IsEmpty()) {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; must define strides")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
   tempValue = tempMaybe.ToLocalChecked();
-  if(!tempValue->IsUint32Array()) {
-    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; strides must be Uint32Array")));
+  if(!tempValue->IsFloat64Array() && !tempValue->IsUint32Array()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; strides must be Float64Array or Uint32Array")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
-  if(tempValue.As<v8::Uint32Array>()->Length() != cTensor.numDimensions) {
+  if(tempValue.As<v8::TypedArray>()->Length() != cTensor.numDimensions) {
     cTensor.data = NULL;
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; strides has wrong length")));
-    return cTensor;
+    return;
+  }
+  if(!readStrides(tempValue, cTensor)) {
+    cTensor.data = NULL;
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; strides must be non-negative integers")));
+    return;
   }
-  cTensor.strides = reinterpret_cast<uint32_t*>(GET_CONTENTS(tempValue.As<v8::Uint32Array>()));
 
 
   tempMaybe = obj->Get(context, String::NewFromUtf8(isolate,"data"));
   if(tempMaybe.IsEmpty()) {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; must define data")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
   tempValue = tempMaybe.ToLocalChecked();
-  if(!tempValue->IsFloat64Array()) {
-    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; data must be Float64Array")));
+  if(!tempValue->IsFloat64Array() && !tempValue->IsFloat32Array()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; data must be Float64Array or Float32Array")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
   }
-  if(tempValue.As<v8::Float64Array>()->Length() < cTensor.maximumOffset()) {
+  if(cTensor.numDimensions > 0 && tempValue.As<v8::TypedArray>()->Length() <= cTensor.maximumOffset()) {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid Tensor data; data buffer too small")));
     cTensor.data = NULL;
-    return cTensor;
+    return;
+  }
+  cTensor.jsData = tempValue;
+  if(tempValue->IsFloat32Array()) {
+    cTensor.dtype = tensor::Float32;
+    cTensor.floatData = reinterpret_cast<float*>(GET_CONTENTS(tempValue.As<v8::Float32Array>()));
+  } else {
+    cTensor.dtype = tensor::Float64;
+    cTensor.data = reinterpret_cast<double*>(GET_CONTENTS(tempValue.As<v8::Float64Array>()));
+  }
+}
+
+JSTensor::JSTensor(Isolate* isolate, const Local<Value> jsTensor) {
+  cTensorFromJSTensor(isolate, jsTensor, *this);
+}
+
+/**
+  * a copy of a JSTensor that stays usable after the binding call that
+  * created it has returned, e.g. from a libuv worker thread.
+  * shape and strides are owned by this object and the js tensor and its
+  * data array are held by persistent handles, so that neither can be
+  * collected while the work is in flight.
+  * Must be created and destroyed on the main thread.
+  **/
+struct PinnedTensor : public Tensor {
+  std::vector<uint32_t> shapeStorage;
+  std::vector<uint64_t> strideStorage;
+  v8::Persistent<Object> pinnedObject;
+  v8::Persistent<Value> pinnedData;
+
+  PinnedTensor(Isolate* isolate, JSTensor& source)
+    : shapeStorage(source.shape, source.shape + source.numDimensions),
+      strideStorage(source.strideStorage),
+      pinnedObject(isolate, source.jsObject),
+      pinnedData(isolate, source.jsData) {
+    data = source.data;
+    floatData = source.floatData;
+    dtype = source.dtype;
+    numDimensions = source.numDimensions;
+    shape = shapeStorage.data();
+    strides = strideStorage.data();
+    initial_offset = source.initial_offset;
+  }
+
+  ~PinnedTensor() {
+    pinnedObject.Reset();
+    pinnedData.Reset();
+  }
+};
+
+/**
+  * the body of a binding: runs on the tensors it was given and returns
+  * a number for ops that produce one (ignored otherwise).
+  **/
+typedef std::function<double(Tensor** tensors, TensorError* error)> TensorOp;
+
+/**
+  * an op queued on the libuv thread pool. Each work item has its own
+  * error slot; the promise is settled on the main thread once it is done.
+  **/
+struct AsyncWork {
+  uv_work_t request;
+  Isolate* isolate;
+  std::string errorPrefix;
+  bool returnsNumber;
+  TensorOp op;
+  std::vector<std::unique_ptr<PinnedTensor>> tensors;
+  std::vector<Tensor*> tensorPointers;
+  TensorError error = tensor::NoError;
+  std::string exceptionMessage;
+  double result = 0;
+
+  v8::Persistent<v8::Promise::Resolver> resolver;
+  v8::Persistent<Context> context;
+  v8::Persistent<Object> resource;
+  node::async_context asyncContext;
+};
+
+void executeAsyncWork(uv_work_t* request) {
+  AsyncWork* work = static_cast<AsyncWork*>(request->data);
+  try {
+    work->result = work->op(work->tensorPointers.data(), &work->error);
+  } catch(const std::exception& e) {
+    work->exceptionMessage = e.what();
+  }
+}
+
+void completeAsyncWork(uv_work_t* request, int status) {
+  AsyncWork* work = static_cast<AsyncWork*>(request->data);
+  Isolate* isolate = work->isolate;
+  v8::HandleScope handleScope(isolate);
+  Local<Context> context = Local<Context>::New(isolate, work->context);
+  Context::Scope contextScope(context);
+  Local<Object> resource = Local<Object>::New(isolate, work->resource);
+  Local<v8::Promise::Resolver> resolver = Local<v8::Promise::Resolver>::New(isolate, work->resolver);
+
+  {
+    //runs the promise reactions once the promise is settled.
+    node::CallbackScope callbackScope(isolate, resource, work->asyncContext);
+    std::string errorString;
+    if(status == UV_ECANCELED)
+      errorString = work->errorPrefix + "cancelled";
+    else if(!work->exceptionMessage.empty())
+      errorString = work->errorPrefix + work->exceptionMessage;
+    else if(work->error != tensor::NoError)
+      errorString = work->errorPrefix + makeErrorString(work->error);
+
+    if(!errorString.empty()) {
+      resolver->Reject(context, Exception::TypeError(
+          String::NewFromUtf8(isolate, errorString.c_str()))).FromMaybe(false);
+    } else if(work->returnsNumber) {
+      resolver->Resolve(context, Number::New(isolate, work->result)).FromMaybe(false);
+    } else {
+      resolver->Resolve(context, v8::Undefined(isolate)).FromMaybe(false);
+    }
+  }
+
+  node::EmitAsyncDestroy(isolate, work->asyncContext);
+  work->resolver.Reset();
+  work->context.Reset();
+  work->resource.Reset();
+  delete work;
+}
+
+/**
+  * runs op on tensors, either right away or, if async, on the libuv thread
+  * pool, in which case the binding returns a Promise that resolves (to the
+  * op's number for returnsNumber ops) or rejects with the op's error.
+  * The caller must have checked that every tensor isValid().
+  **/
+void runTensorOp(const FunctionCallbackInfo<Value>& args, const char* errorPrefix,
+                 const std::vector<JSTensor*>& tensors, TensorOp op,
+                 bool returnsNumber, bool async) {
+  Isolate* isolate = args.GetIsolate();
+
+  if(!async) {
+    std::vector<Tensor*> tensorPointers(tensors.begin(), tensors.end());
+    TensorError error = tensor::NoError;
+    double result = op(tensorPointers.data(), &error);
+    if(error != tensor::NoError) {
+      std::string errorString = std::string(errorPrefix) + makeErrorString(error);
+      isolate->ThrowException(Exception::TypeError(
+          String::NewFromUtf8(isolate, errorString.c_str()) ));
+      return;
+    }
+    if(returnsNumber)
+      args.GetReturnValue().Set(Number::New(isolate, result));
+    return;
+  }
+
+  Local<Context> context = isolate->GetCurrentContext();
+  Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(context).ToLocalChecked();
+  Local<Object> resource = Object::New(isolate);
+
+  AsyncWork* work = new AsyncWork();
+  work->request.data = work;
+  work->isolate = isolate;
+  work->errorPrefix = errorPrefix;
+  work->returnsNumber = returnsNumber;
+  work->op = op;
+  for(JSTensor* tensor : tensors) {
+    work->tensors.emplace_back(new PinnedTensor(isolate, *tensor));
+    work->tensorPointers.push_back(work->tensors.back().get());
   }
-  cTensor.data = reinterpret_cast<double*>(GET_CONTENTS(tempValue.As<v8::Float64Array>()));
+  work->resolver.Reset(isolate, resolver);
+  work->context.Reset(isolate, context);
+  work->resource.Reset(isolate, resource);
+  work->asyncContext = node::EmitAsyncInit(isolate, resource, "astute:tensorOp");
 
-  return cTensor;
+  uv_queue_work(node::GetCurrentEventLoop(isolate), &work->request, executeAsyncWork, completeAsyncWork);
+
+  args.GetReturnValue().Set(resolver->GetPromise());
 }
 
-void contract(const FunctionCallbackInfo<Value>& args) {
+void contractBinding(const FunctionCallbackInfo<Value>& args, bool async) {
   Isolate* isolate = args.GetIsolate();
   // Check the number of arguments passed.
   if (args.Length() < 4) {
@@ -256,9 +510,9 @@ void contract(const FunctionCallbackInfo<Value>& args) {
     return;
   }
 
-  Tensor source1 = cTensorFromJSTensor(isolate, args[0]);
-  Tensor source2 = cTensorFromJSTensor(isolate, args[1]);
-  Tensor dest = cTensorFromJSTensor(isolate, args[3]);
+  JSTensor source1(isolate, args[0]);
+  JSTensor source2(isolate, args[1]);
+  JSTensor dest(isolate, args[3]);
 
   if(!args[2]->IsUint32()) {
     isolate->ThrowException(Exception::TypeError(
@@ -272,18 +526,13 @@ void contract(const FunctionCallbackInfo<Value>& args) {
     return;   
   }
 
-  TensorError error = tensor::NoError;
-
-  tensor::contract(source1, source2, dimsToContract, dest, &error);
-
-  if(error != tensor::NoError) {
-    std::string errorString = std::string("Error in tensor contraction: ") + makeErrorString(error);
-    isolate->ThrowException(Exception::TypeError(
-        String::NewFromUtf8(isolate, errorString.c_str()) ));
-    return;
-  }
-
+  runTensorOp(args, "Error in tensor contraction: ", {&source1, &source2, &dest},
+    [dimsToContract](Tensor** tensors, TensorError* error) {
+      tensor::contract(*tensors[0], *tensors[1], dimsToContract, *tensors[2], error);
+      return 0.0;
+    }, false, async);
 }
+SYNC_AND_ASYNC(contract)
 
 void scalarProduct(const FunctionCallbackInfo<Value>& args) {
   Isolate* isolate = args.GetIsolate();
@@ -294,8 +543,8 @@ void scalarProduct(const FunctionCallbackInfo<Value>& args) {
         String::NewFromUtf8(isolate, "Requires 2 arguments: source1, source2")));
     return;
   }
-  Tensor source1 = cTensorFromJSTensor(isolate, args[0]);
-  Tensor source2 = cTensorFromJSTensor(isolate, args[1]);
+  JSTensor source1(isolate, args[0]);
+  JSTensor source2(isolate, args[1]);
   if(!source1.isValid() || !source2.isValid()) {
     return;
   }
@@ -320,8 +569,8 @@ void subTensor(const FunctionCallbackInfo<Value>& args) {
         String::NewFromUtf8(isolate, "Requires 3 arguments: source1, heldCoords, heldValues, numHeld, dest")));
     return;
   }
-  Tensor source = cTensorFromJSTensor(isolate, args[0]);
-  Tensor dest = cTensorFromJSTensor(isolate, args[4]);
+  JSTensor source(isolate, args[0]);
+  JSTensor dest(isolate, args[4]);
   if(!source.isValid() || !dest.isValid()) {
     return;
   }
@@ -376,10 +625,11 @@ void subTensor(const FunctionCallbackInfo<Value>& args) {
         String::NewFromUtf8(isolate, errorString.c_str()) ));
     return;
   }
+  dest.writeBack(isolate);
 }
 
 
-void addScale(const FunctionCallbackInfo<Value>& args) {
+void addScaleBinding(const FunctionCallbackInfo<Value>& args, bool async) {
   Isolate* isolate = args.GetIsolate();
   // Check the number of arguments passed.
   if (args.Length() < 5) {
@@ -389,9 +639,9 @@ void addScale(const FunctionCallbackInfo<Value>& args) {
     return;
   }
 
-  Tensor source1 = cTensorFromJSTensor(isolate, args[0]);
-  Tensor source2 = cTensorFromJSTensor(isolate, args[1]);
-  Tensor dest = cTensorFromJSTensor(isolate, args[4]);
+  JSTensor source1(isolate, args[0]);
+  JSTensor source2(isolate, args[1]);
+  JSTensor dest(isolate, args[4]);
 
   if(!args[2]->IsNumber()) {
     isolate->ThrowException(Exception::TypeError(
@@ -411,18 +661,15 @@ void addScale(const FunctionCallbackInfo<Value>& args) {
     return;   
   }
 
-  TensorError error = tensor::NoError;
-  tensor::addScale(source1, source2, scale1, scale2, dest, &error);
-
-  if(error != tensor::NoError) {
-    std::string errorString = std::string("Error in addScale: ") + makeErrorString(error);
-    isolate->ThrowException(Exception::TypeError(
-        String::NewFromUtf8(isolate, errorString.c_str()) ));
-    return;
-  }
+  runTensorOp(args, "Error in addScale: ", {&source1, &source2, &dest},
+    [scale1, scale2](Tensor** tensors, TensorError* error) {
+      tensor::addScale(*tensors[0], *tensors[1], scale1, scale2, *tensors[2], error);
+      return 0.0;
+    }, false, async);
 }
+SYNC_AND_ASYNC(addScale)
 
-void multiplyScale(const FunctionCallbackInfo<Value>& args) {
+void multiplyScaleBinding(const FunctionCallbackInfo<Value>& args, bool async) {
   Isolate* isolate = args.GetIsolate();
   // Check the number of arguments passed.
   if (args.Length() < 4) {
@@ -432,9 +679,9 @@ void multiplyScale(const FunctionCallbackInfo<Value>& args) {
     return;
   }
 
-  Tensor source1 = cTensorFromJSTensor(isolate, args[0]);
-  Tensor source2 = cTensorFromJSTensor(isolate, args[1]);
-  Tensor dest = cTensorFromJSTensor(isolate, args[3]);
+  JSTensor source1(isolate, args[0]);
+  JSTensor source2(isolate, args[1]);
+  JSTensor dest(isolate, args[3]);
 
   if(!args[2]->IsNumber()) {
     isolate->ThrowException(Exception::TypeError(
@@ -447,18 +694,15 @@ void multiplyScale(const FunctionCallbackInfo<Value>& args) {
     return;   
   }
 
-  TensorError error = tensor::NoError;
-  tensor::multiplyScale(source1, source2, scale, dest, &error);
-
-  if(error != tensor::NoError) {
-    std::string errorString = std::string("Error in multiplyScale: ") + makeErrorString(error);
-    isolate->ThrowException(Exception::TypeError(
-        String::NewFromUtf8(isolate, errorString.c_str()) ));
-    return;
-  }
+  runTensorOp(args, "Error in multiplyScale: ", {&source1, &source2, &dest},
+    [scale](Tensor** tensors, TensorError* error) {
+      tensor::multiplyScale(*tensors[0], *tensors[1], scale, *tensors[2], error);
+      return 0.0;
+    }, false, async);
 }
+SYNC_AND_ASYNC(multiplyScale)
 
-void divideScale(const FunctionCallbackInfo<Value>& args) {
+void divideScaleBinding(const FunctionCallbackInfo<Value>& args, bool async) {
   Isolate* isolate = args.GetIsolate();
   // Check the number of arguments passed.
   if (args.Length() < 4) {
@@ -468,9 +712,9 @@ void divideScale(const FunctionCallbackInfo<Value>& args) {
     return;
   }
 
-  Tensor source1 = cTensorFromJSTensor(isolate, args[0]);
-  Tensor source2 = cTensorFromJSTensor(isolate, args[1]);
-  Tensor dest = cTensorFromJSTensor(isolate, args[3]);
+  JSTensor source1(isolate, args[0]);
+  JSTensor source2(isolate, args[1]);
+  JSTensor dest(isolate, args[3]);
 
   if(!args[2]->IsNumber()) {
     isolate->ThrowException(Exception::TypeError(
@@ -483,19 +727,16 @@ void divideScale(const FunctionCallbackInfo<Value>& args) {
     return;   
   }
 
-  TensorError error = tensor::NoError;
-  tensor::divideScale(source1, source2, scale, dest, &error);
-
-  if(error != tensor::NoError) {
-    std::string errorString = std::string("Error in divideScale: ") + makeErrorString(error);
-    isolate->ThrowException(Exception::TypeError(
-        String::NewFromUtf8(isolate, errorString.c_str()) ));
-    return;
-  }
+  runTensorOp(args, "Error in divideScale: ", {&source1, &source2, &dest},
+    [scale](Tensor** tensors, TensorError* error) {
+      tensor::divideScale(*tensors[0], *tensors[1], scale, *tensors[2], error);
+      return 0.0;
+    }, false, async);
 }
+SYNC_AND_ASYNC(divideScale)
 
 
-void scale(const FunctionCallbackInfo<Value>& args) {
+void scaleBinding(const FunctionCallbackInfo<Value>& args, bool async) {
   Isolate* isolate = args.GetIsolate();
   // Check the number of arguments passed.
   if (args.Length() < 3) {
@@ -505,8 +746,8 @@ void scale(const FunctionCallbackInfo<Value>& args) {
     return;
   }
 
-  Tensor source = cTensorFromJSTensor(isolate, args[0]);
-  Tensor dest = cTensorFromJSTensor(isolate, args[2]);
+  JSTensor source(isolate, args[0]);
+  JSTensor dest(isolate, args[2]);
 
   if(!args[1]->IsNumber()) {
     isolate->ThrowException(Exception::TypeError(
@@ -519,18 +760,15 @@ void scale(const FunctionCallbackInfo<Value>& args) {
     return;   
   }
 
-  TensorError error = tensor::NoError;
-  tensor::scale(source, scale, dest, &error);
-
-  if(error != tensor::NoError) {
-    std::string errorString = std::string("Error in scale: ") + makeErrorString(error);
-    isolate->ThrowException(Exception::TypeError(
-        String::NewFromUtf8(isolate, errorString.c_str()) ));
-    return;
-  }
+  runTensorOp(args, "Error in scale: ", {&source, &dest},
+    [scale](Tensor** tensors, TensorError* error) {
+      tensor::scale(*tensors[0], scale, *tensors[1], error);
+      return 0.0;
+    }, false, async);
 }
+SYNC_AND_ASYNC(scale)
 
-void fillNormal(const FunctionCallbackInfo<Value>& args) {
+void fillNormalBinding(const FunctionCallbackInfo<Value>& args, bool async) {
   Isolate* isolate = args.GetIsolate();
   // Check the number of arguments passed.
   if (args.Length() < 3) {
@@ -540,7 +778,7 @@ void fillNormal(const FunctionCallbackInfo<Value>& args) {
     return;
   }
 
-  Tensor dest = cTensorFromJSTensor(isolate, args[2]);
+  JSTensor dest(isolate, args[2]);
   if(!dest.isValid())
     return;
 
@@ -558,12 +796,18 @@ void fillNormal(const FunctionCallbackInfo<Value>& args) {
   }
   double stdDev = args[1]->NumberValue();
 
-  tensor::fillNormal(mean, stdDev, dest);
-
-  return;
+  //the counters are reserved here, so async fills draw the same values
+  //a synchronous fill at this point would have.
+  tensor::RandomStream stream = tensor::reserveRandom(dest.totalSize());
+  runTensorOp(args, "Error in fillNormal: ", {&dest},
+    [mean, stdDev, stream](Tensor** tensors, TensorError* error) {
+      tensor::fillNormal(mean, stdDev, *tensors[0], stream);
+      return 0.0;
+    }, false, async);
 }
+SYNC_AND_ASYNC(fillNormal)
 
-void fillUniform(const FunctionCallbackInfo<Value>& args) {
+void fillUniformBinding(const FunctionCallbackInfo<Value>& args, bool async) {
   Isolate* isolate = args.GetIsolate();
   // Check the number of arguments passed.
   if (args.Length() < 3) {
@@ -573,7 +817,7 @@ void fillUniform(const FunctionCallbackInfo<Value>& args) {
     return;
   }
 
-  Tensor dest = cTensorFromJSTensor(isolate, args[2]);
+  JSTensor dest(isolate, args[2]);
   if(!dest.isValid())
     return;
 
@@ -591,12 +835,43 @@ void fillUniform(const FunctionCallbackInfo<Value>& args) {
   }
   double high = args[1]->NumberValue();
 
-  tensor::fillUniform(low, high, dest);
+  //the counters are reserved here, so async fills draw the same values
+  //a synchronous fill at this point would have.
+  tensor::RandomStream stream = tensor::reserveRandom(dest.totalSize());
+  runTensorOp(args, "Error in fillUniform: ", {&dest},
+    [low, high, stream](Tensor** tensors, TensorError* error) {
+      tensor::fillUniform(low, high, *tensors[0], stream);
+      return 0.0;
+    }, false, async);
+}
+SYNC_AND_ASYNC(fillUniform)
+
+void seedRandom(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if(args.Length() < 1 || !args[0]->IsNumber() || args[0]->NumberValue() < 0) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "seed must be a non-negative number")));
+    return;
+  }
+  tensor::seedRandom((uint64_t)args[0]->NumberValue());
+}
+
+void setNumThreads(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if(args.Length() < 1 || !args[0]->IsNumber() || args[0]->NumberValue() < 1) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "numThreads must be a positive number")));
+    return;
+  }
+  tensor::setNumThreads(args[0]->Uint32Value());
+}
 
-  return;
+void getNumThreads(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  args.GetReturnValue().Set(Number::New(isolate, tensor::getNumThreads()));
 }
 
-void sum(const FunctionCallbackInfo<Value>& args) {
+void sumBinding(const FunctionCallbackInfo<Value>& args, bool async) {
   Isolate* isolate = args.GetIsolate();
   // Check the number of arguments passed.
   if (args.Length() < 1) {
@@ -606,66 +881,1187 @@ void sum(const FunctionCallbackInfo<Value>& args) {
     return;
   }
 
-  Tensor source = cTensorFromJSTensor(isolate, args[0]);
+  JSTensor source(isolate, args[0]);
   if(!source.isValid())
     return;
-  double answer = tensor::sum(source);
-  args.GetReturnValue().Set(Number::New(isolate, answer));
+  runTensorOp(args, "Error in sum: ", {&source},
+    [](Tensor** tensors, TensorError* error) {
+      return tensor::sum(*tensors[0]);
+    }, true, async);
+}
+SYNC_AND_ASYNC(sum)
+
+/**
+  * evaluates a fused elementwise program (see fused.h) in one pass.
+  * args: code (Uint32Array of opcode, operand pairs),
+  * constants (Float64Array), inputs (array of tensors), dest.
+  **/
+void fusedElementwiseBinding(const FunctionCallbackInfo<Value>& args, bool async) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: code, constants, inputs, dest")));
+    return;
+  }
+
+  if(!args[0]->IsUint32Array() || args[0].As<v8::Uint32Array>()->Length() % 2 != 0) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "code must be a Uint32Array of opcode, operand pairs")));
+    return;
+  }
+  //the program is copied so that the js arrays may change while an async
+  //evaluation is running.
+  uint32_t* jsCode = reinterpret_cast<uint32_t*>(GET_CONTENTS(args[0].As<v8::Uint32Array>()));
+  uint32_t numInstructions = args[0].As<v8::Uint32Array>()->Length() / 2;
+  std::vector<uint32_t> code(jsCode, jsCode + 2 * numInstructions);
+
+  if(!args[1]->IsFloat64Array()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "constants must be a Float64Array")));
+    return;
+  }
+  double* jsConstants = reinterpret_cast<double*>(GET_CONTENTS(args[1].As<v8::Float64Array>()));
+  uint32_t numConstants = args[1].As<v8::Float64Array>()->Length();
+  std::vector<double> constants(jsConstants, jsConstants + numConstants);
+
+  if(!args[2]->IsArray()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "inputs must be an array of tensors")));
+    return;
+  }
+  Local<Context> context = isolate->GetCurrentContext();
+  Local<v8::Array> jsInputs = args[2].As<v8::Array>();
+  uint32_t numInputs = jsInputs->Length();
+  std::vector<std::unique_ptr<JSTensor>> inputs;
+  std::vector<JSTensor*> tensors;
+  for(uint32_t k=0; k<numInputs; k++) {
+    inputs.emplace_back(new JSTensor(isolate, jsInputs->Get(context, k).ToLocalChecked()));
+    if(!inputs[k]->isValid())
+      return;
+    tensors.push_back(inputs[k].get());
+  }
 
-  return;
+  JSTensor dest(isolate, args[3]);
+  if(!dest.isValid())
+    return;
+  tensors.push_back(&dest);
+
+  runTensorOp(args, "Error in fusedElementwise: ", tensors,
+    [code, constants, numInputs](Tensor** tensors, TensorError* error) mutable {
+      tensor::fusedElementwise(code.data(), code.size() / 2, constants.data(), constants.size(),
+                               tensors, numInputs, *tensors[numInputs], error);
+      return 0.0;
+    }, false, async);
 }
+SYNC_AND_ASYNC(fusedElementwise)
 
-CREATE_OP(exp)
-CREATE_OP(abs)
-CREATE_OP(sqrt)
-CREATE_OP(sin)
-CREATE_OP(cos)
-CREATE_OP(tan)
-CREATE_OP(sinh)
-CREATE_OP(cosh)
-CREATE_OP(tanh)
-CREATE_OP(log)
-CREATE_OP(atan)
-CREATE_OP(acos)
-CREATE_OP(asin)
-CREATE_OP(atanh)
-CREATE_OP(acosh)
-CREATE_OP(asinh)
-CREATE_OP(erf)
-CREATE_OP(floor)
-CREATE_OP(ceil)
-CREATE_OP(round)
-CREATE_OP(sign)
+/**
+  * a tensor::SparseVector read from a js SparseVector (see
+  * src/tensor/sparseTensor.js): indices is a Uint32Array, values a
+  * Float64Array, both at least nnz long. The indices are checked to be
+  * strictly increasing, which the kernels rely on to bounds check a sparse
+  * operand by its last index. If a check fails a TypeError is thrown and
+  * isValid() returns false.
+  **/
+struct JSSparseVector : public tensor::SparseVector {
+  bool valid;
 
-CREATE_BINARY_OP(max)
-CREATE_BINARY_OP(min)
-CREATE_BINARY_OP(pow)
-CREATE_BINARY_OP(fmod)
+  JSSparseVector(Isolate* isolate, const Local<Value> jsSparse);
 
+  bool isValid(void) {
+    return valid;
+  }
+};
 
-void Method(const FunctionCallbackInfo<Value>& args) {
+JSSparseVector::JSSparseVector(Isolate* isolate, const Local<Value> jsSparse) {
+  Local<Context> context = isolate->GetCurrentContext();
+  valid = false;
+  indices = NULL;
+  values = NULL;
+  nnz = 0;
+  capacity = 0;
+  length = 0;
+  if(!jsSparse->IsObject()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseVector; must be an object")));
+    return;
+  }
+  Local<Object> obj = jsSparse->ToObject();
+
+  Local<Value> jsNnz = obj->Get(context, String::NewFromUtf8(isolate, "nnz")).ToLocalChecked();
+  if(!jsNnz->IsUint32()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseVector; nnz must be integer")));
+    return;
+  }
+  nnz = jsNnz->Uint32Value();
+
+  Local<Value> jsIndices = obj->Get(context, String::NewFromUtf8(isolate, "indices")).ToLocalChecked();
+  if(!jsIndices->IsUint32Array() || jsIndices.As<v8::Uint32Array>()->Length() < nnz) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseVector; indices must be a Uint32Array of at least nnz entries")));
+    return;
+  }
+  indices = reinterpret_cast<uint32_t*>(GET_CONTENTS(jsIndices.As<v8::Uint32Array>()));
+
+  Local<Value> jsValues = obj->Get(context, String::NewFromUtf8(isolate, "values")).ToLocalChecked();
+  if(!jsValues->IsFloat64Array() || jsValues.As<v8::Float64Array>()->Length() < nnz) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseVector; values must be a Float64Array of at least nnz entries")));
+    return;
+  }
+  values = reinterpret_cast<double*>(GET_CONTENTS(jsValues.As<v8::Float64Array>()));
+  capacity = MIN(jsIndices.As<v8::Uint32Array>()->Length(), jsValues.As<v8::Float64Array>()->Length());
+
+  for(uint32_t k=1; k<nnz; k++) {
+    if(indices[k] <= indices[k-1]) {
+      isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseVector; indices must be strictly increasing")));
+      return;
+    }
+  }
+
+  //length is optional on the js side.
+  Local<Value> jsLength = obj->Get(context, String::NewFromUtf8(isolate, "length")).ToLocalChecked();
+  length = jsLength->IsNumber() ? jsLength->NumberValue() : extent();
+  valid = true;
+}
+
+bool throwTensorError(Isolate* isolate, const char* errorPrefix, TensorError error) {
+  if(error == tensor::NoError)
+    return false;
+  std::string errorString = std::string(errorPrefix) + makeErrorString(error);
+  isolate->ThrowException(Exception::TypeError(
+      String::NewFromUtf8(isolate, errorString.c_str())));
+  return true;
+}
+
+void sparseDot(const FunctionCallbackInfo<Value>& args) {
   Isolate* isolate = args.GetIsolate();
-  Tensor T = cTensorFromJSTensor(isolate, args[0]);
-  if(T.isValid()) {
-    T.data[3] = 99;
-    args.GetReturnValue().Set(Number::New(isolate, T.strides[1]));
+  if (args.Length() < 2) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 2 arguments: sparse, dense")));
+    return;
+  }
+  JSSparseVector sparse(isolate, args[0]);
+  if(!sparse.isValid())
+    return;
+  JSTensor dense(isolate, args[1]);
+  if(!dense.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  double product = tensor::sparseDot(sparse, dense, &error);
+  if(throwTensorError(isolate, "Error in sparseDot: ", error))
+    return;
+  args.GetReturnValue().Set(Number::New(isolate, product));
+}
+
+void sparseAxpy(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 3) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 3 arguments: sparse, scale, dest")));
+    return;
+  }
+  JSSparseVector sparse(isolate, args[0]);
+  if(!sparse.isValid())
+    return;
+  if(!args[1]->IsNumber()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "scale must be a number")));
+    return;
   }
+  double scale = args[1]->NumberValue();
+  JSTensor dest(isolate, args[2]);
+  if(!dest.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::sparseAxpy(sparse, scale, dest, &error);
+  throwTensorError(isolate, "Error in sparseAxpy: ", error);
 }
 
-void init(Local<Object> exports) {
+void sparseScale(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 3) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 3 arguments: source, scale, dest")));
+    return;
+  }
+  JSSparseVector source(isolate, args[0]);
+  if(!source.isValid())
+    return;
+  if(!args[1]->IsNumber()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "scale must be a number")));
+    return;
+  }
+  double scale = args[1]->NumberValue();
+  JSSparseVector dest(isolate, args[2]);
+  if(!dest.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::sparseScale(source, scale, dest, &error);
+  throwTensorError(isolate, "Error in sparseScale: ", error);
+}
+
+void sparseSum(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 1) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 1 argument: sparse")));
+    return;
+  }
+  JSSparseVector sparse(isolate, args[0]);
+  if(!sparse.isValid())
+    return;
+  args.GetReturnValue().Set(Number::New(isolate, tensor::sparseSum(sparse)));
+}
+
+void sparseGatherScale(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 5) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 5 arguments: sparse, dense, scale, divide, dest")));
+    return;
+  }
+  JSSparseVector sparse(isolate, args[0]);
+  if(!sparse.isValid())
+    return;
+  JSTensor dense(isolate, args[1]);
+  if(!dense.isValid())
+    return;
+  if(!args[2]->IsNumber()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "scale must be a number")));
+    return;
+  }
+  double scale = args[2]->NumberValue();
+  bool divide = args[3]->IsTrue();
+  JSSparseVector dest(isolate, args[4]);
+  if(!dest.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::sparseGatherScale(sparse, dense, scale, divide, dest, &error);
+  throwTensorError(isolate, "Error in sparseGatherScale: ", error);
+}
+
+void sparseSparseAddScale(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 5) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 5 arguments: sparse1, sparse2, scale1, scale2, dest")));
+    return;
+  }
+  JSSparseVector sparse1(isolate, args[0]);
+  if(!sparse1.isValid())
+    return;
+  JSSparseVector sparse2(isolate, args[1]);
+  if(!sparse2.isValid())
+    return;
+  if(!args[2]->IsNumber() || !args[3]->IsNumber()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "scales must be numbers")));
+    return;
+  }
+  double scale1 = args[2]->NumberValue();
+  double scale2 = args[3]->NumberValue();
+  JSSparseVector dest(isolate, args[4]);
+  if(!dest.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::sparseSparseAddScale(sparse1, sparse2, scale1, scale2, dest, &error);
+  if(throwTensorError(isolate, "Error in sparseSparseAddScale: ", error))
+    return;
+  args.GetReturnValue().Set(Number::New(isolate, dest.nnz));
+}
+
+void sparseSparseMultiplyScale(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: sparse1, sparse2, scale, dest")));
+    return;
+  }
+  JSSparseVector sparse1(isolate, args[0]);
+  if(!sparse1.isValid())
+    return;
+  JSSparseVector sparse2(isolate, args[1]);
+  if(!sparse2.isValid())
+    return;
+  if(!args[2]->IsNumber()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "scale must be a number")));
+    return;
+  }
+  double scale = args[2]->NumberValue();
+  JSSparseVector dest(isolate, args[3]);
+  if(!dest.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::sparseSparseMultiplyScale(sparse1, sparse2, scale, dest, &error);
+  if(throwTensorError(isolate, "Error in sparseSparseMultiplyScale: ", error))
+    return;
+  args.GetReturnValue().Set(Number::New(isolate, dest.nnz));
+}
+
+void sparseSparseDot(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 2) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 2 arguments: sparse1, sparse2")));
+    return;
+  }
+  JSSparseVector sparse1(isolate, args[0]);
+  if(!sparse1.isValid())
+    return;
+  JSSparseVector sparse2(isolate, args[1]);
+  if(!sparse2.isValid())
+    return;
+  args.GetReturnValue().Set(Number::New(isolate, tensor::sparseSparseDot(sparse1, sparse2)));
+}
+
+void sparseMatMul(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 3) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 3 arguments: sparse, matrix, dest")));
+    return;
+  }
+  JSSparseVector sparse(isolate, args[0]);
+  if(!sparse.isValid())
+    return;
+  JSTensor matrix(isolate, args[1]);
+  if(!matrix.isValid())
+    return;
+  JSTensor dest(isolate, args[2]);
+  if(!dest.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::sparseMatMul(sparse, matrix, dest, &error);
+  throwTensorError(isolate, "Error in sparseMatMul: ", error);
+}
+
+/**
+  * a tensor::SparseMatrix over the typed arrays of a js SparseMatrix.
+  * Checks that the offsets are nondecreasing and cover the arrays, and
+  * that every index is inside the matrix, so the kernels can index dense
+  * operands without further bounds checks. If a check fails a TypeError
+  * is thrown and isValid() returns false.
+  **/
+struct JSSparseMatrix : public tensor::SparseMatrix {
+  bool valid;
+
+  JSSparseMatrix(Isolate* isolate, const Local<Value> jsMatrix);
+
+  bool isValid(void) {
+    return valid;
+  }
+};
+
+JSSparseMatrix::JSSparseMatrix(Isolate* isolate, const Local<Value> jsMatrix) {
+  Local<Context> context = isolate->GetCurrentContext();
+  valid = false;
+  numRows = 0;
+  numColumns = 0;
+  compressedRows = true;
+  offsets = NULL;
+  indices = NULL;
+  values = NULL;
+  if(!jsMatrix->IsObject()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseMatrix; must be an object")));
+    return;
+  }
+  Local<Object> obj = jsMatrix->ToObject();
+
+  Local<Value> jsNumRows = obj->Get(context, String::NewFromUtf8(isolate, "numRows")).ToLocalChecked();
+  Local<Value> jsNumColumns = obj->Get(context, String::NewFromUtf8(isolate, "numColumns")).ToLocalChecked();
+  if(!jsNumRows->IsUint32() || !jsNumColumns->IsUint32()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseMatrix; numRows and numColumns must be integers")));
+    return;
+  }
+  numRows = jsNumRows->Uint32Value();
+  numColumns = jsNumColumns->Uint32Value();
+  compressedRows = obj->Get(context, String::NewFromUtf8(isolate, "compressedRows")).ToLocalChecked()->IsTrue();
+
+  Local<Value> jsOffsets = obj->Get(context, String::NewFromUtf8(isolate, "offsets")).ToLocalChecked();
+  if(!jsOffsets->IsUint32Array() || jsOffsets.As<v8::Uint32Array>()->Length() != (size_t)outerSize() + 1) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseMatrix; offsets must be a Uint32Array of one more entry than there are compressed rows")));
+    return;
+  }
+  offsets = reinterpret_cast<uint32_t*>(GET_CONTENTS(jsOffsets.As<v8::Uint32Array>()));
+  if(offsets[0] != 0) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseMatrix; offsets must start at 0")));
+    return;
+  }
+  for(uint32_t o=0; o<outerSize(); o++) {
+    if(offsets[o+1] < offsets[o]) {
+      isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseMatrix; offsets must be nondecreasing")));
+      return;
+    }
+  }
+
+  Local<Value> jsIndices = obj->Get(context, String::NewFromUtf8(isolate, "indices")).ToLocalChecked();
+  if(!jsIndices->IsUint32Array() || jsIndices.As<v8::Uint32Array>()->Length() < nnz()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseMatrix; indices must be a Uint32Array of at least nnz entries")));
+    return;
+  }
+  indices = reinterpret_cast<uint32_t*>(GET_CONTENTS(jsIndices.As<v8::Uint32Array>()));
+
+  Local<Value> jsValues = obj->Get(context, String::NewFromUtf8(isolate, "values")).ToLocalChecked();
+  if(!jsValues->IsFloat64Array() || jsValues.As<v8::Float64Array>()->Length() < nnz()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseMatrix; values must be a Float64Array of at least nnz entries")));
+    return;
+  }
+  values = reinterpret_cast<double*>(GET_CONTENTS(jsValues.As<v8::Float64Array>()));
+
+  for(uint32_t k=0; k<nnz(); k++) {
+    if(indices[k] >= innerSize()) {
+      isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid SparseMatrix; index out of bounds")));
+      return;
+    }
+  }
+  valid = true;
+}
+
+void sparseMatrixMultiply(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: matrix, transpose, dense, dest")));
+    return;
+  }
+  JSSparseMatrix matrix(isolate, args[0]);
+  if(!matrix.isValid())
+    return;
+  bool transpose = args[1]->IsTrue();
+  JSTensor dense(isolate, args[2]);
+  if(!dense.isValid())
+    return;
+  JSTensor dest(isolate, args[3]);
+  if(!dest.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::sparseMatrixMultiply(matrix, transpose, dense, dest, &error);
+  throwTensorError(isolate, "Error in sparseMatrixMultiply: ", error);
+}
+
+/**
+  * a tensor::CooTensor over the typed arrays of a js CooTensor. Checks that
+  * the arrays hold nnz nonzeros and that every coordinate is inside the
+  * shape. If a check fails a TypeError is thrown and isValid() returns
+  * false.
+  **/
+struct JSCooTensor : public tensor::CooTensor {
+  bool valid;
+
+  JSCooTensor(Isolate* isolate, const Local<Value> jsCoo);
+
+  bool isValid(void) {
+    return valid;
+  }
+};
+
+JSCooTensor::JSCooTensor(Isolate* isolate, const Local<Value> jsCoo) {
+  Local<Context> context = isolate->GetCurrentContext();
+  valid = false;
+  numDimensions = 0;
+  shape = NULL;
+  coords = NULL;
+  values = NULL;
+  nnz = 0;
+  if(!jsCoo->IsObject()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid CooTensor; must be an object")));
+    return;
+  }
+  Local<Object> obj = jsCoo->ToObject();
+
+  Local<Value> jsShape = obj->Get(context, String::NewFromUtf8(isolate, "shape")).ToLocalChecked();
+  if(!jsShape->IsUint32Array()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid CooTensor; shape must be a Uint32Array")));
+    return;
+  }
+  numDimensions = jsShape.As<v8::Uint32Array>()->Length();
+  shape = reinterpret_cast<uint32_t*>(GET_CONTENTS(jsShape.As<v8::Uint32Array>()));
+
+  Local<Value> jsNnz = obj->Get(context, String::NewFromUtf8(isolate, "nnz")).ToLocalChecked();
+  if(!jsNnz->IsUint32()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid CooTensor; nnz must be integer")));
+    return;
+  }
+  nnz = jsNnz->Uint32Value();
+
+  Local<Value> jsCoords = obj->Get(context, String::NewFromUtf8(isolate, "coords")).ToLocalChecked();
+  if(!jsCoords->IsUint32Array() ||
+     jsCoords.As<v8::Uint32Array>()->Length() < (uint64_t)nnz * numDimensions) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid CooTensor; coords must be a Uint32Array of at least nnz * numDimensions entries")));
+    return;
+  }
+  coords = reinterpret_cast<uint32_t*>(GET_CONTENTS(jsCoords.As<v8::Uint32Array>()));
+
+  Local<Value> jsValues = obj->Get(context, String::NewFromUtf8(isolate, "values")).ToLocalChecked();
+  if(!jsValues->IsFloat64Array() || jsValues.As<v8::Float64Array>()->Length() < nnz) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid CooTensor; values must be a Float64Array of at least nnz entries")));
+    return;
+  }
+  values = reinterpret_cast<double*>(GET_CONTENTS(jsValues.As<v8::Float64Array>()));
+
+  for(uint32_t k=0; k<nnz; k++) {
+    for(uint32_t d=0; d<numDimensions; d++) {
+      if(coordsOf(k)[d] >= shape[d]) {
+        isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid CooTensor; coordinates out of bounds")));
+        return;
+      }
+    }
+  }
+  valid = true;
+}
+
+void cooCoalesce(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 1) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 1 argument: tensor")));
+    return;
+  }
+  JSCooTensor coo(isolate, args[0]);
+  if(!coo.isValid())
+    return;
+  args.GetReturnValue().Set(Number::New(isolate, tensor::cooCoalesce(coo)));
+}
+
+void cooContract(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: sparse, dense, dimsToContract, dest")));
+    return;
+  }
+  JSCooTensor sparse(isolate, args[0]);
+  if(!sparse.isValid())
+    return;
+  if(!sparse.isCoalesced()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "invalid CooTensor; must be coalesced")));
+    return;
+  }
+  JSTensor dense(isolate, args[1]);
+  if(!dense.isValid())
+    return;
+  if(!args[2]->IsUint32()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "dimsToContract must be a nonnegative integer")));
+    return;
+  }
+  uint32_t dimsToContract = args[2]->Uint32Value();
+  JSTensor dest(isolate, args[3]);
+  if(!dest.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::cooContract(sparse, dense, dimsToContract, dest, &error);
+  throwTensorError(isolate, "Error in cooContract: ", error);
+}
+
+/**
+  * JSTensors for the js array of factor matrices of a decomposition. They
+  * are owned by factors; pointers to them are appended to tensors. Returns
+  * false after throwing a TypeError if an entry is not a valid compact
+  * tensor.
+  **/
+bool readFactors(Isolate* isolate, const Local<Value> jsFactors,
+                 std::vector<std::unique_ptr<JSTensor>>& factors, std::vector<Tensor*>& tensors) {
+  if(!jsFactors->IsArray()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "factors must be an array of tensors")));
+    return false;
+  }
+  Local<Context> context = isolate->GetCurrentContext();
+  Local<v8::Array> array = jsFactors.As<v8::Array>();
+  for(uint32_t m=0; m<array->Length(); m++) {
+    factors.emplace_back(new JSTensor(isolate, array->Get(context, m).ToLocalChecked()));
+    if(!factors[m]->isValid())
+      return false;
+    if(!tensor::isCompact(*factors[m])) {
+      isolate->ThrowException(Exception::TypeError(
+          String::NewFromUtf8(isolate, "factors must be compact float64 tensors")));
+      return false;
+    }
+    tensors.push_back(factors[m].get());
+  }
+  return true;
+}
+
+//reads a compact float64 tensor, or throws a TypeError naming it.
+bool readCompact(Isolate* isolate, JSTensor& tensor, const char* name) {
+  if(!tensor.isValid())
+    return false;
+  if(!tensor::isCompact(tensor)) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate,
+        (std::string(name) + " must be a compact float64 tensor").c_str())));
+    return false;
+  }
+  return true;
+}
+
+//mttkrp(X, factors, mode, dest), for a dense or COO tensor X.
+void mttkrp(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: tensor, factors, mode, dest")));
+    return;
+  }
+  std::vector<std::unique_ptr<JSTensor>> factors;
+  std::vector<Tensor*> tensors;
+  if(!readFactors(isolate, args[1], factors, tensors))
+    return;
+  if(!args[2]->IsUint32()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "mode must be a nonnegative integer")));
+    return;
+  }
+  uint32_t mode = args[2]->Uint32Value();
+  JSTensor dest(isolate, args[3]);
+  if(!readCompact(isolate, dest, "dest"))
+    return;
+
+  TensorError error = tensor::NoError;
+  Local<Context> context = isolate->GetCurrentContext();
+  Local<Value> isCoo = args[0]->IsObject() ?
+      args[0]->ToObject()->Get(context, String::NewFromUtf8(isolate, "cooTensor")).ToLocalChecked() :
+      Local<Value>::Cast(v8::Undefined(isolate));
+  if(isCoo->IsTrue()) {
+    JSCooTensor X(isolate, args[0]);
+    if(!X.isValid())
+      return;
+    tensor::mttkrp(X, tensors, mode, dest, &error);
+  } else {
+    JSTensor X(isolate, args[0]);
+    if(!readCompact(isolate, X, "tensor"))
+      return;
+    tensor::mttkrp(X, tensors, mode, dest, &error);
+  }
+  throwTensorError(isolate, "Error in mttkrp: ", error);
+}
+
+void modeProduct(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: tensor, matrix, mode, dest")));
+    return;
+  }
+  JSTensor X(isolate, args[0]);
+  if(!readCompact(isolate, X, "tensor"))
+    return;
+  JSTensor matrix(isolate, args[1]);
+  if(!matrix.isValid())
+    return;
+  if(!args[2]->IsUint32()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "mode must be a nonnegative integer")));
+    return;
+  }
+  uint32_t mode = args[2]->Uint32Value();
+  JSTensor dest(isolate, args[3]);
+  if(!readCompact(isolate, dest, "dest"))
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::modeProduct(X, matrix, mode, dest, &error);
+  throwTensorError(isolate, "Error in modeProduct: ", error);
+}
+
+void modeGram(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: tensor1, tensor2, mode, dest")));
+    return;
+  }
+  JSTensor X(isolate, args[0]);
+  if(!readCompact(isolate, X, "tensor1"))
+    return;
+  JSTensor Y(isolate, args[1]);
+  if(!readCompact(isolate, Y, "tensor2"))
+    return;
+  if(!args[2]->IsUint32()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "mode must be a nonnegative integer")));
+    return;
+  }
+  uint32_t mode = args[2]->Uint32Value();
+  JSTensor dest(isolate, args[3]);
+  if(!readCompact(isolate, dest, "dest"))
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::modeGram(X, Y, mode, dest, &error);
+  throwTensorError(isolate, "Error in modeGram: ", error);
+}
+
+void ttmChain(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: sparse, factors, mode, dest")));
+    return;
+  }
+  JSCooTensor X(isolate, args[0]);
+  if(!X.isValid())
+    return;
+  std::vector<std::unique_ptr<JSTensor>> factors;
+  std::vector<Tensor*> tensors;
+  if(!readFactors(isolate, args[1], factors, tensors))
+    return;
+  if(!args[2]->IsUint32()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "mode must be a nonnegative integer")));
+    return;
+  }
+  uint32_t mode = args[2]->Uint32Value();
+  JSTensor dest(isolate, args[3]);
+  if(!readCompact(isolate, dest, "dest"))
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::ttmChain(X, tensors, mode, dest, &error);
+  throwTensorError(isolate, "Error in ttmChain: ", error);
+}
+
+//binds kronecker and khatriRao: (A, B, dest).
+#define CREATE_KRONECKER_OP(name) \
+void name(const FunctionCallbackInfo<Value>& args) { \
+  Isolate* isolate = args.GetIsolate(); \
+  if (args.Length() < 3) { \
+    isolate->ThrowException(Exception::TypeError( \
+        String::NewFromUtf8(isolate, "Requires 3 arguments: A, B, dest"))); \
+    return; \
+  } \
+  JSTensor A(isolate, args[0]); \
+  JSTensor B(isolate, args[1]); \
+  JSTensor dest(isolate, args[2]); \
+  if(!A.isValid() || !B.isValid() || !dest.isValid()) \
+    return; \
+  TensorError error = tensor::NoError; \
+  tensor::name(A, B, dest, &error); \
+  throwTensorError(isolate, "Error in " #name ": ", error); \
+}
+
+CREATE_KRONECKER_OP(kronecker)
+CREATE_KRONECKER_OP(khatriRao)
+
+void kroneckerMultiply(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: A, B, x, dest")));
+    return;
+  }
+  JSTensor A(isolate, args[0]);
+  JSTensor B(isolate, args[1]);
+  JSTensor x(isolate, args[2]);
+  JSTensor dest(isolate, args[3]);
+  if(!A.isValid() || !B.isValid() || !x.isValid() || !dest.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::kroneckerMultiply(A, B, x, dest, &error);
+  throwTensorError(isolate, "Error in kroneckerMultiply: ", error);
+}
+
+void cholesky(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 1) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 1 argument: matrix")));
+    return;
+  }
+  JSTensor A(isolate, args[0]);
+  if(!A.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::cholesky(A, &error);
+  throwTensorError(isolate, "Error in cholesky: ", error);
+}
+
+void triangularSolve(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: triangular, lower, transpose, dest")));
+    return;
+  }
+  JSTensor T(isolate, args[0]);
+  JSTensor B(isolate, args[3]);
+  if(!T.isValid() || !B.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::triangularSolve(T, args[1]->IsTrue(), args[2]->IsTrue(), B, &error);
+  throwTensorError(isolate, "Error in triangularSolve: ", error);
+}
+
+void leastSquares(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: A, b, ridge, dest")));
+    return;
+  }
+  JSTensor A(isolate, args[0]);
+  JSTensor b(isolate, args[1]);
+  JSTensor dest(isolate, args[3]);
+  if(!A.isValid() || !b.isValid() || !dest.isValid())
+    return;
+  if(!args[2]->IsNumber()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "ridge must be a number")));
+    return;
+  }
+
+  TensorError error = tensor::NoError;
+  tensor::leastSquares(A, b, args[2]->NumberValue(), dest, &error);
+  throwTensorError(isolate, "Error in leastSquares: ", error);
+}
+
+void choleskyQR(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 2) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 2 arguments: matrix, R")));
+    return;
+  }
+  JSTensor Y(isolate, args[0]);
+  JSTensor R(isolate, args[1]);
+  if(!Y.isValid() || !R.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::choleskyQR(Y, R, &error);
+  throwTensorError(isolate, "Error in choleskyQR: ", error);
+}
+
+void svdJacobi(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: matrix, U, S, V")));
+    return;
+  }
+  JSTensor A(isolate, args[0]);
+  JSTensor U(isolate, args[1]);
+  JSTensor S(isolate, args[2]);
+  JSTensor V(isolate, args[3]);
+  if(!A.isValid() || !U.isValid() || !S.isValid() || !V.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::svdJacobi(A, U, S, V, &error);
+  throwTensorError(isolate, "Error in svdJacobi: ", error);
+}
+
+/**
+  * the losses of losses.h, which all take (predictions, labels, loss,
+  * grad).
+  */
+void callLoss(const FunctionCallbackInfo<Value>& args, const char* errorPrefix,
+              void (*loss)(tensor::Tensor&, tensor::Tensor&, tensor::Tensor&, tensor::Tensor&, TensorError*)) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 4) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 4 arguments: predictions, labels, loss, grad")));
+    return;
+  }
+  JSTensor pred(isolate, args[0]);
+  JSTensor labels(isolate, args[1]);
+  JSTensor lossDest(isolate, args[2]);
+  JSTensor grad(isolate, args[3]);
+  if(!pred.isValid() || !labels.isValid() || !lossDest.isValid() || !grad.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  loss(pred, labels, lossDest, grad, &error);
+  throwTensorError(isolate, errorPrefix, error);
+}
+
+void logisticLoss(const FunctionCallbackInfo<Value>& args) {
+  callLoss(args, "Error in logisticLoss: ", tensor::logisticLoss);
+}
+
+void squaredLoss(const FunctionCallbackInfo<Value>& args) {
+  callLoss(args, "Error in squaredLoss: ", tensor::squaredLoss);
+}
+
+void softmaxCrossEntropy(const FunctionCallbackInfo<Value>& args) {
+  callLoss(args, "Error in softmaxCrossEntropy: ", tensor::softmaxCrossEntropy);
+}
+
+/**
+  * a tensor::Slot read from a js tensor or from a quantized slot (see
+  * src/optim/slots.js): {codes, scales, seed}, where codes is a Uint8Array
+  * of a code per value and scales a Float32Array with one for every
+  * SLOT_BLOCK_SIZE of them. If a check fails a TypeError is thrown
+  * and isValid() returns false.
+  **/
+struct JSSlot : public tensor::Slot {
+  std::unique_ptr<JSTensor> jsTensor;
+  bool valid;
+
+  JSSlot(Isolate* isolate, const Local<Value> jsSlot);
+  JSSlot(const JSSlot&) = delete;
+  JSSlot& operator=(const JSSlot&) = delete;
+
+  bool isValid(void) {
+    return valid;
+  }
+};
+
+JSSlot::JSSlot(Isolate* isolate, const Local<Value> jsSlot) {
+  Local<Context> context = isolate->GetCurrentContext();
+  valid = false;
+  tensor = NULL;
+  codes = NULL;
+  scales = NULL;
+  size = 0;
+  seed = 0;
+  if(!jsSlot->IsObject()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid slot; must be an object")));
+    return;
+  }
+  Local<Object> obj = jsSlot->ToObject();
+  Local<Value> jsCodes = obj->Get(context, String::NewFromUtf8(isolate, "codes")).ToLocalChecked();
+  if(jsCodes->IsUndefined()) {
+    jsTensor.reset(new JSTensor(isolate, jsSlot));
+    if(!jsTensor->isValid())
+      return;
+    tensor = jsTensor.get();
+    size = tensor->totalSize();
+    valid = true;
+    return;
+  }
+
+  if(!jsCodes->IsUint8Array()) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid slot; codes must be a Uint8Array")));
+    return;
+  }
+  codes = reinterpret_cast<uint8_t*>(GET_CONTENTS(jsCodes.As<v8::Uint8Array>()));
+  size = jsCodes.As<v8::Uint8Array>()->Length();
+
+  Local<Value> jsScales = obj->Get(context, String::NewFromUtf8(isolate, "scales")).ToLocalChecked();
+  uint64_t numBlocks = (size + tensor::SLOT_BLOCK_SIZE - 1) / tensor::SLOT_BLOCK_SIZE;
+  if(!jsScales->IsFloat32Array() || jsScales.As<v8::Float32Array>()->Length() < numBlocks) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "invalid slot; scales must be a Float32Array with a scale per block")));
+    return;
+  }
+  scales = reinterpret_cast<float*>(GET_CONTENTS(jsScales.As<v8::Float32Array>()));
+
+  Local<Value> jsSeed = obj->Get(context, String::NewFromUtf8(isolate, "seed")).ToLocalChecked();
+  seed = jsSeed->IsNumber() ? (uint64_t)jsSeed->NumberValue() : 0;
+  valid = true;
+}
+
+/**
+  * reads the last argument of the updates of optimizers.h, a step size or
+  * learning rate, into rate, or throws and returns false.
+  */
+bool updateRate(const FunctionCallbackInfo<Value>& args, int numOperands, const char* usage, double& rate) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < numOperands + 1) {
+    isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, usage)));
+    return false;
+  }
+  if(!args[numOperands]->IsNumber()) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "learning rate must be a number")));
+    return false;
+  }
+  rate = args[numOperands]->NumberValue();
+  return true;
+}
+
+//calls update(grad) with jsGrad read as a SparseVector if it has indices, else as a tensor.
+template<typename Update>
+void withGrad(Isolate* isolate, const Local<Value> jsGrad, Update update) {
+  Local<Context> context = isolate->GetCurrentContext();
+  bool sparse = jsGrad->IsObject() &&
+    !jsGrad->ToObject()->Get(context, String::NewFromUtf8(isolate, "indices")).ToLocalChecked()->IsUndefined();
+  if(sparse) {
+    JSSparseVector grad(isolate, jsGrad);
+    if(grad.isValid())
+      update(grad);
+  } else {
+    JSTensor grad(isolate, jsGrad);
+    if(grad.isValid())
+      update(grad);
+  }
+}
+
+void sgdUpdate(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  double stepSize;
+  if(!updateRate(args, 2, "Requires 3 arguments: weights, grad, stepSize", stepSize))
+    return;
+  JSTensor weights(isolate, args[0]);
+  JSTensor grad(isolate, args[1]);
+  if(!weights.isValid() || !grad.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::sgdUpdate(weights, grad, stepSize, &error);
+  throwTensorError(isolate, "Error in sgdUpdate: ", error);
+}
+
+void adaGradUpdate(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  double lr;
+  if(!updateRate(args, 3, "Requires 4 arguments: weights, grad, sumGradSq, lr", lr))
+    return;
+  JSTensor weights(isolate, args[0]);
+  JSSlot sumGradSq(isolate, args[2]);
+  if(!weights.isValid() || !sumGradSq.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  withGrad(isolate, args[1], [&](auto& grad) {
+    tensor::adaGradUpdate(weights, grad, sumGradSq, lr, &error);
+  });
+  throwTensorError(isolate, "Error in adaGradUpdate: ", error);
+}
+
+void freeRexUpdate(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  double lr;
+  if(!updateRate(args, 5, "Requires 6 arguments: weights, grad, sumGrad, oneOverEtaSq, Lmax, lr", lr))
+    return;
+  JSTensor weights(isolate, args[0]);
+  JSSlot sumGrad(isolate, args[2]);
+  JSSlot oneOverEtaSq(isolate, args[3]);
+  JSSlot Lmax(isolate, args[4]);
+  if(!weights.isValid() || !sumGrad.isValid() || !oneOverEtaSq.isValid() || !Lmax.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  withGrad(isolate, args[1], [&](auto& grad) {
+    tensor::freeRexUpdate(weights, grad, sumGrad, oneOverEtaSq, Lmax, lr, &error);
+  });
+  throwTensorError(isolate, "Error in freeRexUpdate: ", error);
+}
+
+void copySlot(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  if (args.Length() < 2) {
+    isolate->ThrowException(Exception::TypeError(
+        String::NewFromUtf8(isolate, "Requires 2 arguments: source, dest")));
+    return;
+  }
+  JSSlot source(isolate, args[0]);
+  JSSlot dest(isolate, args[1]);
+  if(!source.isValid() || !dest.isValid())
+    return;
+
+  TensorError error = tensor::NoError;
+  tensor::copySlot(source, dest, &error);
+  throwTensorError(isolate, "Error in copySlot: ", error);
+}
+
+CREATE_OP(exp)
+CREATE_OP(abs)
+CREATE_OP(sqrt)
+CREATE_OP(sin)
+CREATE_OP(cos)
+CREATE_OP(tan)
+CREATE_OP(sinh)
+CREATE_OP(cosh)
+CREATE_OP(tanh)
+CREATE_OP(log)
+CREATE_OP(atan)
+CREATE_OP(acos)
+CREATE_OP(asin)
+CREATE_OP(atanh)
+CREATE_OP(acosh)
+CREATE_OP(asinh)
+CREATE_OP(erf)
+CREATE_OP(floor)
+CREATE_OP(ceil)
+CREATE_OP(round)
+CREATE_OP(sign)
+
+CREATE_BINARY_OP(max)
+CREATE_BINARY_OP(min)
+CREATE_BINARY_OP(pow)
+CREATE_BINARY_OP(fmod)
+
+
+void Method(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  JSTensor T(isolate, args[0]);
+  if(T.isValid()) {
+    T.data[3] = 99;
+    args.GetReturnValue().Set(Number::New(isolate, T.strides[1]));
+  }
+}
+
+/**
+  * NODE_MODULE_INIT exports the initializer Node looks up by name when the
+  * addon is loaded again, as it is by every worker thread: each one runs it
+  * with its own exports and seeds its own generator. The native core keeps
+  * no other mutable global state.
+  */
+NODE_MODULE_INIT() {
   tensor::seed_generator();
 
   NODE_SET_METHOD(exports, "hello", Method);
-  NODE_SET_METHOD(exports, "contract", contract);
+  DECLARE_SYNC_AND_ASYNC(contract)
   NODE_SET_METHOD(exports, "scalarProduct", scalarProduct);
   NODE_SET_METHOD(exports, "subTensor", subTensor);
-  NODE_SET_METHOD(exports, "addScale", addScale);
-  NODE_SET_METHOD(exports, "multiplyScale", multiplyScale);
-  NODE_SET_METHOD(exports, "divideScale", divideScale);
-  NODE_SET_METHOD(exports, "scale", scale);
-  NODE_SET_METHOD(exports, "fillNormal", fillNormal);
-  NODE_SET_METHOD(exports, "fillUniform", fillUniform);
-  NODE_SET_METHOD(exports, "sum", sum);
+  DECLARE_SYNC_AND_ASYNC(addScale)
+  DECLARE_SYNC_AND_ASYNC(multiplyScale)
+  DECLARE_SYNC_AND_ASYNC(divideScale)
+  DECLARE_SYNC_AND_ASYNC(scale)
+  DECLARE_SYNC_AND_ASYNC(fillNormal)
+  DECLARE_SYNC_AND_ASYNC(fillUniform)
+  NODE_SET_METHOD(exports, "seedRandom", seedRandom);
+  NODE_SET_METHOD(exports, "setNumThreads", setNumThreads);
+  NODE_SET_METHOD(exports, "getNumThreads", getNumThreads);
+  DECLARE_SYNC_AND_ASYNC(sum)
+  DECLARE_SYNC_AND_ASYNC(fusedElementwise)
+
+  NODE_SET_METHOD(exports, "sparseDot", sparseDot);
+  NODE_SET_METHOD(exports, "sparseAxpy", sparseAxpy);
+  NODE_SET_METHOD(exports, "sparseScale", sparseScale);
+  NODE_SET_METHOD(exports, "sparseSum", sparseSum);
+  NODE_SET_METHOD(exports, "sparseGatherScale", sparseGatherScale);
+  NODE_SET_METHOD(exports, "sparseSparseAddScale", sparseSparseAddScale);
+  NODE_SET_METHOD(exports, "sparseSparseMultiplyScale", sparseSparseMultiplyScale);
+  NODE_SET_METHOD(exports, "sparseSparseDot", sparseSparseDot);
+  NODE_SET_METHOD(exports, "sparseMatMul", sparseMatMul);
+  NODE_SET_METHOD(exports, "sparseMatrixMultiply", sparseMatrixMultiply);
+  NODE_SET_METHOD(exports, "cooCoalesce", cooCoalesce);
+  NODE_SET_METHOD(exports, "cooContract", cooContract);
+  NODE_SET_METHOD(exports, "mttkrp", mttkrp);
+  NODE_SET_METHOD(exports, "modeProduct", modeProduct);
+  NODE_SET_METHOD(exports, "modeGram", modeGram);
+  NODE_SET_METHOD(exports, "ttmChain", ttmChain);
+  NODE_SET_METHOD(exports, "kronecker", kronecker);
+  NODE_SET_METHOD(exports, "khatriRao", khatriRao);
+  NODE_SET_METHOD(exports, "kroneckerMultiply", kroneckerMultiply);
+  NODE_SET_METHOD(exports, "cholesky", cholesky);
+  NODE_SET_METHOD(exports, "triangularSolve", triangularSolve);
+  NODE_SET_METHOD(exports, "leastSquares", leastSquares);
+  NODE_SET_METHOD(exports, "choleskyQR", choleskyQR);
+  NODE_SET_METHOD(exports, "svdJacobi", svdJacobi);
+  NODE_SET_METHOD(exports, "logisticLoss", logisticLoss);
+  NODE_SET_METHOD(exports, "squaredLoss", squaredLoss);
+  NODE_SET_METHOD(exports, "softmaxCrossEntropy", softmaxCrossEntropy);
+  NODE_SET_METHOD(exports, "sgdUpdate", sgdUpdate);
+  NODE_SET_METHOD(exports, "adaGradUpdate", adaGradUpdate);
+  NODE_SET_METHOD(exports, "freeRexUpdate", freeRexUpdate);
+  NODE_SET_METHOD(exports, "copySlot", copySlot);
 
   DECLARE_OP(exp)
   DECLARE_OP(abs)
@@ -695,7 +2091,6 @@ void init(Local<Object> exports) {
   DECLARE_BINARY_OP(fmod)
 }
 
-NODE_MODULE(NODE_GYP_MODULE_NAME, init)
 
 }
 
@@ -7,17 +7,43 @@ exports.utilityFuncs = [];
 var Operation = variable.Operation;
 var Variable = variable.Variable;
 
+/**
+  * backward passes that would take several mathops calls and temporaries,
+  * as single native passes (see tensor.fused). They convert sparse
+  * arguments to dense ones, so ops take them only when none is sparse.
+  */
+var fusedBackward = {
+  quotient: tensor.fused.compile((g, x, y) => g.mul(x).div(y.square()).neg()),
+  tan: tensor.fused.compile((g, tanX) => g.mul(tanX.square().add(1))),
+  sin: tensor.fused.compile((g, x) => g.mul(x.cos())),
+  cos: tensor.fused.compile((g, x) => g.mul(x.sin()).neg()),
+  abs: tensor.fused.compile((g, x) => g.mul(x.sign())),
+  broadcast: tensor.fused.compile(g => g)
+};
+
+function anySparse(...tensors) {
+  return tensors.some(t => t.sparse);
+}
+
 class Add extends Operation {
-  forward(x, y) {
+  forward(x, y, dest) {
     if(!mathops.sameShape(x.data, y.data))
       throw new Error("arguments must have same shape!");
 
-    return mathops.addScale(x.data, y.data, 1, 1);
+    return mathops.addScale(x.data, y.data, 1, 1, dest);
   }
 
   backward(outputDerivative, argIndex) {
     return outputDerivative;
   }
+
+  expression(x, y) {
+    return x.add(y);
+  }
+
+  derivativeExpression(g, inputs, output, argIndex) {
+    return g;
+  }
 }
 exports.Add = Add;
 
@@ -29,22 +55,28 @@ exports.utilityFuncs.push(add);
 
 
 class Sub extends Operation {
-  forward(x, y) {
+  forward(x, y, dest) {
     if(!mathops.sameShape(x.data, y.data))
       throw new Error("arguments must have same shape!");
-    var answer = mathops.addScale(x.data, y.data, 1, -1);
-    return mathops.addScale(x.data, y.data, 1, -1);
+    return mathops.addScale(x.data, y.data, 1, -1, dest);
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     switch(argIndex) {
       case 0:
         return outputDerivative;
       case 1:
-        var answer = mathops.scale(outputDerivative, -1);
-        return mathops.scale(outputDerivative, -1);
+        return mathops.scale(outputDerivative, -1, dest);
     }
   }
+
+  expression(x, y) {
+    return x.sub(y);
+  }
+
+  derivativeExpression(g, inputs, output, argIndex) {
+    return argIndex === 0 ? g : g.neg();
+  }
 }
 exports.Sub = Sub;
 
@@ -55,22 +87,30 @@ exports.sub = sub;
 exports.utilityFuncs.push(sub);
 
 class Mul extends Operation {
-  forward(x, y) {
+  forward(x, y, dest) {
     if(!mathops.sameShape(x.data, y.data))
       throw new Error("arguments must have same shape!");
     this.saveForBackward([y.data, x.data]);
-    return mathops.multiplyScale(x.data, y.data, 1);
+    return mathops.multiplyScale(x.data, y.data, 1, dest);
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var [ydata, xdata] = this.getSavedData();
     switch(argIndex) {
       case 0:
-        return mathops.multiplyScale(outputDerivative, ydata, 1);
+        return mathops.multiplyScale(outputDerivative, ydata, 1, dest);
       case 1:
-        return mathops.multiplyScale(outputDerivative, xdata, 1);
+        return mathops.multiplyScale(outputDerivative, xdata, 1, dest);
     }
   }
+
+  expression(x, y) {
+    return x.mul(y);
+  }
+
+  derivativeExpression(g, [x, y], output, argIndex) {
+    return argIndex === 0 ? g.mul(y) : g.mul(x);
+  }
 }
 exports.Mul = Mul;
 
@@ -81,24 +121,34 @@ exports.mul = mul;
 exports.utilityFuncs.push(mul);
 
 class Div extends Operation {
-  forward(x, y) {
+  forward(x, y, dest) {
     if(!mathops.sameShape(x.data, y.data))
       throw new Error("arguments must have same shape!");
     this.saveForBackward([y.data, x.data]);
-    return mathops.divideScale(x.data, y.data, 1);
+    return mathops.divideScale(x.data, y.data, 1, dest);
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var [ydata, xdata] = this.getSavedData();
     switch(argIndex) {
       case 0:
-        return mathops.divideScale(outputDerivative, ydata, 1);
+        return mathops.divideScale(outputDerivative, ydata, 1, dest);
       case 1:
-        var answer_holder = mathops.multiplyScale(ydata, ydata, 1);
+        if(!anySparse(outputDerivative, xdata, ydata))
+          return fusedBackward.quotient(outputDerivative, xdata, ydata, dest);
+        var answer_holder = mathops.multiplyScale(ydata, ydata, 1, dest);
         var divided = mathops.divideScale(outputDerivative, answer_holder, -1, answer_holder);
         return mathops.multiplyScale(answer_holder, xdata, 1, answer_holder);
     }
   }
+
+  expression(x, y) {
+    return x.div(y);
+  }
+
+  derivativeExpression(g, [x, y], output, argIndex) {
+    return argIndex === 0 ? g.div(y) : g.mul(x).div(y.square()).neg();
+  }
 }
 exports.Div = Div;
 
@@ -113,12 +163,21 @@ class Scale extends Operation {
     super();
     this.x = x;
   }
-  forward(v) {
-    return mathops.scale(v.data, this.x);
+  forward(v, dest) {
+    return mathops.scale(v.data, this.x, dest);
   }
 
-  backward(outputDerivative, argIndex) {
-    return mathops.scale(outputDerivative, this.x);
+  backward(outputDerivative, argIndex, dest) {
+    return mathops.scale(outputDerivative, this.x, dest);
+  }
+
+  expression(v) {
+    if(typeof this.x === 'number')
+      return v.mul(this.x);
+  }
+
+  derivativeExpression(g, inputs, output, argIndex) {
+    return g.mul(this.x);
   }
 }
 exports.Scale = Scale;
@@ -134,13 +193,22 @@ class AddScalar extends Operation {
     super();
     this.x = x;
   }
-  forward(v) {
-    return mathops.addScale(v.data, this.x, 1);
+  forward(v, dest) {
+    return mathops.addScale(v.data, this.x, 1, 1, dest);
   }
 
   backward(outputDerivative, argIndex) {
     return outputDerivative;
   }
+
+  expression(v) {
+    if(typeof this.x === 'number')
+      return v.add(this.x);
+  }
+
+  derivativeExpression(g, inputs, output, argIndex) {
+    return g;
+  }
 }
 exports.AddScalar = AddScalar;
 
@@ -152,18 +220,18 @@ exports.utilityFuncs.push(addScalar);
 
 class Dot extends Operation {
 
-  forward(x, y) {
+  forward(x, y, dest) {
     this.saveForBackward([x.data , y.data]);
-    return x.data.dot(y.data);
+    return mathops.dot(x.data, y.data, dest);
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var [xdata , ydata] = this.getSavedData();
     switch(argIndex) {
       case 0:
-        return mathops.multiplyScale(ydata, outputDerivative, 1);
+        return mathops.multiplyScale(ydata, outputDerivative, 1, dest);
       case 1:
-        return mathops.multiplyScale(xdata, outputDerivative, 1);
+        return mathops.multiplyScale(xdata, outputDerivative, 1, dest);
     }
   }
 }
@@ -177,14 +245,22 @@ exports.utilityFuncs.push(dot);
 
 class Square extends Operation {
 
-  forward(x) {
+  forward(x, dest) {
     this.saveForBackward(x.data);
-    return mathops.multiplyScale(x.data, x.data, 1);
+    return mathops.multiplyScale(x.data, x.data, 1, dest);
   }
 
-  backward(outputDerivative) {
+  backward(outputDerivative, argIndex, dest) {
     var inputData = this.getSavedData();
-    return mathops.multiplyScale(outputDerivative, inputData, 2);
+    return mathops.multiplyScale(outputDerivative, inputData, 2, dest);
+  }
+
+  expression(x) {
+    return x.square();
+  }
+
+  derivativeExpression(g, [x], output, argIndex) {
+    return g.mul(x).mul(2);
   }
 }
 exports.Square = Square;
@@ -198,16 +274,23 @@ exports.utilityFuncs.push(square);
 
 class Exp extends Operation {
 
-  forward(x) {
-    var expX = mathops.exp(x.data);
+  forward(x, dest) {
+    var expX = mathops.exp(x.data, dest);
     this.saveForBackward(expX);
     return expX;
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var expX = this.getSavedData();
-    var answer =  mathops.multiplyScale(outputDerivative, expX, 1);
-    return answer;
+    return mathops.multiplyScale(outputDerivative, expX, 1, dest);
+  }
+
+  expression(x) {
+    return x.exp();
+  }
+
+  derivativeExpression(g, inputs, output, argIndex) {
+    return g.mul(output);
   }
 }
 exports.Exp = Exp;
@@ -220,15 +303,23 @@ exports.utilityFuncs.push(exp);
 
 class Sqrt extends Operation {
 
-  forward(x) {
-    var sqrtX = mathops.sqrt(x.data);
+  forward(x, dest) {
+    var sqrtX = mathops.sqrt(x.data, dest);
     this.saveForBackward(sqrtX);
     return sqrtX;
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var sqrtX = this.getSavedData();
-    return mathops.divideScale(outputDerivative, sqrtX, 0.5);
+    return mathops.divideScale(outputDerivative, sqrtX, 0.5, dest);
+  }
+
+  expression(x) {
+    return x.sqrt();
+  }
+
+  derivativeExpression(g, inputs, output, argIndex) {
+    return g.div(output).mul(0.5);
   }
 }
 exports.Sqrt = Sqrt;
@@ -241,15 +332,25 @@ exports.utilityFuncs.push(sqrt);
 
 class Sin extends Operation {
 
-  forward(x) {
+  forward(x, dest) {
     var X = x.data;
     this.saveForBackward(X);
-    return mathops.sin(x.data);
+    return mathops.sin(x.data, dest);
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var X = this.getSavedData();
-    return mathops.multiplyScale(outputDerivative, mathops.cos(X), 1);
+    if(!anySparse(outputDerivative, X))
+      return fusedBackward.sin(outputDerivative, X, dest);
+    return mathops.multiplyScale(outputDerivative, mathops.cos(X, dest), 1, dest);
+  }
+
+  expression(x) {
+    return x.sin();
+  }
+
+  derivativeExpression(g, [x], output, argIndex) {
+    return g.mul(x.cos());
   }
 }
 exports.Sin = Sin;
@@ -263,15 +364,25 @@ exports.utilityFuncs.push(sin);
 
 class Cos extends Operation {
 
-  forward(x) {
+  forward(x, dest) {
     var X = x.data;
     this.saveForBackward(X);
-    return mathops.cos(x.data);
+    return mathops.cos(x.data, dest);
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var X = this.getSavedData();
-    return mathops.multiplyScale(outputDerivative, mathops.sin(X), -1);
+    if(!anySparse(outputDerivative, X))
+      return fusedBackward.cos(outputDerivative, X, dest);
+    return mathops.multiplyScale(outputDerivative, mathops.sin(X, dest), -1, dest);
+  }
+
+  expression(x) {
+    return x.cos();
+  }
+
+  derivativeExpression(g, [x], output, argIndex) {
+    return g.mul(x.sin()).neg();
   }
 }
 exports.Cos = Cos;
@@ -284,24 +395,34 @@ exports.utilityFuncs.push(cos);
 
 class Tan extends Operation {
 
-  forward(x) {
-    var tanX = mathops.tan(x.data);
+  forward(x, dest) {
+    var tanX = mathops.tan(x.data, dest);
     this.saveForBackward(tanX);
     return tanX;
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var tanX = this.getSavedData();
+    if(!anySparse(outputDerivative, tanX))
+      return fusedBackward.tan(outputDerivative, tanX, dest);
 
-    var tanXsquared = mathops.multiplyScale(tanX, tanX, 1);
+    var tanXsquared = mathops.multiplyScale(tanX, tanX, 1, dest);
     //re-use the storage of tanXsquared for the derivative.
-    var secXsquared = mathops.addScale(tanXsquared, 1, 1, 1);
+    var secXsquared = mathops.addScale(tanXsquared, 1, 1, 1, tanXsquared.sparse ? undefined : tanXsquared);
     var derivative = mathops.multiplyScale(outputDerivative,
                                        secXsquared,
                                        1,
                                        secXsquared);
     return derivative;
   }
+
+  expression(x) {
+    return x.tan();
+  }
+
+  derivativeExpression(g, inputs, output, argIndex) {
+    return g.mul(output.square().add(1));
+  }
 }
 exports.Tan = Tan;
 
@@ -318,11 +439,13 @@ class Sum extends Operation {
     return x.data.sum();
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var shape = this.getSavedData();
-    return mathops.multiplyScale(outputDerivative,
-                                tensor.onesLike(shape),
-                                1);
+    if(outputDerivative.sparse)
+      return mathops.multiplyScale(outputDerivative, tensor.onesLike(shape), 1, dest);
+    if(dest === undefined)
+      dest = tensor.zerosLike(shape, tensor.denseTensor.resultDataType(outputDerivative));
+    return fusedBackward.broadcast(outputDerivative, dest);
   }
 }
 exports.Sum = Sum;
@@ -335,14 +458,22 @@ exports.utilityFuncs.push(sum);
 
 class Log extends Operation {
 
-  forward(x) {
+  forward(x, dest) {
     this.saveForBackward(x.data);
-    return mathops.log(x.data);
+    return mathops.log(x.data, dest);
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var xdata = this.getSavedData();
-    return mathops.divideScale(outputDerivative, xdata, 1);
+    return mathops.divideScale(outputDerivative, xdata, 1, dest);
+  }
+
+  expression(x) {
+    return x.log();
+  }
+
+  derivativeExpression(g, [x], output, argIndex) {
+    return g.div(x);
   }
 }
 exports.Log = Log;
@@ -355,14 +486,24 @@ exports.utilityFuncs.push(log);
 
 class Abs extends Operation {
 
-  forward(x) {
+  forward(x, dest) {
     this.saveForBackward(x.data);
-    return mathops.abs(x.data);
+    return mathops.abs(x.data, dest);
   }
 
-  backward(outputDerivative, argIndex) {
+  backward(outputDerivative, argIndex, dest) {
     var xdata = this.getSavedData();
-    return mathops.sign(xdata).mul(outputDerivative);
+    if(!anySparse(outputDerivative, xdata))
+      return fusedBackward.abs(outputDerivative, xdata, dest);
+    return mathops.multiplyScale(mathops.sign(xdata, dest), outputDerivative, 1, dest);
+  }
+
+  expression(x) {
+    return x.abs();
+  }
+
+  derivativeExpression(g, [x], output, argIndex) {
+    return g.mul(x.sign());
   }
 }
 exports.Abs = Abs;
@@ -373,3 +514,83 @@ function abs(x) {
 exports.abs = abs;
 exports.utilityFuncs.push(abs);
 
+
+/**
+  * a loss of predictions against labels (a Variable, a tensor or a
+  * number), computed together with its gradient in one native pass by
+  * tensor.losses[name], where a graph of elementwise operations would
+  * make several passes and keep every intermediate. The labels are the
+  * second input, read on every forward pass, so a Tape replays the loss
+  * against whatever data a labels Variable holds then. logisticLoss and
+  * squaredLoss are differentiable with respect to labels of the shape of
+  * the predictions; other labels may not require gradients.
+  */
+class NativeLoss extends Operation {
+  constructor(name) {
+    super();
+    this.name = name;
+    this.lossFunction = tensor.losses[name];
+    this.gradient = undefined;
+  }
+
+  forwardWrapper(pred, labels) {
+    if(!(labels instanceof Variable))
+      labels = new Variable(labels, {requiresGrad: false});
+    return super.forwardWrapper(pred, labels);
+  }
+
+  forward(pred, labels, dest) {
+    if(labels.requiresGrad && (this.name === 'softmaxCrossEntropy' || !mathops.sameShape(pred.data, labels.data)))
+      throw new Error(this.name + ' is only differentiable with respect to labels of the shape of the predictions; ' +
+                      'pass labels that do not require gradients');
+    //a replaying Tape passes dest, and the gradient can be reused too.
+    var {loss, grad} = this.lossFunction(pred.data, labels.data, dest,
+                                         dest === undefined ? undefined : this.gradient);
+    this.gradient = grad;
+    this.saveForBackward([grad, pred.data, labels.data]);
+    return loss;
+  }
+
+  backward(outputDerivative, argIndex, dest) {
+    var [grad, preddata, labelsdata] = this.getSavedData();
+    //one derivative per row of the loss, for losses that reduce the last dimension.
+    if(outputDerivative instanceof tensor.Tensor && outputDerivative.totalSize() > 1 &&
+       outputDerivative.totalSize() < grad.totalSize()) {
+      outputDerivative = new tensor.Tensor({shape: [...outputDerivative.shape, 1],
+                                            data: outputDerivative.toDataType(outputDerivative.dtype).data,
+                                            dtype: outputDerivative.dtype});
+    }
+    if(argIndex === 0)
+      return mathops.multiplyScale(outputDerivative, grad, 1, dest);
+    //-(pred - label) for squaredLoss, and -pred / (1 + exp(label * pred)) for logisticLoss.
+    var labelGrad = this.name === 'squaredLoss' ? grad.scale(-1) :
+                    preddata.scale(-1).div(preddata.mul(labelsdata).exp().add(1));
+    return mathops.multiplyScale(outputDerivative, labelGrad, 1, dest);
+  }
+}
+exports.NativeLoss = NativeLoss;
+
+//log(1 + exp(-label * pred)) elementwise.
+function logisticLoss(pred, label) {
+  return (new NativeLoss('logisticLoss')).forwardWrapper(pred, label);
+}
+exports.logisticLoss = logisticLoss;
+exports.utilityFuncs.push(logisticLoss);
+
+//(pred - label)^2 / 2 elementwise.
+function squaredLoss(pred, label) {
+  return (new NativeLoss('squaredLoss')).forwardWrapper(pred, label);
+}
+exports.squaredLoss = squaredLoss;
+exports.utilityFuncs.push(squaredLoss);
+
+/**
+  * the cross entropy of the softmax of each row of logits (over their
+  * last dimension) against labels holding the class of each row or target
+  * probabilities with the shape of logits.
+  */
+function softmaxCrossEntropy(logits, labels) {
+  return (new NativeLoss('softmaxCrossEntropy')).forwardWrapper(logits, labels);
+}
+exports.softmaxCrossEntropy = softmaxCrossEntropy;
+exports.utilityFuncs.push(softmaxCrossEntropy);
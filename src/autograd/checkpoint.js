@@ -0,0 +1,68 @@
+/* jshint esversion: 6 */
+var tensor = require('../tensor');
+var variable = require('./variable');
+var Operation = variable.Operation;
+var Variable = variable.Variable;
+
+/**
+  * runs fn(...inputs) as a single operation: forward keeps the inputs and
+  * the output but none of the intermediates fn computes, and backward
+  * computes them again to differentiate fn.
+  */
+class Checkpoint extends Operation {
+  constructor(fn) {
+    super();
+    this.fn = fn;
+    this.inputGrads = undefined;
+  }
+
+  //fn of new Variables holding the data of inputs, cut from their graph.
+  run(inputData) {
+    var inputs = inputData.map((data, i) =>
+      new Variable(data, {requiresGrad: this.parents[i].requiresGrad}));
+    return {inputs, output: this.fn(...inputs)};
+  }
+
+  //a replaying Tape passes a dest after the inputs, which is ignored.
+  forward(...inputs) {
+    var inputData = inputs.slice(0, this.parents.length).map(input => input.data);
+    this.saveForBackward(inputData);
+    return this.run(inputData).output.data;
+  }
+
+  backward(outputDerivative, argIndex) {
+    //recompute once for all the inputs.
+    if(this.inputGrads === undefined || this.inputGrads.outputDerivative !== outputDerivative) {
+      let {inputs, output} = this.run(this.getSavedData());
+      output.backward(outputDerivative);
+      this.inputGrads = {outputDerivative, grads: inputs.map(input => input.grad)};
+    }
+    var grad = this.inputGrads.grads[argIndex];
+    if(!this.parents.slice(argIndex + 1).some(parent => parent.requiresGrad))
+      this.inputGrads = undefined;
+    if(grad === undefined)
+      grad = tensor.zerosLike(this.getSavedData()[argIndex]);
+    return grad;
+  }
+}
+exports.Checkpoint = Checkpoint;
+
+/**
+  * fn(...inputs), for a function of Variables returning a Variable, with
+  * gradient checkpointing: the intermediate results of fn are not kept
+  * for the backward pass but recomputed by it, for one more forward of fn.
+  * Splitting a chain of n steps into about sqrt(n) checkpointed segments
+  * keeps O(sqrt(n)) activations instead of O(n):
+  *
+  *   for(let s=0; s<n; s+=segment)
+  *     h = autograd.checkpoint((h, w) => steps(h, w, s, segment), h, w);
+  *
+  * Pass the parameters fn uses as inputs too: Variables it closes over
+  * get derivatives added to their grads by the recomputation, but are not
+  * part of the graph zeroGrad and tapes walk. fn must compute the same
+  * thing each time it is called, so draw random numbers outside of it.
+  */
+function checkpoint(fn, ...inputs) {
+  return (new Checkpoint(fn)).forwardWrapper(...inputs);
+}
+exports.checkpoint = checkpoint;
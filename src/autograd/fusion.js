@@ -0,0 +1,142 @@
+/* jshint esversion: 6 */
+var tensor = require('../tensor');
+var variable = require('./variable');
+var Operation = variable.Operation;
+
+var fused = tensor.fused;
+
+//larger groups are split, since derivative expressions grow with depth.
+var MAX_FUSED_OPERATIONS = 16;
+
+/**
+  * a group of elementwise operations replaced by one: forward evaluates
+  * the whole group in one fused native pass over its inputs, and the
+  * derivative with respect to each input is one more fused pass over the
+  * inputs and the output derivative, recomputing the intermediates inside
+  * the pass instead of keeping them.
+  */
+class FusedElementwise extends Operation {
+  constructor(forwardKernel, backwardKernels) {
+    super();
+    this.forwardKernel = forwardKernel;
+    this.backwardKernels = backwardKernels;
+  }
+
+  forward(...args) {
+    var inputData = args.slice(0, this.parents.length).map(input => input.data);
+    this.saveForBackward(inputData);
+    return this.forwardKernel(...inputData, args[this.parents.length]);
+  }
+
+  backward(outputDerivative, argIndex, dest) {
+    return this.backwardKernels[argIndex](...this.getSavedData(), outputDerivative, dest);
+  }
+}
+exports.FusedElementwise = FusedElementwise;
+
+//the Expression of op's output on symbolic inputs, if op can be fused.
+function expressionOf(op, inputs) {
+  if(typeof op.expression !== 'function')
+    return undefined;
+  if(!op.parents.every(parent => parent.data instanceof tensor.Tensor))
+    return undefined;
+  var expression = op.expression(...inputs);
+  return expression instanceof fused.Expression ? expression : undefined;
+}
+
+/**
+  * replaces, in the graph computing loss, every tree of two or more
+  * elementwise operations (those with expression() and
+  * derivativeExpression(), on dense inputs) whose intermediate results are
+  * used by nothing but the next operation of the tree, with a single
+  * FusedElementwise operation. The outputs and derivatives it computes
+  * are those of the operations it replaces, and the graph's leaves and
+  * output are unchanged. Returns the number of operations replaced.
+  */
+function fuseElementwise(loss) {
+  var ops = variable.topologicalOrder(loss, true);
+  var uses = new Map([[loss, 1]]);
+  for(let op of ops)
+    op.parents.forEach(parent => uses.set(parent, (uses.get(parent) || 0) + 1));
+  var consumers = new Map();
+  for(let op of ops)
+    op.parents.forEach(parent => consumers.set(parent, op));
+
+  //ops come consumers first, so each op can join the group of its consumer.
+  var groupOf = new Map();
+  var groups = [];
+  for(let op of ops) {
+    if(expressionOf(op, fused.inputExpressions(op.parents.length)) === undefined)
+      continue;
+    let output = op.child;
+    let group = groupOf.get(consumers.get(output));
+    if(group === undefined || uses.get(output) !== 1 || output.stopGrad || !output.requiresGrad ||
+       group.ops.length >= MAX_FUSED_OPERATIONS) {
+      group = {root: op, ops: []};
+      groups.push(group);
+    }
+    group.ops.push(op);
+    groupOf.set(op, group);
+  }
+
+  var replaced = 0;
+  for(let group of groups) {
+    if(group.ops.length < 2)
+      continue;
+    replace(group);
+    replaced += group.ops.length;
+  }
+  return replaced;
+}
+exports.fuseElementwise = fuseElementwise;
+
+function replace(group) {
+  var members = new Set(group.ops);
+  var produced = new Set(group.ops.map(op => op.child));
+  var inputs = [];
+  for(let op of group.ops) {
+    op.parents.forEach(parent => {
+      if(!produced.has(parent) && inputs.indexOf(parent) === -1)
+        inputs.push(parent);
+    });
+  }
+
+  //the value of every variable of the group, and the output derivative g.
+  var symbols = fused.inputExpressions(inputs.length + 1);
+  var g = symbols[inputs.length];
+  var values = new Map(inputs.map((input, i) => [input, symbols[i]]));
+  var valueOf = v => {
+    if(!values.has(v)) {
+      let op = v.parent;
+      values.set(v, expressionOf(op, op.parents.map(valueOf)));
+    }
+    return values.get(v);
+  };
+  var output = valueOf(group.root.child);
+
+  //reverse mode over the group, consumers first as group.ops are.
+  var derivatives = new Map([[group.root.child, g]]);
+  for(let op of group.ops) {
+    let outputDerivative = derivatives.get(op.child);
+    let parentValues = op.parents.map(valueOf);
+    op.parents.forEach((parent, i) => {
+      if(!parent.requiresGrad)
+        return;
+      let derivative = op.derivativeExpression(outputDerivative, parentValues, valueOf(op.child), i);
+      let sum = derivatives.get(parent);
+      derivatives.set(parent, sum === undefined ? derivative : sum.add(derivative));
+    });
+  }
+
+  var forwardKernel = fused.compileExpression(output, inputs.length);
+  var backwardKernels = inputs.map(input => input.requiresGrad ?
+    fused.compileExpression(derivatives.get(input) || g.mul(0), inputs.length + 1) : undefined);
+
+  var op = new FusedElementwise(forwardKernel, backwardKernels);
+  op.parents = inputs;
+  op.child = group.root.child;
+  op.child.parent = op;
+  op.saveForBackward(inputs.map(input => input.data));
+  for(let member of members)
+    member.saveForBackward({});
+}
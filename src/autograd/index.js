@@ -2,6 +2,9 @@
 
 var autogradOps = require('./autogradOps');
 var variable = require('./variable');
+var tape = require('./tape');
+var checkpoint = require('./checkpoint');
+var fusion = require('./fusion');
 
 function firstArgisThis(func) {
   return function() {
@@ -20,6 +23,11 @@ Object.assign(exports, variable);
 for(let key in variable) {
   exports[key] = variable[key];
 }
+exports.Tape = tape.Tape;
+exports.Checkpoint = checkpoint.Checkpoint;
+exports.checkpoint = checkpoint.checkpoint;
+exports.FusedElementwise = fusion.FusedElementwise;
+exports.fuseElementwise = fusion.fuseElementwise;
 
 
 for (let i=0; i<autogradOps.utilityFuncs.length; i++) {
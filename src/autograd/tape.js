@@ -0,0 +1,228 @@
+/* jshint esversion: 6 */
+var tensor = require('../tensor');
+var variable = require('./variable');
+var fusion = require('./fusion');
+
+/**
+  * records the graph a loss function builds and replays it.
+  *
+  * lossFunc() should build the loss from Variables it closes over and
+  * return it. The first run() calls it and records its operations along
+  * with the shape, dtype and sparsity of every leaf Variable. Later runs
+  * do not call it: they re-run the recorded operations' forward and
+  * backward on the current data of the leaves, so that a training loop
+  * neither builds a graph nor allocates most of its tensors on each step.
+  * A leaf whose data changed shape, dtype or sparsity makes run() capture
+  * the graph again.
+  *
+  * Replays write every intermediate result to memory planned when the
+  * graph is captured: each dense tensor the tape computes lives from the
+  * step that computes it to the last step that reads it, and tensors
+  * whose lifetimes do not overlap share a buffer from a pool. The saved
+  * data of an operation is released as soon as its backward has run.
+  * memory describes the plan: {values, buffers, naiveBytes,
+  * plannedBytes}, where naiveBytes is what keeping every intermediate for
+  * the whole step takes, as building the graph does. Planning assumes
+  * that an Operation's backward reads nothing but its outputDerivative
+  * and what its forward saved.
+  *
+  * So only the data of the loss and the grads of the leaves are kept
+  * after run(), and only until the next run(): copy them to keep them.
+  * Inputs that change between steps must be Variables whose data is
+  * replaced (v.data = batch), not new Variables made inside lossFunc,
+  * which a replay would not see.
+  *
+  * Unless opts.fuse is false, captured graphs are rewritten so that
+  * chains of elementwise operations run as single fused operations
+  * (see fusion.js): their intermediate results are neither stored nor
+  * planned.
+  */
+class Tape {
+  constructor(lossFunc, opts) {
+    opts = Object.assign({fuse: true}, opts);
+    this.lossFunc = lossFunc;
+    this.fuse = opts.fuse;
+    this.loss = undefined;
+    this.memory = undefined;
+  }
+
+  /**
+    * computes the loss, and sets the grad of every leaf it depends on to
+    * the derivative of the loss, replacing earlier grads as zeroGrad()
+    * followed by backward() would. Returns the loss Variable.
+    */
+  run() {
+    if(this.loss === undefined ||
+       !this.leaves.every((leaf, i) => sameLayout(leaf.data, this.layouts[i]))) {
+      this.capture();
+    } else {
+      this.replay();
+    }
+    return this.loss;
+  }
+
+  /**
+    * builds the graph and differentiates it, recording every step in
+    * events, then plans the memory of the replays.
+    */
+  capture() {
+    this.loss = this.lossFunc();
+    if(this.fuse)
+      fusion.fuseElementwise(this.loss);
+    var forwardOps = variable.topologicalOrder(this.loss, true).reverse();
+    var variables = new Set([this.loss]);
+    for(let op of forwardOps)
+      op.parents.forEach(parent => variables.add(parent));
+    this.variables = [...variables];
+    this.leaves = this.variables.filter(v => v.parent === undefined);
+    this.layouts = this.leaves.map(layout);
+
+    //lossFunc has run the forward steps.
+    this.events = forwardOps.map(op => ({op, forward: true}));
+    var gradients = new Map([[this.loss, 1.0]]);
+    for(let op of variable.topologicalOrder(this.loss, false)) {
+      let outputDerivative = gradients.get(op.child);
+      if(outputDerivative === undefined)
+        continue;
+      let event;
+      op.parents.forEach((parent, i) => {
+        if(!parent.requiresGrad)
+          return;
+        event = {op, index: i, parent, outputDerivative, saved: savedTensors(op)};
+        event.result = op.backward(outputDerivative, i);
+        let sum = gradients.get(parent);
+        event.accumulate = sum !== undefined;
+        if(event.accumulate) {
+          event.terms = [sum, event.result];
+          event.sum = tensor.addScale(sum, event.result, 1, 1);
+        }
+        gradients.set(parent, event.accumulate ? event.sum : event.result);
+        this.events.push(event);
+      });
+      if(event !== undefined)
+        event.releases = true;
+      op.saveForBackward({});
+    }
+    this.plan(gradients);
+    this.setGrads(gradients);
+  }
+
+  replay() {
+    var gradients = new Map([[this.loss, 1.0]]);
+    for(let event of this.events) {
+      let op = event.op;
+      if(event.forward) {
+        let output = op.forward(...op.parents, event.dest);
+        if(!(output instanceof tensor.Tensor) && !(output instanceof tensor.SparseVector))
+          output = new tensor.Tensor(output);
+        op.child.data = output;
+        continue;
+      }
+      let derivative = op.backward(gradients.get(op.child), event.index, event.dest);
+      if(event.accumulate)
+        derivative = tensor.addScale(gradients.get(event.parent), derivative, 1, 1, event.sumDest);
+      gradients.set(event.parent, derivative);
+      if(event.releases)
+        op.saveForBackward({});
+    }
+    this.setGrads(gradients);
+  }
+
+  setGrads(gradients) {
+    this.variables.forEach(v => { v.grad = undefined; });
+    for(let v of this.leaves.concat([this.loss]))
+      v.grad = gradients.get(v);
+  }
+
+  /**
+    * gives every dense tensor the captured run computed a destination in
+    * the pool for replays (event.dest for the result of a step,
+    * event.sumDest for its sum), by the times of the steps that compute
+    * and read it. Results that are not new, like the output derivative Add
+    * passes on, extend the lifetime of the tensor they are.
+    */
+  plan(gradients) {
+    var values = new Map();
+    var known = new Set(this.leaves.map(leaf => leaf.data));
+    var time = 0;
+    var use = t => {
+      var value = values.get(t);
+      if(value !== undefined)
+        value.last = time;
+    };
+    var define = (t, event, key) => {
+      if(!(t instanceof tensor.Tensor) || known.has(t))
+        return;
+      known.add(t);
+      values.set(t, {first: time, last: time, event, key, shape: [...t.shape], dtype: t.dtype});
+    };
+
+    for(let event of this.events) {
+      if(event.forward) {
+        event.op.parents.forEach(parent => use(parent.data));
+        define(event.op.child.data, event, 'dest');
+      } else {
+        use(event.outputDerivative);
+        event.saved.forEach(use);
+        define(event.result, event, 'dest');
+        if(event.accumulate) {
+          time++;
+          event.terms.forEach(use);
+          define(event.sum, event, 'sumDest');
+        }
+      }
+      time++;
+      ['outputDerivative', 'saved', 'result', 'terms', 'sum'].forEach(key => { delete event[key]; });
+    }
+    time = Infinity;
+    use(this.loss.data);
+    this.leaves.forEach(leaf => use(gradients.get(leaf)));
+
+    //values come in the order they are computed.
+    var free = new Map();
+    var live = [];
+    var buffers = 0;
+    var naiveBytes = 0;
+    var plannedBytes = 0;
+    for(let value of values.values()) {
+      live = live.filter(other => {
+        if(other.last >= value.first)
+          return true;
+        free.get(other.key).push(other.buffer);
+        return false;
+      });
+      let size = value.shape.reduce((a, b) => a * b, 1);
+      let bytes = size * (value.dtype === 'float32' ? 4 : 8);
+      let key = value.dtype + ':' + size;
+      if(!free.has(key))
+        free.set(key, []);
+      let buffer = free.get(key).pop();
+      if(buffer === undefined) {
+        buffer = tensor.zerosLike([size], value.dtype);
+        buffers++;
+        plannedBytes += bytes;
+      }
+      naiveBytes += bytes;
+      value.event[value.key] = new tensor.Tensor({shape: value.shape, data: buffer.data, dtype: value.dtype});
+      live.push({last: value.last, key, buffer});
+    }
+    this.memory = {values: values.size, buffers, naiveBytes, plannedBytes};
+  }
+}
+exports.Tape = Tape;
+
+//the tensors an operation saved for its backward.
+function savedTensors(op) {
+  var saved = op.getSavedData();
+  return (saved instanceof Array ? saved : [saved]).filter(t => t instanceof tensor.Tensor);
+}
+
+function layout(v) {
+  return {sparse: v.data instanceof tensor.SparseVector, dtype: v.data.dtype, shape: [...v.data.shape]};
+}
+
+function sameLayout(data, expected) {
+  return (data instanceof tensor.SparseVector) === expected.sparse && data.dtype === expected.dtype &&
+         data.shape.length === expected.shape.length &&
+         expected.shape.every((size, i) => data.shape[i] === size);
+}
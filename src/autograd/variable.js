@@ -23,28 +23,141 @@ class Variable {
     this.children = [];
   }
 
+  /**
+    * adds the derivative of this variable (1 by default) times the
+    * derivatives of everything it was computed from to their grads.
+    *
+    * The graph is sorted topologically once, so that every Operation runs
+    * its backward exactly once, after all the derivatives of its output
+    * have been summed into one buffer. A variable that feeds several
+    * operations is therefore not re-traversed once per path.
+    */
   backward(derivative) {
     if(derivative === undefined) {
       derivative = 1.0;
     }
-    if(this.grad === undefined) {
-      this.grad = derivative;
-    } else {
-      tensor.addScale(this.grad, derivative, 1, this.grad);
+    var gradients = new Map();
+    accumulate(gradients, this, derivative);
+    for(let op of topologicalOrder(this, false)) {
+      let output = op.child;
+      let entry = gradients.get(output);
+      if(entry === undefined)
+        continue;
+      let inputDerivatives = op.backwardWrapper(summed(entry));
+      op.parents.forEach((parent, i) => {
+        if(parent.requiresGrad)
+          accumulate(gradients, parent, inputDerivatives[i]);
+      });
     }
 
-    if(this.parent !== undefined && !this.stopGrad)
-      this.parent.backwardWrapper(derivative);
+    for(let [variable, entry] of gradients) {
+      let gradient = summed(entry);
+      if(variable.grad === undefined)
+        variable.grad = gradient;
+      else
+        variable.grad = tensor.addScale(variable.grad, gradient, 1, 1);
+    }
   }
 
   zeroGrad() {
     this.grad = undefined;
-    if(this.parent !== undefined)
-      this.parent.zeroGrad();
+    for(let op of topologicalOrder(this, true)) {
+      op.parents.forEach(parent => { parent.grad = undefined; });
+    }
   }
 }
 exports.Variable = Variable;
 
+/**
+  * the Operations root was computed from, each once, ordered so that every
+  * operation comes before the ones that computed its inputs. Unless all is
+  * set, the graph is cut at variables with stopGrad or without
+  * requiresGrad, through which no derivatives flow. The search keeps its
+  * own stack, so deep graphs do not overflow the call stack.
+  */
+function topologicalOrder(root, all) {
+  var follows = v => v.parent !== undefined && (all || (!v.stopGrad && v.requiresGrad));
+  var order = [];
+  var visited = new Set();
+  var stack = [];
+  if(follows(root)) {
+    visited.add(root.parent);
+    stack.push({op: root.parent, next: 0});
+  }
+  while(stack.length > 0) {
+    let top = stack[stack.length - 1];
+    if(top.next < top.op.parents.length) {
+      let parent = top.op.parents[top.next++];
+      if(follows(parent) && !visited.has(parent.parent)) {
+        visited.add(parent.parent);
+        stack.push({op: parent.parent, next: 0});
+      }
+    } else {
+      order.push(stack.pop().op);
+    }
+  }
+  return order.reverse();
+}
+exports.topologicalOrder = topologicalOrder;
+
+/**
+  * adds derivative to the gradient being summed for variable. The first
+  * derivative is kept as it is, since ops may return tensors they share
+  * (Add passes its output derivative to both inputs); the second sums into
+  * a new buffer, which later ones are added to in place.
+  *
+  * Sparse derivatives, like the one Dot gives the weights a SparseVector
+  * feature is multiplied with, are added in place to a dense buffer the
+  * sum owns, touching only their nonzeros. Otherwise they are kept aside
+  * and summed by summed(), so that a gradient made only of sparse terms
+  * stays a SparseVector.
+  */
+function accumulate(gradients, variable, derivative) {
+  var entry = gradients.get(variable);
+  if(entry === undefined) {
+    entry = {gradient: undefined, owned: false, sparseTerms: []};
+    gradients.set(variable, entry);
+  }
+  var gradient = entry.gradient;
+  if(derivative instanceof tensor.SparseVector &&
+     !(entry.owned && gradient.numDimensions === 1 &&
+       (derivative.length === undefined || derivative.length === gradient.shape[0]))) {
+    entry.sparseTerms.push(derivative);
+    return;
+  }
+  if(gradient === undefined) {
+    entry.gradient = derivative;
+    return;
+  }
+  if(entry.owned && (derivative instanceof tensor.SparseVector ||
+     (derivative instanceof tensor.Tensor && tensor.mathops.sameShape(gradient, derivative) &&
+      tensor.denseTensor.resultDataType(gradient, derivative) === gradient.dtype))) {
+    tensor.addScale(gradient, derivative, 1, 1, gradient);
+    return;
+  }
+  entry.gradient = tensor.addScale(gradient, derivative, 1, 1);
+  entry.owned = entry.gradient instanceof tensor.Tensor;
+}
+
+/**
+  * the gradient an entry of accumulate() sums to. Its sparse terms are
+  * merged pairwise, so that summing k of them copies every nonzero
+  * O(log k) times rather than up to k times.
+  */
+function summed(entry) {
+  if(entry.sparseTerms.length > 0) {
+    let sparseSum = tensor.sparseTensor.sumAll(entry.sparseTerms);
+    entry.sparseTerms = [];
+    if(entry.gradient === undefined) {
+      entry.gradient = sparseSum;
+    } else {
+      entry.gradient = tensor.addScale(entry.gradient, sparseSum, 1, 1);
+      entry.owned = entry.gradient instanceof tensor.Tensor;
+    }
+  }
+  return entry.gradient;
+}
+
 
 
 //base class for operations
@@ -83,36 +196,39 @@ class Operation {
       this.parents.push(arg);
     }
     var output = this.forward(...arguments);
+    //derivatives flow into the output only if they flow out of it.
     if(!(output instanceof Variable))
-      output = new Variable(output);
+      output = new Variable(output, {requiresGrad: this.parents.some(parent => parent.requiresGrad)});
     output.parent = this;
     this.child = output;
     return output;
   }
 
+  /**
+    * the derivatives of the loss with respect to each input, given the one
+    * with respect to the output: entry i is undefined for inputs that do
+    * not require gradients.
+    */
   backwardWrapper(outputDerivative) {
-    var inputDerivatives = {};
+    var inputDerivatives = [];
     for(let i=0; i<this.parents.length; i++) {
       if(this.parents[i].requiresGrad) {
         inputDerivatives[i] = this.backward(outputDerivative, i);
       }
     }
-
-    for(let i = 0; i<this.parents.length; i++) {
-      if(this.parents[i].requiresGrad) {
-        this.parents[i].backward(inputDerivatives[i]);
-      }
-    }
+    return inputDerivatives;
   }
 
   zeroGrad() {
-    for(let i = 0; i<this.parents.length; i++)
-      this.parents[i].zeroGrad();
+    this.child.zeroGrad();
   }
 
   /**
     * should take some number of arguments of type Variable.
     * should return exactly one Variable.
+    * A Tape replaying the operation passes one more argument, a tensor of
+    * the shape of the last output to write the new one to; operations may
+    * ignore it and return a new tensor instead.
     * TODO: think about operations with fan-out
     */
   forward() {
@@ -129,10 +245,21 @@ class Operation {
     * 
     * Should return a tensor corresponding to the derivative of
     * the loss with respect to the argIndex'th input to this.forward.
+    * As in forward, a replaying Tape passes a dest tensor the result may
+    * be written to.
     */
   backward(outputDerivative, argIndex) {
     throw new Error('Backward Not Implemented!');
   }
+
+  /*
+    * Elementwise operations may also define expression(...inputs), their
+    * output as a tensor.fused Expression of Expressions for their inputs
+    * (or undefined if it cannot be fused), and
+    * derivativeExpression(g, inputs, output, argIndex), the Expression for
+    * the derivative with respect to input argIndex given g, the one for
+    * the output. Tapes fuse chains of them (see fusion.js).
+    */
 }
 exports.Operation = Operation;
 
@@ -1,11 +1,31 @@
 /* jshint esversion: 6 */
 
+var autograd = require('../autograd');
+var tensor = require('../tensor');
+
+/**
+  * losses of predictions against labels, each computed with its gradient
+  * in one native pass. A Variable pred gives a Variable to differentiate,
+  * and a Tensor a Tensor.
+  */
+
 function logisticLoss(pred, label) {
-  return pred.scale(-label).exp().add(1.0).log();
+  if(pred instanceof autograd.Variable)
+    return autograd.logisticLoss(pred, label);
+  return tensor.losses.logisticLoss(pred, label).loss;
 }
 exports.logisticLoss = logisticLoss;
 
 function squaredLoss(pred, label) {
-  return pred.sub(label).square().scale(0.5);
+  if(pred instanceof autograd.Variable)
+    return autograd.squaredLoss(pred, label);
+  return tensor.losses.squaredLoss(pred, label).loss;
+}
+exports.squaredLoss = squaredLoss;
+
+function softmaxCrossEntropy(logits, labels) {
+  if(logits instanceof autograd.Variable)
+    return autograd.softmaxCrossEntropy(logits, labels);
+  return tensor.losses.softmaxCrossEntropy(logits, labels).loss;
 }
-exports.squaredLoss = squaredLoss;
\ No newline at end of file
+exports.softmaxCrossEntropy = softmaxCrossEntropy;
@@ -2,6 +2,8 @@
 
 
 optim = require('./optimizer');
+var tensor = require('../tensor');
+var kernels = require('./kernels');
 
 class SGD extends optim.Optimizer {
   constructor(opts) {
@@ -12,8 +14,14 @@ class SGD extends optim.Optimizer {
 
   applyGrads(vars) {
     this.t += 1;
+    var stepSize = this.lr/Math.sqrt(this.t);
     for(let v of vars) {
-      v.data = v.data.add(v.grad.scale(-this.lr/Math.sqrt(this.t)));
+      //coordinates a sparse grad does not hold would not move, and the
+      //decayed step size is that of the step they are updated at.
+      if(optim.sparseGrad(v) !== undefined)
+        tensor.addScale(v.data, v.grad, 1, -stepSize, v.data);
+      else if(!kernels.sgd(v.data, v.grad, stepSize))
+        v.data = v.data.add(v.grad.scale(-stepSize));
     }
   }
 }
@@ -3,6 +3,8 @@
 
 optim = require('./optimizer');
 tensor = require('../tensor');
+var kernels = require('./kernels');
+var slots = require('./slots');
 
 var EPSILON = 0.000001;
 
@@ -22,6 +24,11 @@ class AdaGrad extends optim.Optimizer {
     this.t += 1;
     for(let v of vars) {
       var sumGradSq = this.getSlot(v, 'sumGradSq');
+      //the coordinates a sparse grad does not hold would not change.
+      var grad = optim.sparseGrad(v) || v.grad;
+      if(kernels.adaGrad(v.data, grad, sumGradSq, this.lr))
+        continue;
+      sumGradSq = slots.asTensor(sumGradSq, v.data.dtype);
       sumGradSq = tensor.addScale(v.grad.square(), sumGradSq, 1, 1, sumGradSq);
       v.data = v.data.add(v.grad.divideScale(sumGradSq.sqrt(), -this.lr));
       this.setSlot(v, 'sumGradSq', sumGradSq);
@@ -3,13 +3,30 @@
 
 optim = require('./optimizer');
 tensor = require('../tensor');
+var kernels = require('./kernels');
+var slots = require('./slots');
 
 var EPSILON = 0.000001;
 
+//-sign(sumGrad) * (exp(lr * |previous sumGrad| / sqrt(oneOverEtaSq)) - 1), for
+//the updates the native kernel does not take.
+var freeRexWeights = tensor.fused.compile((sumGrad, absSumGrad, oneOverEtaSq, lr) =>
+  sumGrad.sign().neg().mul(absSumGrad.div(oneOverEtaSq.sqrt()).mul(lr).exp().sub(1)));
+
+/**
+  * Updates with a sparse grad touch only the coordinates it holds and
+  * those the previous update gave a nonzero gradient: a coordinate's
+  * first step with a zero gradient still changes its oneOverEtaSq and
+  * weight, as they lag its sumGrad by a step, but later ones do not. So
+  * the weights are those of dense updates after every step.
+  */
 class FreeRex extends optim.Optimizer {
   constructor(opts) {
     super(opts);
     this.lr = opts.lr || 0.45;
+    //v -> the SparseVector of the coordinates the last update of v moved,
+    //or undefined after a dense update.
+    this.moved = new Map();
   }
 
   makeSlots(vars) {
@@ -27,24 +44,47 @@ class FreeRex extends optim.Optimizer {
       var oneOverEtaSq = this.getSlot(v, 'oneOverEtaSq');
       var Lmax = this.getSlot(v, 'Lmax');
 
-      var absGrad = v.grad.abs();
+      var grad = optim.sparseGrad(v);
+      if(grad !== undefined && this.moved.get(v) !== undefined &&
+         this.applySparseGrad(v, grad, sumGrad, oneOverEtaSq, Lmax))
+        continue;
+      if(grad !== undefined) {
+        this.moved.set(v, grad.emptyLike());
+        grad = grad.toDense(v.data.shape[0]).toDataType(v.data.dtype);
+      } else {
+        this.moved.delete(v);
+        grad = v.grad;
+      }
+      if(kernels.freeRex(v.data, grad, sumGrad, oneOverEtaSq, Lmax, this.lr))
+        continue;
+      [sumGrad, oneOverEtaSq, Lmax] = [sumGrad, oneOverEtaSq, Lmax].map(slot => slots.asTensor(slot, v.data.dtype));
+
+      var absGrad = grad.abs();
       var gradSquared = absGrad.square();
       var absSumGrad = sumGrad.abs();
 
-      tensor.add(sumGrad, v.grad, sumGrad);
+      tensor.add(sumGrad, grad, sumGrad);
       tensor.max(Lmax, absGrad, Lmax);
 
       tensor.max(oneOverEtaSq.add(gradSquared.scale(2)), Lmax.mul(absSumGrad), oneOverEtaSq);
 
-      var direction = sumGrad.sign();
-      tensor.scale(direction, -1, direction);
-
-      direction.mul( tensor.exp(absSumGrad.divideScale(oneOverEtaSq.sqrt(), this.lr)).sub(1) , v.data);
+      freeRexWeights(sumGrad, absSumGrad, oneOverEtaSq, this.lr, v.data);
 
       this.setSlot(v, 'sumGrad', sumGrad);
       this.setSlot(v, 'oneOverEtaSq', oneOverEtaSq);
       this.setSlot(v, 'Lmax', Lmax);
     }
   }
+
+  //the dense update of the coordinates grad holds or the last update moved.
+  //False, with nothing changed, if the native kernel does not take the
+  //operands: the caller then updates densely.
+  applySparseGrad(v, grad, sumGrad, oneOverEtaSq, Lmax) {
+    var coordinates = tensor.sparseTensor.addScale(this.moved.get(v), grad, 0, 1);
+    if(!kernels.freeRex(v.data, coordinates, sumGrad, oneOverEtaSq, Lmax, this.lr))
+      return false;
+    this.moved.set(v, grad.emptyLike());
+    return true;
+  }
 }
 module.exports = FreeRex;
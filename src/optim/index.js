@@ -4,11 +4,13 @@ var optimizer = require('./optimizer');
 var SGD = require('./SGD');
 var AdaGrad = require('./adagrad');
 var FreeRex = require('./freerex');
+var slots = require('./slots');
 
 
 module.exports = {
   optimizer,
   SGD,
   AdaGrad,
-  FreeRex
+  FreeRex,
+  slots
 };
\ No newline at end of file
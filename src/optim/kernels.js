@@ -0,0 +1,67 @@
+/* jshint esversion: 6 */
+
+var tensor = require('../tensor');
+var slots = require('./slots');
+var tensorBinding = require('../../build/Release/tensorBinding');
+
+/**
+  * the native single-pass updates of csrc/optimizers.h, which read the
+  * gradient and write the weights and slots in place without allocating
+  * anything. Each returns false, leaving everything as it was, unless the
+  * weights are a row-major tensor, the slots row-major tensors or
+  * QuantizedSlots of as many values, and the grad a tensor of as many
+  * values or a SparseVector over a vector of weights; the optimizers then
+  * fall back to tensor ops. Grads that are not row-major are copied.
+  */
+
+var isRowMajor = tensor.denseTensor.isRowMajor;
+
+function fits(weights, grad, slotValues) {
+  if(!(weights instanceof tensor.Tensor) || !isRowMajor(weights))
+    return false;
+  var size = weights.totalSize();
+  if(grad instanceof tensor.SparseVector) {
+    if(weights.numDimensions !== 1 || (grad.nnz > 0 && grad.indices[grad.nnz - 1] >= size))
+      return false;
+  } else if(!(grad instanceof tensor.Tensor) || grad.totalSize() !== size) {
+    return false;
+  }
+  return slotValues.every(slot => slot instanceof slots.QuantizedSlot ? slot.totalSize() === size :
+                                  slot instanceof tensor.Tensor && slot.totalSize() === size && isRowMajor(slot));
+}
+
+function update(kernel, weights, grad, slotValues, rate) {
+  if(!fits(weights, grad, slotValues))
+    return false;
+  if(grad instanceof tensor.Tensor && !isRowMajor(grad))
+    grad = grad.toDataType(grad.dtype);
+  tensor.lazy.beforeWrite(weights);
+  slotValues.forEach(slot => {
+    if(slot instanceof slots.QuantizedSlot)
+      slot.seed++;
+    else
+      tensor.lazy.beforeWrite(slot);
+  });
+  kernel(weights, grad, ...slotValues, rate);
+  return true;
+}
+
+//weights -= stepSize * grad, for a dense grad.
+function sgd(weights, grad, stepSize) {
+  if(grad instanceof tensor.SparseVector)
+    return false;
+  return update(tensorBinding.sgdUpdate, weights, grad, [], stepSize);
+}
+exports.sgd = sgd;
+
+//sumGradSq += grad^2, weights -= lr * grad / sqrt(sumGradSq)
+function adaGrad(weights, grad, sumGradSq, lr) {
+  return update(tensorBinding.adaGradUpdate, weights, grad, [sumGradSq], lr);
+}
+exports.adaGrad = adaGrad;
+
+//the FreeRex update of all the slots and the weights.
+function freeRex(weights, grad, sumGrad, oneOverEtaSq, Lmax, lr) {
+  return update(tensorBinding.freeRexUpdate, weights, grad, [sumGrad, oneOverEtaSq, Lmax], lr);
+}
+exports.freeRex = freeRex;
@@ -1,28 +1,65 @@
 /* jshint esversion: 6 */
 
+var tensor = require('../tensor');
+var Tape = require('../autograd/tape').Tape;
+var slots = require('./slots');
 
-//base class for optimizers
+/**
+  * base class for optimizers.
+  *
+  * opts.slotType sets how the state kept per weight (the slots) is stored:
+  * 'float64', 'float32', or 'int8' for 8-bit values quantized in blocks
+  * (see slots.QuantizedSlot), which only the native updates of dense
+  * row-major variables read. By default slots are stored as they are made.
+  */
 class Optimizer {
   constructor(opts) {
     this.vars = opts.vars;
+    this.slotType = opts.slotType;
     this.slots = new Map();
+    this.tapes = new WeakMap();
     this.makeSlots(this.vars);
   }
 
+  /**
+    * loss is either a Variable, whose graph is differentiated, or a
+    * function returning one: then the graph it builds is captured on a
+    * Tape by the first step and replayed by the following ones, so pass
+    * the same function every time (see autograd.Tape).
+    */
   step(loss, vars) {
-    loss.zeroGrad();
-    loss.backward();
+    if(loss instanceof Function) {
+      if(!this.tapes.has(loss))
+        this.tapes.set(loss, new Tape(loss));
+      this.tapes.get(loss).run();
+    } else {
+      loss.zeroGrad();
+      loss.backward();
+    }
     if(vars === undefined)
       vars = this.vars;
     this.applyGrads(vars);
   }
 
   setSlot(v, name, value) {
+    value = slots.store(value, this.slotType);
+    if(value instanceof slots.QuantizedSlot && !(v.data instanceof tensor.Tensor))
+      throw new Error('8-bit slots need dense variables');
     if(this.slots.get(v) === undefined)
       this.slots.set(v, new Map());
     this.slots.get(v).set(name, value);
   }
 
+  //the bytes all the slots take.
+  slotBytes() {
+    var total = 0;
+    for(let named of this.slots.values()) {
+      for(let slot of named.values())
+        total += slots.bytes(slot);
+    }
+    return total;
+  }
+
   makeSlots(vars) {
   }
 
@@ -34,4 +71,24 @@ class Optimizer {
     return this.slots.get(v).get(name);
   }
 }
-exports.Optimizer = Optimizer;
\ No newline at end of file
+exports.Optimizer = Optimizer;
+
+/**
+  * v.grad if it is a SparseVector that an update can apply to the
+  * coordinates it holds alone: v.data is a dense vector with unit stride
+  * and an entry for each of them. undefined otherwise.
+  * The coordinates it does not hold are those a dense update would give a
+  * zero gradient, so optimizers bring them up to date lazily if at all.
+  */
+function sparseGrad(v) {
+  var grad = v.grad;
+  if(!(grad instanceof tensor.SparseVector) || !(v.data instanceof tensor.Tensor))
+    return undefined;
+  if(v.data.numDimensions !== 1 || v.data.strides[0] !== 1)
+    return undefined;
+  if(grad.nnz > 0 && grad.indices[grad.nnz - 1] >= v.data.shape[0])
+    return undefined;
+  tensor.lazy.beforeWrite(v.data);
+  return grad;
+}
+exports.sparseGrad = sparseGrad;
@@ -0,0 +1,70 @@
+/* jshint esversion: 6 */
+
+var tensor = require('../tensor');
+var tensorBinding = require('../../build/Release/tensorBinding');
+
+//values share a scale per block of this many (SLOT_BLOCK_SIZE in csrc/optimizers.h).
+var BLOCK_SIZE = 256;
+
+/**
+  * optimizer state stored as 8 bits per value, with a float32 scale per
+  * block of BLOCK_SIZE values: about an eighth of the memory of float64
+  * values. See Slot in csrc/optimizers.h for the encoding, which rounds
+  * magnitudes down to 16 octaves below the largest of a block to one of
+  * the two levels around them, 9% apart, and smaller ones to the lowest
+  * level or zero, at random and without bias. The native optimizer updates
+  * dequantize and requantize it as they go; seed is advanced by every
+  * update, so that each rounds differently.
+  */
+class QuantizedSlot {
+  constructor(values) {
+    var size = values.totalSize();
+    this.shape = [...values.shape];
+    this.codes = new Uint8Array(size);
+    this.scales = new Float32Array(Math.ceil(size / BLOCK_SIZE));
+    this.seed = 0;
+    tensorBinding.copySlot(values, this);
+  }
+
+  totalSize() {
+    return this.codes.length;
+  }
+
+  //the values as a new tensor of the given dtype.
+  toTensor(dtype) {
+    var T = tensor.zerosLike(this.shape, dtype);
+    tensorBinding.copySlot(this, T);
+    return T;
+  }
+}
+exports.QuantizedSlot = QuantizedSlot;
+
+/**
+  * value, a tensor, stored as slotType: 'float64' or 'float32' for a
+  * tensor of that dtype, 'int8' for a QuantizedSlot, or undefined to keep
+  * it as it is.
+  */
+function store(value, slotType) {
+  if(slotType === undefined || value instanceof QuantizedSlot)
+    return value;
+  if(slotType === 'int8')
+    return new QuantizedSlot(value);
+  if(slotType !== 'float64' && slotType !== 'float32')
+    throw new Error('unknown slot type: ' + slotType);
+  return value.dtype === slotType ? value : value.toDataType(slotType);
+}
+exports.store = store;
+
+//slot as a tensor for tensor ops: a QuantizedSlot is dequantized to dtype.
+function asTensor(slot, dtype) {
+  return slot instanceof QuantizedSlot ? slot.toTensor(dtype) : slot;
+}
+exports.asTensor = asTensor;
+
+//the bytes the values of a slot take.
+function bytes(slot) {
+  if(slot instanceof QuantizedSlot)
+    return slot.codes.byteLength + slot.scales.byteLength;
+  return slot.totalSize() * (slot.dtype === 'float32' ? 4 : 8);
+}
+exports.bytes = bytes;
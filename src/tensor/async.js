@@ -0,0 +1,149 @@
+/* jshint esversion: 6 */
+
+/**
+  * Promise-returning variants of the heavy dense tensor ops.
+  *
+  * The work runs on the libuv thread pool instead of the event loop, so a
+  * large matMul or fill does not stall everything else the process is
+  * doing. Each function takes the same arguments as its synchronous
+  * counterpart and resolves to the same result:
+  *
+  *   tensor.async.matMul(A, B).then(C => ...);
+  *
+  * The tensors involved are kept alive until the promise settles, but their
+  * contents must not be modified in the meantime. Errors, including invalid
+  * arguments, are reported by rejecting the promise.
+  */
+
+var denseTensor = require('./denseTensor');
+var lazy = require('./lazy');
+var nodetensor = require('../../build/Release/tensorBinding');
+
+function rejectOnThrow(func) {
+  return function() {
+    try {
+      return func.apply(this, arguments);
+    } catch(error) {
+      return Promise.reject(error);
+    }
+  };
+}
+
+function toDense(source) {
+  if(source.sparse)
+    throw new Error('async ops only support dense tensors');
+  return denseTensor.numberToTensor(source);
+}
+
+function run(opname, args, dest) {
+  lazy.beforeWrite(dest);
+  return nodetensor[opname + 'Async'](...args).then(() => dest);
+}
+
+function elementwiseDest(source1, source2) {
+  return denseTensor.zerosLike(denseTensor.broadcastShape(source1, source2),
+                               denseTensor.resultDataType(source1, source2));
+}
+
+function contract(source1, source2, dimsToContract, dest) {
+  source1 = toDense(source1);
+  source2 = toDense(source2);
+  if(dest === undefined)
+    dest = denseTensor.contractDest(source1, source2, dimsToContract);
+  return run('contract', [source1, source2, dimsToContract, dest], dest);
+}
+exports.contract = rejectOnThrow(contract);
+
+function matMul(source1, source2, dest) {
+  return contract(source1, source2, 1, dest);
+}
+exports.matMul = rejectOnThrow(matMul);
+exports.dot = exports.matMul;
+
+function addScale(source1, source2, scale1, scale2, dest) {
+  source1 = toDense(source1);
+  source2 = toDense(source2);
+  if(dest === undefined)
+    dest = elementwiseDest(source1, source2);
+  return run('addScale', [source1, source2, scale1, scale2, dest], dest);
+}
+exports.addScale = rejectOnThrow(addScale);
+
+function multiplyScale(source1, source2, scale, dest) {
+  source1 = toDense(source1);
+  source2 = toDense(source2);
+  if(dest === undefined)
+    dest = elementwiseDest(source1, source2);
+  return run('multiplyScale', [source1, source2, scale, dest], dest);
+}
+exports.multiplyScale = rejectOnThrow(multiplyScale);
+
+function divideScale(source1, source2, scale, dest) {
+  source1 = toDense(source1);
+  source2 = toDense(source2);
+  if(dest === undefined)
+    dest = elementwiseDest(source1, source2);
+  return run('divideScale', [source1, source2, scale, dest], dest);
+}
+exports.divideScale = rejectOnThrow(divideScale);
+
+exports.add = rejectOnThrow((source1, source2, dest) => addScale(source1, source2, 1, 1, dest));
+exports.sub = rejectOnThrow((source1, source2, dest) => addScale(source1, source2, 1, -1, dest));
+exports.mul = rejectOnThrow((source1, source2, dest) => multiplyScale(source1, source2, 1, dest));
+exports.div = rejectOnThrow((source1, source2, dest) => divideScale(source1, source2, 1, dest));
+
+function scale(source, scale, dest) {
+  source = toDense(source);
+  if(dest === undefined)
+    dest = denseTensor.zerosLike(source);
+  return run('scale', [source, scale, dest], dest);
+}
+exports.scale = rejectOnThrow(scale);
+
+function fillNormal(mean, stdDev, dest) {
+  return run('fillNormal', [mean, stdDev, dest], dest);
+}
+exports.fillNormal = rejectOnThrow(fillNormal);
+
+function fillUniform(low, high, dest) {
+  return run('fillUniform', [low, high, dest], dest);
+}
+exports.fillUniform = rejectOnThrow(fillUniform);
+
+function sum(source) {
+  return nodetensor.sumAsync(toDense(source)).then(denseTensor.numberToTensor);
+}
+exports.sum = rejectOnThrow(sum);
+
+function exportOp(opname) {
+  exports[opname] = rejectOnThrow((source, dest) => {
+    source = toDense(source);
+    if(dest === undefined)
+      dest = denseTensor.zerosLike(source);
+    return run(opname, [source, dest], dest);
+  });
+}
+
+function exportBinaryOp(opname) {
+  exports[opname] = rejectOnThrow((source1, source2, dest) => {
+    source1 = toDense(source1);
+    source2 = toDense(source2);
+    if(dest === undefined)
+      dest = elementwiseDest(source1, source2);
+    return run(opname, [source1, source2, dest], dest);
+  });
+}
+
+['exp', 'abs', 'sqrt', 'sin', 'cos', 'tan', 'sinh', 'cosh', 'tanh', 'log',
+ 'atan', 'acos', 'asin', 'atanh', 'acosh', 'asinh', 'erf', 'floor', 'ceil',
+ 'round', 'sign'].forEach(exportOp);
+
+['max', 'min', 'pow', 'fmod'].forEach(exportBinaryOp);
+
+/**
+  * evaluates a fused program (see fused.js) on the thread pool.
+  */
+function fusedElementwise(code, constants, sources, dest) {
+  return run('fusedElementwise', [code, constants, sources, dest], dest);
+}
+exports.fusedElementwise = rejectOnThrow(fusedElementwise);
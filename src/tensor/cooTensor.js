@@ -0,0 +1,176 @@
+/* jshint esversion: 6 */
+
+var denseTensor = require('./denseTensor');
+var lazy = require('./lazy');
+var tensorBinding = require('../../build/Release/tensorBinding');
+
+var DimensionType = Uint32Array;
+var CoordType = Uint32Array;
+var ValueType = Float64Array;
+
+/**
+  * a sparse tensor of any rank in coordinate (COO) format: the k-th
+  * nonzero is values[k] at coordinates
+  * coords[k*numDimensions .. (k+1)*numDimensions), for k < nnz.
+  *
+  * Nonzeros may be added in any order and may repeat coordinates, in which
+  * case they add up. coalesce() sorts them into row-major order and merges
+  * repeats; contractions coalesce first. This is the layout of
+  * tensor::CooTensor in csrc/sparse.h.
+  *
+  * data is either a list of [coords, value] pairs or {coords, values, nnz},
+  * whose arrays are used as they are.
+  */
+class CooTensor {
+  constructor(shape, data) {
+    this.shape = new DimensionType(shape);
+    this.numDimensions = this.shape.length;
+    if(data !== undefined && data.coords !== undefined) {
+      this.coords = data.coords;
+      this.values = data.values;
+      this.nnz = data.nnz === undefined ? data.values.length : data.nnz;
+      this.coalesced = false;
+    } else {
+      this.setEntries(data === undefined ? [] : [...data]);
+    }
+    this.cooTensor = true;
+  }
+
+  setEntries(entries) {
+    this.coords = new CoordType(entries.length * this.numDimensions);
+    this.values = new ValueType(entries.length);
+    entries.forEach(([coords, value], k) => {
+      this.coords.set(coords, k * this.numDimensions);
+      this.values[k] = value;
+    });
+    this.nnz = entries.length;
+    this.coalesced = false;
+  }
+
+  totalSize() {
+    return this.shape.reduce((x, y) => x*y, 1);
+  }
+
+  coordsOf(k) {
+    return this.coords.subarray(k * this.numDimensions, (k+1) * this.numDimensions);
+  }
+
+  /**
+    * sorts the nonzeros into row-major order and sums repeated
+    * coordinates, in place. Returns this tensor.
+    */
+  coalesce() {
+    if(!this.coalesced) {
+      this.nnz = tensorBinding.cooCoalesce(this);
+      this.coalesced = true;
+    }
+    return this;
+  }
+
+  at(coords) {
+    var value = 0;
+    for(let k=0; k<this.nnz; k++) {
+      if(this.coordsOf(k).every((coord, d) => coord === coords[d]))
+        value += this.values[k];
+    }
+    return value;
+  }
+
+  //yields [coords, value] for every stored nonzero.
+  *entries() {
+    for(let k=0; k<this.nnz; k++) {
+      yield [[...this.coordsOf(k)], this.values[k]];
+    }
+  }
+
+  clone() {
+    var T = new CooTensor(this.shape, {
+      coords: this.coords.slice(0, this.nnz * this.numDimensions),
+      values: this.values.slice(0, this.nnz)
+    });
+    T.coalesced = this.coalesced;
+    return T;
+  }
+
+  //the tensor with its dimensions in reverse order, like Tensor.transpose().
+  transpose() {
+    var numDimensions = this.numDimensions;
+    var coords = new CoordType(this.nnz * numDimensions);
+    for(let k=0; k<this.nnz; k++) {
+      for(let d=0; d<numDimensions; d++) {
+        coords[k * numDimensions + d] = this.coords[k * numDimensions + numDimensions - 1 - d];
+      }
+    }
+    return new CooTensor(this.shape.slice(0).reverse(),
+                         {coords, values: this.values.slice(0, this.nnz)});
+  }
+
+  toDense(dtype) {
+    var T = denseTensor.zerosLike(this.shape, dtype);
+    for(let k=0; k<this.nnz; k++) {
+      let coords = [...this.coordsOf(k)];
+      T.set(coords, T.at(coords) + this.values[k]);
+    }
+    return T;
+  }
+
+  contract(other, dimsToContract, dest) {
+    return contract(this, other, dimsToContract, dest);
+  }
+
+  matMul(other, dest) {
+    return contract(this, other, 1, dest);
+  }
+}
+exports.CooTensor = CooTensor;
+
+//the nonzeros of a dense tensor as a coalesced CooTensor.
+function fromDense(tensor) {
+  var entries = [];
+  var coords = new Array(tensor.numDimensions).fill(0);
+  for(let i=0; i<tensor.totalSize(); i++) {
+    let value = tensor.at(coords);
+    if(value !== 0)
+      entries.push([coords.slice(0), value]);
+    for(let d=tensor.numDimensions-1; d>=0; d--) {
+      if(++coords[d] < tensor.shape[d])
+        break;
+      coords[d] = 0;
+    }
+  }
+  var T = new CooTensor(tensor.shape, entries);
+  T.coalesced = true;
+  return T;
+}
+exports.fromDense = fromDense;
+
+/**
+  * contract() with a CooTensor operand: the last dimsToContract dimensions
+  * of source1 against the first dimsToContract dimensions of source2, into
+  * a dense tensor. A dense source1 contracted with a sparse source2 is
+  * computed as the contraction of the transposes, written through a
+  * transposed view of dest.
+  */
+function contract(source1, source2, dimsToContract, dest) {
+  if(source1.cooTensor && source2.cooTensor)
+    source2 = source2.toDense();
+  if(dest === undefined)
+    dest = denseTensor.contractDest(source1, source2, dimsToContract);
+
+  if(source2.cooTensor) {
+    contract(source2.transpose(), denseTensor.numberToTensor(source1).transpose(), dimsToContract,
+             dest.numDimensions > 1 ? dest.transpose() : dest);
+    return dest;
+  }
+
+  source1.coalesce();
+  var dense = denseTensor.numberToTensor(source2);
+  //the kernel reads dense while it writes dest.
+  var target = dest.data === dense.data ? denseTensor.zerosLike(dest.shape, dest.dtype) : dest;
+  lazy.beforeWrite(dest);
+  tensorBinding.cooContract(source1, dense, dimsToContract, target);
+  if(target !== dest)
+    tensorBinding.scale(target, 1, dest);
+  return dest;
+}
+exports.contract = contract;
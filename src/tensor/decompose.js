@@ -0,0 +1,435 @@
+/* jshint esversion: 6 */
+
+var denseTensor = require('./denseTensor');
+var lazy = require('./lazy');
+var linalg = require('./linalg');
+var tensorBinding = require('../../build/Release/tensorBinding');
+
+/**
+  * CP and Tucker decompositions of dense tensors and CooTensors.
+  *
+  * The work of every iteration runs in the kernels of csrc/decompose.h:
+  * the matricized tensor times Khatri-Rao product (mttkrp) of CP-ALS and
+  * the tensor-times-matrix chains of Tucker/HOOI, on several threads (see
+  * setNumThreads), and the rank x rank solves of CP-ALS go through
+  * linalg.js. Everything is computed in float64.
+  *
+  * Kronecker and Khatri-Rao products, and products with a Kronecker
+  * product that never form it, are here as well.
+  */
+
+var isRowMajor = denseTensor.isRowMajor;
+var rowMajor = denseTensor.rowMajor;
+
+function elapsed(start) {
+  var [seconds, nanoseconds] = process.hrtime(start);
+  return seconds * 1e3 + nanoseconds / 1e6;
+}
+
+//the binding reads every entry of factors; the one for mode is a placeholder.
+function factorList(factors, mode) {
+  var placeholder = factors[mode === 0 ? 1 : 0];
+  return factors.map((factor, m) => m === mode && factor === undefined ? placeholder : factor);
+}
+
+/**
+  * the matricized tensor times Khatri-Rao product of X for mode:
+  *   dest[i, r] = sum of X[i_0, .., i, .., i_N-1] * prod_{m != mode} factors[m][i_m, r]
+  * for a dense tensor or a CooTensor X and factor matrices of equal rank
+  * (factors[mode] is not read and may be undefined). The Khatri-Rao
+  * product is never formed.
+  */
+function mttkrp(X, factors, mode, dest) {
+  factors = factorList(factors.map(factor => factor && rowMajor(factor)), mode);
+  if(!X.cooTensor)
+    X = rowMajor(X);
+  var rank = factors[mode === 0 ? 1 : 0].shape[1];
+  if(dest === undefined)
+    dest = denseTensor.zerosLike([X.shape[mode], rank], 'float64');
+  lazy.beforeWrite(dest);
+  tensorBinding.mttkrp(X, factors, mode, dest);
+  return dest;
+}
+exports.mttkrp = mttkrp;
+
+/**
+  * the mode product of X with matrix, which replaces dimension mode of X by
+  * the columns of matrix:
+  *   dest[.., j, ..] = sum_i X[.., i, ..] * matrix[i, j]
+  */
+function modeProduct(X, matrix, mode, dest) {
+  X = rowMajor(X);
+  //a transposed row-major matrix is read as it is.
+  if(!(matrix.numDimensions === 2 && matrix.dtype === 'float64' &&
+       matrix.strides[0] === 1 && matrix.strides[1] === matrix.shape[0]))
+    matrix = rowMajor(matrix);
+  if(dest === undefined) {
+    let shape = [...X.shape];
+    shape[mode] = matrix.shape[1];
+    dest = denseTensor.zerosLike(shape, 'float64');
+  }
+  lazy.beforeWrite(dest);
+  tensorBinding.modeProduct(X, matrix, mode, dest);
+  return dest;
+}
+exports.modeProduct = modeProduct;
+
+//X_(mode) Y_(mode)^T for tensors of equal shape but in dimension mode.
+function modeGram(X, Y, mode, dest) {
+  X = rowMajor(X);
+  Y = rowMajor(Y);
+  if(dest === undefined)
+    dest = denseTensor.zerosLike([X.shape[mode], Y.shape[mode]], 'float64');
+  lazy.beforeWrite(dest);
+  tensorBinding.modeGram(X, Y, mode, dest);
+  return dest;
+}
+exports.modeGram = modeGram;
+
+function squaredNorm(X) {
+  var values = X.cooTensor ? X.values.subarray(0, X.nnz) : X.data;
+  var total = 0;
+  for(let value of values) {
+    total += value * value;
+  }
+  return total;
+}
+
+//A^T A of a row-major matrix, as a row-major Float64Array.
+function gram(A) {
+  return rowMajor(denseTensor.contract(A.transpose(), A, 1)).data.slice(0);
+}
+
+/**
+  * dest = M V^-1 for the symmetric positive semidefinite rank x rank
+  * matrix V of an ALS step (a row-major Float64Array), by Cholesky. A
+  * singular V is regularized with a small multiple of its trace.
+  */
+function solveGram(V, M, dest) {
+  var rank = M.shape[1];
+  var trace = 0;
+  for(let i=0; i<rank; i++) {
+    trace += V[i * rank + i];
+  }
+  var ridge = 0;
+  for(let attempt=0; ; attempt++) {
+    let L = new denseTensor.Tensor({shape: [rank, rank], data: V.slice(0)});
+    for(let i=0; i<rank; i++) {
+      L.data[i * rank + i] += ridge;
+    }
+    try {
+      linalg.cholesky(L, L);
+    } catch(error) {
+      if(attempt >= 8 || !/NotPositiveDefiniteError/.test(error.message))
+        throw error;
+      ridge = ridge === 0 ? 1e-12 * Math.max(trace, 1e-300) : ridge * 100;
+      continue;
+    }
+    //X V = M is V X^T = M^T.
+    let solution = linalg.choleskySolve(L, M.transpose());
+    lazy.beforeWrite(dest);
+    tensorBinding.scale(solution.transpose(), 1, dest);
+    return dest;
+  }
+}
+
+/**
+  * orthonormalizes the columns of a row-major rows x columns Float64Array
+  * in place, by modified Gram-Schmidt applied twice. A column that depends
+  * on the ones before it is replaced by a random one.
+  */
+function orthonormalize(data, rows, columns) {
+  for(let c=0; c<columns; c++) {
+    for(let attempt=0; ; attempt++) {
+      let original = 0;
+      for(let i=0; i<rows; i++) {
+        original += data[i * columns + c] * data[i * columns + c];
+      }
+      for(let pass=0; pass<2; pass++) {
+        for(let p=0; p<c; p++) {
+          let dot = 0;
+          for(let i=0; i<rows; i++) {
+            dot += data[i * columns + p] * data[i * columns + c];
+          }
+          for(let i=0; i<rows; i++) {
+            data[i * columns + c] -= dot * data[i * columns + p];
+          }
+        }
+      }
+      let norm = 0;
+      for(let i=0; i<rows; i++) {
+        norm += data[i * columns + c] * data[i * columns + c];
+      }
+      if(norm > 1e-20 * original && norm > 0) {
+        norm = Math.sqrt(norm);
+        for(let i=0; i<rows; i++) {
+          data[i * columns + c] /= norm;
+        }
+        break;
+      }
+      if(attempt >= 8)
+        throw new Error('cannot orthonormalize: more columns than rows');
+      for(let i=0; i<rows; i++) {
+        data[i * columns + c] = Math.random() - 0.5;
+      }
+    }
+  }
+}
+
+/**
+  * a rank-R CP (CANDECOMP/PARAFAC) decomposition of a dense tensor or a
+  * CooTensor X by alternating least squares:
+  *   X ~ sum_r weights[r] * factors[0][:, r] o .. o factors[N-1][:, r]
+  * with unit columns in every factor. Each step of an iteration computes
+  * the mttkrp for one mode and solves with the Hadamard product of the
+  * Gram matrices of the other factors.
+  *
+  * opts:
+  *   maxIterations  (default 100)
+  *   tolerance      stop once the fit changes by less (default 1e-8)
+  *   init           initial factor matrices (random uniform by default)
+  *   onIteration    called with {iteration, fit, time} after each iteration
+  *
+  * Returns {weights, factors, fit, iterations}, where fit is
+  * 1 - |X - model| / |X| and iterations lists the fit and time in
+  * milliseconds of every iteration.
+  */
+function cpALS(X, rank, opts) {
+  opts = Object.assign({maxIterations: 100, tolerance: 1e-8}, opts);
+  X = X.cooTensor ? X.coalesce() : rowMajor(X);
+  var N = X.numDimensions;
+  var factors = [];
+  for(let m=0; m<N; m++) {
+    factors.push(opts.init ? rowMajor(opts.init[m]).clone() :
+                 denseTensor.uniformLike([X.shape[m], rank], 0, 1, 'float64'));
+  }
+  var grams = factors.map(gram);
+  var weights = new Float64Array(rank).fill(1);
+  var normX = Math.sqrt(squaredNorm(X));
+  var fit = 0;
+  var iterations = [];
+
+  for(let iteration=1; iteration<=opts.maxIterations; iteration++) {
+    let start = process.hrtime();
+    let M;
+    for(let n=0; n<N; n++) {
+      M = mttkrp(X, factors, n);
+      let V = new Float64Array(rank * rank).fill(1);
+      for(let m=0; m<N; m++) {
+        if(m !== n)
+          grams[m].forEach((value, k) => { V[k] *= value; });
+      }
+      solveGram(V, M, factors[n]);
+
+      let A = factors[n].data;
+      let rows = X.shape[n];
+      weights.fill(0);
+      for(let i=0; i<rows; i++) {
+        for(let r=0; r<rank; r++) {
+          weights[r] += A[i * rank + r] * A[i * rank + r];
+        }
+      }
+      weights = weights.map(Math.sqrt);
+      for(let i=0; i<rows; i++) {
+        for(let r=0; r<rank; r++) {
+          if(weights[r] > 0)
+            A[i * rank + r] /= weights[r];
+        }
+      }
+      grams[n] = gram(factors[n]);
+    }
+
+    //|X - model|^2 = |X|^2 + |model|^2 - 2 <X, model>, where <X, model>
+    //comes from the last mttkrp.
+    let A = factors[N-1].data;
+    let inner = 0;
+    for(let k=0; k<M.data.length; k++) {
+      inner += weights[k % rank] * M.data[k] * A[k];
+    }
+    let normModel = 0;
+    for(let r=0; r<rank; r++) {
+      for(let s=0; s<rank; s++) {
+        let product = weights[r] * weights[s];
+        for(let m=0; m<N; m++) {
+          product *= grams[m][r * rank + s];
+        }
+        normModel += product;
+      }
+    }
+    let residual = Math.sqrt(Math.max(0, normX * normX + normModel - 2 * inner));
+    let previousFit = fit;
+    fit = normX === 0 ? 1 : 1 - residual / normX;
+
+    let record = {iteration, fit, time: elapsed(start)};
+    iterations.push(record);
+    if(opts.onIteration)
+      opts.onIteration(record);
+    if(Math.abs(fit - previousFit) < opts.tolerance)
+      break;
+  }
+  return {weights, factors, fit, iterations};
+}
+exports.cpALS = cpALS;
+
+/**
+  * X times the transpose of every factor but the mode-th, with the
+  * dimension to update: dense X gives a tensor whose dimension mode is
+  * untouched, and a CooTensor the [X.shape[mode], prod of the ranks]
+  * unfolding, whose dimension 0 is the one to update.
+  */
+function projectAllBut(X, factors, mode) {
+  if(X.cooTensor) {
+    let width = factors.reduce((total, factor, m) => m === mode ? total : total * factor.shape[1], 1);
+    let Y = denseTensor.zerosLike([X.shape[mode], width], 'float64');
+    tensorBinding.ttmChain(X, factorList(factors, mode), mode, Y);
+    return {Y, mode: 0};
+  }
+  var Y = X;
+  for(let m=0; m<X.numDimensions; m++) {
+    if(m !== mode)
+      Y = modeProduct(Y, factors[m], m);
+  }
+  return {Y, mode};
+}
+
+/**
+  * a Tucker decomposition of a dense tensor or a CooTensor X with the
+  * given ranks, by higher-order orthogonal iteration (HOOI):
+  *   X ~ core x_0 factors[0] x_1 .. x_N-1 factors[N-1]
+  * where factors[m] is a [X.shape[m], ranks[m]] matrix with orthonormal
+  * columns and core is [ranks]. Each step of an iteration projects X on
+  * the other factors and refines the factor of one mode by a step of
+  * subspace iteration on the projection. A sparse X is projected from its
+  * nonzeros and never densified.
+  *
+  * Takes the opts of cpALS and returns {core, factors, fit, iterations}.
+  */
+function tucker(X, ranks, opts) {
+  opts = Object.assign({maxIterations: 50, tolerance: 1e-8}, opts);
+  X = X.cooTensor ? X.coalesce() : rowMajor(X);
+  var N = X.numDimensions;
+  var factors = [];
+  for(let m=0; m<N; m++) {
+    let U = opts.init ? rowMajor(opts.init[m]).clone() :
+            denseTensor.normalLike([X.shape[m], ranks[m]], 0, 1, 'float64');
+    orthonormalize(U.data, X.shape[m], ranks[m]);
+    factors.push(U);
+  }
+  var normX = Math.sqrt(squaredNorm(X));
+  var core;
+  var fit = 0;
+  var iterations = [];
+
+  for(let iteration=1; iteration<=opts.maxIterations; iteration++) {
+    let start = process.hrtime();
+    let projection;
+    for(let n=0; n<N; n++) {
+      projection = projectAllBut(X, factors, n);
+      let {Y, mode} = projection;
+      //U <- orth(Y_(n) Y_(n)^T U)
+      let C = modeProduct(Y, factors[n], mode);
+      modeGram(Y, C, mode, factors[n]);
+      orthonormalize(factors[n].data, X.shape[n], ranks[n]);
+    }
+
+    let {Y, mode} = projection;
+    if(mode === N-1) {
+      core = modeProduct(Y, factors[N-1], N-1);
+    } else {
+      //the sparse projection is [I_N-1, prod of the other ranks].
+      let unfolded = rowMajor(denseTensor.contract(Y.transpose(), factors[N-1], 1));
+      core = new denseTensor.Tensor({shape: ranks, data: unfolded.data});
+    }
+    let residual = Math.sqrt(Math.max(0, normX * normX - squaredNorm(core)));
+    let previousFit = fit;
+    fit = normX === 0 ? 1 : 1 - residual / normX;
+
+    let record = {iteration, fit, time: elapsed(start)};
+    iterations.push(record);
+    if(opts.onIteration)
+      opts.onIteration(record);
+    if(Math.abs(fit - previousFit) < opts.tolerance)
+      break;
+  }
+  return {core, factors, fit, iterations};
+}
+exports.tucker = tucker;
+
+//a 1-dimensional tensor as a one column matrix view.
+function asMatrix(tensor) {
+  tensor = denseTensor.numberToTensor(tensor);
+  if(tensor.numDimensions !== 1)
+    return tensor;
+  return new denseTensor.Tensor({shape: [tensor.shape[0], 1], strides: [tensor.strides[0], 1],
+                                 initial_offset: tensor.initial_offset, data: tensor.data,
+                                 dtype: tensor.dtype});
+}
+
+/**
+  * the Kronecker product A (x) B of an [m, n] and a [p, q] matrix, which is
+  * [m*p, n*q] with dest[i*p + j, a*q + b] = A[i, a] * B[j, b]. The
+  * Kronecker product of two vectors is a vector.
+  */
+function kronecker(A, B, dest) {
+  A = denseTensor.numberToTensor(A);
+  B = denseTensor.numberToTensor(B);
+  var A2 = asMatrix(A);
+  var B2 = asMatrix(B);
+  var shape = [A2.shape[0] * B2.shape[0], A2.shape[1] * B2.shape[1]];
+  if(dest === undefined) {
+    dest = denseTensor.zerosLike(A.numDimensions === 1 && B.numDimensions === 1 ? [shape[0]] : shape,
+                                 denseTensor.resultDataType(A, B));
+  }
+  lazy.beforeWrite(dest);
+  tensorBinding.kronecker(A2, B2, dest.numDimensions === 1 ? asMatrix(dest) : dest);
+  return dest;
+}
+exports.kronecker = kronecker;
+
+/**
+  * the Khatri-Rao (column-wise Kronecker) product of an [m, R] and a [p, R]
+  * matrix, which is [m*p, R] with dest[i*p + j, r] = A[i, r] * B[j, r].
+  */
+function khatriRao(A, B, dest) {
+  A = denseTensor.numberToTensor(A);
+  B = denseTensor.numberToTensor(B);
+  if(dest === undefined) {
+    dest = denseTensor.zerosLike([A.shape[0] * B.shape[0], A.shape[1]],
+                                 denseTensor.resultDataType(A, B));
+  }
+  lazy.beforeWrite(dest);
+  tensorBinding.khatriRao(A, B, dest);
+  return dest;
+}
+exports.khatriRao = khatriRao;
+
+//matrix as a gemm operand of dtype: row-major or a transposed row-major matrix.
+function gemmOperand(matrix, dtype) {
+  if(matrix.dtype === dtype && (isRowMajor(matrix) || isRowMajor(matrix.transpose())))
+    return matrix;
+  return matrix.toDataType(dtype);
+}
+
+/**
+  * (A (x) B) x for an [m, n] matrix A, a [p, q] matrix B and a vector of
+  * n*q entries or an [n*q, k] matrix x, computed as two matrix products on
+  * x viewed as [n, q, k]. The Kronecker product is never formed.
+  */
+function kroneckerMultiply(A, B, x, dest) {
+  x = denseTensor.numberToTensor(x);
+  var dtype = denseTensor.resultDataType(A, B) === 'float32' ? 'float32' : denseTensor.resultDataType(x);
+  A = gemmOperand(A, dtype);
+  B = gemmOperand(B, dtype);
+  x = rowMajor(x, dtype);
+  if(dest === undefined) {
+    let rows = A.shape[0] * B.shape[0];
+    dest = denseTensor.zerosLike(x.numDimensions === 2 ? [rows, x.shape[1]] : [rows], dtype);
+  }
+  var target = dest.dtype === dtype && isRowMajor(dest) ? dest : denseTensor.zerosLike(dest.shape, dtype);
+  lazy.beforeWrite(dest);
+  tensorBinding.kroneckerMultiply(A, B, x, target);
+  if(target !== dest)
+    tensorBinding.scale(target, 1, dest);
+  return dest;
+}
+exports.kroneckerMultiply = kroneckerMultiply;
@@ -2,10 +2,77 @@
 
 var tensorBinding = require('../../build/Release/tensorBinding');
 var tensorUtil = require('./tensorUtil');
+var lazy = require('./lazy');
+var sparseMatrix = require('./sparseMatrix');
+var cooTensor = require('./cooTensor');
 
 var DimensionType = Uint32Array;
-var DataStorageType = Float64Array;
-var StrideType = Uint32Array;
+//strides and offsets can exceed 2^32 for large tensors; Float64Array holds
+//them exactly up to 2^53.
+var StrideType = Float64Array;
+
+/**
+  * Tensors store their values either in a Float64Array ('float64') or in a
+  * Float32Array ('float32'). float32 tensors are a mixed-precision mode:
+  * the native code reads and writes single precision storage but does all
+  * arithmetic, and in particular all accumulation in sums, dot products and
+  * contractions, in double precision.
+  */
+var DataStorageTypes = {
+  float64: Float64Array,
+  float32: Float32Array
+};
+var defaultDataType = 'float64';
+
+function setDefaultDataType(dtype) {
+  if(DataStorageTypes[dtype] === undefined)
+    throw new Error('unknown dtype: ' + dtype);
+  defaultDataType = dtype;
+}
+exports.setDefaultDataType = setDefaultDataType;
+
+function getDefaultDataType() {
+  return defaultDataType;
+}
+exports.getDefaultDataType = getDefaultDataType;
+
+function dataTypeOf(data) {
+  if(data instanceof Float32Array)
+    return 'float32';
+  if(data instanceof Float64Array)
+    return 'float64';
+  return undefined;
+}
+
+//the storage type of the result of an operation on source1 and source2.
+function resultDataType(source1, source2) {
+  if(source1.dtype === 'float32' || (source2 !== undefined && source2.dtype === 'float32'))
+    return 'float32';
+  return 'float64';
+}
+exports.resultDataType = resultDataType;
+
+/**
+  * Tensors created with {shared: true} keep their values in a
+  * SharedArrayBuffer, so they can be posted to worker threads without
+  * copying: the Tensor rebuilt from the message on the other side uses the
+  * same memory. See parallel.js.
+  */
+function sharedStorage(DataStorageType, source) {
+  if(typeof SharedArrayBuffer === 'undefined')
+    throw new Error('SharedArrayBuffer is not available in this runtime');
+  var length = typeof source === 'number' ? source : source.length;
+  var data = new DataStorageType(new SharedArrayBuffer(length * DataStorageType.BYTES_PER_ELEMENT));
+  if(typeof source !== 'number')
+    data.set(source);
+  return data;
+}
+
+function isShared(tensor) {
+  return typeof SharedArrayBuffer !== 'undefined' && !tensor.sparse &&
+    tensor.data !== null && tensor.data.buffer instanceof SharedArrayBuffer;
+}
+exports.isShared = isShared;
 
 function parseArrayTensor(data) {
   if(data !== undefined && !(data instanceof Array)) {
@@ -20,6 +87,42 @@ function parseArrayTensor(data) {
   return shape;
 }
 
+//strides of a dense row-major tensor with the given shape.
+function denseStrides(shape) {
+  var strides = new StrideType(shape.length);
+  var currentStride = 1;
+  for(let i=shape.length-1; i>=0; i--) {
+    strides[i] = currentStride;
+    currentStride *= shape[i];
+  }
+  return strides;
+}
+exports.denseStrides = denseStrides;
+
+//whether tensor has the strides of a dense row-major tensor of its shape.
+function isRowMajor(tensor) {
+  var strides = denseStrides(tensor.shape);
+  return strides.every((stride, i) => stride === tensor.strides[i]);
+}
+exports.isRowMajor = isRowMajor;
+
+/**
+  * tensor (a dense or sparse tensor, or a number) as a row-major dense
+  * tensor of dtype (float64 by default), copied only if it is not one
+  * already.
+  */
+function rowMajor(tensor, dtype) {
+  if(dtype === undefined)
+    dtype = 'float64';
+  if(tensor.sparse)
+    tensor = tensor.toDense();
+  tensor = numberToTensor(tensor);
+  if(tensor.dtype === dtype && isRowMajor(tensor))
+    return tensor;
+  return tensor.toDataType(dtype);
+}
+exports.rowMajor = rowMajor;
+
 class Tensor {
   constructor(opts) {
     if(opts instanceof Array) {
@@ -28,7 +131,12 @@ class Tensor {
     if(!isNaN(opts)) {
       opts = {data: [opts]};
     }
-    var {shape, numDimensions, strides, initial_offset, data} = opts;
+    var {shape, numDimensions, strides, initial_offset, data, dtype, shared} = opts;
+    if(dtype === undefined)
+      dtype = dataTypeOf(data) || defaultDataType;
+    var DataStorageType = DataStorageTypes[dtype];
+    if(DataStorageType === undefined)
+      throw new Error('unknown dtype: ' + dtype);
     if(data !== undefined) {
       if(shape === undefined)
         shape = parseArrayTensor(data);
@@ -45,12 +153,7 @@ class Tensor {
       var totalSize = shape.reduce((x,y) => {return x*y;});
 
       if(strides === undefined) {
-        strides = new StrideType(numDimensions);
-        var currentStride = 1;
-        for(let i=numDimensions-1; i>=0; i--) {
-          strides[i] = currentStride;
-          currentStride *= shape[i];
-        }
+        strides = denseStrides(shape);
       }
       if(strides instanceof Array) {
         strides = new StrideType(strides);
@@ -60,7 +163,14 @@ class Tensor {
         initial_offset = 0;
       }
 
-      if(data instanceof Array) {
+      if(shared) {
+        if(data === undefined)
+          data = sharedStorage(DataStorageType, totalSize);
+        else if(!(data.buffer instanceof SharedArrayBuffer) || dataTypeOf(data) !== dtype)
+          data = sharedStorage(DataStorageType, data);
+      }
+
+      if(data instanceof Array || (dataTypeOf(data) !== undefined && dataTypeOf(data) !== dtype)) {
         data = new DataStorageType(data);
       }
 
@@ -76,6 +186,7 @@ class Tensor {
     }
 
     this.sparse = false;
+    this.dtype = dtype;
     this.shape = shape;
     this.numDimensions = numDimensions;
     this.strides = strides;
@@ -122,6 +233,7 @@ class Tensor {
       }
       offset += coords[i] * this.strides[i];
     }
+    lazy.beforeWrite(this);
     this.data[offset] = value;
     return value;
   }
@@ -135,13 +247,14 @@ class Tensor {
     opts.shape = this.shape;
     opts.numDimensions = this.numDimensions;
     opts.strides = this.strides;
-    initial_offset = this.initial_offset;
+    opts.initial_offset = this.initial_offset;
+    opts.dtype = this.dtype;
     opts.data = this.data.slice(0);
     return new Tensor(opts);
   }
 
   compacted() {
-    var data = new DataStorageType(this.totalSize());
+    var data = new DataStorageTypes[this.dtype](this.totalSize());
     var shape = this.shape.slice(0);
 
     var compactified = new Tensor({data, shape});
@@ -179,6 +292,27 @@ class Tensor {
     return scale(this, x);
   }
 
+  /**
+    * returns this tensor if its storage is already shared, otherwise a
+    * compact copy backed by a SharedArrayBuffer.
+    */
+  toShared() {
+    if(isShared(this))
+      return this;
+    var T = new Tensor({shape: this.shape.slice(0), dtype: this.dtype, shared: true});
+    tensorBinding.scale(this, 1, T);
+    return T;
+  }
+
+  /**
+    * returns a copy of this tensor stored with the given dtype.
+    */
+  toDataType(dtype) {
+    var T = new Tensor({shape: this.shape.slice(0), dtype});
+    tensorBinding.scale(this, 1, T);
+    return T;
+  }
+
 }
 exports.Tensor = Tensor;
 
@@ -194,17 +328,42 @@ function transpose(tensor) {
 exports.transpose = transpose;
 
 function fillNormal(mean, stdDev, dest) {
+  lazy.beforeWrite(dest);
   tensorBinding.fillNormal(mean, stdDev, dest);
   return dest;
 }
 exports.fillNormal = fillNormal;
 
 function fillUniform(low, high, dest) {
+  lazy.beforeWrite(dest);
   tensorBinding.fillUniform(low, high, dest);
   return dest;
 }
 exports.fillUniform = fillUniform;
 
+/**
+  * fillNormal and fillUniform use a counter-based generator (see
+  * csrc/random.h). After seed(value) the values they produce depend only
+  * on value and on the sizes of the fills made since, not on the number of
+  * threads, the dtype or the strides of the tensors filled.
+  */
+function seed(value) {
+  tensorBinding.seedRandom(value);
+}
+exports.seed = seed;
+
+//number of threads the multithreaded native kernels (large fills, sparse
+//matrix products) split their work across.
+function setNumThreads(numThreads) {
+  tensorBinding.setNumThreads(numThreads);
+}
+exports.setNumThreads = setNumThreads;
+
+function getNumThreads() {
+  return tensorBinding.getNumThreads();
+}
+exports.getNumThreads = getNumThreads;
+
 function print2DTensor(tensor) {
   var strings = [];
   for(let i=0; i<tensor.shape[0]; i++) {
@@ -237,45 +396,35 @@ function printTensor(tensor) {
 }
 exports.printTensor = printTensor;
 
-function zerosLike(shape) {
+function zerosLike(shape, dtype) {
   if(shape instanceof Tensor) {
+    if(dtype === undefined)
+      dtype = shape.dtype;
     shape = shape.shape;
   }
-  return new Tensor({shape});
+  return new Tensor({shape, dtype});
 }
 exports.zerosLike = zerosLike;
 
-function uniformLike(shape, low, high) {
-  if(shape instanceof Tensor) {
-    shape = shape.shape;
-  }
-  return (new Tensor({shape})).fillUniform(low, high);
+function uniformLike(shape, low, high, dtype) {
+  return zerosLike(shape, dtype).fillUniform(low, high);
 }
 exports.uniformLike = uniformLike;
 
-function normalLike(shape, mean, stdDev) {
-  if(shape instanceof Tensor) {
-    shape = shape.shape;
-  }
-  return (new Tensor({shape})).fillNormal(mean, stdDev);
+function normalLike(shape, mean, stdDev, dtype) {
+  return zerosLike(shape, dtype).fillNormal(mean, stdDev);
 }
 exports.normalLike = normalLike;
 
-function onesLike(shape) {
-  if(shape instanceof Tensor) {
-    shape = shape.shape;
-  }
-  ones = new Tensor({shape});
+function onesLike(shape, dtype) {
+  ones = zerosLike(shape, dtype);
   ones.data.fill(1.0);
   return ones;
 }
 exports.onesLike = onesLike;
 
-function fillLike(shape, value) {
-  if(shape instanceof Tensor) {
-    shape = shape.shape;
-  }
-  ones = new Tensor({shape});
+function fillLike(shape, value, dtype) {
+  ones = zerosLike(shape, dtype);
   ones.data.fill(value);
   return ones;
 }
@@ -300,29 +449,39 @@ function broadcastShape(tensor1, tensor2) {
 exports.broadcastShape = broadcastShape;
 
 
-function contract(source1, source2, dimsToContract, dest) {
-  if(dest === undefined) {
-    let shape = [];
-    if(dimsToContract===0) {
-      for(let dim of source1.shape) {
-        shape.push(dim);
-      }
-      for(let dim of source2.shape) {
-        shape.push(dim);
-      }  
-    } else {
-      for(let dim of source1.shape.slice(0,-dimsToContract)) {
-        shape.push(dim);
-      }
-      for(let dim of source2.shape.slice(dimsToContract)) {
-        shape.push(dim);
-      }
+//the dest tensor a contraction of source1 and source2 writes to.
+function contractDest(source1, source2, dimsToContract) {
+  let shape = [];
+  if(dimsToContract===0) {
+    for(let dim of source1.shape) {
+      shape.push(dim);
+    }
+    for(let dim of source2.shape) {
+      shape.push(dim);
+    }  
+  } else {
+    for(let dim of source1.shape.slice(0,-dimsToContract)) {
+      shape.push(dim);
+    }
+    for(let dim of source2.shape.slice(dimsToContract)) {
+      shape.push(dim);
     }
-    if(shape.length === 0)
-      shape = [1];
-  
-    dest = new Tensor({shape});
   }
+  if(shape.length === 0)
+    shape = [1];
+
+  return new Tensor({shape, dtype: resultDataType(source1, source2)});
+}
+exports.contractDest = contractDest;
+
+function contract(source1, source2, dimsToContract, dest) {
+  if(source1.sparseMatrix || source2.sparseMatrix)
+    return sparseMatrix.contract(source1, source2, dimsToContract, dest);
+  if(source1.cooTensor || source2.cooTensor)
+    return cooTensor.contract(source1, source2, dimsToContract, dest);
+  if(dest === undefined)
+    dest = contractDest(source1, source2, dimsToContract);
+  lazy.beforeWrite(dest);
   tensorBinding.contract(source1, source2, dimsToContract,dest);
   return dest;
 }
@@ -336,48 +495,61 @@ function numberToTensor(number) {
   if(number instanceof Tensor)
     return number;
 
-  return new Tensor({shape:[1], data: new DataStorageType([number])});
+  //float64 whatever the default, so that numbers never lower the precision of a result.
+  return new Tensor({shape:[1], data: [number], dtype: 'float64'});
 }
 exports.numberToTensor = numberToTensor;
 
 function addScale(source1, source2, scale1, scale2, dest) {
+  if(lazy.getLazyEvaluation())
+    return lazy.record((a, b) => a.scale(scale1).add(b.scale(scale2)), [source1, source2], dest);
   source1 = numberToTensor(source1);
   source2 = numberToTensor(source2);
   if(dest === undefined)
-    dest = zerosLike(broadcastShape(source1, source2));
+    dest = zerosLike(broadcastShape(source1, source2), resultDataType(source1, source2));
   dest = numberToTensor(dest);
+  lazy.beforeWrite(dest);
   tensorBinding.addScale(source1, source2, scale1, scale2, dest);
   return dest;
 }
 exports.addScale = addScale;
 
 function multiplyScale(source1, source2, scale, dest) {
+  if(lazy.getLazyEvaluation())
+    return lazy.record((a, b) => a.mul(b).scale(scale), [source1, source2], dest);
   source1 = numberToTensor(source1);
   source2 = numberToTensor(source2);
   if(dest === undefined)
-    dest = zerosLike(broadcastShape(source1, source2));
+    dest = zerosLike(broadcastShape(source1, source2), resultDataType(source1, source2));
   dest = numberToTensor(dest);
+  lazy.beforeWrite(dest);
   tensorBinding.multiplyScale(source1, source2, scale, dest);
   return dest;
 }
 exports.multiplyScale = multiplyScale;
 
 function divideScale(source1, source2, scale, dest) {
+  if(lazy.getLazyEvaluation())
+    return lazy.record((a, b) => a.div(b).scale(scale), [source1, source2], dest);
   source1 = numberToTensor(source1);
   source2 = numberToTensor(source2);
   if(dest === undefined)
-    dest = zerosLike(broadcastShape(source1, source2));
+    dest = zerosLike(broadcastShape(source1, source2), resultDataType(source1, source2));
   dest = numberToTensor(dest);
 
+  lazy.beforeWrite(dest);
   tensorBinding.divideScale(source1, source2, scale, dest);
   return dest;
 }
 exports.divideScale = divideScale;
 
 function scale(source, scale, dest) {
+  if(lazy.getLazyEvaluation())
+    return lazy.record(a => a.scale(scale), [source], dest);
   source = numberToTensor(source);
   if(dest === undefined)
     dest = zerosLike(source);
+  lazy.beforeWrite(dest);
   tensorBinding.scale(source, scale, dest);
   return dest;
 }
@@ -0,0 +1,183 @@
+/* jshint esversion: 6 */
+
+/**
+  * fused elementwise expressions.
+  *
+  * compile(func) traces func once with symbolic inputs and turns the
+  * resulting expression into a small postfix program. Calling the compiled
+  * function evaluates the whole expression natively in a single tiled pass
+  * over its inputs, instead of allocating a temporary for every step.
+  *
+  *   var softplus = fused.compile((x, y) => x.mul(y).neg().exp().add(1).log());
+  *   var loss = softplus(pred, label);
+  *
+  * Inputs may be tensors or numbers and are broadcast against each other.
+  * An optional extra argument is used as dest.
+  */
+
+var denseTensor = require('./denseTensor');
+var lazy = require('./lazy');
+var nodetensor = require('../../build/Release/tensorBinding');
+
+//must match FusedOpcode in csrc/fused.h
+var opcodes = {
+  input: 0,
+  constant: 1,
+
+  add: 2,
+  sub: 3,
+  mul: 4,
+  div: 5,
+  pow: 6,
+  max: 7,
+  min: 8,
+  fmod: 9,
+
+  neg: 10,
+  square: 11,
+  sign: 12,
+  abs: 13,
+  sqrt: 14,
+  exp: 15,
+  log: 16,
+  sin: 17,
+  cos: 18,
+  tan: 19,
+  sinh: 20,
+  cosh: 21,
+  tanh: 22,
+  atan: 23,
+  acos: 24,
+  asin: 25,
+  atanh: 26,
+  acosh: 27,
+  asinh: 28,
+  erf: 29,
+  floor: 30,
+  ceil: 31,
+  round: 32
+};
+
+var binaryOps = ['add', 'sub', 'mul', 'div', 'pow', 'max', 'min', 'fmod'];
+var unaryOps = ['neg', 'square', 'sign', 'abs', 'sqrt', 'exp', 'log',
+                'sin', 'cos', 'tan', 'sinh', 'cosh', 'tanh', 'atan', 'acos',
+                'asin', 'atanh', 'acosh', 'asinh', 'erf', 'floor', 'ceil', 'round'];
+
+class Expression {
+  constructor(op, operands, operand) {
+    this.op = op;
+    this.operands = operands || [];
+    //input index or constant value
+    this.operand = operand;
+  }
+
+  scale(factor) {
+    if(factor === 1)
+      return this;
+    return this.mul(factor);
+  }
+}
+
+function toExpression(value) {
+  if(value instanceof Expression)
+    return value;
+  if(typeof value === 'number')
+    return new Expression('constant', [], value);
+  throw new Error('fused expressions can only combine expressions and numbers');
+}
+
+for(let op of binaryOps) {
+  Expression.prototype[op] = function(other) {
+    return new Expression(op, [this, toExpression(other)]);
+  };
+}
+
+for(let op of unaryOps) {
+  Expression.prototype[op] = function() {
+    return new Expression(op, [this]);
+  };
+}
+
+function emit(expression, code, constants) {
+  for(let operand of expression.operands) {
+    emit(operand, code, constants);
+  }
+  var operand = 0;
+  if(expression.op === 'input') {
+    operand = expression.operand;
+  } else if(expression.op === 'constant') {
+    operand = constants.length;
+    constants.push(expression.operand);
+  }
+  code.push(opcodes[expression.op], operand);
+}
+
+function broadcastShapeOf(tensors) {
+  if(tensors.length === 0)
+    return [1];
+  var shape = tensors[0];
+  for(let i=1; i<tensors.length; i++) {
+    let broadcast = denseTensor.broadcastShape(shape, tensors[i]);
+    shape = {shape: broadcast, numDimensions: broadcast.length};
+  }
+  return shape.shape;
+}
+
+function inputExpressions(numInputs) {
+  var inputs = [];
+  for(let i=0; i<numInputs; i++) {
+    inputs.push(new Expression('input', [], i));
+  }
+  return inputs;
+}
+exports.inputExpressions = inputExpressions;
+
+function compile(func) {
+  var numInputs = func.length;
+  return compileExpression(toExpression(func(...inputExpressions(numInputs))), numInputs);
+}
+
+/**
+  * compile() for an expression already built on inputExpressions(numInputs),
+  * for code generating expressions rather than tracing a function.
+  */
+function compileExpression(expression, numInputs) {
+  var code = [];
+  var constants = [];
+  emit(expression, code, constants);
+  code = new Uint32Array(code);
+  constants = new Float64Array(constants);
+
+  function fused(...args) {
+    if(args.length < numInputs)
+      throw new Error('fused expression requires ' + numInputs + ' inputs');
+
+    var sources = [];
+    var dtype = 'float64';
+    for(let i=0; i<numInputs; i++) {
+      let source = args[i];
+      if(source.sparse)
+        source = source.toDense();
+      source = denseTensor.numberToTensor(source);
+      dtype = denseTensor.resultDataType(source, {dtype});
+      sources.push(source);
+    }
+
+    var dest = args[numInputs];
+    if(dest === undefined)
+      dest = denseTensor.zerosLike(broadcastShapeOf(sources), dtype);
+
+    lazy.beforeWrite(dest);
+    nodetensor.fusedElementwise(code, constants, sources, dest);
+    return dest;
+  }
+  fused.code = code;
+  fused.constants = constants;
+  return fused;
+}
+exports.compile = compile;
+exports.compileExpression = compileExpression;
+exports.Expression = Expression;
+exports.toExpression = toExpression;
+exports.broadcastShapeOf = broadcastShapeOf;
+exports.opcodes = opcodes;
@@ -2,15 +2,35 @@
 
 var denseTensor = require('./denseTensor');
 var sparseTensor = require('./sparseTensor');
+var sparseMatrix = require('./sparseMatrix');
+var cooTensor = require('./cooTensor');
+var decompose = require('./decompose');
+var linalg = require('./linalg');
+var losses = require('./losses');
 var mathops = require('./mathops');
+var fused = require('./fused');
+var lazy = require('./lazy');
+var async = require('./async');
+var parallel = require('./parallel');
 
 
 exports.denseTensor = denseTensor;
 exports.mathops = mathops;
 exports.sparseTensor = sparseTensor;
+exports.sparseMatrix = sparseMatrix;
+exports.cooTensor = cooTensor;
+exports.decompose = decompose;
+exports.linalg = linalg;
+exports.losses = losses;
+exports.fused = fused;
+exports.lazy = lazy;
+exports.async = async;
+exports.parallel = parallel;
 
 exports.Tensor = denseTensor.Tensor;
 exports.SparseVector = sparseTensor.SparseVector;
+exports.SparseMatrix = sparseMatrix.SparseMatrix;
+exports.CooTensor = cooTensor.CooTensor;
 
 function firstArgisThis(func) {
   return function() {
@@ -34,7 +54,19 @@ for (let key in mathops) {
 exports.onesLike = denseTensor.onesLike;
 exports.zerosLike = denseTensor.zerosLike;
 exports.fillLike = denseTensor.fillLike;
+exports.setDefaultDataType = denseTensor.setDefaultDataType;
+exports.getDefaultDataType = denseTensor.getDefaultDataType;
+exports.setLazyEvaluation = lazy.setLazyEvaluation;
+exports.getLazyEvaluation = lazy.getLazyEvaluation;
+exports.kronecker = decompose.kronecker;
+exports.khatriRao = decompose.khatriRao;
+exports.kroneckerMultiply = decompose.kroneckerMultiply;
+exports.setNumThreads = denseTensor.setNumThreads;
+exports.getNumThreads = denseTensor.getNumThreads;
 
 exports.random = {};
 exports.random.uniformLike = denseTensor.uniformLike;
 exports.random.normalLike = denseTensor.normalLike;
+exports.random.seed = denseTensor.seed;
+exports.random.setNumThreads = denseTensor.setNumThreads;
+exports.random.getNumThreads = denseTensor.getNumThreads;
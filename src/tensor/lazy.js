@@ -0,0 +1,295 @@
+/* jshint esversion: 6 */
+
+/**
+  * opt-in lazy evaluation of elementwise ops.
+  *
+  * While lazy evaluation is on, the elementwise functions of mathops and
+  * denseTensor (add, mul, scale, exp, max, ...) do not run. They record a
+  * DAG of fused.Expression nodes and return a pending tensor whose shape
+  * and dtype are known but whose data is only computed when it is needed:
+  * reading .data, at(), sum(), or passing the tensor to any native call.
+  * The pending part of the DAG behind that tensor is then compiled into a
+  * single fused program and evaluated in one pass, so
+  *  - pending tensors that are never read are never computed,
+  *  - intermediates of a chain of ops never get a buffer of their own,
+  *  - an op given an explicit dest evaluates its whole pending expression
+  *    straight into dest.
+  *
+  * Before the library writes to a buffer (ops with a dest, set(), fill*),
+  * every pending tensor that reads that buffer is materialized. Writes made
+  * directly through .data are not tracked, and neither are tensors that
+  * are re-assigned a new .data while pending ops read them.
+  */
+
+var denseTensor = require('./denseTensor');
+var fused = require('./fused');
+var nodetensor = require('../../build/Release/tensorBinding');
+
+var enabled = false;
+
+//set once anything has been recorded, so that beforeWrite is free for
+//programs that never use lazy evaluation.
+var recorded = false;
+
+//largest expression fused into one program; bigger DAGs are cut by
+//materializing their pending operands first.
+var MAX_FUSED_SIZE = 64;
+
+//ArrayBuffer -> Set of references to the pending tensors that read it.
+//Pending tensors are held weakly where the runtime allows it, so that
+//dropped ones are never computed.
+var readers = new WeakMap();
+
+var stats = {evaluations: 0};
+exports.stats = stats;
+
+function setLazyEvaluation(enable) {
+  enabled = Boolean(enable);
+}
+exports.setLazyEvaluation = setLazyEvaluation;
+
+function getLazyEvaluation() {
+  return enabled;
+}
+exports.getLazyEvaluation = getLazyEvaluation;
+
+function isPending(tensor) {
+  return tensor.lazyNode !== undefined;
+}
+exports.isPending = isPending;
+
+function makeRef(tensor) {
+  if(typeof WeakRef !== 'undefined')
+    return new WeakRef(tensor);
+  return {deref: () => tensor};
+}
+
+//a view on the current storage of source, so that later re-assignments
+//of source.data do not change what a pending op reads.
+function captureView(source) {
+  return new denseTensor.Tensor({
+    shape: source.shape.slice(0),
+    strides: source.strides.slice(0),
+    initial_offset: source.initial_offset,
+    data: source.data,
+    dtype: source.dtype
+  });
+}
+
+function toNode(source) {
+  if(source.lazyNode !== undefined)
+    return source.lazyNode;
+  return new fused.Expression('input', [], captureView(source));
+}
+
+function leafOf(node) {
+  if(node.result !== undefined)
+    return node.result;
+  if(node.op === 'input')
+    return node.operand;
+  return undefined;
+}
+
+function sizeOf(node) {
+  if(leafOf(node) !== undefined)
+    return 1;
+  if(node.size === undefined) {
+    node.size = 1;
+    for(let operand of node.operands) {
+      node.size += sizeOf(operand);
+    }
+  }
+  return node.size;
+}
+
+function emit(node, program) {
+  var leaf = leafOf(node);
+  if(leaf !== undefined) {
+    let index = program.inputIndices.get(leaf);
+    if(index === undefined) {
+      index = program.inputs.length;
+      program.inputs.push(leaf);
+      program.inputIndices.set(leaf, index);
+    }
+    program.code.push(fused.opcodes.input, index);
+    return;
+  }
+  if(node.op === 'constant') {
+    program.code.push(fused.opcodes.constant, program.constants.length);
+    program.constants.push(node.operand);
+    return;
+  }
+  for(let operand of node.operands) {
+    emit(operand, program);
+  }
+  program.code.push(fused.opcodes[node.op], 0);
+}
+
+function evaluate(node, dest) {
+  var program = {code: [], constants: [], inputs: [], inputIndices: new Map()};
+  emit(node, program);
+  nodetensor.fusedElementwise(new Uint32Array(program.code),
+                              new Float64Array(program.constants),
+                              program.inputs, dest);
+  stats.evaluations++;
+}
+
+function collectBuffers(node, buffers) {
+  var leaf = leafOf(node);
+  if(leaf !== undefined) {
+    buffers.add(leaf.data.buffer);
+    return;
+  }
+  for(let operand of node.operands) {
+    collectBuffers(operand, buffers);
+  }
+}
+
+function addReader(buffer, tensor) {
+  var pending = readers.get(buffer);
+  if(pending === undefined) {
+    pending = new Set();
+    readers.set(buffer, pending);
+  }
+  if(pending.size > 256) {
+    for(let ref of pending) {
+      if(ref.deref() === undefined)
+        pending.delete(ref);
+    }
+  }
+  pending.add(tensor.lazyRef);
+  tensor.lazyBuffers.push(buffer);
+}
+
+function register(tensor) {
+  var buffers = new Set();
+  collectBuffers(tensor.lazyNode, buffers);
+  tensor.lazyRef = makeRef(tensor);
+  tensor.lazyBuffers = [];
+  for(let buffer of buffers) {
+    addReader(buffer, tensor);
+  }
+}
+
+function force(node) {
+  if(node.result === undefined) {
+    let dest = denseTensor.zerosLike(node.shape, node.dtype);
+    let buffers = new Set();
+    collectBuffers(node, buffers);
+    evaluate(node, dest);
+    node.result = dest;
+
+    //pending tensors that depended on node now read dest instead. They
+    //all read the buffers node read, so registering those is enough.
+    for(let buffer of buffers) {
+      let pending = readers.get(buffer);
+      if(pending === undefined)
+        continue;
+      for(let ref of pending) {
+        let T = ref.deref();
+        if(T !== undefined && T.lazyNode !== undefined)
+          addReader(dest.data.buffer, T);
+      }
+    }
+  }
+  return node.result;
+}
+
+function unregister(tensor) {
+  for(let buffer of tensor.lazyBuffers) {
+    let pending = readers.get(buffer);
+    if(pending !== undefined)
+      pending.delete(tensor.lazyRef);
+  }
+  tensor.lazyRef = undefined;
+  tensor.lazyBuffers = undefined;
+}
+
+//turns a pending tensor into an ordinary one backed by data.
+function settle(tensor, data) {
+  Object.defineProperty(tensor, 'data', {
+    value: data,
+    writable: true,
+    configurable: true,
+    enumerable: true
+  });
+  unregister(tensor);
+  tensor.lazyNode = undefined;
+}
+
+function materialize(tensor) {
+  if(tensor.lazyNode !== undefined)
+    settle(tensor, force(tensor.lazyNode).data);
+  return tensor.data;
+}
+exports.materialize = materialize;
+
+function pendingTensor(node) {
+  var T = Object.create(denseTensor.Tensor.prototype);
+  T.sparse = false;
+  T.dtype = node.dtype;
+  T.shape = node.shape;
+  T.numDimensions = node.shape.length;
+  T.strides = denseTensor.denseStrides(node.shape);
+  T.initial_offset = 0;
+  Object.defineProperty(T, 'data', {
+    get: function() { return materialize(this); },
+    set: function(data) { settle(this, data); },
+    configurable: true,
+    enumerable: true
+  });
+  T.lazyNode = node;
+  register(T);
+  return T;
+}
+
+/**
+  * materializes every pending tensor that reads the storage of tensor,
+  * which is about to be written.
+  */
+function beforeWrite(tensor) {
+  if(!recorded || !tensor.data)
+    return;
+  var buffer = tensor.data.buffer;
+  var pending = readers.get(buffer);
+  if(pending === undefined)
+    return;
+  readers.delete(buffer);
+  for(let ref of pending) {
+    let T = ref.deref();
+    if(T !== undefined)
+      materialize(T);
+  }
+}
+exports.beforeWrite = beforeWrite;
+
+/**
+  * records build(...operands) over the given sources, which may be tensors
+  * or numbers. If dest is given the expression is evaluated into it right
+  * away, otherwise a pending tensor is returned.
+  */
+function record(build, sources, dest) {
+  recorded = true;
+  sources = sources.map(denseTensor.numberToTensor);
+  var operands = sources.map(toNode);
+  var node = fused.toExpression(build(...operands));
+  if(sizeOf(node) > MAX_FUSED_SIZE) {
+    //inputs are leaves already; only pending operands need evaluating.
+    operands.filter(operand => leafOf(operand) === undefined).forEach(force);
+    node = fused.toExpression(build(...operands));
+  }
+
+  if(dest !== undefined) {
+    beforeWrite(dest);
+    evaluate(node, dest);
+    return dest;
+  }
+
+  node.shape = fused.broadcastShapeOf(sources).slice(0);
+  node.dtype = sources.reduce((dtype, source) => denseTensor.resultDataType(source, {dtype}), 'float64');
+  //a pending tensor never shares its node with one of its sources.
+  if(leafOf(node) !== undefined || operands.indexOf(node) !== -1)
+    node = new fused.Expression('mul', [node, fused.toExpression(1)]);
+  return pendingTensor(node);
+}
+exports.record = record;
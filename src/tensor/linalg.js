@@ -0,0 +1,196 @@
+/* jshint esversion: 6 */
+
+var denseTensor = require('./denseTensor');
+var lazy = require('./lazy');
+var tensorBinding = require('../../build/Release/tensorBinding');
+
+/**
+  * Cholesky and QR factorizations, triangular solves, least squares and
+  * singular value decompositions, natively on top of BLAS (see
+  * csrc/linalg.h). The kernels work on row-major
+  * matrices in place: every function writes its result to dest, which
+  * defaults to a new tensor and may be the input itself, e.g.
+  * cholesky(A, A) factors A in place. Other operands are copied to
+  * row-major storage of the result's dtype when they are not already.
+  *
+  * A matrix that is not positive definite throws an Error mentioning
+  * NotPositiveDefiniteError.
+  */
+
+var isRowMajor = denseTensor.isRowMajor;
+var rowMajor = denseTensor.rowMajor;
+
+/**
+  * runs kernel(target) on a row-major copy of source of the dtype of dest
+  * (new by default), or on dest itself if it is source and row-major, and
+  * leaves the result in dest.
+  */
+function inPlace(source, dest, dtype, kernel) {
+  if(dest === undefined)
+    dest = denseTensor.zerosLike(source.shape, dtype);
+  var target = dest;
+  if(!isRowMajor(dest)) {
+    target = denseTensor.zerosLike(dest.shape, dest.dtype);
+  }
+  if(target !== source)
+    tensorBinding.scale(source, 1, target);
+  lazy.beforeWrite(dest);
+  kernel(target);
+  if(target !== dest)
+    tensorBinding.scale(target, 1, dest);
+  return dest;
+}
+
+/**
+  * the Cholesky factor L of a symmetric positive definite matrix A: lower
+  * triangular, with A = L L^T. Only the lower triangle of A is read.
+  */
+function cholesky(A, dest) {
+  A = denseTensor.numberToTensor(A);
+  var dtype = dest === undefined ? A.dtype : dest.dtype;
+  return inPlace(A, dest, dtype, target => tensorBinding.cholesky(target));
+}
+exports.cholesky = cholesky;
+
+/**
+  * op(T)^-1 B for a triangular matrix T and a vector or matrix B, where
+  * op(T) is T, or T^T with {transpose: true}. T is lower triangular
+  * unless {lower: false}; only its triangle is read.
+  */
+function triangularSolve(T, B, opts, dest) {
+  opts = Object.assign({lower: true, transpose: false}, opts);
+  B = denseTensor.numberToTensor(B);
+  var dtype = dest === undefined ? denseTensor.resultDataType(T, B) : dest.dtype;
+  T = rowMajor(T, dtype);
+  return inPlace(B, dest, dtype, target => {
+    tensorBinding.triangularSolve(T, opts.lower, opts.transpose, target);
+  });
+}
+exports.triangularSolve = triangularSolve;
+
+//A^-1 B for the Cholesky factor L of A.
+function choleskySolve(L, B, dest) {
+  B = denseTensor.numberToTensor(B);
+  var dtype = dest === undefined ? denseTensor.resultDataType(L, B) : dest.dtype;
+  L = rowMajor(L, dtype);
+  return inPlace(B, dest, dtype, target => {
+    tensorBinding.triangularSolve(L, true, false, target);
+    tensorBinding.triangularSolve(L, true, true, target);
+  });
+}
+exports.choleskySolve = choleskySolve;
+
+/**
+  * the x minimizing |A x - b|^2 + ridge |x|^2 for an [m, n] matrix A and b
+  * a vector of m entries or an [m, k] matrix, by the normal equations.
+  * opts: {ridge} (default 0).
+  */
+function leastSquares(A, b, opts, dest) {
+  opts = Object.assign({ridge: 0}, opts);
+  b = denseTensor.numberToTensor(b);
+  var dtype = dest === undefined ? denseTensor.resultDataType(A, b) : dest.dtype;
+  A = rowMajor(A, dtype);
+  b = rowMajor(b, dtype);
+  if(dest === undefined) {
+    let shape = b.numDimensions === 2 ? [A.shape[1], b.shape[1]] : [A.shape[1]];
+    dest = denseTensor.zerosLike(shape, dtype);
+  }
+  //the kernel reads A and b while it writes dest.
+  var target = isRowMajor(dest) && dest.data !== A.data && dest.data !== b.data ?
+               dest : denseTensor.zerosLike(dest.shape, dtype);
+  lazy.beforeWrite(dest);
+  tensorBinding.leastSquares(A, b, opts.ridge, target);
+  if(target !== dest)
+    tensorBinding.scale(target, 1, dest);
+  return dest;
+}
+exports.leastSquares = leastSquares;
+
+/**
+  * the thin QR factorization Y = Q R of a tall [m, k] matrix Y, by
+  * CholeskyQR: Q is [m, k] with orthonormal columns, R is [k, k] upper
+  * triangular. Returns {Q, R}; Q is dest (new by default, or Y itself to
+  * work in place).
+  */
+function qr(Y, dest) {
+  Y = denseTensor.numberToTensor(Y);
+  var dtype = dest === undefined ? Y.dtype : dest.dtype;
+  var R = denseTensor.zerosLike([Y.shape[1], Y.shape[1]], dtype);
+  var Q = inPlace(Y, dest, dtype, target => tensorBinding.choleskyQR(target, R));
+  return {Q, R};
+}
+exports.qr = qr;
+
+/**
+  * the singular value decomposition A = U diag(S) V^T of a small [m, n]
+  * matrix, by one-sided Jacobi rotations, in float64: U is [m, r], S the
+  * r = min(m, n) singular values in decreasing order and V is [n, r].
+  * Returns {U, S, V}. For large matrices see randomizedSVD.
+  */
+function svd(A) {
+  A = denseTensor.numberToTensor(A);
+  if(A.shape[0] < A.shape[1]) {
+    let {U, S, V} = svd(A.transpose());
+    return {U: V, S, V: U};
+  }
+  var [m, n] = A.shape;
+  var U = denseTensor.zerosLike([m, n], 'float64');
+  var S = denseTensor.zerosLike([n], 'float64');
+  var V = denseTensor.zerosLike([n, n], 'float64');
+  tensorBinding.svdJacobi(rowMajor(A, 'float64'), U, S, V);
+  return {U, S, V};
+}
+exports.svd = svd;
+
+//the first columns of a matrix, as a new row-major tensor.
+function leadingColumns(matrix, columns) {
+  var view = new denseTensor.Tensor({shape: [matrix.shape[0], columns], strides: matrix.strides,
+                                     initial_offset: matrix.initial_offset, data: matrix.data,
+                                     dtype: matrix.dtype});
+  return view.toDataType(matrix.dtype);
+}
+
+/**
+  * the rank-k truncated SVD A ~ U diag(S) V^T of a large [m, n] matrix by
+  * a randomized range finder (Halko, Martinsson and Tropp):
+  *
+  *   Q = qr(A G) for a Gaussian [n, k + oversampling] sketch G, refined by
+  *       powerIterations rounds of Q = qr(A qr(A^T Q));
+  *   A^T Q = P R, so that Q^T A = R^T P^T;
+  *   R^T = Ur diag(S) Vr^T by svd(), giving U = Q Ur and V = P Vr.
+  *
+  * All the products with A and the QR factorizations run on BLAS-3 (and
+  * the sketch is a threaded normal fill); only the SVD of the small
+  * [k + oversampling]^2 matrix does not. Computes in the dtype of A.
+  *
+  * opts: {oversampling (default 10), powerIterations (default 2)}.
+  * Returns {U, S, V} with U [m, k], S [k] and V [n, k].
+  */
+function randomizedSVD(A, k, opts) {
+  opts = Object.assign({oversampling: 10, powerIterations: 2}, opts);
+  A = denseTensor.numberToTensor(A);
+  var dtype = A.dtype;
+  var [m, n] = A.shape;
+  k = Math.min(k, m, n);
+  var width = Math.min(k + opts.oversampling, m, n);
+  var At = A.transpose();
+
+  var sketch = denseTensor.normalLike([n, width], 0, 1, dtype);
+  var Q = denseTensor.contract(A, sketch, 1);
+  qr(Q, Q);
+  for(let i=0; i<opts.powerIterations; i++) {
+    let Z = qr(denseTensor.contract(At, Q, 1)).Q;
+    denseTensor.contract(A, Z, 1, Q);
+    qr(Q, Q);
+  }
+  var {Q: P, R} = qr(denseTensor.contract(At, Q, 1));
+  var small = svd(R.transpose());
+  var U = denseTensor.contract(Q, small.U.toDataType(dtype), 1);
+  var V = denseTensor.contract(P, small.V.toDataType(dtype), 1);
+  return {
+    U: leadingColumns(U, k),
+    S: new denseTensor.Tensor({shape: [k], data: small.S.data.slice(0, k), dtype}),
+    V: leadingColumns(V, k)
+  };
+}
+exports.randomizedSVD = randomizedSVD;
@@ -0,0 +1,55 @@
+/* jshint esversion: 6 */
+
+var denseTensor = require('./denseTensor');
+var lazy = require('./lazy');
+var tensorBinding = require('../../build/Release/tensorBinding');
+
+/**
+  * losses computed natively together with their gradient in one pass (see
+  * csrc/losses.h). Each function returns {loss, grad}, where grad is the
+  * derivative of the sum of loss with respect to the predictions. loss
+  * and grad default to new tensors and may be passed to be overwritten,
+  * in which case they must be row-major and of the dtype of the
+  * predictions. Labels are a tensor or a number.
+  */
+
+var isRowMajor = denseTensor.isRowMajor;
+var rowMajor = denseTensor.rowMajor;
+
+function nativeLoss(kernel, pred, label, lossShape, loss, grad) {
+  var dtype = denseTensor.resultDataType(denseTensor.numberToTensor(pred));
+  pred = rowMajor(pred, dtype);
+  label = rowMajor(label, dtype);
+  if(loss === undefined)
+    loss = denseTensor.zerosLike(lossShape(pred), dtype);
+  if(grad === undefined)
+    grad = denseTensor.zerosLike(pred.shape, dtype);
+  lazy.beforeWrite(loss);
+  lazy.beforeWrite(grad);
+  kernel(pred, label, loss, grad);
+  return {loss, grad};
+}
+
+//log(1 + exp(-label * pred)) elementwise, for labels of -1 and 1.
+function logisticLoss(pred, label, loss, grad) {
+  return nativeLoss(tensorBinding.logisticLoss, pred, label, pred => pred.shape, loss, grad);
+}
+exports.logisticLoss = logisticLoss;
+
+//(pred - label)^2 / 2 elementwise.
+function squaredLoss(pred, label, loss, grad) {
+  return nativeLoss(tensorBinding.squaredLoss, pred, label, pred => pred.shape, loss, grad);
+}
+exports.squaredLoss = squaredLoss;
+
+/**
+  * the cross entropy of softmax(logits) over the last dimension, for
+  * labels holding the class of each row (loss has the shape of logits
+  * without its last dimension) or target probabilities with the shape of
+  * logits.
+  */
+function softmaxCrossEntropy(logits, labels, loss, grad) {
+  var rowShape = logits => logits.numDimensions > 1 ? [...logits.shape].slice(0, -1) : [1];
+  return nativeLoss(tensorBinding.softmaxCrossEntropy, logits, labels, rowShape, loss, grad);
+}
+exports.softmaxCrossEntropy = softmaxCrossEntropy;
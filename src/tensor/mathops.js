@@ -2,6 +2,7 @@
 
 var denseTensor = require('./denseTensor');
 var sparseTensor = require('./sparseTensor');
+var lazy = require('./lazy');
 var nodetensor = require('../../build/Release/tensorBinding');
 
 var mathjs = require('mathjs');
@@ -19,11 +20,14 @@ function exportOp(opname, canSparse, opfunc) {
     if(source.sparse) {
       return source.apply(opfunc, dest);
     } else {
+      if(lazy.getLazyEvaluation())
+        return lazy.record(x => x[opname](), [source], dest);
       source = denseTensor.numberToTensor(source);
       if(dest === undefined)
         dest = denseTensor.zerosLike(source);
       dest = denseTensor.numberToTensor(dest);
 
+      lazy.beforeWrite(dest);
       nodetensor[opname](source, dest);
 
       return dest;
@@ -58,11 +62,15 @@ function exportBinaryOp(opname, canSparse, commutative, opfunc) {
     if(source1.sparse) {
       return source1.applyBinary(opfunc, source2, dest);
     } else {
+      if(lazy.getLazyEvaluation())
+        return lazy.record((x, y) => x[opname](y), [source1, source2], dest);
       source1 = denseTensor.numberToTensor(source1);
       if(dest === undefined)
-        dest = denseTensor.zerosLike(denseTensor.broadcastShape(source1, source2));
+        dest = denseTensor.zerosLike(denseTensor.broadcastShape(source1, source2),
+                                     denseTensor.resultDataType(source1, source2));
       dest = denseTensor.numberToTensor(dest);
 
+      lazy.beforeWrite(dest);
       nodetensor[opname](source1, source2, dest);
 
       return dest;
@@ -0,0 +1,243 @@
+/* jshint esversion: 6 */
+
+/**
+  * data-parallel map over shared tensors on a pool of worker threads.
+  *
+  *   var X = tensor.random.normalLike([10000, 100], 0, 1).toShared();
+  *   var Y = tensor.zerosLike(X).toShared();
+  *   parallel.map((x, y) => tensor.exp(x, y), [X, Y]).then(() => ...);
+  *
+  * map splits every tensor argument along its first dimension into one
+  * contiguous block of rows per task and calls func on the blocks in the
+  * workers. The blocks are views on the shared storage of the arguments,
+  * so nothing is copied and whatever func writes to them is visible to the
+  * caller once the promise resolves. Tensors wrapped with whole(T) are
+  * passed unsplit, and other arguments are passed as they are.
+  *
+  * func is sent to the workers as source code, so it cannot use variables
+  * from the scope it was written in. Inside it, `tensor` is this library's
+  * tensor module and `require` is available. Its last argument is
+  * {index, start, end}, the task number and the rows it covers. map
+  * resolves to the list of values returned by the tasks; func may also
+  * return a promise.
+  *
+  * Every tensor passed to map must be shared (see Tensor.toShared). The
+  * caller must not modify them until the promise settles.
+  */
+
+var os = require('os');
+var path = require('path');
+var denseTensor = require('./denseTensor');
+var lazy = require('./lazy');
+
+var WORKER_SCRIPT = path.join(__dirname, 'parallelWorker.js');
+
+function loadWorkerThreads() {
+  try {
+    return require('worker_threads');
+  } catch(error) {
+    throw new Error('parallel map requires worker_threads, which this version of node does not provide');
+  }
+}
+
+class Whole {
+  constructor(tensor) {
+    this.tensor = tensor;
+  }
+}
+
+/**
+  * marks a tensor to be passed to every task unsplit.
+  */
+function whole(tensor) {
+  return new Whole(tensor);
+}
+exports.whole = whole;
+
+function toMessage(value) {
+  if(!(value instanceof denseTensor.Tensor))
+    return value;
+  return {
+    isTensor: true,
+    dtype: value.dtype,
+    shape: value.shape,
+    strides: value.strides,
+    initial_offset: value.initial_offset,
+    data: value.data
+  };
+}
+exports.toMessage = toMessage;
+
+function fromMessage(value) {
+  if(value === null || typeof value !== 'object' || !value.isTensor)
+    return value;
+  var {dtype, shape, strides, initial_offset, data} = value;
+  return new denseTensor.Tensor({dtype, shape, strides, initial_offset, data});
+}
+exports.fromMessage = fromMessage;
+
+//rows [start, end) of T, as a view on the same storage.
+function rowView(T, start, end) {
+  var shape = T.shape.slice(0);
+  shape[0] = end - start;
+  return {
+    isTensor: true,
+    dtype: T.dtype,
+    shape,
+    strides: T.strides,
+    initial_offset: T.initial_offset + start * T.strides[0],
+    data: T.data
+  };
+}
+
+function checkShared(T) {
+  if(!(T instanceof denseTensor.Tensor))
+    throw new Error('parallel map only supports dense tensors');
+  lazy.beforeWrite(T);
+  lazy.materialize(T);
+  if(!denseTensor.isShared(T))
+    throw new Error('parallel map requires shared tensors, see Tensor.toShared()');
+}
+
+class WorkerPool {
+  constructor(numWorkers) {
+    this.numWorkers = numWorkers || os.cpus().length;
+    this.workers = [];
+    this.idle = [];
+    this.queue = [];
+  }
+
+  spawn() {
+    var {Worker} = loadWorkerThreads();
+    var worker = new Worker(WORKER_SCRIPT);
+    worker.on('message', message => this.finish(worker, message));
+    worker.on('error', error => this.fail(worker, error));
+    //idle workers do not keep the process alive.
+    worker.unref();
+    this.workers.push(worker);
+    return worker;
+  }
+
+  dispatch() {
+    while(this.queue.length > 0) {
+      let worker = this.idle.pop();
+      if(worker === undefined) {
+        if(this.workers.length >= this.numWorkers)
+          return;
+        worker = this.spawn();
+      }
+      let task = this.queue.shift();
+      worker.task = task;
+      worker.ref();
+      worker.postMessage(task.message);
+    }
+  }
+
+  finish(worker, message) {
+    var task = worker.task;
+    worker.task = undefined;
+    worker.unref();
+    this.idle.push(worker);
+    if(message.error !== undefined) {
+      let error = new Error(message.error);
+      error.stack = message.stack;
+      task.reject(error);
+    } else {
+      task.resolve(fromMessage(message.result));
+    }
+    this.dispatch();
+  }
+
+  fail(worker, error) {
+    this.workers.splice(this.workers.indexOf(worker), 1);
+    if(worker.task !== undefined)
+      worker.task.reject(error);
+    this.dispatch();
+  }
+
+  /**
+    * runs one call of func (a function or its source) in a worker.
+    */
+  run(func, args) {
+    var message = {source: func.toString(), args: args.map(toMessage)};
+    return new Promise((resolve, reject) => {
+      this.queue.push({message, resolve, reject});
+      this.dispatch();
+    });
+  }
+
+  /**
+    * see the top of this file. opts.numTasks sets how many blocks the
+    * tensors are split into, by default the number of workers.
+    */
+  map(func, args, opts) {
+    try {
+      return Promise.all(this.splitTasks(func, args, opts || {}));
+    } catch(error) {
+      return Promise.reject(error);
+    }
+  }
+
+  splitTasks(func, args, opts) {
+    var source = func.toString();
+    var numRows;
+    for(let arg of args) {
+      if(arg instanceof Whole) {
+        checkShared(arg.tensor);
+      } else if(arg instanceof denseTensor.Tensor) {
+        checkShared(arg);
+        if(numRows === undefined)
+          numRows = arg.shape[0];
+        else if(arg.shape[0] !== numRows)
+          throw new Error('parallel map: tensors split across tasks must have the same first dimension');
+      }
+    }
+    if(numRows === undefined)
+      throw new Error('parallel map needs at least one tensor to split');
+
+    var numTasks = Math.max(1, Math.min(opts.numTasks || this.numWorkers, numRows));
+    var tasks = [];
+    for(let index=0; index<numTasks; index++) {
+      let start = Math.floor(index * numRows / numTasks);
+      let end = Math.floor((index + 1) * numRows / numTasks);
+      let taskArgs = args.map(arg => {
+        if(arg instanceof Whole)
+          return toMessage(arg.tensor);
+        if(arg instanceof denseTensor.Tensor)
+          return rowView(arg, start, end);
+        return arg;
+      });
+      taskArgs.push({index, start, end});
+      tasks.push(this.run(source, taskArgs));
+    }
+    return tasks;
+  }
+
+  /**
+    * stops every worker. Tasks not yet started are rejected.
+    */
+  terminate() {
+    var queue = this.queue;
+    this.queue = [];
+    for(let task of queue) {
+      task.reject(new Error('worker pool terminated'));
+    }
+    var workers = this.workers;
+    this.workers = [];
+    this.idle = [];
+    return Promise.all(workers.map(worker => worker.terminate()));
+  }
+}
+exports.WorkerPool = WorkerPool;
+
+var defaultPool;
+
+/**
+  * map on a default pool with one worker per cpu, created on first use.
+  */
+function map(func, args, opts) {
+  if(defaultPool === undefined)
+    defaultPool = new WorkerPool();
+  return defaultPool.map(func, args, opts);
+}
+exports.map = map;
@@ -0,0 +1,29 @@
+/* jshint esversion: 6 */
+
+//entry point of the worker threads of parallel.WorkerPool.
+
+var {parentPort} = require('worker_threads');
+var tensor = require('./index');
+var parallel = require('./parallel');
+
+var compiled = new Map();
+
+function compile(source) {
+  var func = compiled.get(source);
+  if(func === undefined) {
+    /* jshint evil: true */
+    func = new Function('tensor', 'require', 'return (' + source + ');')(tensor, require);
+    compiled.set(source, func);
+  }
+  return func;
+}
+
+parentPort.on('message', ({source, args}) => {
+  new Promise(resolve => {
+    resolve(compile(source)(...args.map(parallel.fromMessage)));
+  }).then(result => {
+    parentPort.postMessage({result: parallel.toMessage(result)});
+  }, error => {
+    parentPort.postMessage({error: String(error && error.message), stack: error && error.stack});
+  });
+});
@@ -0,0 +1,217 @@
+/* jshint esversion: 6 */
+
+var denseTensor = require('./denseTensor');
+var lazy = require('./lazy');
+var tensorBinding = require('../../build/Release/tensorBinding');
+
+var OffsetType = Uint32Array;
+var IndexType = Uint32Array;
+var ValueType = Float64Array;
+
+/**
+  * a sparse matrix in compressed sparse row ('csr') or compressed sparse
+  * column ('csc') format. In csr format the nonzeros of row i are
+  * values[k] at column indices[k], for offsets[i] <= k < offsets[i+1];
+  * csc is the same with rows and columns swapped. Indices within a row
+  * (column) need not be sorted.
+  *
+  * This is the layout of tensor::SparseMatrix in csrc/sparse.h: products
+  * with dense vectors and matrices run natively, on several threads for
+  * large operands (see setNumThreads), in either format and for either the
+  * matrix or its transpose.
+  *
+  * data is {offsets, indices, values}; the arrays are used as they are.
+  */
+class SparseMatrix {
+  constructor(shape, data, format) {
+    if(format === undefined)
+      format = 'csr';
+    if(format !== 'csr' && format !== 'csc')
+      throw new Error('unknown sparse matrix format: ' + format);
+    this.numRows = shape[0];
+    this.numColumns = shape[1];
+    this.shape = [this.numRows, this.numColumns];
+    this.numDimensions = 2;
+    this.format = format;
+    this.compressedRows = format === 'csr';
+    this.offsets = data.offsets;
+    this.indices = data.indices;
+    this.values = data.values;
+    this.sparseMatrix = true;
+  }
+
+  get nnz() {
+    return this.offsets[this.offsets.length - 1];
+  }
+
+  totalSize() {
+    return this.numRows * this.numColumns;
+  }
+
+  at(row, column) {
+    if(row instanceof Array) {
+      column = row[1];
+      row = row[0];
+    }
+    var outer = this.compressedRows ? row : column;
+    var inner = this.compressedRows ? column : row;
+    for(let k=this.offsets[outer]; k<this.offsets[outer+1]; k++) {
+      if(this.indices[k] === inner)
+        return this.values[k];
+    }
+    return 0;
+  }
+
+  //yields [row, column, value] for every stored entry.
+  *entries() {
+    var outerSize = this.offsets.length - 1;
+    for(let outer=0; outer<outerSize; outer++) {
+      for(let k=this.offsets[outer]; k<this.offsets[outer+1]; k++) {
+        if(this.compressedRows)
+          yield [outer, this.indices[k], this.values[k]];
+        else
+          yield [this.indices[k], outer, this.values[k]];
+      }
+    }
+  }
+
+  /**
+    * the transpose, sharing this matrix's arrays: the csr form of a matrix
+    * is the csc form of its transpose.
+    */
+  transpose() {
+    return new SparseMatrix([this.numColumns, this.numRows], this,
+                            this.compressedRows ? 'csc' : 'csr');
+  }
+
+  //this matrix in the given format, converted with a counting sort.
+  toFormat(format) {
+    if(format === this.format)
+      return this;
+    return fromEntries(this.shape, this.entries(), format);
+  }
+
+  toCSR() {
+    return this.toFormat('csr');
+  }
+
+  toCSC() {
+    return this.toFormat('csc');
+  }
+
+  toDense(dtype) {
+    var T = denseTensor.zerosLike(this.shape, dtype);
+    for(let [row, column, value] of this.entries()) {
+      T.set([row, column], T.at([row, column]) + value);
+    }
+    return T;
+  }
+
+  matMul(other, dest) {
+    return matMul(this, other, dest);
+  }
+
+  contract(other, dimsToContract, dest) {
+    return contract(this, other, dimsToContract, dest);
+  }
+}
+exports.SparseMatrix = SparseMatrix;
+
+/**
+  * a shape[0] x shape[1] sparse matrix in the given format ('csr' by
+  * default) holding the [row, column, value] triples of entries. Entries
+  * keep their order within each row (column); repeated positions are
+  * stored as they are, and add up in products and toDense.
+  */
+function fromEntries(shape, entries, format) {
+  var compressedRows = format === undefined || format === 'csr';
+  var triples = [...entries];
+  var outerSize = compressedRows ? shape[0] : shape[1];
+  var offsets = new OffsetType(outerSize + 1);
+  for(let [row, column] of triples) {
+    let outer = compressedRows ? row : column;
+    if(!(outer >= 0 && outer < outerSize))
+      throw new Error('IndexOutOfBounds');
+    offsets[outer + 1]++;
+  }
+  for(let o=0; o<outerSize; o++) {
+    offsets[o + 1] += offsets[o];
+  }
+
+  var indices = new IndexType(triples.length);
+  var values = new ValueType(triples.length);
+  var next = offsets.slice(0, outerSize);
+  for(let [row, column, value] of triples) {
+    let k = next[compressedRows ? row : column]++;
+    indices[k] = compressedRows ? column : row;
+    values[k] = value;
+  }
+  return new SparseMatrix(shape, {offsets, indices, values}, format);
+}
+exports.fromEntries = fromEntries;
+
+//the nonzeros of a 2-dimensional dense tensor as a sparse matrix.
+function fromDense(tensor, format) {
+  if(tensor.numDimensions !== 2)
+    throw new Error('DimensionMismatchError');
+  var entries = [];
+  for(let i=0; i<tensor.shape[0]; i++) {
+    for(let j=0; j<tensor.shape[1]; j++) {
+      let value = tensor.at([i, j]);
+      if(value !== 0)
+        entries.push([i, j, value]);
+    }
+  }
+  return fromEntries(tensor.shape, entries, format);
+}
+exports.fromDense = fromDense;
+
+//dest = matrix dense, or matrix^T dense if transpose is set.
+function multiply(matrix, transpose, dense, dest) {
+  dense = denseTensor.numberToTensor(dense);
+  var numRows = transpose ? matrix.numColumns : matrix.numRows;
+  if(dest === undefined) {
+    let shape = dense.numDimensions === 2 ? [numRows, dense.shape[1]] : [numRows];
+    dest = denseTensor.zerosLike(shape, denseTensor.resultDataType(dense));
+  }
+  //the kernel reads dense while it writes dest.
+  var target = dest.data === dense.data ? denseTensor.zerosLike(dest.shape, dest.dtype) : dest;
+  lazy.beforeWrite(dest);
+  tensorBinding.sparseMatrixMultiply(matrix, transpose, dense, target);
+  if(target !== dest)
+    tensorBinding.scale(target, 1, dest);
+  return dest;
+}
+
+/**
+  * products of a sparse matrix with a dense vector or matrix, on either
+  * side. dense A times sparse S is computed as (S^T A^T)^T, writing
+  * through a transposed view of dest, so it runs the same kernels.
+  */
+function matMul(source1, source2, dest) {
+  if(source1.sparseMatrix && source2.sparseMatrix)
+    return matMul(source1, source2.toDense(), dest);
+  if(source1.sparseMatrix)
+    return multiply(source1, false, source2, dest);
+
+  source1 = denseTensor.numberToTensor(source1);
+  if(source1.numDimensions === 1)
+    return multiply(source2, true, source1, dest);
+  if(dest === undefined) {
+    dest = denseTensor.zerosLike([source1.shape[0], source2.numColumns],
+                                 denseTensor.resultDataType(source1));
+  }
+  if(dest.numDimensions !== 2)
+    throw new Error('DimensionMismatchError');
+  multiply(source2, true, source1.transpose(), dest.transpose());
+  return dest;
+}
+exports.matMul = matMul;
+
+//contract() with a sparse matrix operand; only matrix products are supported.
+function contract(source1, source2, dimsToContract, dest) {
+  if(dimsToContract !== 1)
+    throw new Error('sparse matrices only support contracting one dimension');
+  return matMul(source1, source2, dest);
+}
+exports.contract = contract;
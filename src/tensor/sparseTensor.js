@@ -1,23 +1,51 @@
 /* jshint esversion: 6 */
 
 var denseTensor = require('./denseTensor');
-var tensorUtil = require('./tensorUtil');
-
-
+var lazy = require('./lazy');
+var tensorBinding = require('../../build/Release/tensorBinding');
+
+var IndexType = Uint32Array;
+var ValueType = Float64Array;
+
+/**
+  * a sparse vector stored as sorted parallel arrays: values[k] is the entry
+  * at indices[k] for k < nnz, indices are strictly increasing and every
+  * other entry is zero. The arrays may have spare capacity past nnz, so
+  * that set() can insert without reallocating every time.
+  *
+  * This is the layout of tensor::SparseVector in csrc/sparse.h, so the
+  * dot products, axpys, scalings and sums below run natively without
+  * converting anything.
+  *
+  * data is either a list (or Map) of [index, value] pairs or
+  * {indices, values, nnz}, whose arrays are used as they are.
+  * length may be left undefined.
+  */
 class SparseVector {
   constructor(data, length) {
-    this.length = length;
-    this.data = data;
-
-    if(this.data === undefined)
-      this.data = new Map();
-    if(Symbol.iterator in this.data)
-      this.data = new Map(this.data);
+    if(data !== undefined && data.indices !== undefined) {
+      this.indices = data.indices;
+      this.values = data.values;
+      this.nnz = data.nnz === undefined ? data.indices.length : data.nnz;
+    } else {
+      this.setPairs(data === undefined ? [] : [...data]);
+    }
 
     this.sparse = true;
-    this.shape = [length];
-
     this.numDimensions = 1;
+    this.setLength(length);
+  }
+
+  setPairs(pairs) {
+    //later pairs win, as they would in a Map.
+    var entries = new Map(pairs);
+    var indices = [...entries.keys()].sort((a, b) => a - b);
+    this.indices = new IndexType(indices);
+    this.values = new ValueType(indices.length);
+    for(let k=0; k<indices.length; k++) {
+      this.values[k] = entries.get(indices[k]);
+    }
+    this.nnz = indices.length;
   }
 
   setLength(length) {
@@ -31,25 +59,84 @@ class SparseVector {
     return this.length;
   }
 
+  /**
+    * position of coord in indices, or -(insertion point) - 1 if coord is
+    * not stored.
+    */
+  search(coord) {
+    var low = 0;
+    var high = this.nnz - 1;
+    while(low <= high) {
+      let middle = (low + high) >>> 1;
+      let index = this.indices[middle];
+      if(index < coord)
+        low = middle + 1;
+      else if(index > coord)
+        high = middle - 1;
+      else
+        return middle;
+    }
+    return -low - 1;
+  }
+
   at(coord) {
     if(coord instanceof Array)
       coord = coord[0];
-    return this.data.get(coord) || 0;
+    var position = this.search(coord);
+    return position >= 0 ? this.values[position] : 0;
   }
 
   broadcastAt(coord) {
-    if(coord instanceof Array)
-      coord = coord[0];
-    return this.data.get(coord) || 0;
+    return this.at(coord);
   }
 
   set(coord, value) {
     if(coord instanceof Array)
       coord = coord[0];
+    var position = this.search(coord);
+    if(position >= 0) {
+      if(value === 0) {
+        this.indices.copyWithin(position, position + 1, this.nnz);
+        this.values.copyWithin(position, position + 1, this.nnz);
+        this.nnz--;
+      } else {
+        this.values[position] = value;
+      }
+      return;
+    }
     if(value === 0)
-      this.data.delete(coord);
-    else
-      this.data.set(coord, value);
+      return;
+
+    position = -position - 1;
+    if(this.nnz === this.indices.length)
+      this.reserve(Math.max(4, 2 * this.nnz));
+    this.indices.copyWithin(position + 1, position, this.nnz);
+    this.values.copyWithin(position + 1, position, this.nnz);
+    this.indices[position] = coord;
+    this.values[position] = value;
+    this.nnz++;
+  }
+
+  reserve(capacity) {
+    if(capacity <= this.indices.length)
+      return;
+    var indices = new IndexType(capacity);
+    var values = new ValueType(capacity);
+    indices.set(this.indices.subarray(0, this.nnz));
+    values.set(this.values.subarray(0, this.nnz));
+    this.indices = indices;
+    this.values = values;
+  }
+
+  *entries() {
+    for(let k=0; k<this.nnz; k++) {
+      yield [this.indices[k], this.values[k]];
+    }
+  }
+
+  //a Map of the nonzeros, as data used to be. It is a copy: set() writes.
+  get data() {
+    return new Map(this.entries());
   }
 
   dot(other) {
@@ -61,19 +148,32 @@ class SparseVector {
   }
 
   clone() {
-    return new SparseVector(this.data, this.length);
+    return new SparseVector({
+      indices: this.indices.slice(0, this.nnz),
+      values: this.values.slice(0, this.nnz)
+    }, this.length);
+  }
+
+  //a vector with the same nonzero positions as this one and zero values.
+  emptyLike() {
+    return new SparseVector({
+      indices: this.indices.slice(0, this.nnz),
+      values: new ValueType(this.nnz)
+    }, this.length);
   }
 
   applyInPlace(func) {
-    for(let [key, value] of this.data) {
-      this.data.set(key, func(value));
+    for(let k=0; k<this.nnz; k++) {
+      this.values[k] = func(this.values[k]);
     }
     return this;
   }
 
   copyFrom(other) {
-    this.length = other.length;
-    this.data = new Map(other.data);
+    this.setLength(other.length);
+    this.indices = other.indices.slice(0, other.nnz);
+    this.values = other.values.slice(0, other.nnz);
+    this.nnz = other.nnz;
   }
 
   apply(func, dest) {
@@ -81,16 +181,18 @@ class SparseVector {
       dest = this.clone();
       return dest.applyInPlace(func);
     } else {
-      for(let [key, value] of this.data) {
-        dest.set([key], func(value));
+      for(let k=0; k<this.nnz; k++) {
+        dest.set([this.indices[k]], func(this.values[k]));
       }
       return dest;
     }
   }
 
   copyTo(dest) {
-    for(let [key, value] of this.data) {
-      dest.set([key], value);
+    if(!dest.sparse)
+      lazy.beforeWrite(dest);
+    for(let k=0; k<this.nnz; k++) {
+      dest.set([this.indices[k]], this.values[k]);
     }
   }
 
@@ -99,47 +201,95 @@ class SparseVector {
       dest = this.clone();
       return dest.applyBinaryInPlace(func, other);
     } else {
-      for(let [key, value] of this.data) {
-        dest.set([key], func(value, other.at([key])));
+      for(let k=0; k<this.nnz; k++) {
+        let index = this.indices[k];
+        dest.set([index], func(this.values[k], other.broadcastAt([index])));
       }
       return dest;
     }
   }
 
   applyBinaryInPlace(func, other) {
-    for(let [key, value] of this.data) {
-      this.data.set(key, func(value, other.at(key)));
+    for(let k=0; k<this.nnz; k++) {
+      this.values[k] = func(this.values[k], other.broadcastAt([this.indices[k]]));
     }
-    return this;    
+    return this;
   }
 
   toDense(length) {
     if(length === undefined)
       length = this.length;
-    if(this.length === undefined)
-      length = this.data.size;
+    if(length === undefined)
+      length = this.nnz === 0 ? 0 : this.indices[this.nnz - 1] + 1;
 
     var T = new denseTensor.Tensor({shape: [length]});
-    for(let [key, value] of this.data) {
-      T.set(key, value);
-    }
+    tensorBinding.sparseAxpy(this, 1, T);
     return T;
   }
 }
 exports.SparseVector = SparseVector;
 
-function multiplyScale(sparse, dense, scaleFactor, dest) {
-  if(!isNaN(dense)) {
-    return scale(sparse, dense*scaleFactor, dest);
+//dense operands the native kernels take directly.
+function isDenseVector(tensor) {
+  return tensor instanceof denseTensor.Tensor && tensor.numDimensions === 1;
+}
+
+/**
+  * hands back result, which has the structure of a sparse source, as the
+  * value of an op called with dest. A sparse dest becomes a copy of result
+  * and a dense dest becomes its dense form. If the op allocated result
+  * itself (owned), a sparse dest takes its arrays instead of copying them.
+  */
+function deliver(result, dest, owned) {
+  if(dest === undefined || dest === result)
+    return result;
+  if(dest.sparse && owned) {
+    dest.setLength(result.length);
+    dest.indices = result.indices;
+    dest.values = result.values;
+    dest.nnz = result.nnz;
+  } else if(dest.sparse) {
+    dest.copyFrom(result);
+  } else if(isDenseVector(dest)) {
+    lazy.beforeWrite(dest);
+    tensorBinding.scale(denseTensor.zerosLike(dest), 1, dest);
+    tensorBinding.sparseAxpy(result, 1, dest);
+  } else {
+    result.copyTo(dest);
   }
-  if(dest === undefined) {
-    dest = new SparseVector();
-    dest.setLength(sparse.length);
+  return dest;
+}
+
+//an empty vector with room for capacity nonzeros.
+function withCapacity(capacity, length) {
+  return new SparseVector({
+    indices: new IndexType(capacity),
+    values: new ValueType(capacity),
+    nnz: 0
+  }, length);
+}
+
+function gatherScale(sparse, dense, scaleFactor, divide, dest) {
+  var result = dest === sparse ? sparse : sparse.emptyLike();
+  if(isDenseVector(dense)) {
+    tensorBinding.sparseGatherScale(sparse, dense, scaleFactor, divide, result);
+  } else {
+    for(let k=0; k<sparse.nnz; k++) {
+      let other = dense.broadcastAt(sparse.indices[k]);
+      result.values[k] = scaleFactor * (divide ? sparse.values[k] / other : sparse.values[k] * other);
+    }
   }
-  for(let [key, value] of sparse.data) {
-    dest.set(key, scaleFactor * value * dense.broadcastAt(key));
+  return deliver(result, dest, true);
+}
+
+function multiplyScale(sparse, other, scaleFactor, dest) {
+  if(!isNaN(other)) {
+    return scale(sparse, other*scaleFactor, dest);
   }
-  return dest;
+  if(other.sparse) {
+    return multiplyScaleSparseSparse(sparse, other, scaleFactor, dest);
+  }
+  return gatherScale(sparse, other, scaleFactor, false, dest);
 }
 exports.multiplyScale = multiplyScale;
 
@@ -152,64 +302,67 @@ function addScale(source1, source2, scale1, scale2, dest) {
 }
 exports.addScale = addScale;
 
+//merges the sorted index lists natively, into a result sized once for the union.
 function addScaleSparseSparse(sparse1, sparse2, scale1, scale2, dest) {
-  if(dest === undefined) {
-    dest = new SparseVector();
-    dest.setLength(Math.max(sparse1.length, sparse2.length));
-  }
-  for(let [key, value] of sparse1.data) {
-    dest.set(key, dest.at(key) + scale1 * value);
-  }
-  for(let [key, value] of sparse2.data) {
-    dest.set(key, dest.at(key) + scale2 * value);
+  var result = withCapacity(sparse1.nnz + sparse2.nnz, Math.max(sparse1.length, sparse2.length));
+  result.nnz = tensorBinding.sparseSparseAddScale(sparse1, sparse2, scale1, scale2, result);
+  return deliver(result, dest, true);
+}
+
+/**
+  * the sum of a nonempty list of sparse vectors, merged in pairs so that
+  * each nonzero is copied once per round, in O(log(vectors.length))
+  * rounds. A single vector is returned as it is.
+  */
+function sumAll(vectors) {
+  while(vectors.length > 1) {
+    let merged = [];
+    for(let k=0; k+1<vectors.length; k+=2) {
+      merged.push(addScaleSparseSparse(vectors[k], vectors[k + 1], 1, 1));
+    }
+    if(vectors.length % 2 === 1)
+      merged.push(vectors[vectors.length - 1]);
+    vectors = merged;
   }
-  return dest;
+  return vectors[0];
+}
+exports.sumAll = sumAll;
+
+function multiplyScaleSparseSparse(sparse1, sparse2, scaleFactor, dest) {
+  var result = withCapacity(Math.min(sparse1.nnz, sparse2.nnz), Math.max(sparse1.length, sparse2.length));
+  result.nnz = tensorBinding.sparseSparseMultiplyScale(sparse1, sparse2, scaleFactor, result);
+  return deliver(result, dest, true);
 }
 
 function addScaleSparseDense(sparse, dense, scale1, scale2, dest) {
   dense = denseTensor.numberToTensor(dense);
   if(dest === undefined) {
-    dest = new denseTensor.Tensor({shape: sparse.shape});
-  }
-  denseTensor.addScale(dest, dense, 0, scale2, dest);
-  // denseTensor.scale(dense, scale2, dest);
-  for(let [key, value] of sparse.data) {
-    dest.set(key, scale1 * value +  dense.broadcastAt(key));
-  }
+    let shape = sparse.length === undefined ? dense.shape : sparse.shape;
+    dest = new denseTensor.Tensor({shape});
+  }
+  //dest += scale1 * sparse touches only the nonzeros.
+  if(dest !== dense || scale2 !== 1)
+    denseTensor.addScale(dest, dense, 0, scale2, dest);
+  lazy.beforeWrite(dest);
+  tensorBinding.sparseAxpy(sparse, scale1, dest);
   return dest;
 }
 
 
 function divideScale(sparse, dense, scale, dest) {
-  if(dest === undefined) {
-    dest = new SparseVector();
-    dest.setLength(sparse.length);
-  }
-  for(let [key, value] of sparse.data) {
-    dest.set(key, scale * value / dense.broadcastAt(key));
-  }
-  return dest;
+  return gatherScale(sparse, denseTensor.numberToTensor(dense), scale, true, dest);
 }
 exports.divideScale = divideScale;
 
 function scale(sparse, scaleFactor, dest) {
-  if(dest === undefined) {
-    dest = new SparseVector();
-    dest.setLength(sparse.length);
-  }
-  for(let [key, value] of sparse.data) {
-    dest.set(key, scaleFactor * value);
-  }
-  return dest; 
+  var result = dest === sparse ? sparse : sparse.emptyLike();
+  tensorBinding.sparseScale(sparse, scaleFactor, result);
+  return deliver(result, dest, true);
 }
 exports.scale = scale;
 
 function sum(sparse) {
-  var answer = 0;
-  for(let [key, value] of sparse.data) {
-    answer += value;
-  }
-  return answer;
+  return tensorBinding.sparseSum(sparse);
 }
 exports.sum = sum;
 
@@ -217,9 +370,16 @@ function dot(sparse, other, dest) {
   if(!sparse.sparse) {
     throw new Error('Attempted to use sparse dot product with non-sparse argument!');
   }
-  var product = 0;
-  for(let [key, value] of sparse.data) {
-    product += value * other.at(key);
+  var product;
+  if(other.sparse) {
+    product = tensorBinding.sparseSparseDot(sparse, other);
+  } else if(isDenseVector(other)) {
+    product = tensorBinding.sparseDot(sparse, other);
+  } else {
+    product = 0;
+    for(let k=0; k<sparse.nnz; k++) {
+      product += sparse.values[k] * other.at(sparse.indices[k]);
+    }
   }
   if(dest === undefined) {
     dest = new denseTensor.Tensor([product]);
@@ -240,13 +400,8 @@ function matMul(sparse, other, dest) {
   if(other.numDimensions != 2 || dest.numDimensions != 1) {
     throw new Error('DimensionMismatchError');
   }
-  for(let i=0; i<dest.shape[0]; i++) {
-    let product = 0;
-    for(let [key, value] of sparse.data) {
-      product += value * other.at([key, i]);
-    }
-    dest.set([i], product);
-  }
+  lazy.beforeWrite(dest);
+  tensorBinding.sparseMatMul(sparse, other, dest);
   return dest;
 }
 exports.matMul = matMul;
@@ -146,6 +146,273 @@ describe('AutoGrad', function() {
       assert.equal(V1.grad, undefined);
       assert.equal(V2.grad.at(5), 10);
     });
+
+    it('keeps gradients of sparse features sparse', function() {
+      var n = 100000;
+      var w = new autograd.Variable(tensor.fillLike(tensor.zerosLike([n]), 0.5));
+      var scalings = new autograd.Variable(tensor.fillLike(w.data, 2), {requiresGrad: false});
+      var features = [[[3, 1], [70, 2]], [[3, -1], [900, 4]], [[5, 2]]].map(pairs =>
+        new autograd.Variable(new tensor.SparseVector(pairs, n), {requiresGrad: false}));
+
+      var loss = features.map(x => w.dot(x.div(scalings))).reduce((a, b) => a.add(b)).square();
+      loss.backward();
+
+      //d/dw (sum_i <w, x_i / 2>)^2 = (sum_i <w, x_i / 2>) * sum_i x_i
+      var total = 0.5 * (1 + 2 - 1 + 4 + 2) / 2;
+      assert(w.grad instanceof tensor.SparseVector);
+      assert(w.grad.nnz <= 4);
+      [[3, 0], [5, 2], [70, 2], [900, 4], [6, 0]].forEach(([i, x]) =>
+        assert.equal(w.grad.at(i), total * x));
+      assert.equal(features[0].div(scalings).requiresGrad, false);
+    });
+
+    it('runs every backward once on graphs that reuse values', function() {
+      //y_{i+1} = y_i + y_i has 2^depth paths back to x.
+      var depth = 40;
+      var x = new autograd.Variable(tensor.onesLike([3]));
+      var y = x.mul(x);
+      var ops = [y.parent];
+      for(let i=0; i<depth; i++) {
+        y = y.add(y);
+        ops.push(y.parent);
+      }
+      var calls = 0;
+      ops.forEach(op => {
+        var backward = op.backward;
+        op.backward = function(...args) { calls++; return backward.apply(this, args); };
+      });
+      var loss = y.sum();
+      loss.zeroGrad();
+      loss.backward();
+
+      //one call per input of each op, however many paths lead to it.
+      assert.equal(calls, 2 * ops.length);
+      //d/dx 2^depth x^2 = 2^(depth + 1) x.
+      assert.equal(x.grad.at(1), Math.pow(2, depth + 1));
+      loss.backward();
+      assert.equal(x.grad.at(1), Math.pow(2, depth + 2));
+    });
+
+    it('replays a captured tape', function() {
+      var x = new autograd.Variable(tensor.random.normalLike([5], 0, 1));
+      var y = new autograd.Variable(tensor.random.normalLike([5], 0, 1), {requiresGrad: false});
+      var captures = 0;
+      var lossFunc = () => {
+        captures++;
+        return x.mul(y).sin().add(x.square()).add(x).sum();
+      };
+      var tape = new autograd.Tape(lossFunc);
+
+      function check() {
+        var loss = tape.run();
+        var xGrad = x.grad.toDataType('float64');
+        var expected = lossFunc();
+        expected.zeroGrad();
+        expected.backward();
+        captures--;
+        assert.ok(Math.abs(loss.data.data[0] - expected.data.data[0]) < 1e-12);
+        for(let i=0; i<x.data.shape[0]; i++)
+          assert.ok(Math.abs(xGrad.data[i] - x.grad.data[i]) < 1e-12);
+      }
+
+      check();
+      for(let step=0; step<3; step++) {
+        x.data = tensor.random.normalLike([5], 0, 1);
+        check();
+      }
+      assert.equal(captures, 1);
+
+      //new shapes are captured again.
+      x.data = tensor.random.normalLike([7], 0, 1);
+      y.data = tensor.random.normalLike([7], 0, 1);
+      check();
+      assert.equal(captures, 2);
+      assert.equal(x.grad.shape[0], 7);
+    });
+
+    it('fuses chains of elementwise operations on tapes', function() {
+      var x = new autograd.Variable(tensor.random.normalLike([50], 0, 1));
+      var w = new autograd.Variable(tensor.random.uniformLike([50], 1, 2));
+      var lossFunc = () => {
+        var a = x.scale(-2).exp().add(w).log();
+        var b = a.mul(x).div(w).sin().square();
+        return b.sub(a.abs().sqrt()).sum();
+      };
+      var plain = new autograd.Tape(lossFunc, {fuse: false});
+      var fused = new autograd.Tape(lossFunc);
+      for(let step=0; step<2; step++) {
+        x.data = tensor.random.normalLike([50], 0, 1);
+        let expected = plain.run().data.data[0];
+        let expectedGrads = [x.grad, w.grad].map(g => g.toDataType('float64'));
+        let loss = fused.run();
+        assert.ok(Math.abs(loss.data.data[0] - expected) <= 1e-12 * Math.abs(expected));
+        [x.grad, w.grad].forEach((grad, k) => {
+          for(let i=0; i<50; i++)
+            assert.ok(Math.abs(grad.data[i] - expectedGrads[k].data[i]) <= 1e-10 * (1 + Math.abs(grad.data[i])));
+        });
+      }
+      //a is used twice, so it is one fused operation, and the rest another.
+      assert.equal(autograd.topologicalOrder(fused.loss, true).length, 3);
+      assert.ok(fused.memory.plannedBytes < plain.memory.plannedBytes);
+    });
+
+    it('recomputes checkpointed segments with the same gradients', function() {
+      var w = new autograd.Variable(tensor.random.normalLike([4], 0, 1));
+      var x0 = tensor.random.normalLike([4], 0, 1);
+      var steps = (h, w, n) => {
+        for(let i=0; i<n; i++)
+          h = h.sin().mul(w).add(h);
+        return h;
+      };
+
+      var x = new autograd.Variable(x0);
+      var plain = steps(x, w, 16).sum();
+      plain.zeroGrad();
+      plain.backward();
+      var expected = [x.grad, w.grad];
+
+      x = new autograd.Variable(x0);
+      var h = x;
+      for(let s=0; s<4; s++)
+        h = autograd.checkpoint((h, w) => steps(h, w, 4), h, w);
+      var loss = h.sum();
+      //the outer graph holds the four segments and the sum.
+      assert.equal(autograd.topologicalOrder(loss, true).length, 5);
+      loss.zeroGrad();
+      loss.backward();
+
+      assert.deepEqual(Array.from(loss.data.data), Array.from(plain.data.data));
+      //the derivative with respect to x flows down one chain, through the
+      //same operations in the same order, so it is bitwise identical. w
+      //feeds every step: its 16 terms are summed in one order by the plain
+      //graph, but four to a segment and then across segments when
+      //checkpointed, which rounds differently.
+      assert.deepEqual(Array.from(x.grad.data), Array.from(expected[0].data));
+      for(let i=0; i<4; i++)
+        assert.ok(Math.abs(w.grad.data[i] - expected[1].data[i]) <= 1e-12 * Math.abs(expected[1].data[i]));
+    });
+
+    it('reuses buffers for intermediates of a replayed tape', function() {
+      var x = new autograd.Variable(tensor.random.uniformLike([1000], 0.5, 1));
+      var lossFunc = () => {
+        var y = x;
+        for(let i=0; i<10; i++)
+          y = y.sin().add(x).square().scale(0.1);
+        return y.sum();
+      };
+      var tape = new autograd.Tape(lossFunc, {fuse: false});
+      tape.run();
+      assert.ok(tape.memory.plannedBytes * 3 < tape.memory.naiveBytes);
+
+      x.data = tensor.random.uniformLike([1000], 0.5, 1);
+      var loss = tape.run();
+      var value = loss.data.data[0];
+      var grad = x.grad.toDataType('float64');
+      var expected = lossFunc();
+      expected.zeroGrad();
+      expected.backward();
+      assert.ok(Math.abs(value - expected.data.data[0]) < 1e-12 * Math.abs(value));
+      for(let i=0; i<1000; i++)
+        assert.ok(Math.abs(grad.data[i] - x.grad.data[i]) <= 1e-12 * Math.abs(x.grad.data[i]));
+    });
+  });
+
+  describe('fused losses', function() {
+
+    function assertClose(actual, expected) {
+      actual = actual.toDataType('float64');
+      expected = expected.toDataType('float64');
+      assert.equal(actual.totalSize(), expected.totalSize());
+      for(let i=0; i<expected.totalSize(); i++)
+        assert.ok(Math.abs(actual.data[i] - expected.data[i]) <= 1e-10 * (1 + Math.abs(expected.data[i])),
+                  actual.data[i] + ' != ' + expected.data[i]);
+    }
+
+    //the loss and the gradient of its sum, differentiated through a graph.
+    function reference(lossFunc, pred) {
+      var x = new autograd.Variable(pred);
+      var loss = lossFunc(x);
+      var total = loss.sum();
+      total.zeroGrad();
+      total.backward();
+      return {loss: loss.data, grad: x.grad};
+    }
+
+    it('computes logistic and squared losses with their gradients', function() {
+      var pred = tensor.random.normalLike([3, 4], 0, 2);
+      var label = tensor.random.uniformLike([3, 4], -1, 1).sign();
+
+      var ones = new autograd.Variable(tensor.onesLike([3, 4]), {requiresGrad: false});
+      var expected = reference(x => x.mul(label.scale(-1)).exp().add(ones).log(), pred);
+      var actual = reference(x => x.logisticLoss(label), pred);
+      assertClose(actual.loss, expected.loss);
+      assertClose(actual.grad, expected.grad);
+
+      expected = reference(x => x.sub(label).square().scale(0.5), pred);
+      actual = reference(x => x.squaredLoss(label), pred);
+      assertClose(actual.loss, expected.loss);
+      assertClose(actual.grad, expected.grad);
+
+      //exp(1000) overflows, the fused loss does not.
+      var {loss, grad} = tensor.losses.logisticLoss(new tensor.Tensor([-1000, 1000]), 1);
+      assert.deepEqual(Array.from(loss.data), [1000, 0]);
+      assert.deepEqual(Array.from(grad.data), [-1, -0]);
+    });
+
+    it('computes softmax cross entropy with its gradient', function() {
+      var logits = tensor.random.normalLike([5, 3], 0, 3);
+      var classes = new tensor.Tensor({shape: [5], data: [0, 2, 1, 1, 0]});
+      var targets = tensor.zerosLike([5, 3]);
+      for(let r=0; r<5; r++)
+        targets.set([r, classes.data[r]], 1);
+
+      //logsumexp(z) - z[class] and softmax(z) - onehot(class), row by row.
+      var expected = {loss: tensor.zerosLike([5]), grad: tensor.zerosLike([5, 3])};
+      for(let r=0; r<5; r++) {
+        let z = [0, 1, 2].map(c => logits.at(r, c));
+        let sum = z.reduce((total, value) => total + Math.exp(value), 0);
+        expected.loss.set(r, Math.log(sum) - z[classes.data[r]]);
+        z.forEach((value, c) => expected.grad.set([r, c], Math.exp(value) / sum - targets.at(r, c)));
+      }
+
+      assertClose(reference(x => x.softmaxCrossEntropy(classes), logits).loss, expected.loss);
+      assertClose(reference(x => x.softmaxCrossEntropy(classes), logits).grad, expected.grad);
+      assertClose(reference(x => x.softmaxCrossEntropy(targets), logits).grad, expected.grad);
+
+      assert.throws(() => tensor.losses.softmaxCrossEntropy(logits, classes.scale(3)), /IndexOutOfBounds/);
+    });
+
+    it('differentiates losses with respect to labels', function() {
+      var pred = new autograd.Variable(tensor.random.normalLike([3, 4], 0, 2), {requiresGrad: false});
+      var label = tensor.random.normalLike([3, 4], 0, 1);
+      var expected = reference(y => pred.sub(y).square().scale(0.5), label);
+      assertClose(reference(y => pred.squaredLoss(y), label).grad, expected.grad);
+      var ones = new autograd.Variable(tensor.onesLike([3, 4]), {requiresGrad: false});
+      expected = reference(y => pred.mul(y).scale(-1).exp().add(ones).log(), label);
+      assertClose(reference(y => pred.logisticLoss(y), label).grad, expected.grad);
+
+      var classes = new autograd.Variable(new tensor.Tensor({shape: [3], data: [0, 2, 1]}));
+      assert.throws(() => autograd.softmaxCrossEntropy(pred, classes), /differentiable/);
+    });
+
+    it('replays losses against the labels a tape is run with', function() {
+      var w = new autograd.Variable(new tensor.Tensor([0.5, -1]));
+      var X = new autograd.Variable(new tensor.Tensor([1, 2]), {requiresGrad: false});
+      var y = new autograd.Variable(new tensor.Tensor([1]), {requiresGrad: false});
+      var lossFunc = () => autograd.logisticLoss(w.dot(X), y).sum();
+      var tape = new autograd.Tape(lossFunc);
+      for(let labels of [[1], [-1], [1]]) {
+        y.data = new tensor.Tensor(labels);
+        let loss = tape.run().data.data[0];
+        let wGrad = w.grad.toDataType('float64');
+        let expected = lossFunc();
+        expected.zeroGrad();
+        expected.backward();
+        assert.ok(Math.abs(loss - expected.data.data[0]) < 1e-12);
+        for(let i=0; i<2; i++)
+          assert.ok(Math.abs(wGrad.data[i] - w.grad.data[i]) < 1e-12);
+      }
+    });
   });
 
   describe('optimizer', function() {
@@ -173,5 +440,166 @@ describe('AutoGrad', function() {
     it('FreeRex should optimize', function() {
       testOptimizer(vars => {return new optim.FreeRex({vars: vars});});
     });
+    it('optimizes by replaying a loss function', function() {
+      var x = new autograd.Variable([10, 8]);
+      var y = new autograd.Variable([3, -4], {requiresGrad: false});
+      var opt = new optim.AdaGrad({lr: 1.0, vars: [x]});
+      var lossFunc = () => x.dot(y).sub(6).square();
+      for(let t=1; t<100; t++) {
+        opt.step(lossFunc);
+      }
+      assertSmall(lossFunc().data);
+    });
+    it('updates dense variables natively as tensor ops would', function() {
+      var n = 1000;
+      for(let Optimizer of [optim.SGD, optim.AdaGrad, optim.FreeRex]) {
+        let native = new autograd.Variable(tensor.zerosLike([n]));
+        let ops = new autograd.Variable(tensor.zerosLike([n]));
+        let nativeOpt = new Optimizer({lr: 0.3, vars: [native]});
+        let opsOpt = new Optimizer({lr: 0.3, vars: [ops]});
+        for(let t=0; t<10; t++) {
+          //strided weights do not fit the kernels.
+          let strided = new tensor.Tensor({shape: [n], strides: [2], data: new Float64Array(2 * n)});
+          for(let i=0; i<n; i++)
+            strided.data[2 * i] = ops.data.at(i);
+          ops.data = strided;
+          native.grad = tensor.zerosLike([n]);
+          for(let i=0; i<n; i++)
+            native.grad.data[i] = Math.random() * 4 - 2;
+          ops.grad = native.grad;
+          let weights = native.data;
+          nativeOpt.applyGrads([native]);
+          opsOpt.applyGrads([ops]);
+          assert.strictEqual(native.data, weights);
+          for(let i=0; i<n; i++)
+            assert(Math.abs(native.data.at(i) - ops.data.at(i)) < 1e-12, Optimizer.name + ' at ' + i);
+        }
+      }
+    });
+    it('applies sparse grads lazily as dense updates would', function() {
+      var n = 50;
+      for(let Optimizer of [optim.SGD, optim.AdaGrad, optim.FreeRex]) {
+        let sparse = new autograd.Variable(tensor.zerosLike([n]));
+        let dense = new autograd.Variable(tensor.zerosLike([n]));
+        let sparseOpt = new Optimizer({lr: 0.3, vars: [sparse]});
+        let denseOpt = new Optimizer({lr: 0.3, vars: [dense]});
+        for(let t=0; t<30; t++) {
+          let pairs = [0, 1, 2].map(() => [Math.floor(Math.random() * n), Math.random() * 4 - 2]);
+          sparse.grad = new tensor.SparseVector(pairs, n);
+          dense.grad = sparse.grad.toDense();
+          let before = sparse.data.data;
+          sparseOpt.applyGrads([sparse]);
+          denseOpt.applyGrads([dense]);
+          for(let i=0; i<n; i++)
+            assert(Math.abs(sparse.data.at(i) - dense.data.at(i)) < 1e-12, Optimizer.name + ' at ' + i);
+          if(t > 0)
+            assert.strictEqual(sparse.data.data, before);
+        }
+      }
+    });
+    it('updates densely when the native kernel does not take a sparse FreeRex update', function() {
+      var kernels = require('../src/optim/kernels');
+      var freeRex = kernels.freeRex;
+      var n = 20;
+      var sparse = new autograd.Variable(tensor.zerosLike([n]));
+      var dense = new autograd.Variable(tensor.zerosLike([n]));
+      var sparseOpt = new optim.FreeRex({lr: 0.3, vars: [sparse]});
+      var denseOpt = new optim.FreeRex({lr: 0.3, vars: [dense]});
+      try {
+        for(let t=0; t<10; t++) {
+          kernels.freeRex = t % 2 ? () => false : freeRex;
+          let pairs = [0, 1, 2].map(() => [Math.floor(Math.random() * n), Math.random() * 4 - 2]);
+          sparse.grad = new tensor.SparseVector(pairs, n);
+          dense.grad = sparse.grad.toDense();
+          sparseOpt.applyGrads([sparse]);
+          denseOpt.applyGrads([dense]);
+          for(let i=0; i<n; i++)
+            assert(Math.abs(sparse.data.at(i) - dense.data.at(i)) < 1e-12, 'at ' + i);
+        }
+      } finally {
+        kernels.freeRex = freeRex;
+      }
+    });
+    it('quantizes slots to a level around each value without bias', function() {
+      var n = 10000;
+      var values = tensor.zerosLike([n]);
+      for(let i=0; i<n; i++)
+        values.data[i] = (Math.random() < 0.5 ? -1 : 1) * Math.pow(10, -3 * Math.random());
+      var slot = new optim.slots.QuantizedSlot(values);
+      assert.strictEqual(optim.slots.bytes(slot), n + 4 * Math.ceil(n / 256));
+      var restored = slot.toTensor('float64');
+      var meanError = 0;
+      for(let i=0; i<n; i++) {
+        let error = (restored.data[i] - values.data[i]) / values.data[i];
+        assert(Math.abs(error) < 0.091, 'at ' + i);
+        meanError += error / n;
+      }
+      assert(Math.abs(meanError) < 0.005);
+      //values below the lowest level of their block, about 2^-16 of its largest.
+      for(let small of [1e-3, 1e-6]) {
+        let blocks = 400;
+        let tiny = tensor.fillLike([256 * blocks], small);
+        for(let b=0; b<blocks; b++)
+          tiny.data[256 * b] = 1000;
+        let tinyRestored = new optim.slots.QuantizedSlot(tiny).toTensor('float64');
+        let mean = 0;
+        for(let i=0; i<tiny.data.length; i++) {
+          if(i % 256 !== 0)
+            mean += tinyRestored.data[i] / (255 * blocks);
+        }
+        assert(Math.abs(mean - small) < 0.1 * small + 1e-6, small + ': ' + mean);
+      }
+      //values at a level stay there, whatever the rounding.
+      var restoredAgain = new optim.slots.QuantizedSlot(restored).toTensor('float64');
+      for(let i=0; i<n; i++)
+        assert(Math.abs(restoredAgain.data[i] - restored.data[i]) <= 1e-6 * Math.abs(restored.data[i]), 'at ' + i);
+    });
+    it('trains with float32 and 8-bit slots about as well as float64', function() {
+      var n = 2000;
+      var target = tensor.zerosLike([n]);
+      for(let i=0; i<n; i++)
+        target.data[i] = Math.random() * 2 - 1;
+      //FreeRex computes the weights from its slots, so they take on their rounding errors.
+      for(let [Optimizer, lr, int8Error] of [[optim.AdaGrad, 0.1, 1e-3], [optim.FreeRex, 0.45, 0.05]]) {
+        let trained = {};
+        for(let slotType of ['float64', 'float32', 'int8']) {
+          let x = new autograd.Variable(tensor.zerosLike([n]));
+          let opt = new Optimizer({lr: lr, vars: [x], slotType: slotType});
+          for(let t=0; t<200; t++) {
+            x.grad = x.data.sub(target);
+            opt.applyGrads([x]);
+          }
+          trained[slotType] = {x: x.data, bytes: opt.slotBytes()};
+        }
+        let distance = (a, b) => Math.sqrt(a.sub(b).square().sum().at(0) / n);
+        let baseline = distance(trained.float64.x, target);
+        assert(baseline < 1e-3, Optimizer.name);
+        assert(distance(trained.float32.x, trained.float64.x) < 1e-6, Optimizer.name);
+        assert(distance(trained.int8.x, target) < baseline + int8Error, Optimizer.name);
+        assert.strictEqual(trained.float32.bytes * 2, trained.float64.bytes);
+        assert(trained.int8.bytes * 7 < trained.float64.bytes);
+      }
+    });
+    it('applies sparse grads to 8-bit slots', function() {
+      var n = 1000;
+      for(let Optimizer of [optim.AdaGrad, optim.FreeRex]) {
+        let sparse = new autograd.Variable(tensor.zerosLike([n]));
+        let dense = new autograd.Variable(tensor.zerosLike([n]));
+        let sparseOpt = new Optimizer({lr: 0.3, vars: [sparse], slotType: 'int8'});
+        let denseOpt = new Optimizer({lr: 0.3, vars: [dense]});
+        for(let t=0; t<30; t++) {
+          let pairs = [0, 1, 2].map(k => [k * 300 + t % 5, Math.random() * 4 - 2]);
+          sparse.grad = new tensor.SparseVector(pairs, n);
+          dense.grad = sparse.grad.toDense();
+          sparseOpt.applyGrads([sparse]);
+          denseOpt.applyGrads([dense]);
+        }
+        //the 15 coordinates the grads hold move, by about as much as with float64 slots.
+        for(let i=0; i<n; i++)
+          assert((sparse.data.at(i) === 0) === (dense.data.at(i) === 0), Optimizer.name + ' at ' + i);
+        let error = Math.sqrt(sparse.data.sub(dense.data).square().sum().at(0) / 15);
+        assert(error < 0.15, Optimizer.name);
+      }
+    });
   });
 });
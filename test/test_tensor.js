@@ -42,6 +42,16 @@ describe('Tensor', function() {
       assert.deepEqual(T3.data, [2, 4, 4, 6]);
     });
 
+    it('should keep strides and offsets beyond 2^32 exact', function() {
+      let T = new tensor.Tensor({shape: [2], strides: [Math.pow(2, 32)], data: [1, 2]});
+      assert.equal(T.strides[0], Math.pow(2, 32));
+      //a 32-bit stride would wrap to 0 and silently alias data[0].
+      assert.throws(() => T.sum(), /data buffer too small/);
+
+      let U = new tensor.Tensor({shape: [1], initial_offset: Math.pow(2, 32), data: [1]});
+      assert.throws(() => U.scale(2), /data buffer too small/);
+    });
+
   });
 
   describe('contract', function() {
@@ -153,5 +163,719 @@ describe('Tensor', function() {
       assert.equal(S3.at(1), 3);
       assert.equal(S3.at(2), 0);
     });
+
+    it('should keep nonzeros sorted', function() {
+      let S = new tensor.SparseVector([[9, 1], [2, 5], [4, -1]], 10);
+      S.set(0, 3);
+      S.set(7, 2);
+      S.set(4, 0);
+      assert.deepEqual(S.indices.subarray(0, S.nnz), [0, 2, 7, 9]);
+      assert.deepEqual(S.values.subarray(0, S.nnz), [3, 5, 2, 1]);
+      assert.deepEqual([...S.entries()], [[0, 3], [2, 5], [7, 2], [9, 1]]);
+      assert.deepEqual(S.toDense().data, [3,0,5,0,0,0,0,2,0,1]);
+    });
+
+    it('should copy its nonzeros to a read-only data Map', function() {
+      let S = new tensor.SparseVector([[9, 1], [2, 5]], 10);
+      assert.deepEqual([...S.data], [[2, 5], [9, 1]]);
+      S.data.set(4, 3);
+      assert.equal(S.at(4), 0);
+      assert.throws(() => { 'use strict'; S.data = new Map(); });
+    });
+
+    it('should combine with strided and float32 dense vectors natively', function() {
+      let S = new tensor.SparseVector([[0, 2], [3, -1], [5, 4]], 6);
+      let M = new tensor.Tensor([[1,2],[3,4],[5,6],[7,8],[9,10],[11,12]]);
+      let T = new tensor.Tensor({data: [1,2,3,4,5,6], dtype: 'float32'});
+      assert.equal(S.dot(T).data[0], 2 - 4 + 24);
+      let strided = new tensor.Tensor({shape: [6], strides: [2], initial_offset: 1,
+                                       data: new Float64Array([0,1,0,2,0,3,0,4,0,5,0,6])});
+      assert.equal(S.dot(strided).data[0], 2 - 4 + 24);
+      assert.deepEqual(S.matMul(M).data, [2 - 7 + 44, 4 - 8 + 48]);
+      assert.deepEqual(tensor.mul(S, T).values, [2, -4, 24]);
+      assert.deepEqual(tensor.div(S, 2).values, [1, -0.5, 2]);
+      assert.deepEqual(tensor.scale(S, 3).values, [6, -3, 12]);
+      assert.equal(tensor.sum(S), 5);
+      assert.deepEqual(tensor.sub(S, T).data, [1, -2, -3, -5, -5, -2]);
+
+      let dest = tensor.fillLike([6], 7);
+      tensor.scale(S, 2, dest);
+      assert.deepEqual(dest.data, [4, 0, 0, -2, 0, 8]);
+
+      assert.throws(() => S.dot(new tensor.Tensor([1,2,3])), /DimensionMismatchError/);
+    });
+
+    it('should merge sparse vectors natively', function() {
+      let S1 = new tensor.SparseVector([[1, 2], [4, 3], [8, -1]], 10);
+      let S2 = new tensor.SparseVector([[0, 5], [4, 1], [8, 2], [9, 4]], 10);
+      let sum = tensor.addScale(S1, S2, 2, -1);
+      assert.deepEqual([...sum.entries()], [[0, -5], [1, 4], [4, 5], [8, -4], [9, -4]]);
+      let product = tensor.mul(S1, S2);
+      assert.deepEqual([...product.entries()], [[4, 3], [8, -2]]);
+      assert.equal(product.length, 10);
+      assert.equal(S2.dot(S1).data[0], 1);
+
+      //accumulating into a source takes over the merged arrays
+      let grad = S1.clone();
+      tensor.add(grad, S2, grad);
+      assert.deepEqual(grad.toDense().data, [5, 2, 0, 0, 4, 0, 0, 0, 1, 4]);
+      assert.deepEqual(S1.toDense().data, [0, 2, 0, 0, 3, 0, 0, 0, -1, 0]);
+
+      //one much denser operand is searched rather than stepped through
+      let dense = new tensor.SparseVector([...Array(1000).keys()].map(i => [i, i]));
+      let few = new tensor.SparseVector([[3, 1], [500, 2], [2000, 7]]);
+      assert.equal(dense.dot(few).data[0], 1003);
+      assert.deepEqual([...tensor.mul(dense, few).entries()], [[3, 3], [500, 1000]]);
+    });
+  });
+
+  describe('Sparse Matrix', function() {
+    var M = new tensor.Tensor([[1,0,2],[0,0,3],[4,5,0],[0,0,0]]);
+
+    it('should convert between formats', function() {
+      let S = tensor.sparseMatrix.fromDense(M);
+      assert.equal(S.nnz, 5);
+      assert.deepEqual(S.offsets, [0, 2, 3, 5, 5]);
+      assert.equal(S.at(2, 1), 5);
+      assert.equal(S.at([1, 0]), 0);
+      let C = S.toCSC();
+      assert.equal(C.format, 'csc');
+      assert.deepEqual(C.offsets, [0, 2, 3, 5]);
+      assert.deepEqual(C.toDense().data, M.data);
+      assert.deepEqual(S.transpose().toDense().data, M.transpose().toDataType('float64').data);
+      assert.throws(() => tensor.sparseMatrix.fromEntries([2, 2], [[2, 0, 1]]), /IndexOutOfBounds/);
+    });
+
+    it('should multiply dense vectors and matrices', function() {
+      let v = new tensor.Tensor([1, -1, 2]);
+      let w = new tensor.Tensor([1, 2, 3, 4]);
+      let B = new tensor.Tensor([[1,2],[3,4],[5,6]], 'float32');
+      for(let S of [tensor.sparseMatrix.fromDense(M), tensor.sparseMatrix.fromDense(M, 'csc')]) {
+        assert.deepEqual(S.matMul(v).data, [5, 6, -1, 0]);
+        assert.deepEqual(tensor.matMul(w, S).data, [13, 15, 8]);
+        assert.deepEqual(S.transpose().matMul(w).data, [13, 15, 8]);
+        assert.deepEqual(tensor.matMul(S, B).data, [11, 14, 15, 18, 19, 28, 0, 0]);
+        assert.deepEqual(tensor.denseTensor.contract(B.transpose(), S.transpose(), 1).data, [11, 15, 19, 0, 14, 18, 28, 0]);
+
+        let dest = tensor.fillLike([4], 7).transpose();
+        assert.equal(tensor.matMul(S, v, dest), dest);
+        assert.deepEqual(dest.data, [5, 6, -1, 0]);
+        assert.throws(() => S.matMul(w), /DimensionMismatchError/);
+        assert.throws(() => S.contract(v, 2), /one dimension/);
+      }
+    });
+
+    it('should split large products across threads', function() {
+      let numThreads = tensor.getNumThreads();
+      try {
+        tensor.random.seed(7);
+        let D = tensor.random.uniformLike([500, 300], -1, 1);
+        let X = tensor.random.normalLike([300, 20], 0, 1);
+        let Y = tensor.random.normalLike([500, 20], 0, 1);
+        D.data.forEach((value, i) => { if(value < 0.8) D.data[i] = 0; });
+        let S = tensor.sparseMatrix.fromDense(D);
+        let expected = [tensor.matMul(D, X), tensor.matMul(D.transpose(), Y)];
+        for(let threads of [1, 3]) {
+          tensor.setNumThreads(threads);
+          for(let T of [S, S.toCSC()]) {
+            let products = [T.matMul(X), T.transpose().matMul(Y)];
+            products.forEach((P, k) => {
+              assert(P.data.every((value, i) => Math.abs(value - expected[k].data[i]) < 1e-9));
+            });
+          }
+        }
+      } finally {
+        tensor.setNumThreads(numThreads);
+      }
+    });
+  });
+
+  describe('COO Tensor', function() {
+    it('should coalesce repeated coordinates', function() {
+      let S = new tensor.CooTensor([2, 3, 2], [
+        [[1, 2, 0], 4], [[0, 1, 1], 2], [[1, 2, 0], -1], [[0, 0, 1], 5]]);
+      assert.equal(S.at([1, 2, 0]), 3);
+      S.coalesce();
+      assert.equal(S.nnz, 3);
+      assert.deepEqual([...S.entries()], [[[0, 0, 1], 5], [[0, 1, 1], 2], [[1, 2, 0], 3]]);
+      let D = S.toDense();
+      assert.deepEqual(tensor.cooTensor.fromDense(D).toDense().data, D.data);
+      assert.deepEqual(S.transpose().toDense().data, D.transpose().toDataType('float64').data);
+    });
+
+    it('should contract with dense tensors', function() {
+      tensor.random.seed(3);
+      let D = tensor.random.uniformLike([4, 5, 6], -1, 1);
+      D.data.forEach((value, i) => { if(value < 0.5) D.data[i] = 0; });
+      let S = tensor.cooTensor.fromDense(D);
+      let A = tensor.random.normalLike([6, 3], 0, 1);
+      let B = tensor.random.normalLike([6, 5, 2], 0, 1, 'float32');
+      let C = tensor.random.normalLike([7, 4], 0, 1);
+      let close = (X, Y) => X.data.every((value, i) => Math.abs(value - Y.data[i]) < 1e-5);
+
+      for(let threads of [1, 3]) {
+        let numThreads = tensor.getNumThreads();
+        tensor.setNumThreads(threads);
+        try {
+          assert(close(S.contract(A, 1), D.contract(A, 1)));
+          assert(close(S.contract(B, 2), D.contract(B, 2)));
+          assert(close(tensor.matMul(C, S), C.contract(D, 1)));
+          assert(close(S.contract(D.transpose(), 3), D.contract(D.transpose(), 3)));
+          let dest = tensor.zerosLike([3, 5, 4]).transpose();
+          assert.equal(S.contract(A.transpose().transpose(), 1, dest), dest);
+          assert(close(dest.toDataType('float64'), D.contract(A, 1)));
+        } finally {
+          tensor.setNumThreads(numThreads);
+        }
+      }
+      assert.throws(() => S.contract(A, 2), /DimensionMismatchError/);
+    });
+  });
+
+  describe('decompositions', function() {
+    //sum_r A[:, r] o B[:, r] o C[:, r]
+    function cpTensor(A, B, C) {
+      let X = tensor.zerosLike([A.shape[0], B.shape[0], C.shape[0]]);
+      for(let i=0; i<A.shape[0]; i++)
+        for(let j=0; j<B.shape[0]; j++)
+          for(let k=0; k<C.shape[0]; k++) {
+            let value = 0;
+            for(let r=0; r<A.shape[1]; r++)
+              value += A.at([i, r]) * B.at([j, r]) * C.at([k, r]);
+            X.set([i, j, k], value);
+          }
+      return X;
+    }
+
+    it('should compute mttkrp of dense and sparse tensors', function() {
+      tensor.random.seed(5);
+      let X = tensor.random.uniformLike([4, 3, 5, 2], -1, 1);
+      X.data.forEach((value, i) => { if(value < 0) X.data[i] = 0; });
+      let S = tensor.cooTensor.fromDense(X);
+      let factors = [...X.shape].map(size => tensor.random.normalLike([size, 3], 0, 1));
+      let close = (Y, Z) => Y.data.every((value, i) => Math.abs(value - Z.data[i]) < 1e-9);
+
+      for(let threads of [1, 3]) {
+        let numThreads = tensor.getNumThreads();
+        tensor.setNumThreads(threads);
+        try {
+          for(let mode=0; mode<4; mode++) {
+            let expected = tensor.zerosLike([X.shape[mode], 3]);
+            for(let i=0; i<X.totalSize(); i++) {
+              let coords = [], rest = i;
+              for(let d=3; d>=0; d--) {
+                coords[d] = rest % X.shape[d];
+                rest = Math.floor(rest / X.shape[d]);
+              }
+              for(let r=0; r<3; r++) {
+                let value = X.data[i];
+                factors.forEach((factor, m) => { if(m !== mode) value *= factor.at([coords[m], r]); });
+                expected.set([coords[mode], r], expected.at([coords[mode], r]) + value);
+              }
+            }
+            assert(close(tensor.decompose.mttkrp(X, factors, mode), expected));
+            assert(close(tensor.decompose.mttkrp(S, factors, mode), expected));
+          }
+        } finally {
+          tensor.setNumThreads(numThreads);
+        }
+      }
+      assert.throws(() => tensor.decompose.mttkrp(X, factors.slice(1), 0), /DimensionMismatchError/);
+    });
+
+    it('should recover low rank tensors', function() {
+      tensor.random.seed(8);
+      let [A, B, C] = [6, 5, 4].map(size => tensor.random.uniformLike([size, 2], 0, 1));
+      let X = cpTensor(A, B, C);
+      let fits = [];
+      let cp = tensor.decompose.cpALS(X, 2, {maxIterations: 500, tolerance: 1e-12,
+                                             onIteration: ({fit}) => fits.push(fit)});
+      assert(cp.fit > 0.9999, 'cp fit ' + cp.fit);
+      assert.equal(fits.length, cp.iterations.length);
+      let [A2, B2, C2] = cp.factors;
+      let model = cpTensor(A2.mul(new tensor.Tensor([...cp.weights])), B2, C2);
+      assert(model.data.every((value, i) => Math.abs(value - X.data[i]) < 1e-3));
+
+      let sparse = tensor.decompose.cpALS(tensor.cooTensor.fromDense(X), 2,
+                                          {maxIterations: 500, tolerance: 1e-12});
+      assert(sparse.fit > 0.9999, 'sparse cp fit ' + sparse.fit);
+
+      //a tensor of multilinear rank (2, 2, 2) has an exact Tucker decomposition.
+      let [U, V, W] = [6, 5, 4].map(size => tensor.random.normalLike([size, 2], 0, 1));
+      let G = tensor.random.normalLike([2, 2, 2], 0, 1);
+      let Y = G;
+      [U, V, W].forEach((factor, m) => { Y = tensor.decompose.modeProduct(Y, factor.transpose(), m); });
+      for(let input of [Y, tensor.cooTensor.fromDense(Y)]) {
+        let tucker = tensor.decompose.tucker(input, [2, 2, 2]);
+        assert(tucker.fit > 0.9999, 'tucker fit ' + tucker.fit);
+        assert.deepEqual([...tucker.core.shape], [2, 2, 2]);
+        let gram = tucker.factors[1].transpose().contract(tucker.factors[1], 1);
+        assert(Math.abs(gram.at([0, 0]) - 1) < 1e-9 && Math.abs(gram.at([0, 1])) < 1e-9);
+      }
+    });
+  });
+
+  describe('Kronecker products', function() {
+    it('should form Kronecker and Khatri-Rao products', function() {
+      let A = new tensor.Tensor([[1, 2], [3, 4], [5, 6]]);
+      let B = new tensor.Tensor([[0, 1], [-1, 2]]);
+      let K = tensor.kronecker(A, B);
+      assert.deepEqual([...K.shape], [6, 4]);
+      for(let i=0; i<3; i++)
+        for(let j=0; j<2; j++)
+          for(let a=0; a<2; a++)
+            for(let b=0; b<2; b++)
+              assert.equal(K.at([i*2 + j, a*2 + b]), A.at([i, a]) * B.at([j, b]));
+      assert.deepEqual(tensor.kronecker(A.transpose(), B.transpose(), tensor.zerosLike([4, 6], 'float32')).data,
+                       new Float32Array(K.transpose().toDataType('float32').data));
+      assert.deepEqual([...tensor.kronecker(new tensor.Tensor([1, 2]), new tensor.Tensor([3, 4, 5])).data],
+                       [3, 4, 5, 6, 8, 10]);
+
+      let R = tensor.khatriRao(A, B);
+      assert.deepEqual([...R.shape], [6, 2]);
+      for(let i=0; i<6; i++)
+        for(let r=0; r<2; r++)
+          assert.equal(R.at([i, r]), A.at([Math.floor(i / 2), r]) * B.at([i % 2, r]));
+      assert.throws(() => tensor.khatriRao(A, B.transpose().contract(A.transpose(), 1)), /DimensionMismatchError/);
+    });
+
+    it('should multiply by Kronecker products without forming them', function() {
+      tensor.random.seed(4);
+      let close = (X, Y, tolerance) => X.data.every((value, i) => Math.abs(value - Y.data[i]) < tolerance);
+      //shapes for which either factor is applied first.
+      for(let [m, n, p, q] of [[3, 4, 5, 2], [6, 2, 2, 7]]) {
+        let A = tensor.random.normalLike([m, n], 0, 1);
+        let B = tensor.random.normalLike([p, q], 0, 1);
+        let K = tensor.kronecker(A, B);
+        let x = tensor.random.normalLike([n*q], 0, 1);
+        let X = tensor.random.normalLike([n*q, 3], 0, 1);
+        assert(close(tensor.kroneckerMultiply(A, B, x), K.contract(x, 1), 1e-12));
+        assert(close(tensor.kroneckerMultiply(A, B, X), K.contract(X, 1), 1e-12));
+        let At = A.transpose().toDataType('float64').transpose();
+        let dest = tensor.zerosLike([3, m*p]).transpose();
+        assert.equal(tensor.kroneckerMultiply(At, B.toDataType('float32'), X, dest), dest);
+        assert(close(dest.toDataType('float64'), K.contract(X, 1), 1e-4));
+      }
+      assert.throws(() => tensor.kroneckerMultiply(tensor.zerosLike([2, 2]), tensor.zerosLike([2, 2]),
+                                                   tensor.zerosLike([5])), /DimensionMismatchError/);
+    });
+  });
+
+  describe('linear algebra', function() {
+    let close = (X, Y, tolerance) => X.data.every((value, i) => Math.abs(value - Y.data[i]) < tolerance);
+
+    //a well-conditioned symmetric positive definite n x n matrix.
+    function spd(n, dtype) {
+      let B = tensor.random.normalLike([n, n], 0, 1);
+      let A = B.contract(B.transpose(), 1);
+      for(let i=0; i<n; i++)
+        A.set([i, i], A.at([i, i]) + n);
+      return dtype === undefined ? A : A.toDataType(dtype);
+    }
+
+    it('should factor positive definite matrices', function() {
+      tensor.random.seed(11);
+      //larger than a block, with a partial last block.
+      let A = spd(150);
+      for(let threads of [1, 3]) {
+        let numThreads = tensor.getNumThreads();
+        tensor.setNumThreads(threads);
+        try {
+          let L = tensor.linalg.cholesky(A);
+          assert.equal(L.at([3, 100]), 0);
+          assert(close(L.contract(L.transpose(), 1), A, 1e-9));
+        } finally {
+          tensor.setNumThreads(numThreads);
+        }
+      }
+      let B = A.clone();
+      assert.equal(tensor.linalg.cholesky(B, B), B);
+      assert(close(B.contract(B.transpose(), 1), A, 1e-9));
+
+      let A32 = spd(70, 'float32');
+      let L32 = tensor.linalg.cholesky(A32);
+      assert.equal(L32.dtype, 'float32');
+      assert(close(L32.contract(L32.transpose(), 1), A32, 1e-2));
+
+      let indefinite = new tensor.Tensor([[1, 2], [2, 1]]);
+      assert.throws(() => tensor.linalg.cholesky(indefinite), /NotPositiveDefiniteError/);
+    });
+
+    it('should solve triangular systems and least squares', function() {
+      tensor.random.seed(12);
+      let A = spd(90);
+      let L = tensor.linalg.cholesky(A);
+      let b = tensor.random.normalLike([90], 0, 1);
+      let B = tensor.random.normalLike([90, 4], 0, 1);
+      assert(close(L.contract(tensor.linalg.triangularSolve(L, b), 1), b, 1e-9));
+      let U = L.transpose().toDataType('float64');
+      assert(close(U.contract(tensor.linalg.triangularSolve(U, B, {lower: false}), 1), B, 1e-9));
+      assert(close(U.contract(tensor.linalg.triangularSolve(L, B, {transpose: true}), 1), B, 1e-9));
+      let X = B.clone();
+      tensor.linalg.choleskySolve(L, X, X);
+      assert(close(A.contract(X, 1), B, 1e-9));
+
+      let M = tensor.random.normalLike([200, 30], 0, 1);
+      let x = tensor.random.normalLike([30], 0, 1);
+      assert(close(tensor.linalg.leastSquares(M, M.contract(x, 1)), x, 1e-9));
+      //the normal equations of the residual are satisfied.
+      let y = tensor.random.normalLike([200, 2], 0, 1);
+      let solution = tensor.linalg.leastSquares(M, y, {ridge: 0.5});
+      let residual = M.contract(solution, 1).sub(y);
+      let gradient = M.transpose().contract(residual, 1).add(solution.scale(0.5));
+      assert(gradient.data.every(value => Math.abs(value) < 1e-9));
+      assert.throws(() => tensor.linalg.leastSquares(tensor.zerosLike([5, 2]), tensor.zerosLike([5])),
+                    /NotPositiveDefiniteError/);
+    });
+
+    it('should compute QR and singular value decompositions', function() {
+      tensor.random.seed(13);
+      let identity = n => {
+        let I = tensor.zerosLike([n, n]);
+        for(let i=0; i<n; i++)
+          I.set([i, i], 1);
+        return I;
+      };
+      //nearly dependent columns take the shifted path.
+      let Y = tensor.random.normalLike([300, 12], 0, 1);
+      for(let i=0; i<300; i++)
+        Y.set([i, 11], Y.at([i, 10]) + 1e-9 * Y.at([i, 11]));
+      for(let input of [tensor.random.normalLike([300, 12], 0, 1), Y]) {
+        let {Q, R} = tensor.linalg.qr(input);
+        assert(close(Q.transpose().contract(Q, 1), identity(12), 1e-12));
+        assert(close(Q.contract(R, 1), input, 1e-9));
+        assert.equal(R.at([5, 2]), 0);
+      }
+
+      let A = tensor.random.normalLike([7, 5], 0, 1);
+      for(let matrix of [A, A.transpose()]) {
+        let {U, S, V} = tensor.linalg.svd(matrix);
+        assert(S.data.every((value, i) => i === 0 || value <= S.data[i-1]));
+        assert(close(U.mul(S).contract(V.transpose(), 1), matrix.toDataType('float64'), 1e-12));
+        assert(close(V.transpose().contract(V, 1), identity(5), 1e-12));
+      }
+
+      //a rank 8 matrix plus a little noise.
+      let low = tensor.random.normalLike([400, 8], 0, 1).contract(tensor.random.normalLike([8, 250], 0, 1), 1);
+      let M = low.add(tensor.random.normalLike([400, 250], 0, 1e-6));
+      let exact = tensor.linalg.svd(M);
+      let {U, S, V} = tensor.linalg.randomizedSVD(M, 8);
+      assert.deepEqual([...U.shape], [400, 8]);
+      assert.deepEqual([...V.shape], [250, 8]);
+      assert(S.data.every((value, i) => Math.abs(value - exact.S.data[i]) < 1e-6 * exact.S.data[0]));
+      assert(close(U.mul(S).contract(V.transpose(), 1), M, 1e-4));
+
+      //float32 sketches of low-rank matrices are too ill-conditioned for float32 Gram matrices.
+      for(let noise of [0, 1e-4]) {
+        let low32 = tensor.random.normalLike([300, 5], 0, 1).contract(tensor.random.normalLike([5, 200], 0, 1), 1);
+        let M32 = low32.add(tensor.random.normalLike([300, 200], 0, noise)).toDataType('float32');
+        let exact32 = tensor.linalg.svd(M32);
+        let result = tensor.linalg.randomizedSVD(M32, 3);
+        assert.equal(result.S.dtype, 'float32');
+        assert(result.S.data.every((value, i) => Math.abs(value - exact32.S.data[i]) < 1e-4 * exact32.S.data[0]));
+        assert(close(result.U.transpose().contract(result.U, 1), identity(3), 1e-4));
+      }
+    });
+  });
+
+  describe('mixed precision', function() {
+    it('should construct float32 tensors', function() {
+      let T = new tensor.Tensor({shape: [2,2], dtype: 'float32'});
+      assert(T.data instanceof Float32Array);
+      assert.equal(T.dtype, 'float32');
+      let T2 = new tensor.Tensor({data: new Float32Array([1,2,3])});
+      assert.equal(T2.dtype, 'float32');
+    });
+
+    it('should keep float32 storage through elementwise ops', function() {
+      let T1 = new tensor.Tensor({data: [1,2,3], dtype: 'float32'});
+      let T2 = new tensor.Tensor([1,1,1]);
+      let T3 = T1.add(T2);
+      assert.equal(T3.dtype, 'float32');
+      assert.deepEqual(T3.data, [2,3,4]);
+      assert.deepEqual(T1.exp().log().round().data, [1,2,3]);
+      assert.deepEqual(T1.max(2).data, [2,2,3]);
+    });
+
+    it('should accumulate float32 sums in double precision', function() {
+      let n = 1000000;
+      let T = tensor.fillLike([n], 0.1, 'float32');
+      let expected = n * Math.fround(0.1);
+      assert(Math.abs(T.sum().data[0] - expected) < 1e-6);
+    });
+
+    it('should contract float32 and mixed storage tensors', function() {
+      let T1 = new tensor.Tensor({data: [[1,2],[3,4]], dtype: 'float32'});
+      let T2 = new tensor.Tensor([[2,3],[4,5]]);
+      assert.deepEqual(T1.matMul(T2).data, [10,13,22,29]);
+      assert.deepEqual(T1.matMul(T2.toDataType('float32')).data, [10,13,22,29]);
+
+      let v = new tensor.Tensor({data: [1,2], dtype: 'float32'});
+      assert.deepEqual(v.dot(v).data, [5]);
+      assert.deepEqual(v.dot(new tensor.Tensor([1,2])).data, [5]);
+
+      let T3 = new tensor.Tensor({data: [[[1,2],[3,4]],[[5,6],[7,8]]], dtype: 'float32'});
+      assert.deepEqual(T3.contract(new tensor.Tensor([1,2]), 1).data, [5,11,17,23]);
+    });
+
+    it('should honor the default dtype', function() {
+      tensor.setDefaultDataType('float32');
+      try {
+        assert.equal(tensor.zerosLike([3]).dtype, 'float32');
+        assert.equal(tensor.random.normalLike([3], 0, 1).dtype, 'float32');
+      } finally {
+        tensor.setDefaultDataType('float64');
+      }
+      assert.equal(tensor.zerosLike([3]).dtype, 'float64');
+    });
+
+    it('should not let numbers pick the precision of a result', function() {
+      let T = new tensor.Tensor({data: [1, 2], dtype: 'float64'});
+      tensor.setDefaultDataType('float32');
+      try {
+        let sum = T.add(0.1);
+        assert.equal(sum.dtype, 'float64');
+        assert.deepEqual(sum.data, [1.1, 2.1]);
+        assert.equal(T.scale(0.1).mul(0.3).dtype, 'float64');
+        assert.equal(T.toDataType('float32').add(0.1).dtype, 'float32');
+      } finally {
+        tensor.setDefaultDataType('float64');
+      }
+    });
+  });
+
+  describe('fused expressions', function() {
+    it('should match the equivalent chain of ops', function() {
+      let x = new tensor.Tensor([[1,-2,3],[0.5,4,-1]]);
+      let y = new tensor.Tensor([[1,1,-1],[2,0.5,-3]]);
+      let logistic = tensor.fused.compile((x, y) => x.mul(y).neg().exp().add(1).log());
+      let expected = x.mul(y).scale(-1).exp().add(1).log();
+      let result = logistic(x, y);
+      assert.deepEqual(result.shape, [2,3]);
+      for(let i=0; i<6; i++) {
+        assert(Math.abs(result.data[i] - expected.data[i]) < 1e-12);
+      }
+
+      let dest = tensor.zerosLike(x);
+      assert.equal(logistic(x, y, dest), dest);
+      assert.deepEqual(dest.data, result.data);
+    });
+
+    it('should broadcast tensors, numbers and strided views', function() {
+      let T = new tensor.Tensor([[1,2],[3,4]]);
+      let row = new tensor.Tensor([10,20]);
+      let f = tensor.fused.compile((a, b, c) => a.add(b).mul(c).sub(1));
+      assert.deepEqual(f(T, row, 2).data, [21, 43, 25, 47]);
+      assert.deepEqual(f(T.transpose(), row, 2).data, [21, 45, 23, 47]);
+
+      //more elements than one tile
+      let big = tensor.onesLike([3, 1000]);
+      let scaled = tensor.fused.compile(a => a.scale(3).square())(big);
+      assert.equal(scaled.sum().data[0], 27000);
+    });
+
+    it('should reject mismatched shapes', function() {
+      let f = tensor.fused.compile((a, b) => a.add(b));
+      assert.throws(() => f(tensor.onesLike([3]), tensor.onesLike([2]), tensor.zerosLike([3])),
+                    /DimensionMismatchError/);
+    });
+  });
+
+  describe('lazy evaluation', function() {
+    function withLazy(func) {
+      tensor.setLazyEvaluation(true);
+      try {
+        func();
+      } finally {
+        tensor.setLazyEvaluation(false);
+      }
+    }
+
+    it('should defer and fuse chains of ops', function() {
+      let x = new tensor.Tensor([[1,-2,3],[0.5,4,-1]]);
+      let y = new tensor.Tensor([1,-1,2]);
+      let expected = x.mul(y).scale(-1).exp().add(1).log();
+      withLazy(() => {
+        let evaluations = tensor.lazy.stats.evaluations;
+        let unused = x.exp().sqrt();
+        let T = x.mul(y).scale(-1).exp().add(1).log();
+        assert(tensor.lazy.isPending(T));
+        assert.deepEqual(T.shape, [2,3]);
+        assert.equal(tensor.lazy.stats.evaluations, evaluations);
+
+        for(let i=0; i<6; i++) {
+          assert(Math.abs(T.data[i] - expected.data[i]) < 1e-12);
+        }
+        assert(!tensor.lazy.isPending(T));
+        assert(tensor.lazy.isPending(unused));
+        assert.equal(tensor.lazy.stats.evaluations, evaluations + 1);
+        assert.equal(T.add(1).sum().data[0], expected.sum().data[0] + 6);
+      });
+    });
+
+    it('should evaluate pending ops before their inputs are overwritten', function() {
+      let x = new tensor.Tensor([1,2,3]);
+      withLazy(() => {
+        let doubled = x.scale(2);
+        let plusOne = doubled.add(1);
+        tensor.scale(x, 10, x);
+        x.set(0, -1);
+        assert.deepEqual(doubled.data, [2,4,6]);
+        tensor.add(doubled, doubled, doubled);
+        assert.deepEqual(plusOne.data, [3,5,7]);
+        assert.deepEqual(x.data, [-1,20,30]);
+      });
+    });
+
+    it('should evaluate into an explicit dest in one pass', function() {
+      let x = new tensor.Tensor([1,2,3]);
+      let dest = tensor.zerosLike(x);
+      withLazy(() => {
+        let evaluations = tensor.lazy.stats.evaluations;
+        assert.equal(tensor.add(x.square(), x.scale(3), dest), dest);
+        assert.equal(tensor.lazy.stats.evaluations, evaluations + 1);
+        assert.deepEqual(dest.data, [4, 10, 18]);
+      });
+    });
+
+    it('should split long chains that mix pending and input tensors', function() {
+      let x = new tensor.Tensor([1,-2,3]);
+      let expected = x;
+      for(let i=0; i<40; i++)
+        expected = expected.add(x).scale(0.5);
+      withLazy(() => {
+        let y = x;
+        for(let i=0; i<40; i++)
+          y = y.add(x).scale(0.5);
+        for(let i=0; i<3; i++)
+          assert(Math.abs(y.data[i] - expected.data[i]) < 1e-12);
+      });
+    });
+  });
+
+  describe('async ops', function() {
+    it('should resolve to the same results as the synchronous ops', function() {
+      let A = tensor.random.normalLike([30, 20], 0, 1);
+      let B = tensor.random.normalLike([20, 10], 0, 1);
+      let expected = tensor.matMul(A, B);
+      return tensor.async.matMul(A, B).then(C => {
+        assert.deepEqual(C.shape, [30, 10]);
+        for(let i=0; i<C.data.length; i++) {
+          assert(Math.abs(C.data[i] - expected.data[i]) < 1e-12);
+        }
+        return tensor.async.sum(C);
+      }).then(total => {
+        assert(Math.abs(total.data[0] - expected.sum().data[0]) < 1e-9);
+      });
+    });
+
+    it('should run several ops concurrently', function() {
+      let x = new tensor.Tensor([1, 2, 3]);
+      let y = new tensor.Tensor([4, 5, 6]);
+      let filled = tensor.zerosLike([1000]);
+      return Promise.all([
+        tensor.async.add(x, y),
+        tensor.async.scale(x, 2),
+        tensor.async.exp(x),
+        tensor.async.max(x, 2),
+        tensor.async.fillUniform(2, 3, filled)
+      ]).then(([sum, scaled, exp, max, uniform]) => {
+        assert.deepEqual(sum.data, [5, 7, 9]);
+        assert.deepEqual(scaled.data, [2, 4, 6]);
+        assert.deepEqual(exp.data, x.exp().data);
+        assert.deepEqual(max.data, [2, 2, 3]);
+        assert.equal(uniform, filled);
+        assert(filled.data.every(value => value >= 2 && value <= 3));
+      });
+    });
+
+    it('should reject on invalid arguments', function() {
+      let dest = tensor.zerosLike([3]);
+      return tensor.async.add(tensor.onesLike([3]), tensor.onesLike([2]), dest).then(
+        () => assert.fail('expected a rejection'),
+        error => assert(/DimensionMismatchError/.test(error.message)));
+    });
+  });
+
+  describe('shared tensors', function() {
+    it('should be backed by a SharedArrayBuffer', function() {
+      let T = new tensor.Tensor({data: [[1,2],[3,4]], shared: true});
+      assert(T.data.buffer instanceof SharedArrayBuffer);
+      assert.deepEqual(T.data, [1,2,3,4]);
+      let U = new tensor.Tensor([[1,2],[3,4]]).transpose().toShared();
+      assert(tensor.denseTensor.isShared(U));
+      assert.deepEqual(U.data, [1,3,2,4]);
+      assert.equal(U.toShared(), U);
+      assert.deepEqual(tensor.add(T, U).data, [2,5,5,8]);
+    });
+
+    it('should be processed in parallel by worker threads', function() {
+      let pool = new tensor.parallel.WorkerPool(2);
+      let X = tensor.random.normalLike([101, 7], 0, 1).toShared();
+      let Y = tensor.zerosLike(X).toShared();
+      let offset = new tensor.Tensor({data: [1,2,3,4,5,6,7], shared: true});
+      return pool.map((x, y, offset, factor, chunk) => {
+        tensor.add(x, offset, y);
+        tensor.scale(y, factor, y);
+        return chunk.end - chunk.start;
+      }, [X, Y, tensor.parallel.whole(offset), 2], {numTasks: 4}).then(rows => {
+        assert.deepEqual(rows, [25, 25, 25, 26]);
+        let expected = tensor.add(X, offset).scale(2);
+        assert.deepEqual(Y.data, expected.data);
+        return pool.map(x => { throw new Error('failed on ' + x.shape[0]); }, [X]);
+      }).then(() => assert.fail('expected a rejection'), error => {
+        assert(/failed on 5\d/.test(error.message));
+        return tensor.parallel.map(x => x, [tensor.zerosLike([3])]).then(
+          () => assert.fail('expected a rejection'),
+          error => assert(/shared/.test(error.message)));
+      }).then(() => pool.terminate(), error => {
+        pool.terminate();
+        throw error;
+      });
+    });
+  });
+
+  describe('random', function() {
+    it('should be reproducible after seeding', function() {
+      tensor.random.seed(1234);
+      let A = tensor.random.normalLike([5, 7], 0, 1);
+      let B = tensor.random.uniformLike([3], -1, 1);
+      tensor.random.seed(1234);
+      assert.deepEqual(tensor.random.normalLike([5, 7], 0, 1).data, A.data);
+      assert.deepEqual(tensor.random.uniformLike([3], -1, 1).data, B.data);
+      assert(B.data.every(value => value >= -1 && value < 1));
+
+      //strided and float32 dests get the same values in index order
+      tensor.random.seed(1234);
+      let transposed = tensor.zerosLike([7, 5]).transpose().fillNormal(0, 1);
+      assert.deepEqual(transposed.toDataType('float64').data, A.data);
+      tensor.random.seed(1234);
+      let single = tensor.random.normalLike([5, 7], 0, 1, 'float32');
+      assert.deepEqual(single.data, new Float32Array(A.data));
+      tensor.random.seed(1234);
+      return tensor.async.fillNormal(0, 1, tensor.zerosLike([5, 7])).then(T => {
+        assert.deepEqual(T.data, A.data);
+      });
+    });
+
+    it('should not depend on the number of threads', function() {
+      let numThreads = tensor.random.getNumThreads();
+      try {
+        tensor.random.setNumThreads(1);
+        tensor.random.seed(99);
+        let serial = tensor.random.normalLike([300, 401], 2, 3);
+        tensor.random.setNumThreads(4);
+        tensor.random.seed(99);
+        let parallel = tensor.random.normalLike([300, 401], 2, 3);
+        assert.deepEqual(parallel.data, serial.data);
+
+        let mean = serial.sum().data[0] / serial.data.length;
+        let variance = tensor.sub(serial, mean).square().sum().data[0] / serial.data.length;
+        assert(Math.abs(mean - 2) < 0.05);
+        assert(Math.abs(variance - 9) < 0.1);
+      } finally {
+        tensor.random.setNumThreads(numThreads);
+      }
+    });
   });
 });
\ No newline at end of file